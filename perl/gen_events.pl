@@ -146,6 +146,95 @@ END
     $delim = ',';
 }
 
-print  OUTFILE "};\n";
+print  OUTFILE "};\n\n";
+
+# Build a perfect hash over the distinct event names (hash and displace).
+# Names are hashed with 32 bit FNV-1a, the basis is XORed with the seed.
+# A first hash (seed 0) selects the bucket, the per bucket displacement is
+# the seed of the second hash that selects the slot. Events sharing a name
+# but with different counter limits are chained through the next array.
+# The same hash function is implemented in perfmon.c (perfmon_hashString).
+sub fnv_hash
+{
+    my ($seed, $str) = @_;
+    my $hash = (2166136261 ^ $seed) & 0xFFFFFFFF;
+    foreach my $c (unpack("C*", $str))
+    {
+        $hash ^= $c;
+        $hash = ($hash * 16777619) & 0xFFFFFFFF;
+    }
+    return $hash;
+}
+
+my @names = ();
+my %first = ();
+my @next = ();
+my %last = ();
+for (my $i = 0; $i < $num_events; $i++)
+{
+    my $name = $events[$i]->{name};
+    $next[$i] = -1;
+    if (exists $first{$name})
+    {
+        $next[$last{$name}] = $i;
+    }
+    else
+    {
+        $first{$name} = $i;
+        push(@names, $name);
+    }
+    $last{$name} = $i;
+}
+
+my $num_names = scalar(@names);
+my $num_buckets = int($num_names / 4) + 1;
+my $num_slots = $num_names + int($num_names / 4) + 1;
+my @buckets = ();
+my @disp = (0) x $num_buckets;
+my @slots = (-1) x $num_slots;
+foreach my $name (@names)
+{
+    push(@{$buckets[fnv_hash(0, $name) % $num_buckets]}, $name);
+}
+my @order = sort { scalar(@{$buckets[$b] || []}) <=> scalar(@{$buckets[$a] || []}) or $a <=> $b } (0..$num_buckets-1);
+foreach my $bucket (@order)
+{
+    my @keys = @{$buckets[$bucket] || []};
+    last if (scalar(@keys) == 0);
+    my $d = 1;
+    while (1)
+    {
+        my %used = ();
+        my $ok = 1;
+        foreach my $key (@keys)
+        {
+            my $slot = fnv_hash($d, $key) % $num_slots;
+            if ($slots[$slot] >= 0 or exists $used{$slot})
+            {
+                $ok = 0;
+                last;
+            }
+            $used{$slot} = $first{$key};
+        }
+        if ($ok)
+        {
+            foreach my $slot (keys %used)
+            {
+                $slots[$slot] = $used{$slot};
+            }
+            $disp[$bucket] = $d;
+            last;
+        }
+        $d++;
+        die "Cannot create event hash for $arch\n" if ($d > 0xFFFFFF);
+    }
+}
+
+print OUTFILE "#define NUM_ARCH_EVENTS_HASH_BUCKETS_$ucArch $num_buckets\n";
+print OUTFILE "#define NUM_ARCH_EVENTS_HASH_SLOTS_$ucArch $num_slots\n\n";
+print OUTFILE "static uint32_t ".$arch."_arch_events_disp[NUM_ARCH_EVENTS_HASH_BUCKETS_$ucArch] = {".join(",", @disp)."};\n";
+print OUTFILE "static int ".$arch."_arch_events_slots[NUM_ARCH_EVENTS_HASH_SLOTS_$ucArch] = {".join(",", @slots)."};\n";
+print OUTFILE "static int ".$arch."_arch_events_next[NUM_ARCH_EVENTS_$ucArch] = {".join(",", @next)."};\n\n";
+print OUTFILE "static PerfmonEventHash ".$arch."_arch_events_hash = {NUM_ARCH_EVENTS_HASH_BUCKETS_$ucArch, NUM_ARCH_EVENTS_HASH_SLOTS_$ucArch, ".$arch."_arch_events_disp, ".$arch."_arch_events_slots, ".$arch."_arch_events_next};\n";
 close OUTFILE;
 
@@ -0,0 +1,148 @@
+#!/usr/bin/perl
+
+# Precompiles the performance group files groups/<ARCH>/*.txt into one
+# catalog per architecture (<OUTDIR>/<ARCH>/catalog.lua). The catalog is a
+# Lua chunk returning the already parsed group data, likwid.lua loads it
+# with a single loadfile() instead of listing and parsing every group file.
+
+use strict;
+use warnings;
+use File::Path qw(make_path);
+
+if (! $ARGV[1] ){
+    die "ERROR: Usage: perl ./$0 <GROUPDIR> <OUTDIR>\n\n";
+}
+
+my $GROUP_dir = $ARGV[0];
+my $OUT_dir = $ARGV[1];
+
+sub quote
+{
+    my $str = shift;
+    $str =~ s/\\/\\\\/g;
+    $str =~ s/"/\\"/g;
+    $str =~ s/\n/\\n/g;
+    $str =~ s/\r/\\r/g;
+    $str =~ s/\t/\\t/g;
+    return "\"$str\"";
+}
+
+sub trim
+{
+    my $str = shift;
+    $str =~ s/^\s+//;
+    $str =~ s/\s+$//;
+    return $str;
+}
+
+# Same state machine as get_groupdata() in likwid.lua
+sub parse_group
+{
+    my ($name, $filename) = @_;
+    my %group = (ShortDescription => undef,
+                 EventString => "",
+                 Events => [],
+                 Metrics => [],
+                 LongDescription => "",
+                 GroupString => $name);
+    my $parse_eventset = 0;
+    my $parse_metrics = 0;
+    my $parse_long = 0;
+
+    open GROUPFILE, "<$filename" or die "Cannot open $filename\n";
+    my $content = do { local $/; <GROUPFILE> };
+    close GROUPFILE;
+
+    foreach my $line (split(/\n/, $content, -1))
+    {
+        if (($parse_eventset or $parse_metrics or $parse_long) and length($line) == 0)
+        {
+            $parse_eventset = 0;
+            $parse_metrics = 0;
+            $parse_long = 0;
+        }
+        if ($line =~ /^SHORT[A-Za-z]*/)
+        {
+            my @list = split(/\s+/, $line, -1);
+            shift @list;
+            $group{ShortDescription} = join(" ", @list);
+        }
+        $parse_eventset = 1 if ($line =~ /^EVENTSET$/);
+        $parse_metrics = 1 if ($line =~ /^METRICS$/);
+        $parse_long = 1 if ($line =~ /^LONG$/);
+
+        if ($parse_eventset and $line !~ /^EVENTSET$/)
+        {
+            my @list = split(/\s+/, trim($line));
+            my $eventstring = join(":", $list[1], $list[0], @list[2..$#list]);
+            $group{EventString} .= ",".$eventstring;
+            push(@{$group{Events}}, {Event => $list[1], Counter => $list[0]});
+        }
+        if ($parse_metrics and $line !~ /^METRICS$/)
+        {
+            my @list = split(/\s+/, trim($line));
+            my $formula = pop @list;
+            push(@{$group{Metrics}}, {description => join(" ", @list),
+                                      formula => $formula});
+        }
+        if ($parse_long and $line !~ /^LONG$/)
+        {
+            $group{LongDescription} .= "\n".$line;
+        }
+    }
+    $group{LongDescription} = substr($group{LongDescription}, 1) if (length($group{LongDescription}) > 0);
+    $group{EventString} = substr($group{EventString}, 1) if (length($group{EventString}) > 0);
+    return \%group;
+}
+
+opendir(DIR, $GROUP_dir) or die "Cannot open directory $GROUP_dir\n";
+my @archs = sort grep { !/^\./ && -d "$GROUP_dir/$_" } readdir(DIR);
+closedir(DIR);
+
+make_path($OUT_dir) unless (-d $OUT_dir);
+
+foreach my $arch (@archs)
+{
+    opendir(DIR, "$GROUP_dir/$arch") or die "Cannot open directory $GROUP_dir/$arch\n";
+    my @files = sort grep { /\.txt$/ } readdir(DIR);
+    closedir(DIR);
+
+    mkdir "$OUT_dir/$arch" unless (-d "$OUT_dir/$arch");
+    open OUTFILE, ">$OUT_dir/$arch/catalog.lua" or die "Cannot write $OUT_dir/$arch/catalog.lua\n";
+    print OUTFILE "-- DONT TOUCH: GENERATED FILE!\n";
+    print OUTFILE "return {\n";
+    print OUTFILE "names = {";
+    print OUTFILE join(",", map { my $n = $_; $n =~ s/\.txt$//; quote($n) } @files);
+    print OUTFILE "},\n";
+    print OUTFILE "groups = {\n";
+    foreach my $file (@files)
+    {
+        my $name = $file;
+        $name =~ s/\.txt$//;
+        my $group = parse_group($name, "$GROUP_dir/$arch/$file");
+        print OUTFILE "[".quote($name)."] = {\n";
+        if (defined($group->{ShortDescription}))
+        {
+            print OUTFILE "ShortDescription = ".quote($group->{ShortDescription}).",\n";
+        }
+        print OUTFILE "GroupString = ".quote($group->{GroupString}).",\n";
+        print OUTFILE "EventString = ".quote($group->{EventString}).",\n";
+        print OUTFILE "LongDescription = ".quote($group->{LongDescription}).",\n";
+        print OUTFILE "Events = {";
+        foreach my $event (@{$group->{Events}})
+        {
+            print OUTFILE "{Event = ".quote($event->{Event}).", Counter = ".quote($event->{Counter})."},";
+        }
+        print OUTFILE "},\n";
+        print OUTFILE "Metrics = {\n";
+        foreach my $metric (@{$group->{Metrics}})
+        {
+            print OUTFILE "{description = ".quote($metric->{description}).", formula = ".quote($metric->{formula})."},\n";
+        }
+        print OUTFILE "},\n";
+        print OUTFILE "},\n";
+    }
+    print OUTFILE "},\n";
+    print OUTFILE "}\n";
+    close OUTFILE;
+}
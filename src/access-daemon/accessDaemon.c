@@ -93,7 +93,8 @@ static char* filepath;
 static const char* ident = "accessD";
 static AllowedPrototype allowed = NULL;
 static AllowedPciPrototype allowedPci = NULL;
-static int FD_MSR[MAX_NUM_THREADS];
+static int* FD_MSR = NULL;
+static uint32_t numHWThreads = 0;
 static int FD_PCI[MAX_NUM_NODES][MAX_NUM_PCI_DEVICES];
 static int isPCIUncore = 0;
 static PciDevice* pci_devices_daemon = NULL;
@@ -501,7 +502,7 @@ static void msr_read(AccessDataRecord * dRecord)
     dRecord->errorcode = ERR_NOERROR;
     dRecord->data = 0;
 
-    if (FD_MSR[cpu] <= 0)
+    if ((cpu >= numHWThreads) || (FD_MSR[cpu] <= 0))
     {
         dRecord->errorcode = ERR_NODEV;
         return;
@@ -531,7 +532,7 @@ static void msr_write(AccessDataRecord * dRecord)
 
     dRecord->errorcode = ERR_NOERROR;
     
-    if (FD_MSR[cpu] <= 0)
+    if ((cpu >= numHWThreads) || (FD_MSR[cpu] <= 0))
     {
         dRecord->errorcode = ERR_NODEV;
         return;
@@ -558,7 +559,7 @@ static void msr_check(AccessDataRecord * dRecord)
     uint32_t cpu = dRecord->cpu;
     dRecord->errorcode = ERR_NOERROR;
 
-    if (FD_MSR[cpu] < 0)
+    if ((cpu >= numHWThreads) || (FD_MSR[cpu] < 0))
     {
         dRecord->errorcode = ERR_NODEV;
         return;
@@ -830,9 +831,14 @@ int main(void)
     socklen_t socklen;
     AccessDataRecord dRecord;
     mode_t oldumask;
-    uint32_t numHWThreads = sysconf(_SC_NPROCESSORS_CONF);
     uint32_t model;
-    for (int i=0;i<MAX_NUM_THREADS;i++)
+    numHWThreads = sysconf(_SC_NPROCESSORS_CONF);
+    FD_MSR = (int*) malloc(numHWThreads * sizeof(int));
+    if (FD_MSR == NULL)
+    {
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i=0;i<numHWThreads;i++)
     {
         FD_MSR[i] = -1;
     }
@@ -54,7 +54,7 @@
 
 
 static int registeredCpus = 0;
-static int registeredCpuList[MAX_NUM_THREADS] = { [0 ... (MAX_NUM_THREADS-1)] = 0 };
+static int* registeredCpuList = NULL;
 
 
 static int (*access_read)(PciDeviceIndex dev, const int cpu, uint32_t reg, uint64_t *data) = NULL;
@@ -101,7 +101,16 @@ int HPMinit(void)
         }
 #endif
     }
-    
+    if (registeredCpuList == NULL)
+    {
+        registeredCpuList = (int*) calloc(cpuid_topology.numHWThreads, sizeof(int));
+        if (registeredCpuList == NULL)
+        {
+            ERROR_PLAIN_PRINT(Cannot allocate list of registered CPUs);
+            return -ENOMEM;
+        }
+    }
+
     return 0;
 }
 
@@ -114,6 +123,14 @@ int HPMinitialized(void)
 int HPMaddThread(int cpu_id)
 {
     int ret;
+    if ((cpu_id < 0) || (cpu_id >= cpuid_topology.numHWThreads))
+    {
+        return -ERANGE;
+    }
+    if (registeredCpuList == NULL)
+    {
+        return -ENODEV;
+    }
     if (registeredCpuList[cpu_id] == 0)
     {
         if (access_init != NULL)
@@ -140,7 +157,7 @@ int HPMaddThread(int cpu_id)
 
 void HPMfinalize()
 {
-    if (registeredCpus != 0)
+    if ((registeredCpus != 0) && (registeredCpuList != NULL))
     {
         for (int i=0; i<cpuid_topology.numHWThreads; i++)
         {
@@ -166,6 +183,11 @@ void HPMfinalize()
         access_write = NULL;
     if (access_check != NULL)
         access_check = NULL;
+    if (registeredCpuList != NULL)
+    {
+        free(registeredCpuList);
+        registeredCpuList = NULL;
+    }
     return;
 }
 
@@ -182,7 +204,7 @@ int HPMread(int cpu_id, PciDeviceIndex dev, uint32_t reg, uint64_t* data)
     {
         return -ERANGE;
     }
-    if (registeredCpuList[cpu_id] == 0)
+    if ((registeredCpuList == NULL) || (registeredCpuList[cpu_id] == 0))
     {
         return -ENODEV;
     }
@@ -203,7 +225,7 @@ int HPMwrite(int cpu_id, PciDeviceIndex dev, uint32_t reg, uint64_t data)
         ERROR_PRINT(MSR WRITE C %d OUT OF RANGE, cpu_id);
         return -ERANGE;
     }
-    if (registeredCpuList[cpu_id] == 0)
+    if ((registeredCpuList == NULL) || (registeredCpuList[cpu_id] == 0))
     {
         return -ENODEV;
     }
@@ -213,7 +235,11 @@ int HPMwrite(int cpu_id, PciDeviceIndex dev, uint32_t reg, uint64_t data)
 
 int HPMcheck(PciDeviceIndex dev, int cpu_id)
 {
-    if (registeredCpuList[cpu_id] == 0)
+    if ((cpu_id < 0) || (cpu_id >= cpuid_topology.numHWThreads))
+    {
+        return -ERANGE;
+    }
+    if ((registeredCpuList == NULL) || (registeredCpuList[cpu_id] == 0))
     {
         return -ENODEV;
     }
@@ -19,12 +19,19 @@
 #include <configuration.h>
 #include <affinity.h>
 
+/* #####   LOCAL TYPE DEFINITIONS   ####################################### */
+
+/* Daemon connection of a CPU, padded to a full cacheline */
+typedef struct {
+    int socket;
+    pthread_mutex_t lock;
+} CACHELINE_ALIGNED AccessClientCpu;
+
 /* #####   VARIABLES  -  LOCAL TO THIS SOURCE FILE   ###################### */
 static int globalSocket = -1;
 static int cpuSockets_open = 0;
-static int cpuSockets[MAX_NUM_THREADS] = { [0 ... MAX_NUM_THREADS-1] = -1};
+static AccessClientCpu* cpuSockets = NULL;
 static pthread_mutex_t globalLock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t cpuLocks[MAX_NUM_THREADS] = { [0 ... MAX_NUM_THREADS-1] = PTHREAD_MUTEX_INITIALIZER };
 
 /* #####   FUNCTION DEFINITIONS  -  LOCAL TO THIS SOURCE FILE   ########### */
 static char*
@@ -158,16 +165,33 @@ access_client_startDaemon(int cpu_id)
 int access_client_init(int cpu_id)
 {
     int ret = 0;
-    if (cpuSockets[cpu_id] < 0)
+    pthread_mutex_lock(&globalLock);
+    if (cpuSockets == NULL)
     {
-        pthread_mutex_lock(&cpuLocks[cpu_id]);
-        cpuSockets[cpu_id] = access_client_startDaemon(cpu_id);
+        if (posix_memalign((void**) &cpuSockets, CACHELINE_SIZE,
+                           cpuid_topology.numHWThreads * sizeof(AccessClientCpu)) != 0)
+        {
+            cpuSockets = NULL;
+            pthread_mutex_unlock(&globalLock);
+            return -ENOMEM;
+        }
+        for (int i = 0; i < cpuid_topology.numHWThreads; i++)
+        {
+            cpuSockets[i].socket = -1;
+            pthread_mutex_init(&cpuSockets[i].lock, NULL);
+        }
+    }
+    pthread_mutex_unlock(&globalLock);
+    if (cpuSockets[cpu_id].socket < 0)
+    {
+        pthread_mutex_lock(&cpuSockets[cpu_id].lock);
+        cpuSockets[cpu_id].socket = access_client_startDaemon(cpu_id);
         cpuSockets_open++;
-        pthread_mutex_unlock(&cpuLocks[cpu_id]);
+        pthread_mutex_unlock(&cpuSockets[cpu_id].lock);
         if (globalSocket == -1)
         {
             pthread_mutex_lock(&globalLock);
-            globalSocket = cpuSockets[cpu_id];
+            globalSocket = cpuSockets[cpu_id].socket;
             pthread_mutex_unlock(&globalLock);
         }
     }
@@ -188,10 +212,10 @@ int access_client_read(PciDeviceIndex dev, const int cpu_id, uint32_t reg, uint6
         return -ENOENT;
     }
 
-    if ((cpuSockets[cpu_id] >= 0) && (cpuSockets[cpu_id] != globalSocket))
+    if ((cpuSockets[cpu_id].socket >= 0) && (cpuSockets[cpu_id].socket != globalSocket))
     {
-        socket = cpuSockets[cpu_id];
-        lockptr = &cpuLocks[cpu_id];
+        socket = cpuSockets[cpu_id].socket;
+        lockptr = &cpuSockets[cpu_id].lock;
     }
 
     if (dev != MSR_DEV)
@@ -249,10 +273,10 @@ int access_client_write(PciDeviceIndex dev, const int cpu_id, uint32_t reg, uint
         return -ENOENT;
     }
 
-    if ((cpuSockets[cpu_id] >= 0) && (cpuSockets[cpu_id] != socket))
+    if ((cpuSockets[cpu_id].socket >= 0) && (cpuSockets[cpu_id].socket != socket))
     {
-        socket = cpuSockets[cpu_id];
-        lockptr = &cpuLocks[cpu_id];
+        socket = cpuSockets[cpu_id].socket;
+        lockptr = &cpuSockets[cpu_id].lock;
     }
 
     if (dev != MSR_DEV)
@@ -296,17 +320,27 @@ int access_client_write(PciDeviceIndex dev, const int cpu_id, uint32_t reg, uint
 void access_client_finalize(int cpu_id)
 {
     AccessDataRecord record;
-    if (cpuSockets[cpu_id] > 0)
+    if (cpuSockets == NULL)
+    {
+        return;
+    }
+    if (cpuSockets[cpu_id].socket > 0)
     {
         record.type = DAEMON_EXIT;
-        CHECK_ERROR(write(cpuSockets[cpu_id], &record, sizeof(AccessDataRecord)),socket write failed);
-        CHECK_ERROR(close(cpuSockets[cpu_id]),socket close failed);
-        cpuSockets[cpu_id] = -1;
+        CHECK_ERROR(write(cpuSockets[cpu_id].socket, &record, sizeof(AccessDataRecord)),socket write failed);
+        CHECK_ERROR(close(cpuSockets[cpu_id].socket),socket close failed);
+        cpuSockets[cpu_id].socket = -1;
         cpuSockets_open--;
     }
     if (cpuSockets_open == 0)
     {
         globalSocket = -1;
+        for (int i = 0; i < cpuid_topology.numHWThreads; i++)
+        {
+            pthread_mutex_destroy(&cpuSockets[i].lock);
+        }
+        free(cpuSockets);
+        cpuSockets = NULL;
     }
 }
 
@@ -323,12 +357,16 @@ int access_client_check(PciDeviceIndex dev, int cpu_id)
     {
         record.cpu = affinity_core2node_lookup[cpu_id];
     }
-    if ((cpuSockets[cpu_id] > 0) && (cpuSockets[cpu_id] != globalSocket))
+    if (cpuSockets == NULL)
+    {
+        return 0;
+    }
+    if ((cpuSockets[cpu_id].socket > 0) && (cpuSockets[cpu_id].socket != globalSocket))
     {
-        socket = cpuSockets[cpu_id];
-        lockptr = &cpuLocks[cpu_id];
+        socket = cpuSockets[cpu_id].socket;
+        lockptr = &cpuSockets[cpu_id].lock;
     }
-    if ((cpuSockets[cpu_id] > 0) || ((cpuSockets_open == 1) && (globalSocket > 0)))
+    if ((cpuSockets[cpu_id].socket > 0) || ((cpuSockets_open == 1) && (globalSocket > 0)))
     {
         pthread_mutex_lock(lockptr);
         CHECK_ERROR(write(socket, &record, sizeof(AccessDataRecord)), socket write failed);
@@ -62,7 +62,7 @@
 #define TOSTRING(x) STRINGIFY(x)
 
 /* #####   VARIABLES  -  LOCAL TO THIS SOURCE FILE   ###################### */
-static int FD[MAX_NUM_THREADS] = { [0 ... MAX_NUM_THREADS-1] = -1 };
+static int* FD = NULL;
 static int rdpmc_works_pmc = -1;
 static int rdpmc_works_fixed = -1;
 
@@ -140,6 +140,18 @@ access_x86_msr_init(const int cpu_id)
     int i = 0;
 
     char* msr_file_name;
+    if (FD == NULL)
+    {
+        FD = (int*) malloc(cpuid_topology.numHWThreads * sizeof(int));
+        if (FD == NULL)
+        {
+            return -ENOMEM;
+        }
+        for (i = 0; i < cpuid_topology.numHWThreads; i++)
+        {
+            FD[i] = -1;
+        }
+    }
     if (FD[cpu_id] > 0)
     {
         return 0;
@@ -212,7 +224,7 @@ access_x86_msr_finalize(const int cpu_id)
 {
     int i = 0;
 
-    if (FD[cpu_id] > 0)
+    if ((FD != NULL) && (FD[cpu_id] > 0))
     {
         close(FD[cpu_id]);
         FD[cpu_id] = 0;
@@ -246,7 +258,7 @@ access_x86_msr_read( const int cpu_id, uint32_t reg, uint64_t *data)
     else
     {
 fallback:
-        if (FD[cpu_id] > 0)
+        if ((FD != NULL) && (FD[cpu_id] > 0))
         {
             DEBUG_PRINT(DEBUGLEV_DEVELOP, Read MSR counter 0x%X with RDMSR instruction on CPU %d, reg, cpu_id);
             if ( pread(FD[cpu_id], data, sizeof(*data), reg) != sizeof(*data) )
@@ -262,7 +274,7 @@ int
 access_x86_msr_write( const int cpu_id, uint32_t reg, uint64_t data)
 {
     int ret;
-    if (FD[cpu_id] > 0)
+    if ((FD != NULL) && (FD[cpu_id] > 0))
     {
         DEBUG_PRINT(DEBUGLEV_DEVELOP, Write MSR counter 0x%X with WRMSR instruction on CPU %d data 0x%X, reg, cpu_id, data);
         ret = pwrite(FD[cpu_id], &data, sizeof(data), reg);
@@ -276,7 +288,7 @@ access_x86_msr_write( const int cpu_id, uint32_t reg, uint64_t data)
 
 int access_x86_msr_check(PciDeviceIndex dev, int cpu_id)
 {
-    if (dev == MSR_DEV)
+    if ((dev == MSR_DEV) && (FD != NULL))
     {
         if (FD[cpu_id] > 0)
         {
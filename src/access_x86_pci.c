@@ -53,10 +53,10 @@
 
 #include <access_x86_pci.h>
 
+#include <configuration.h>
+#include <pci_proc.h>
 #ifdef LIKWID_USE_HWLOC
 #include <pci_hwloc.h>
-#else
-#include <pci_proc.h>
 #endif
 
 /* #####   MACROS  -  LOCAL TO THIS SOURCE FILE   ######################### */
@@ -144,8 +144,17 @@ access_x86_pci_init(const int socket)
         }
 
 #ifdef LIKWID_USE_HWLOC
-        DEBUG_PLAIN_PRINT(DEBUGLEV_DETAIL, Using hwloc to find pci devices);
-        ret = hwloc_pci_init(testDevice, socket_bus, &nr_sockets);
+        ret = -ENODEV;
+        if (!config_useHwloc())
+        {
+            DEBUG_PLAIN_PRINT(DEBUGLEV_DETAIL, Using procfs to find pci devices);
+            ret = proc_pci_init(testDevice, socket_bus, &nr_sockets);
+        }
+        if (ret)
+        {
+            DEBUG_PLAIN_PRINT(DEBUGLEV_DETAIL, Using hwloc to find pci devices);
+            ret = hwloc_pci_init(testDevice, socket_bus, &nr_sockets);
+        }
         if (ret)
         {
             ERROR_PLAIN_PRINT(Using hwloc to find pci devices failed);
@@ -54,7 +54,7 @@
 
 /* #####   EXPORTED VARIABLES   ########################################### */
 
-int affinity_core2node_lookup[MAX_NUM_THREADS];
+int* affinity_core2node_lookup = NULL;
 
 /* #####   MACROS  -  LOCAL TO THIS SOURCE FILE   ######################### */
 
@@ -76,7 +76,7 @@ getProcessorID(cpu_set_t* cpu_set)
 {
     int processorId;
 
-    for ( processorId = 0; processorId < MAX_NUM_THREADS; processorId++ )
+    for ( processorId = 0; processorId < CPU_SETSIZE; processorId++ )
     {
         if ( CPU_ISSET(processorId,cpu_set) )
         {
@@ -147,6 +147,51 @@ treeFillNextEntries(
     return numberOfEntries-counter;
 }
 
+static int
+treeFillCoreEntries(
+    TreeNode* tree,
+    int* processorIds,
+    int socketId,
+    int coreIdx)
+{
+    int count = 0;
+    TreeNode* node = tree_getChildNode(tree);
+    TreeNode* thread;
+
+    for (int i=0; i<socketId && node != NULL; i++)
+    {
+        node = tree_getNextNode(node);
+    }
+    if (node == NULL)
+    {
+        DEBUG_PRINT(DEBUGLEV_DEVELOP, Cannot find socket %d in topology tree, socketId);
+        return 0;
+    }
+    node = tree_getChildNode(node);
+    for (int i=0; i<coreIdx && node != NULL; i++)
+    {
+        node = tree_getNextNode(node);
+    }
+    if (node == NULL)
+    {
+        DEBUG_PRINT(DEBUGLEV_DEVELOP, Cannot find core %d in topology tree, coreIdx);
+        return 0;
+    }
+
+    /* Only the HW threads of this core, inactive ones are left out */
+    thread = tree_getChildNode(node);
+    while ( thread != NULL )
+    {
+        if (cpuid_topology.threadPool[thread->id].inCpuSet)
+        {
+            processorIds[count] = thread->id;
+            count++;
+        }
+        thread = tree_getNextNode(thread);
+    }
+    return count;
+}
+
 /* #####   FUNCTION DEFINITIONS  -  EXPORTED FUNCTIONS   ################## */
 
 void
@@ -187,8 +232,32 @@ affinity_init()
     numberOfCacheDomains = cpuid_topology.numSockets *
         (cpuid_topology.numCoresPerSocket/numberOfCoresPerCache);
     DEBUG_PRINT(DEBUGLEV_DEVELOP, Affinity: Cache domains %d, numberOfCacheDomains);
+    /* Tile domains group the cores sharing a L2 cache. On CPUs with private
+     * L2 caches every tile contains a single core. */
+    int numberOfTileDomains = 0;
+    int numberOfCoresPerTile = 1;
+    for (int i=0; i < cpuid_topology.numCacheLevels; i++)
+    {
+        if ((cpuid_topology.cacheLevels[i].level == 2) &&
+            (cpuid_topology.cacheLevels[i].type != INSTRUCTIONCACHE))
+        {
+            numberOfCoresPerTile = cpuid_topology.cacheLevels[i].threads/
+                                   cpuid_topology.numThreadsPerCore;
+            if (numberOfCoresPerTile < 1)
+            {
+                numberOfCoresPerTile = 1;
+            }
+            numberOfTileDomains = cpuid_topology.numSockets *
+                ((cpuid_topology.numCoresPerSocket + numberOfCoresPerTile - 1)/numberOfCoresPerTile);
+            break;
+        }
+    }
+    DEBUG_PRINT(DEBUGLEV_DEVELOP, Affinity: Tile domains %d with %d cores, numberOfTileDomains, numberOfCoresPerTile);
+    int numberOfCoreDomains = cpuid_topology.numSockets * cpuid_topology.numCoresPerSocket;
+    DEBUG_PRINT(DEBUGLEV_DEVELOP, Affinity: Core domains %d, numberOfCoreDomains);
     /* determine total number of domains */
     numberOfDomains += numberOfSocketDomains + numberOfCacheDomains + numberOfNumaDomains;
+    numberOfDomains += numberOfTileDomains + numberOfCoreDomains;
     DEBUG_PRINT(DEBUGLEV_DEVELOP, Affinity: All domains %d, numberOfDomains);
     domains = (AffinityDomain*) malloc(numberOfDomains * sizeof(AffinityDomain));
     if (!domains)
@@ -196,6 +265,20 @@ affinity_init()
         fprintf(stderr,"No more memory for %ld bytes for array of affinity domains\n",numberOfDomains * sizeof(AffinityDomain));
         return;
     }
+    /* The lookup is indexed by the processor IDs in the topology tree */
+    int numberOfLookups = cpuid_topology.numHWThreads;
+    for (int i=0; i < cpuid_topology.numHWThreads; i++)
+    {
+        numberOfLookups = MAX(numberOfLookups, (int)cpuid_topology.threadPool[i].apicId + 1);
+    }
+    free(affinity_core2node_lookup);
+    affinity_core2node_lookup = (int*) calloc(numberOfLookups, sizeof(int));
+    if (!affinity_core2node_lookup)
+    {
+        fprintf(stderr,"No more memory for %ld bytes for the socket lookup\n",numberOfLookups * sizeof(int));
+        free(domains);
+        return;
+    }
 
     /* Node domain */
     domains[0].numberOfProcessors = cpuid_topology.activeHWThreads;
@@ -353,6 +436,66 @@ affinity_init()
         domains[currentDomain + subCounter].numberOfProcessors = tmp;
     }
 
+    /* Tile domains */
+    currentDomain += numberOfNumaDomains;
+    subCounter = 0;
+    for (int i=0; i < numberOfSocketDomains && numberOfTileDomains > 0; i++ )
+    {
+        for ( offset = 0; offset < (int)cpuid_topology.numCoresPerSocket; offset += numberOfCoresPerTile )
+        {
+            int cores = MIN(numberOfCoresPerTile, (int)cpuid_topology.numCoresPerSocket - offset);
+            domains[currentDomain + subCounter].numberOfProcessors = cores * cpuid_topology.numThreadsPerCore;
+            domains[currentDomain + subCounter].numberOfCores = cores;
+            domains[currentDomain + subCounter].tag = bformat("T%d", subCounter);
+            DEBUG_PRINT(DEBUGLEV_DEVELOP, Affinity domain T%d: %d HW threads on %d cores, subCounter, domains[currentDomain + subCounter].numberOfProcessors, domains[currentDomain + subCounter].numberOfCores);
+            domains[currentDomain + subCounter].processorList =
+                            (int*) malloc(domains[currentDomain + subCounter].numberOfProcessors*sizeof(int));
+            if (!domains[currentDomain + subCounter].processorList)
+            {
+                fprintf(stderr,"No more memory for %ld bytes for processor list of affinity domain %s\n",
+                        domains[currentDomain + subCounter].numberOfProcessors*sizeof(int),
+                        bdata(domains[currentDomain + subCounter].tag));
+                return;
+            }
+            tmp = 0;
+            for (int j = 0; j < cores; j++)
+            {
+                tmp += treeFillCoreEntries(cpuid_topology.topologyTree,
+                                           domains[currentDomain + subCounter].processorList + tmp,
+                                           i, offset + j);
+            }
+            domains[currentDomain + subCounter].numberOfProcessors = tmp;
+            subCounter++;
+        }
+    }
+
+    /* Core domains */
+    currentDomain += numberOfTileDomains;
+    subCounter = 0;
+    for (int i=0; i < numberOfSocketDomains; i++ )
+    {
+        for ( int j=0; j < (int)cpuid_topology.numCoresPerSocket; j++ )
+        {
+            domains[currentDomain + subCounter].numberOfProcessors = cpuid_topology.numThreadsPerCore;
+            domains[currentDomain + subCounter].numberOfCores = 1;
+            domains[currentDomain + subCounter].tag = bformat("P%d", subCounter);
+            domains[currentDomain + subCounter].processorList =
+                            (int*) malloc(cpuid_topology.numThreadsPerCore*sizeof(int));
+            if (!domains[currentDomain + subCounter].processorList)
+            {
+                fprintf(stderr,"No more memory for %ld bytes for processor list of affinity domain %s\n",
+                        cpuid_topology.numThreadsPerCore*sizeof(int),
+                        bdata(domains[currentDomain + subCounter].tag));
+                return;
+            }
+            domains[currentDomain + subCounter].numberOfProcessors =
+                    treeFillCoreEntries(cpuid_topology.topologyTree,
+                                        domains[currentDomain + subCounter].processorList,
+                                        i, j);
+            subCounter++;
+        }
+    }
+
     affinity_numberOfDomains = numberOfDomains;
     affinityDomains.numberOfAffinityDomains = numberOfDomains;
     affinityDomains.numberOfSocketDomains = numberOfSocketDomains;
@@ -362,6 +505,9 @@ affinity_init()
     affinityDomains.numberOfCoresPerCache = numberOfCoresPerCache;
     affinityDomains.numberOfProcessorsPerCache = numberOfProcessorsPerCache;
     affinityDomains.domains = domains;
+    affinityDomains.numberOfTileDomains = numberOfTileDomains;
+    affinityDomains.numberOfCoresPerTile = numberOfCoresPerTile;
+    affinityDomains.numberOfCoreDomains = numberOfCoreDomains;
     affinity_initialized = 1;
 }
 
@@ -398,6 +544,9 @@ affinity_finalize()
     affinityDomains.numberOfCacheDomains = 0;
     affinityDomains.numberOfCoresPerCache = 0;
     affinityDomains.numberOfProcessorsPerCache = 0;
+    affinityDomains.numberOfTileDomains = 0;
+    affinityDomains.numberOfCoresPerTile = 0;
+    affinityDomains.numberOfCoreDomains = 0;
     affinity_initialized = 0;
 }
 
@@ -0,0 +1,259 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  agent_cgroup.c
+ *
+ *      Description:  Scanner for the cpuset membership of batch jobs. Every
+ *                    cgroup directory below a root whose name starts with a
+ *                    prefix (like job_<id>) is a job, its CPUs are taken from
+ *                    cpuset.cpus.effective (cgroup v2) or cpuset.cpus (v1).
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+/* #####   HEADER FILE INCLUDES   ######################################### */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <types.h>
+#include <error.h>
+#include <agent_cgroup.h>
+
+/* #####   FUNCTION DEFINITIONS  -  LOCAL TO THIS SOURCE FILE   ########### */
+
+static char*
+cgroup_readCpuset(const char* path)
+{
+    int i;
+    FILE* fp = NULL;
+    char filename[4096];
+    char* line = NULL;
+    size_t len = 0;
+    static const char* files[] = {"cpuset.cpus.effective", "cpuset.cpus", NULL};
+
+    for (i = 0; files[i] != NULL; i++)
+    {
+        snprintf(filename, sizeof(filename), "%s/%s", path, files[i]);
+        fp = fopen(filename, "r");
+        if (fp != NULL)
+        {
+            break;
+        }
+    }
+    if (fp == NULL)
+    {
+        return NULL;
+    }
+    if (getline(&line, &len, fp) < 0)
+    {
+        free(line);
+        line = NULL;
+    }
+    fclose(fp);
+    return line;
+}
+
+static int
+cgroup_addJob(const char* path, const char* id, int* numJobs, int* size, AgentJob** jobs)
+{
+    int* cpus = NULL;
+    int numCpus = 0;
+    char* cpuset = cgroup_readCpuset(path);
+
+    if (cpuset == NULL)
+    {
+        return 0;
+    }
+    numCpus = agent_cgroupParseCpus(cpuset, &cpus);
+    free(cpuset);
+    if (numCpus <= 0)
+    {
+        free(cpus);
+        return 0;
+    }
+    if (*numJobs == *size)
+    {
+        AgentJob* tmp = (AgentJob*) realloc(*jobs, (*size + 16) * sizeof(AgentJob));
+        if (tmp == NULL)
+        {
+            free(cpus);
+            return -ENOMEM;
+        }
+        *jobs = tmp;
+        *size += 16;
+    }
+    (*jobs)[*numJobs].id = strdup(id);
+    (*jobs)[*numJobs].numCpus = numCpus;
+    (*jobs)[*numJobs].cpus = cpus;
+    (*numJobs)++;
+    return 0;
+}
+
+static int
+cgroup_scanDir(const char* path, const char* prefix, int depth,
+               int* numJobs, int* size, AgentJob** jobs)
+{
+    int ret = 0;
+    DIR* dir = NULL;
+    struct dirent* entry = NULL;
+    size_t prefixLen = strlen(prefix);
+
+    dir = opendir(path);
+    if (dir == NULL)
+    {
+        return (depth == 0 ? -errno : 0);
+    }
+    while ((entry = readdir(dir)) != NULL)
+    {
+        char subpath[4096];
+        struct stat st;
+        if (entry->d_name[0] == '.')
+        {
+            continue;
+        }
+        snprintf(subpath, sizeof(subpath), "%s/%s", path, entry->d_name);
+        if ((stat(subpath, &st) != 0) || (!S_ISDIR(st.st_mode)))
+        {
+            continue;
+        }
+        if ((strncmp(entry->d_name, prefix, prefixLen) == 0) &&
+            (strlen(entry->d_name) > prefixLen))
+        {
+            /* Steps and tasks below a job belong to the job */
+            ret = cgroup_addJob(subpath, entry->d_name + prefixLen, numJobs, size, jobs);
+        }
+        else if (depth + 1 < AGENT_JOB_MAXDEPTH)
+        {
+            ret = cgroup_scanDir(subpath, prefix, depth + 1, numJobs, size, jobs);
+        }
+        if (ret < 0)
+        {
+            break;
+        }
+    }
+    closedir(dir);
+    return ret;
+}
+
+/* #####   FUNCTION DEFINITIONS  -  EXPORTED FUNCTIONS   ################## */
+
+int
+agent_cgroupParseCpus(const char* str, int** cpus)
+{
+    int num = 0;
+    int size = 0;
+    const char* ptr = str;
+    int* list = NULL;
+
+    *cpus = NULL;
+    while ((ptr != NULL) && (*ptr != '\0') && (*ptr != '\n'))
+    {
+        char* end = NULL;
+        long start = strtol(ptr, &end, 10);
+        long stop = start;
+        long cpu;
+        if (end == ptr)
+        {
+            free(list);
+            return -EINVAL;
+        }
+        if (*end == '-')
+        {
+            ptr = end + 1;
+            stop = strtol(ptr, &end, 10);
+            if ((end == ptr) || (stop < start))
+            {
+                free(list);
+                return -EINVAL;
+            }
+        }
+        for (cpu = start; cpu <= stop; cpu++)
+        {
+            if (num == size)
+            {
+                int* tmp = (int*) realloc(list, (size + 64) * sizeof(int));
+                if (tmp == NULL)
+                {
+                    free(list);
+                    return -ENOMEM;
+                }
+                list = tmp;
+                size += 64;
+            }
+            list[num++] = (int)cpu;
+        }
+        ptr = (*end == ',' ? end + 1 : end);
+    }
+    *cpus = list;
+    return num;
+}
+
+int
+agent_cgroupScan(const char* root, const char* prefix, AgentJob** jobs)
+{
+    int ret;
+    int numJobs = 0;
+    int size = 0;
+    AgentJob* list = NULL;
+
+    if ((root == NULL) || (jobs == NULL))
+    {
+        return -EINVAL;
+    }
+    if ((prefix == NULL) || (strlen(prefix) == 0))
+    {
+        prefix = AGENT_JOB_PREFIX;
+    }
+    ret = cgroup_scanDir(root, prefix, 0, &numJobs, &size, &list);
+    if (ret < 0)
+    {
+        agent_cgroupFree(numJobs, list);
+        *jobs = NULL;
+        return ret;
+    }
+    *jobs = list;
+    return numJobs;
+}
+
+void
+agent_cgroupFree(int numJobs, AgentJob* jobs)
+{
+    int i;
+
+    if (jobs == NULL)
+    {
+        return;
+    }
+    for (i = 0; i < numJobs; i++)
+    {
+        free(jobs[i].id);
+        free(jobs[i].cpus);
+    }
+    free(jobs);
+}
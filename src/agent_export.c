@@ -0,0 +1,1070 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  agent_export.c
+ *
+ *      Description:  Native output backends of likwid-agent. All metrics of one
+ *                    measurement interval are sent to Ganglia with a single
+ *                    sendmmsg() call, to the system log with one syslog(3)
+ *                    message and appended to a time series file with one
+ *                    write(). No external tools are executed.
+ *                    The latest metrics can be published through a local
+ *                    Unix socket or HTTP endpoint and a seqlock protected
+ *                    shared memory segment.
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+/* #####   HEADER FILE INCLUDES   ######################################### */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <poll.h>
+#include <grp.h>
+#include <pthread.h>
+#include <sched.h>
+#include <syslog.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <types.h>
+#include <error.h>
+#include <agent_export.h>
+
+/* #####   MACROS  -  LOCAL TO THIS SOURCE FILE   ######################### */
+
+/* Message types of the Ganglia 3.1 XDR protocol */
+#define GANGLIA_METADATA_FULL 128
+#define GANGLIA_METRIC_DOUBLE 135
+/* Slope 'both' as used by gmetric for gauges */
+#define GANGLIA_SLOPE_BOTH 3
+
+/* #####   LOCAL TYPE DEFINITIONS   ####################################### */
+
+typedef struct {
+    char data[AGENT_GANGLIA_PACKET_SIZE];
+    int len;
+    int overflow;
+} XdrPacket;
+
+typedef struct {
+    int fd;
+    int numMetrics;
+} TsFile;
+
+typedef struct {
+    const char* name;
+    int value;
+} SyslogCode;
+
+typedef enum {
+    ENDPOINT_UNIX = 0,
+    ENDPOINT_HTTP
+} EndpointType;
+
+/* #####   VARIABLES  -  LOCAL TO THIS SOURCE FILE   ###################### */
+
+static int ganglia_socket = -1;
+static struct sockaddr_storage ganglia_addr;
+static socklen_t ganglia_addrlen = 0;
+static char ganglia_hostname[256];
+static XdrPacket* ganglia_packets = NULL;
+static struct mmsghdr* ganglia_msgs = NULL;
+static struct iovec* ganglia_iovs = NULL;
+
+static int syslog_open = 0;
+static int syslog_level = LOG_NOTICE;
+
+static TsFile ts_files[AGENT_MAX_TSFILES];
+static int ts_initialized = 0;
+
+static int endpoint_socket = -1;
+static EndpointType endpoint_type = ENDPOINT_UNIX;
+static char* endpoint_path = NULL;
+static pthread_t endpoint_thread;
+static volatile int endpoint_running = 0;
+static pthread_mutex_t endpoint_lock = PTHREAD_MUTEX_INITIALIZER;
+static char* endpoint_text = NULL;
+static size_t endpoint_len = 0;
+static size_t endpoint_size = 0;
+
+static AgentShmHeader* shm_header = NULL;
+static size_t shm_mapSize = 0;
+
+static SyslogCode syslog_facilities[] = {
+    {"kern", LOG_KERN}, {"user", LOG_USER}, {"mail", LOG_MAIL},
+    {"daemon", LOG_DAEMON}, {"auth", LOG_AUTH}, {"syslog", LOG_SYSLOG},
+    {"lpr", LOG_LPR}, {"news", LOG_NEWS}, {"uucp", LOG_UUCP},
+    {"cron", LOG_CRON}, {"authpriv", LOG_AUTHPRIV}, {"ftp", LOG_FTP},
+    {"local0", LOG_LOCAL0}, {"local1", LOG_LOCAL1}, {"local2", LOG_LOCAL2},
+    {"local3", LOG_LOCAL3}, {"local4", LOG_LOCAL4}, {"local5", LOG_LOCAL5},
+    {"local6", LOG_LOCAL6}, {"local7", LOG_LOCAL7}, {NULL, 0}
+};
+
+static SyslogCode syslog_levels[] = {
+    {"emerg", LOG_EMERG}, {"panic", LOG_EMERG}, {"alert", LOG_ALERT},
+    {"crit", LOG_CRIT}, {"err", LOG_ERR}, {"error", LOG_ERR},
+    {"warning", LOG_WARNING}, {"warn", LOG_WARNING}, {"notice", LOG_NOTICE},
+    {"info", LOG_INFO}, {"debug", LOG_DEBUG}, {NULL, 0}
+};
+
+/* #####   FUNCTION DEFINITIONS  -  LOCAL TO THIS SOURCE FILE   ########### */
+
+static void
+xdr_putUint(XdrPacket* p, uint32_t value)
+{
+    uint32_t be = htonl(value);
+    if (p->len + 4 > AGENT_GANGLIA_PACKET_SIZE)
+    {
+        p->overflow = 1;
+        return;
+    }
+    memcpy(p->data + p->len, &be, 4);
+    p->len += 4;
+}
+
+static void
+xdr_putDouble(XdrPacket* p, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(uint64_t));
+    xdr_putUint(p, (uint32_t)(bits >> 32));
+    xdr_putUint(p, (uint32_t)(bits & 0xFFFFFFFFULL));
+}
+
+static void
+xdr_putString(XdrPacket* p, const char* str)
+{
+    uint32_t len = (str ? strlen(str) : 0);
+    uint32_t padded = (len + 3) & ~3U;
+    xdr_putUint(p, len);
+    if (p->len + padded > AGENT_GANGLIA_PACKET_SIZE)
+    {
+        p->overflow = 1;
+        return;
+    }
+    if (len > 0)
+    {
+        memcpy(p->data + p->len, str, len);
+    }
+    memset(p->data + p->len + len, 0, padded - len);
+    p->len += padded;
+}
+
+static void
+ganglia_packMetricId(XdrPacket* p, uint32_t type, const char* name)
+{
+    p->len = 0;
+    p->overflow = 0;
+    xdr_putUint(p, type);
+    xdr_putString(p, ganglia_hostname);
+    xdr_putString(p, name);
+    xdr_putUint(p, 0); /* spoof */
+}
+
+static void
+ganglia_packMetadata(XdrPacket* p, const char* group, int tmax, AgentMetric* metric)
+{
+    int numExtra = (group ? 2 : 1);
+    ganglia_packMetricId(p, GANGLIA_METADATA_FULL, metric->name);
+    xdr_putString(p, "double");
+    xdr_putString(p, metric->name);
+    xdr_putString(p, (metric->unit ? metric->unit : ""));
+    xdr_putUint(p, GANGLIA_SLOPE_BOTH);
+    xdr_putUint(p, tmax);
+    xdr_putUint(p, 0); /* dmax */
+    xdr_putUint(p, numExtra);
+    xdr_putString(p, "TITLE");
+    xdr_putString(p, metric->name);
+    if (group)
+    {
+        xdr_putString(p, "GROUP");
+        xdr_putString(p, group);
+    }
+}
+
+static void
+ganglia_packValue(XdrPacket* p, AgentMetric* metric)
+{
+    ganglia_packMetricId(p, GANGLIA_METRIC_DOUBLE, metric->name);
+    xdr_putString(p, "%f");
+    xdr_putDouble(p, metric->value);
+}
+
+static int
+syslog_lookup(SyslogCode* codes, const char* name, size_t len)
+{
+    int i;
+    for (i = 0; codes[i].name != NULL; i++)
+    {
+        if ((strlen(codes[i].name) == len) && (strncasecmp(codes[i].name, name, len) == 0))
+        {
+            return codes[i].value;
+        }
+    }
+    return -1;
+}
+
+static int
+append_name(char* buf, int pos, int size, const char* name)
+{
+    while ((*name != '\0') && (pos < size - 1))
+    {
+        buf[pos++] = ((*name == ' ') || (*name == ',') ? '_' : *name);
+        name++;
+    }
+    buf[pos] = '\0';
+    return pos;
+}
+
+static int
+endpoint_sendAll(int fd, const char* buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t ret = send(fd, buf, len, MSG_NOSIGNAL);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -errno;
+        }
+        buf += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+static int
+endpoint_readRequest(int fd, char* buf, size_t size)
+{
+    size_t len = 0;
+    struct pollfd pfd;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    buf[0] = '\0';
+    while (len < size - 1)
+    {
+        ssize_t ret;
+        if (poll(&pfd, 1, AGENT_ENDPOINT_TIMEOUT) <= 0)
+        {
+            return -ETIMEDOUT;
+        }
+        ret = recv(fd, buf + len, size - 1 - len, 0);
+        if (ret <= 0)
+        {
+            break;
+        }
+        len += ret;
+        buf[len] = '\0';
+        if (strstr(buf, "\r\n\r\n") || strstr(buf, "\n\n"))
+        {
+            break;
+        }
+    }
+    return len;
+}
+
+static void
+endpoint_handleClient(int fd)
+{
+    char* text = NULL;
+    size_t len = 0;
+    char header[256];
+
+    pthread_mutex_lock(&endpoint_lock);
+    if (endpoint_len > 0)
+    {
+        text = (char*) malloc(endpoint_len);
+        if (text)
+        {
+            memcpy(text, endpoint_text, endpoint_len);
+            len = endpoint_len;
+        }
+    }
+    pthread_mutex_unlock(&endpoint_lock);
+
+    if (endpoint_type == ENDPOINT_HTTP)
+    {
+        char request[1024];
+        int hlen;
+        if (endpoint_readRequest(fd, request, sizeof(request)) <= 0)
+        {
+            free(text);
+            return;
+        }
+        if (strncmp(request, "GET ", 4) != 0)
+        {
+            hlen = snprintf(header, sizeof(header),
+                        "HTTP/1.0 405 Method Not Allowed\r\nAllow: GET\r\nContent-Length: 0\r\n\r\n");
+            endpoint_sendAll(fd, header, hlen);
+            free(text);
+            return;
+        }
+        hlen = snprintf(header, sizeof(header),
+                        "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %llu\r\n\r\n",
+                        LLU_CAST len);
+        if (endpoint_sendAll(fd, header, hlen) < 0)
+        {
+            free(text);
+            return;
+        }
+    }
+    if (len > 0)
+    {
+        endpoint_sendAll(fd, text, len);
+    }
+    free(text);
+}
+
+static void*
+endpoint_serve(void* arg)
+{
+    struct pollfd pfd;
+
+    pfd.fd = endpoint_socket;
+    pfd.events = POLLIN;
+    while (endpoint_running)
+    {
+        int client;
+        if (poll(&pfd, 1, AGENT_ENDPOINT_TIMEOUT) <= 0)
+        {
+            continue;
+        }
+        client = accept(endpoint_socket, NULL, NULL);
+        if (client < 0)
+        {
+            continue;
+        }
+        endpoint_handleClient(client);
+        close(client);
+    }
+    return NULL;
+}
+
+static char*
+shm_filename(const char* name)
+{
+    char* filename = NULL;
+    if (name == NULL)
+    {
+        return NULL;
+    }
+    filename = (char*) malloc(strlen(name) + 10);
+    if (filename)
+    {
+        sprintf(filename, (name[0] == '/' ? "%s" : "/dev/shm/%s"), name);
+    }
+    return filename;
+}
+
+/* Sends the first num packed Ganglia messages with as few syscalls as
+ * possible. Returns the number of sent messages or -errno */
+static int
+ganglia_sendPackets(int num)
+{
+    int sent = 0;
+
+    memset(ganglia_msgs, 0, num * sizeof(struct mmsghdr));
+    for (int i = 0; i < num; i++)
+    {
+        ganglia_iovs[i].iov_base = ganglia_packets[i].data;
+        ganglia_iovs[i].iov_len = ganglia_packets[i].len;
+        ganglia_msgs[i].msg_hdr.msg_name = &ganglia_addr;
+        ganglia_msgs[i].msg_hdr.msg_namelen = ganglia_addrlen;
+        ganglia_msgs[i].msg_hdr.msg_iov = &ganglia_iovs[i];
+        ganglia_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    while (sent < num)
+    {
+        int ret = sendmmsg(ganglia_socket, &ganglia_msgs[sent], num - sent, 0);
+        if (ret < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -errno;
+        }
+        sent += ret;
+    }
+    return sent;
+}
+
+/* #####   FUNCTION DEFINITIONS  -  EXPORTED FUNCTIONS   ################## */
+
+int
+agent_gangliaOpen(const char* host, int port)
+{
+    int ret;
+    char service[16];
+    struct addrinfo hints;
+    struct addrinfo* res = NULL;
+
+    if (ganglia_socket >= 0)
+    {
+        agent_gangliaClose();
+    }
+    memset(&hints, 0, sizeof(struct addrinfo));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    snprintf(service, sizeof(service), "%d", (port > 0 ? port : AGENT_GANGLIA_PORT));
+    ret = getaddrinfo((host ? host : AGENT_GANGLIA_HOST), service, &hints, &res);
+    if (ret != 0)
+    {
+        ERROR_PRINT(Cannot resolve Ganglia host %s: %s, host, gai_strerror(ret));
+        return -EINVAL;
+    }
+    ganglia_socket = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (ganglia_socket < 0)
+    {
+        ret = -errno;
+        freeaddrinfo(res);
+        return ret;
+    }
+    memcpy(&ganglia_addr, res->ai_addr, res->ai_addrlen);
+    ganglia_addrlen = res->ai_addrlen;
+    freeaddrinfo(res);
+
+    ganglia_packets = (XdrPacket*) malloc(AGENT_MAX_METRICS * sizeof(XdrPacket));
+    ganglia_msgs = (struct mmsghdr*) malloc(AGENT_MAX_METRICS * sizeof(struct mmsghdr));
+    ganglia_iovs = (struct iovec*) malloc(AGENT_MAX_METRICS * sizeof(struct iovec));
+    if ((!ganglia_packets) || (!ganglia_msgs) || (!ganglia_iovs))
+    {
+        agent_gangliaClose();
+        return -ENOMEM;
+    }
+    memset(ganglia_hostname, 0, sizeof(ganglia_hostname));
+    gethostname(ganglia_hostname, sizeof(ganglia_hostname)-1);
+    return 0;
+}
+
+int
+agent_gangliaSend(const char* group, int tmax, int sendMeta,
+                  int numMetrics, AgentMetric* metrics)
+{
+    int i;
+    int num = 0;
+    int sent = 0;
+    int ret;
+
+    if (ganglia_socket < 0)
+    {
+        return -EBADF;
+    }
+    /* Each metadata or value message must be a datagram of its own. The
+     * messages are sent in batches of at most AGENT_MAX_METRICS. */
+    for (i = 0; i < numMetrics; i++)
+    {
+        if (num + 2 > AGENT_MAX_METRICS)
+        {
+            ret = ganglia_sendPackets(num);
+            if (ret < 0)
+            {
+                return ret;
+            }
+            sent += ret;
+            num = 0;
+        }
+        if (sendMeta)
+        {
+            ganglia_packMetadata(&ganglia_packets[num], group, tmax, &metrics[i]);
+            if (!ganglia_packets[num].overflow)
+            {
+                num++;
+            }
+        }
+        ganglia_packValue(&ganglia_packets[num], &metrics[i]);
+        if (!ganglia_packets[num].overflow)
+        {
+            num++;
+        }
+    }
+    ret = ganglia_sendPackets(num);
+    if (ret < 0)
+    {
+        return ret;
+    }
+    return sent + ret;
+}
+
+void
+agent_gangliaClose(void)
+{
+    if (ganglia_socket >= 0)
+    {
+        close(ganglia_socket);
+        ganglia_socket = -1;
+    }
+    free(ganglia_packets);
+    ganglia_packets = NULL;
+    free(ganglia_msgs);
+    ganglia_msgs = NULL;
+    free(ganglia_iovs);
+    ganglia_iovs = NULL;
+}
+
+int
+agent_syslogOpen(const char* prio)
+{
+    int facility = LOG_LOCAL0;
+    int level = LOG_NOTICE;
+
+    if ((prio != NULL) && (strlen(prio) > 0))
+    {
+        const char* dot = strchr(prio, '.');
+        if (dot)
+        {
+            facility = syslog_lookup(syslog_facilities, prio, dot - prio);
+            level = syslog_lookup(syslog_levels, dot + 1, strlen(dot + 1));
+        }
+        else
+        {
+            level = syslog_lookup(syslog_levels, prio, strlen(prio));
+        }
+        if ((facility < 0) || (level < 0))
+        {
+            ERROR_PRINT(Invalid syslog priority %s, prio);
+            return -EINVAL;
+        }
+    }
+    openlog("LIKWID", LOG_NDELAY|LOG_PID, facility);
+    syslog_level = level;
+    syslog_open = 1;
+    return 0;
+}
+
+int
+agent_syslogSend(const char* group, int numMetrics, AgentMetric* metrics)
+{
+    int i;
+    int pos = 0;
+    int start = 0;
+    char msg[AGENT_SYSLOG_MSG_SIZE];
+
+    if (!syslog_open)
+    {
+        return -EBADF;
+    }
+    if (group)
+    {
+        start = snprintf(msg, sizeof(msg), "%s:", group);
+        if (start >= (int)sizeof(msg))
+        {
+            start = 0;
+        }
+    }
+    pos = start;
+    for (i = 0; i < numMetrics; i++)
+    {
+        char entry[AGENT_SYSLOG_MSG_SIZE];
+        int len = append_name(entry, 0, sizeof(entry), metrics[i].name);
+        len += snprintf(entry + len, sizeof(entry) - len, "=%g", metrics[i].value);
+        if (len >= (int)sizeof(entry) - start - 1)
+        {
+            continue;
+        }
+        if (pos + 1 + len >= (int)sizeof(msg))
+        {
+            syslog(syslog_level, "%s", msg);
+            pos = start;
+        }
+        msg[pos++] = ' ';
+        memcpy(msg + pos, entry, len + 1);
+        pos += len;
+    }
+    if (pos > start)
+    {
+        syslog(syslog_level, "%s", msg);
+    }
+    return 0;
+}
+
+void
+agent_syslogClose(void)
+{
+    if (syslog_open)
+    {
+        closelog();
+        syslog_open = 0;
+    }
+}
+
+int
+agent_tsOpen(const char* filename, int numMetrics, AgentMetric* metrics)
+{
+    int i;
+    int fd;
+    int handle = -1;
+    struct stat st;
+
+    if (!ts_initialized)
+    {
+        for (i = 0; i < AGENT_MAX_TSFILES; i++)
+        {
+            ts_files[i].fd = -1;
+        }
+        ts_initialized = 1;
+    }
+    for (i = 0; i < AGENT_MAX_TSFILES; i++)
+    {
+        if (ts_files[i].fd < 0)
+        {
+            handle = i;
+            break;
+        }
+    }
+    if (handle < 0)
+    {
+        return -EMFILE;
+    }
+    fd = open(filename, O_WRONLY|O_CREAT|O_APPEND, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+    if (fd < 0)
+    {
+        return -errno;
+    }
+    /* A new file starts with a header line naming the columns */
+    if ((fstat(fd, &st) == 0) && (st.st_size == 0))
+    {
+        size_t size = 16;
+        char* header;
+        int pos;
+        for (i = 0; i < numMetrics; i++)
+        {
+            size += strlen(metrics[i].name) + 1;
+        }
+        header = (char*) malloc(size);
+        if (header == NULL)
+        {
+            close(fd);
+            return -ENOMEM;
+        }
+        pos = snprintf(header, size, "# Timestamp");
+        for (i = 0; i < numMetrics; i++)
+        {
+            header[pos++] = ',';
+            pos = append_name(header, pos, size, metrics[i].name);
+        }
+        header[pos++] = '\n';
+        if (write(fd, header, pos) != pos)
+        {
+            ERROR_PRINT(Cannot write header of time series file %s, filename);
+        }
+        free(header);
+    }
+    ts_files[handle].fd = fd;
+    ts_files[handle].numMetrics = numMetrics;
+    return handle;
+}
+
+int
+agent_tsWrite(int handle, uint64_t timestamp, int numMetrics, AgentMetric* metrics)
+{
+    int i;
+    int pos;
+    int ret = 0;
+    size_t size;
+    char* line;
+
+    if ((!ts_initialized) || (handle < 0) || (handle >= AGENT_MAX_TSFILES) ||
+        (ts_files[handle].fd < 0))
+    {
+        return -EBADF;
+    }
+    if (numMetrics != ts_files[handle].numMetrics)
+    {
+        return -EINVAL;
+    }
+    size = 24 + numMetrics * 26;
+    line = (char*) malloc(size);
+    if (line == NULL)
+    {
+        return -ENOMEM;
+    }
+    pos = snprintf(line, size, "%llu", LLU_CAST timestamp);
+    for (i = 0; i < numMetrics; i++)
+    {
+        pos += snprintf(line + pos, size - pos, ",%.17g", metrics[i].value);
+    }
+    line[pos++] = '\n';
+    if (write(ts_files[handle].fd, line, pos) != pos)
+    {
+        ret = -errno;
+    }
+    free(line);
+    return ret;
+}
+
+void
+agent_tsClose(int handle)
+{
+    if ((ts_initialized) && (handle >= 0) && (handle < AGENT_MAX_TSFILES) &&
+        (ts_files[handle].fd >= 0))
+    {
+        close(ts_files[handle].fd);
+        ts_files[handle].fd = -1;
+    }
+}
+
+int
+agent_endpointOpen(const char* spec, const char* group)
+{
+    int ret;
+    int one = 1;
+
+    if (endpoint_running)
+    {
+        agent_endpointClose();
+    }
+    if ((spec == NULL) || (strncmp(spec, "unix:", 5) == 0))
+    {
+        struct sockaddr_un addr;
+        const char* path = (spec ? spec + 5 : "");
+        if ((strlen(path) == 0) || (strlen(path) >= sizeof(addr.sun_path)))
+        {
+            ERROR_PRINT(Invalid socket path for endpoint %s, spec);
+            return -EINVAL;
+        }
+        endpoint_socket = socket(AF_LOCAL, SOCK_STREAM, 0);
+        if (endpoint_socket < 0)
+        {
+            return -errno;
+        }
+        memset(&addr, 0, sizeof(struct sockaddr_un));
+        addr.sun_family = AF_LOCAL;
+        strcpy(addr.sun_path, path);
+        unlink(path);
+        /* The socket is created accessible for the owner only, clients of
+         * other users need to be in the configured group */
+        mode_t mask = umask(S_IRWXG|S_IRWXO);
+        ret = bind(endpoint_socket, (struct sockaddr*) &addr, sizeof(struct sockaddr_un));
+        umask(mask);
+        if (ret < 0)
+        {
+            ret = -errno;
+            ERROR_PRINT(Cannot bind endpoint socket %s, path);
+            close(endpoint_socket);
+            endpoint_socket = -1;
+            return ret;
+        }
+        if (group != NULL)
+        {
+            struct group* grp = getgrnam(group);
+            if ((grp == NULL) || (chown(path, (uid_t)-1, grp->gr_gid) < 0) ||
+                (chmod(path, S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP) < 0))
+            {
+                ERROR_PRINT(Cannot grant group %s access to endpoint socket %s, group, path);
+                close(endpoint_socket);
+                endpoint_socket = -1;
+                unlink(path);
+                return -EPERM;
+            }
+        }
+        endpoint_path = strdup(path);
+        endpoint_type = ENDPOINT_UNIX;
+    }
+    else if (strncmp(spec, "http:", 5) == 0)
+    {
+        struct sockaddr_in addr;
+        int port = atoi(spec + 5);
+        if ((port <= 0) || (port > 65535))
+        {
+            ERROR_PRINT(Invalid port for endpoint %s, spec);
+            return -EINVAL;
+        }
+        endpoint_socket = socket(AF_INET, SOCK_STREAM, 0);
+        if (endpoint_socket < 0)
+        {
+            return -errno;
+        }
+        setsockopt(endpoint_socket, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(int));
+        memset(&addr, 0, sizeof(struct sockaddr_in));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        /* Only local consumers, the endpoint has no authentication */
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(endpoint_socket, (struct sockaddr*) &addr, sizeof(struct sockaddr_in)) < 0)
+        {
+            ret = -errno;
+            ERROR_PRINT(Cannot bind endpoint to localhost port %d, port);
+            close(endpoint_socket);
+            endpoint_socket = -1;
+            return ret;
+        }
+        endpoint_type = ENDPOINT_HTTP;
+    }
+    else
+    {
+        ERROR_PRINT(Unknown endpoint %s (use unix:<path> or http:<port>), spec);
+        return -EINVAL;
+    }
+    if (listen(endpoint_socket, 16) < 0)
+    {
+        ret = -errno;
+        agent_endpointClose();
+        return ret;
+    }
+    endpoint_running = 1;
+    if (pthread_create(&endpoint_thread, NULL, endpoint_serve, NULL) != 0)
+    {
+        endpoint_running = 0;
+        agent_endpointClose();
+        return -EAGAIN;
+    }
+    return 0;
+}
+
+void
+agent_endpointClose(void)
+{
+    if (endpoint_running)
+    {
+        endpoint_running = 0;
+        pthread_join(endpoint_thread, NULL);
+    }
+    if (endpoint_socket >= 0)
+    {
+        close(endpoint_socket);
+        endpoint_socket = -1;
+    }
+    if (endpoint_path)
+    {
+        unlink(endpoint_path);
+        free(endpoint_path);
+        endpoint_path = NULL;
+    }
+    pthread_mutex_lock(&endpoint_lock);
+    free(endpoint_text);
+    endpoint_text = NULL;
+    endpoint_len = 0;
+    endpoint_size = 0;
+    pthread_mutex_unlock(&endpoint_lock);
+}
+
+int
+agent_shmOpen(const char* name, size_t size)
+{
+    int fd;
+    int ret;
+    struct stat st;
+    char* filename = shm_filename(name);
+
+    if (filename == NULL)
+    {
+        return -EINVAL;
+    }
+    if (shm_header)
+    {
+        agent_shmClose();
+    }
+    if (size == 0)
+    {
+        size = AGENT_SHM_SIZE;
+    }
+    /* /dev/shm is writable for all users, so a stale entry is removed and
+     * the segment is always created freshly without following links */
+    unlink(filename);
+    fd = open(filename, O_RDWR|O_CREAT|O_EXCL|O_NOFOLLOW, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+    if (fd < 0)
+    {
+        ret = -errno;
+        ERROR_PRINT(Cannot create shared memory segment %s, filename);
+        free(filename);
+        return ret;
+    }
+    if ((fstat(fd, &st) < 0) || (!S_ISREG(st.st_mode)) || (st.st_uid != geteuid()))
+    {
+        ERROR_PRINT(Shared memory segment %s is no regular file of the agent, filename);
+        close(fd);
+        free(filename);
+        return -EPERM;
+    }
+    fchmod(fd, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+    shm_mapSize = sizeof(AgentShmHeader) + size;
+    if (ftruncate(fd, shm_mapSize) < 0)
+    {
+        ret = -errno;
+        close(fd);
+        free(filename);
+        return ret;
+    }
+    shm_header = (AgentShmHeader*) mmap(NULL, shm_mapSize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    free(filename);
+    if (shm_header == MAP_FAILED)
+    {
+        shm_header = NULL;
+        return -errno;
+    }
+    memset(shm_header, 0, sizeof(AgentShmHeader));
+    shm_header->version = AGENT_SHM_VERSION;
+    shm_header->headerSize = sizeof(AgentShmHeader);
+    shm_header->capacity = size;
+    __sync_synchronize();
+    memcpy(shm_header->magic, AGENT_SHM_MAGIC, 8);
+    return 0;
+}
+
+void
+agent_shmClose(void)
+{
+    if (shm_header)
+    {
+        munmap(shm_header, shm_mapSize);
+        shm_header = NULL;
+        shm_mapSize = 0;
+    }
+}
+
+int
+agent_publish(const char* text, size_t len, uint64_t timestamp)
+{
+    int ret = 0;
+
+    if (endpoint_running)
+    {
+        pthread_mutex_lock(&endpoint_lock);
+        if (len > endpoint_size)
+        {
+            char* tmp = (char*) realloc(endpoint_text, len);
+            if (tmp == NULL)
+            {
+                pthread_mutex_unlock(&endpoint_lock);
+                return -ENOMEM;
+            }
+            endpoint_text = tmp;
+            endpoint_size = len;
+        }
+        memcpy(endpoint_text, text, len);
+        endpoint_len = len;
+        pthread_mutex_unlock(&endpoint_lock);
+    }
+    if (shm_header)
+    {
+        if (len > shm_header->capacity)
+        {
+            /* Keep complete lines only */
+            len = shm_header->capacity;
+            while ((len > 0) && (text[len-1] != '\n'))
+            {
+                len--;
+            }
+            ret = -E2BIG;
+        }
+        shm_header->seq++;
+        __sync_synchronize();
+        memcpy(((char*)shm_header) + sizeof(AgentShmHeader), text, len);
+        shm_header->length = len;
+        shm_header->timestamp = timestamp;
+        __sync_synchronize();
+        shm_header->seq++;
+    }
+    return ret;
+}
+
+int
+agent_shmRead(const char* name, char* buf, size_t size)
+{
+    int fd;
+    int retries = 0;
+    int ret = -EAGAIN;
+    struct stat st;
+    AgentShmHeader* header = NULL;
+    char* filename = shm_filename(name);
+
+    if ((filename == NULL) || (buf == NULL) || (size == 0))
+    {
+        free(filename);
+        return -EINVAL;
+    }
+    fd = open(filename, O_RDONLY);
+    free(filename);
+    if (fd < 0)
+    {
+        return -errno;
+    }
+    if ((fstat(fd, &st) < 0) || (st.st_size < (off_t)sizeof(AgentShmHeader)))
+    {
+        close(fd);
+        return -EINVAL;
+    }
+    header = (AgentShmHeader*) mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (header == MAP_FAILED)
+    {
+        return -errno;
+    }
+    if ((memcmp(header->magic, AGENT_SHM_MAGIC, 8) != 0) ||
+        (header->version != AGENT_SHM_VERSION) ||
+        (header->headerSize != sizeof(AgentShmHeader)) ||
+        (sizeof(AgentShmHeader) + header->capacity > (size_t)st.st_size))
+    {
+        munmap(header, st.st_size);
+        return -EINVAL;
+    }
+    while (retries++ < 1000)
+    {
+        uint64_t len;
+        uint64_t seq = header->seq;
+        if (seq & 1)
+        {
+            sched_yield();
+            continue;
+        }
+        __sync_synchronize();
+        len = header->length;
+        if (len > header->capacity)
+        {
+            continue;
+        }
+        if (len > size - 1)
+        {
+            len = size - 1;
+        }
+        memcpy(buf, ((char*)header) + header->headerSize, len);
+        __sync_synchronize();
+        if (header->seq == seq)
+        {
+            buf[len] = '\0';
+            ret = (int)len;
+            break;
+        }
+    }
+    munmap(header, st.st_size);
+    return ret;
+}
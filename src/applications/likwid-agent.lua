@@ -37,21 +37,35 @@ dconfig["groupStrings"] ={}
 dconfig["groupData"] ={}
 dconfig["accessmode"] = 1
 dconfig["duration"] = 1
+dconfig["continuous"] = false
+dconfig["rotate"] = 1
 dconfig["groupPath"] = "<INSTALLED_PREFIX>/share/likwid/mongroups"
 dconfig["logPath"] = nil
 dconfig["logStyle"] = "log"
 dconfig["gmetric"] = false
-dconfig["gmetricPath"] = "gmetric"
-dconfig["gmetricConfig"] = nil
-dconfig["gmetricHasUnit"] = false
-dconfig["gmetricHasGroup"] = false
+dconfig["gangliaHost"] = "239.2.11.71"
+dconfig["gangliaPort"] = 8649
+dconfig["gangliaMetaInterval"] = 20
 dconfig["rrd"] = false
 dconfig["rrdPath"] = "."
+dconfig["tsPath"] = nil
+dconfig["endpoint"] = nil
+dconfig["endpointGroup"] = nil
+dconfig["shmName"] = nil
+dconfig["jobCgroup"] = nil
+dconfig["jobPrefix"] = "job_"
+dconfig["jobRefresh"] = 10
 dconfig["syslog"] = false
 dconfig["syslogPrio"] = "local0.notice"
 dconfig["stdout"] = false
 
 rrdconfig = {}
+rrdpipe = nil
+tsconfig = {}
+published = {}
+jobs = {}
+jobKeys = {}
+lastJobScan = nil
 
 
 local function read_daemon_config(filename)
@@ -94,6 +108,20 @@ local function read_daemon_config(filename)
                 dconfig["duration"] = tonumber(linelist[1])
             end
 
+            if line:match("^CONTINUOUS%a*") ~= nil then
+                local linelist = likwid.stringsplit(line, "%s+", nil, "%s+")
+                table.remove(linelist, 1)
+                if linelist[1] == "True" then
+                    dconfig["continuous"] = true
+                end
+            end
+
+            if line:match("^ROTATE%a*") ~= nil then
+                local linelist = likwid.stringsplit(line, "%s+", nil, "%s+")
+                table.remove(linelist, 1)
+                dconfig["rotate"] = tonumber(linelist[1])
+            end
+
             if line:match("^ACCESSMODE%a*") ~= nil then
                 local linelist = likwid.stringsplit(line, "%s+", nil, "%s+")
                 table.remove(linelist, 1)
@@ -124,16 +152,64 @@ local function read_daemon_config(filename)
                 end
             end
 
-            if line:match("^GMETRICPATH%a*") ~= nil then
+            if line:match("^GANGLIAHOST%a*") ~= nil then
+                local linelist = likwid.stringsplit(line, "%s+", nil, "%s+")
+                table.remove(linelist, 1)
+                dconfig["gangliaHost"] = linelist[1]
+            end
+
+            if line:match("^GANGLIAPORT%a*") ~= nil then
+                local linelist = likwid.stringsplit(line, "%s+", nil, "%s+")
+                table.remove(linelist, 1)
+                dconfig["gangliaPort"] = tonumber(linelist[1])
+            end
+
+            if line:match("^GANGLIAMETA%a*") ~= nil then
+                local linelist = likwid.stringsplit(line, "%s+", nil, "%s+")
+                table.remove(linelist, 1)
+                dconfig["gangliaMetaInterval"] = tonumber(linelist[1])
+            end
+
+            if line:match("^JOBCGROUP%a*") ~= nil then
+                local linelist = likwid.stringsplit(line, "%s+", nil, "%s+")
+                table.remove(linelist, 1)
+                dconfig["jobCgroup"] = linelist[1]
+            end
+
+            if line:match("^JOBPREFIX%a*") ~= nil then
+                local linelist = likwid.stringsplit(line, "%s+", nil, "%s+")
+                table.remove(linelist, 1)
+                dconfig["jobPrefix"] = linelist[1]
+            end
+
+            if line:match("^JOBREFRESH%a*") ~= nil then
+                local linelist = likwid.stringsplit(line, "%s+", nil, "%s+")
+                table.remove(linelist, 1)
+                dconfig["jobRefresh"] = tonumber(linelist[1])
+            end
+
+            if line:match("^ENDPOINT%s") ~= nil then
+                local linelist = likwid.stringsplit(line, "%s+", nil, "%s+")
+                table.remove(linelist, 1)
+                dconfig["endpoint"] = linelist[1]
+            end
+
+            if line:match("^ENDPOINTGROUP%a*") ~= nil then
+                local linelist = likwid.stringsplit(line, "%s+", nil, "%s+")
+                table.remove(linelist, 1)
+                dconfig["endpointGroup"] = linelist[1]
+            end
+
+            if line:match("^SHMNAME%a*") ~= nil then
                 local linelist = likwid.stringsplit(line, "%s+", nil, "%s+")
                 table.remove(linelist, 1)
-                dconfig["gmetricPath"] = linelist[1]
+                dconfig["shmName"] = linelist[1]
             end
 
-            if line:match("^GMETRICCONFIG%a*") ~= nil then
+            if line:match("^TSPATH%a*") ~= nil then
                 local linelist = likwid.stringsplit(line, "%s+", nil, "%s+")
                 table.remove(linelist, 1)
-                dconfig["gmetricConfig"] = linelist[1]
+                dconfig["tsPath"] = linelist[1]
             end
 
             if line:match("^RRD%a*") ~= nil then
@@ -167,44 +243,27 @@ local function read_daemon_config(filename)
     end
 end
 
-local function calc_sum(key, results)
-    local sum = 0.0
-    local numThreads = likwid.getNumberOfThreads()
-    for thread=1, numThreads do
-        sum = sum + results[thread][key]
-    end
-    return sum
-end
-
-local function calc_avg(key, results)
-    local sum = 0.0
-    local numThreads = likwid.getNumberOfThreads()
-    for thread=1, numThreads do
-        sum = sum + results[thread][key]
-    end
-    return sum/numThreads
-end
-
-local function calc_min(key, results)
-    local min = math.huge
-    local numThreads = likwid.getNumberOfThreads()
-    for thread=1, numThreads do
-        if results[thread][key] < min then
-            min = results[thread][key]
+-- Aggregate each metric over all CPUs and per socket. Metrics of uncore
+-- counters are aggregated over the sockets, not over the CPUs.
+local function calc_aggregates(gdata, threadOutput, cpus)
+    local aggregates = {}
+    if gdata["UncoreMetrics"] == nil then
+        gdata["UncoreMetrics"] = {}
+        for i, metric in pairs(gdata["Metrics"]) do
+            gdata["UncoreMetrics"][i] = likwid.isUncoreMetric(metric["formula"], gdata["Events"])
         end
     end
-    return min
-end
-
-local function calc_max(key, results)
-    local max = 0
-    local numThreads = likwid.getNumberOfThreads()
-    for thread=1, numThreads do
-        if results[thread][key] > max then
-            max = results[thread][key]
+    for i, metric in pairs(gdata["Metrics"]) do
+        local desc = metric["description"]
+        local values = {}
+        for thread=1, likwid.getNumberOfThreads() do
+            values[thread] = threadOutput[thread][desc]
         end
+        local node = likwid.aggregateValues(cpus, values, gdata["UncoreMetrics"][i], "node")
+        aggregates[desc] = {node = node[1],
+                            sockets = likwid.aggregateValues(cpus, values, gdata["UncoreMetrics"][i], "socket")}
     end
-    return max
+    return aggregates
 end
 
 local function check_logfile()
@@ -240,94 +299,136 @@ local function logfile(groupID, results)
     f:close()
 end
 
-local function check_logger()
-    cmd = "which logger"
-    local f = io.popen(cmd)
-    if f == nil then
-        return false
-    end
-    f:close()
-    return true
-end
-
-local function logger(results)
-    cmd = "logger -t LIKWID "
-    if dconfig["syslogPrio"] ~= nil then
-        cm = cmd .."-p "..dconfig["syslogPrio"].." "
-    end
-    local timestamp = results["Timestamp"]
+local function sorted_metrics(results)
+    local keys = {}
     for k,v in pairs(results) do
         if k ~= "Timestamp" then
-            local resultcmd = cmd .. k:gsub("%(",""):gsub("%)","") .. " " ..v
-            local f = io.popen(resultcmd)
-            if f == nil then
-                print("Cannot use logger, maybe not in $PATH")
-                return
-            end
-            f:close()
+            table.insert(keys, k)
         end
     end
-    
+    table.sort(keys)
+    local metrics = {}
+    for i, k in pairs(keys) do
+        local name = k
+        local unit = nil
+        local s,e = k:find("%[")
+        if s ~= nil then
+            name = k:sub(0,s-2):gsub("^%s*(.-)%s*$", "%1"):gsub("_$","")
+            unit = k:sub(s+1,k:len()-1):gsub("^%s*(.-)%s*$", "%1")
+        end
+        local value = tonumber(results[k])
+        if value == nil then
+            value = 0
+        end
+        table.insert(metrics, {name=name, unit=unit, value=value, key=k})
+    end
+    return metrics
 end
 
-local function check_gmetric()
-    if dconfig["gmetricPath"] == nil then
-        return false
+local function logger(gdata, metrics)
+    local ret = likwid.syslogSend(gdata["GroupString"], metrics)
+    if ret < 0 then
+        print("Cannot write metrics to syslog")
     end
-    local f = io.popen(dconfig["gmetricPath"].." -h","r")
-    if f == nil then
-        return false
+end
+
+local function gmetric(gdata, metrics, sendMeta)
+    local group = nil
+    if gdata["GroupString"] ~= gdata["EventString"] then
+        group = gdata["GroupString"]
     end
-    local msg = f:read("*a")
-    if msg:match("units=") then
-        dconfig["gmetricHasUnit"] = true
+    local tmax = #dconfig["groupData"] * dconfig["duration"]
+    local ret = likwid.gangliaSend(group, tmax, sendMeta, metrics)
+    if ret < 0 then
+        print("Cannot send metrics to Ganglia at "..dconfig["gangliaHost"]..":"..tostring(dconfig["gangliaPort"]))
     end
-    if msg:match("group=") then
-        dconfig["gmetricHasGroup"] = true
+end
+
+local function tsfile(gdata, allmetrics)
+    local group = gdata["GroupString"]
+    -- Jobs come and go, the columns of a time series file are fixed
+    local metrics = {}
+    for i, metric in pairs(allmetrics) do
+        if not jobKeys[metric["key"]] then
+            table.insert(metrics, metric)
+        end
+    end
+    if tsconfig[group] == nil then
+        local filename = dconfig["tsPath"].."/likwid."..group..".ts"
+        local handle = likwid.tsOpen(filename, metrics)
+        if handle < 0 then
+            print("Cannot open time series file "..filename..". Deactivating time series output.")
+            dconfig["tsPath"] = nil
+            return
+        end
+        tsconfig[group] = handle
+    end
+    if likwid.tsWrite(tsconfig[group], os.time(), metrics) < 0 then
+        print("Cannot write to time series file of group "..group)
     end
-    f:close()
-    return true
 end
 
-local function gmetric(gdata, results)
-    execList = {}
-    if dconfig["gmetricPath"] == nil then
-        return
+local function exposition_label(str)
+    str = str:gsub("\\","\\\\")
+    str = str:gsub("\"","\\\"")
+    str = str:gsub("\n","\\n")
+    return str
+end
+
+-- Plain text exposition of all per-CPU and aggregated metrics of a group,
+-- one sample per line: likwid_metric{group,metric,scope[,cpu]} value time_ms
+local function metric_name(desc)
+    local func = desc:match("^(%u+)%s")
+    if func == "AVG" or func == "SUM" or func == "MIN" or func == "MAX" or func == "ONCE" then
+        return desc:sub(func:len()+2)
     end
-    table.insert(execList, dconfig["gmetricPath"])
-    if dconfig["gmetricConfig"] ~= nil then
-        table.insert(execList, "-c")
-        table.insert(execList, dconfig["gmetricConfig"])
+    return desc
+end
+
+local function exposition(gdata, threadOutput, aggregates, jobOutput, cpus, timestamp)
+    local lines = {}
+    local group = exposition_label(gdata["GroupString"])
+    local ms = string.format("%d", timestamp * 1000)
+    table.insert(lines, "# group "..gdata["GroupString"])
+    for i, metric in pairs(gdata["Metrics"]) do
+        local desc = metric["description"]
+        local name = metric_name(desc)
+        local prefix = "likwid_metric{group=\""..group.."\",metric=\""..exposition_label(name).."\",scope=\""
+        for thread=1, likwid.getNumberOfThreads() do
+            table.insert(lines, string.format("%scpu\",cpu=\"%d\"} %s %s", prefix, cpus[thread], tostring(threadOutput[thread][desc]), ms))
+        end
+        local node = aggregates[desc]["node"]
+        table.insert(lines, prefix.."sum\"} "..tostring(node["sum"]).." "..ms)
+        table.insert(lines, prefix.."avg\"} "..tostring(node["avg"]).." "..ms)
+        table.insert(lines, prefix.."min\"} "..tostring(node["min"]).." "..ms)
+        table.insert(lines, prefix.."max\"} "..tostring(node["max"]).." "..ms)
+        for _, socket in pairs(aggregates[desc]["sockets"]) do
+            table.insert(lines, string.format("%ssocket\",socket=\"%d\"} %s %s", prefix, socket["domain"], tostring(socket["sum"]), ms))
+        end
+        for id, results in pairs(jobOutput) do
+            table.insert(lines, prefix.."job\",job=\""..exposition_label(id).."\"} "..tostring(results[desc]).." "..ms)
+        end
     end
-    if dconfig["gmetricHasGroup"] and gdata["GroupString"] ~= gdata["EventString"] then
-        table.insert(execList, "-g")
-        table.insert(execList, gdata["GroupString"])
+    table.insert(lines, "")
+    return table.concat(lines, "\n")
+end
+
+local function publish(groupID, text, timestamp)
+    published[groupID] = text
+    local all = {}
+    for i=1, #dconfig["groupData"] do
+        if published[i] ~= nil then
+            table.insert(all, published[i])
+        end
     end
-    for k,v in pairs(results) do
-        local execStr = table.concat(execList, " ")
-        if k ~= "Timestamp" then
-            execStr = execStr .. " -t double "
-
-            local name = k
-            local unit = nil
-            local s,e = k:find("%[")
-            if s ~= nil then
-                name = k:sub(0,s-2):gsub("^%s*(.-)%s*$", "%1")
-                unit = k:sub(s+1,k:len()-1):gsub("^%s*(.-)%s*$", "%1")
-            end
-            execStr = execStr .. " --name=\"" .. name .."\""
-            if dconfig["gmetricHasUnit"] and unit ~= nil then
-                execStr = execStr .. " --units=\"" .. unit .."\""
-            end
-            local value = tonumber(v)
-            if v ~= nil and value ~= nil then
-                execStr = execStr .. " --value=\"" .. string.format("%f", value) .."\""
-            elseif v ~= nil then
-                execStr = execStr .. " --value=\"" .. tostring(v) .."\""
-            else
-                execStr = execStr .. " --value=\"0\""
-            end
-            os.execute(execStr)
+    local ret = likwid.publish(table.concat(all), timestamp)
+    if ret < 0 then
+        if dconfig["shmName"] ~= nil and dconfig["endpoint"] == nil then
+            print("Published metrics exceed the shared memory segment "..dconfig["shmName"])
+        elseif dconfig["shmName"] ~= nil then
+            print("Cannot publish metrics to endpoint "..dconfig["endpoint"].." or shared memory segment "..dconfig["shmName"])
+        else
+            print("Cannot publish metrics to endpoint "..tostring(dconfig["endpoint"]))
         end
     end
 end
@@ -343,25 +444,39 @@ local function normalize_rrd_string(str)
     return str
 end
 
+-- All RRD commands are written to one persistent 'rrdtool -' process
 local function check_rrd()
-    local f = io.popen("rrdtool")
-    if f == nil then
+    -- popen starts the shell even if rrdtool is missing, the first write
+    -- would then kill the agent with SIGPIPE
+    if os.execute("which rrdtool > /dev/null 2>&1") ~= true then
+        return false
+    end
+    rrdpipe = io.popen("rrdtool - > /dev/null", "w")
+    if rrdpipe == nil then
         return false
     end
-    f:close()
     return true
 end
 
+local function rrd_write(rrdstring)
+    if rrdpipe:write(rrdstring.."\n") == nil or rrdpipe:flush() == nil then
+        print("Cannot write to rrdtool. Deactivating rrd output.")
+        rrdpipe:close()
+        rrdpipe = nil
+        dconfig["rrd"] = false
+    end
+end
+
 local function create_rrd(numGroups, duration, groupData)
     local rrdname = dconfig["rrdPath"].."/".. groupData["GroupString"] .. ".rrd"
-    local rrdstring = "rrdtool create "..rrdname.." --step ".. tostring(numGroups*duration)
+    local rrdstring = "create "..rrdname.." --step ".. tostring(numGroups*duration)
     if rrdconfig[groupData["GroupString"]] == nil then
         rrdconfig[groupData["GroupString"]] = {}
     end
-    for i, metric in pairs(groupdata["Metrics"]) do
+    for i, metric in pairs(groupData["Metrics"]) do
         rrdstring = rrdstring .. " DS"..":" .. normalize_rrd_string(metric["description"]) ..":GAUGE:"
         rrdstring = rrdstring ..tostring(numGroups*duration) ..":0:U"
-        table.insert(rrdconfig[groupData["GroupString"]], metric["description"])
+        table.insert(rrdconfig[groupData["GroupString"]], (metric["description"]:gsub(" ","_")))
     end
     rrdstring = rrdstring .." RRA:AVERAGE:0.5:" .. tostring(60/duration)..":10"
     rrdstring = rrdstring .." RRA:MIN:0.5:" .. tostring(60/duration)..":10"
@@ -374,16 +489,20 @@ local function create_rrd(numGroups, duration, groupData)
     rrdstring = rrdstring .." RRA:AVERAGE:0.5:" .. tostring(86400/duration)..":31"
     rrdstring = rrdstring .." RRA:MIN:0.5:" .. tostring(86400/duration)..":31"
     rrdstring = rrdstring .." RRA:MAX:0.5:" .. tostring(86400/duration)..":31"
-    os.execute(rrdstring)
+    rrd_write(rrdstring)
 end
 
 local function rrd(groupData, results)
     local rrdname = dconfig["rrdPath"].."/".. groupData["GroupString"] .. ".rrd"
-    local rrdstring = "rrdtool update "..rrdname.." N"
+    local rrdstring = "update "..rrdname.." N"
     for i, id in pairs(rrdconfig[groupData["GroupString"]]) do
-        rrdstring = rrdstring .. ":" .. tostring(results[id])
+        local value = results[id]
+        if value == nil then
+            value = "U"
+        end
+        rrdstring = rrdstring .. ":" .. tostring(value)
     end
-    os.execute(rrdstring)
+    rrd_write(rrdstring)
 end
 
 -- Read commandline arguments
@@ -410,10 +529,14 @@ if dconfig["duration"] == 0 then
     print("Invalid value 0 for duration. Sanitizing to 1 second.")
     dconfig["duration"] = 1
 end
+if dconfig["rotate"] == nil or dconfig["rotate"] < 1 then
+    print("Invalid value for rotate. Sanitizing to 1.")
+    dconfig["rotate"] = 1
+end
 
 if dconfig["syslog"] then
-    if check_logger() == false then
-        print("Cannot find tool logger, disabling syslog output.")
+    if likwid.syslogOpen(dconfig["syslogPrio"]) < 0 then
+        print("Cannot open syslog with priority "..dconfig["syslogPrio"]..", disabling syslog output.")
         dconfig["syslog"] = false
     end
 end
@@ -424,11 +547,20 @@ if dconfig["logPath"] then
     end
 end
 if dconfig["gmetric"] then
-    if check_gmetric() == false then
-        print("Cannot find gmetric using path "..dconfig["gmetricPath"]..". Deactivating gmetric output.")
+    if likwid.gangliaOpen(dconfig["gangliaHost"], dconfig["gangliaPort"]) < 0 then
+        print("Cannot send to Ganglia at "..dconfig["gangliaHost"]..":"..tostring(dconfig["gangliaPort"])..". Deactivating gmetric output.")
         dconfig["gmetric"] = false
     end
 end
+if dconfig["gangliaMetaInterval"] == nil or dconfig["gangliaMetaInterval"] < 1 then
+    dconfig["gangliaMetaInterval"] = 20
+end
+if dconfig["tsPath"] then
+    if likwid.access(dconfig["tsPath"], "w") ~= 0 then
+        print("Cannot write to time series path "..dconfig["tsPath"]..". Deactivating time series output.")
+        dconfig["tsPath"] = nil
+    end
+end
 if dconfig["rrd"] then
     if check_rrd() == false then
         print("Cannot find rrdtool. Deactivating rrd output.")
@@ -436,15 +568,32 @@ if dconfig["rrd"] then
     end
 end
 
+if dconfig["endpoint"] then
+    if likwid.endpointOpen(dconfig["endpoint"], dconfig["endpointGroup"]) < 0 then
+        print("Cannot open endpoint "..dconfig["endpoint"]..". Deactivating endpoint.")
+        dconfig["endpoint"] = nil
+    end
+end
+if dconfig["shmName"] then
+    if likwid.shmOpen(dconfig["shmName"]) < 0 then
+        print("Cannot create shared memory segment "..dconfig["shmName"]..". Deactivating shared memory output.")
+        dconfig["shmName"] = nil
+    end
+end
+
 -- Activate output to stdout only if no other backend is set
-if dconfig["logPath"] == nil and dconfig["rrd"] == false and dconfig["gmetric"] == false and dconfig["syslog"] == false then
+if dconfig["logPath"] == nil and dconfig["rrd"] == false and dconfig["gmetric"] == false and dconfig["syslog"] == false and dconfig["tsPath"] == nil and dconfig["endpoint"] == nil and dconfig["shmName"] == nil then
     dconfig["stdout"] = true
 end
 
 -- Add all cpus to the cpulist
 local cpulist = {}
+cpu2thread = {}
+cpu2socket = {}
 for i=0, cputopo["numHWThreads"]-1 do
     table.insert(cpulist, cputopo["threadPool"][i]["apicId"])
+    cpu2thread[cputopo["threadPool"][i]["apicId"]] = #cpulist
+    cpu2socket[cputopo["threadPool"][i]["apicId"]] = cputopo["threadPool"][i]["packageId"]
 end
 
 -- Select access mode to msr devices, try configuration file first
@@ -481,104 +630,300 @@ for k,v in pairs(dconfig["groupData"]) do
     end
 end
 
-likwid.catchSignal()
-while likwid.getSignalState() == 0 do
-
-    for groupID,gdata in pairs(dconfig["groupData"]) do
-        local old_mtime = likwid_getRuntimeOfGroup(groupID)
-        local cur_time = os.time()
-        likwid.setupCounters(groupID)
-
-        -- Perform the measurement
-        likwid.startCounters()
-        likwid.sleep(dconfig["duration"] * 1E6)
-        likwid.stopCounters()
-
-        -- temporal array collecting counter to values for each thread for metric calculation
-        threadResults = {}
-        local mtime = likwid_getRuntimeOfGroup(groupID)
-        local clock = likwid_getCpuClock();
-
-        for event=1, likwid.getNumberOfEvents(groupID) do
-            for thread=1, likwid.getNumberOfThreads() do
-                if threadResults[thread] == nil then
-                    threadResults[thread] = {}
-                end
-                local time = mtime - old_mtime
-                threadResults[thread]["time"] = time
-                threadResults[thread]["inverseClock"] = 1.0/clock;
-                local result = likwid.getResult(groupID, event, thread)
-                if threadResults[thread][gdata["Events"][event]["Counter"]] == nil then
-                    threadResults[thread][gdata["Events"][event]["Counter"]] = 0
-                end
-                
-                if gdata["Events"][event]["Counter"]:match("PWR%d") then
-                    dname = gdata["Events"][event]["Event"]:match("PWR_(%a+)_ENERGY")
-                    if power["domains"][dname]["supportInfo"] then
-                        if result ~= 0 and result/time > power["domains"][dname]["maxPower"]*1E-6 then
-                            result = power["domains"][dname]["tdp"]*1E-6 * time
-                        end
-                    end
-                end
-                threadResults[thread][gdata["Events"][event]["Counter"]] = result
+-- Map the CPUs of all jobs to the measured threads, the cgroup cpusets are
+-- read again after JOBREFRESH seconds
+local function update_jobs()
+    if dconfig["jobCgroup"] == nil then
+        return
+    end
+    local now = os.time()
+    if lastJobScan ~= nil and now - lastJobScan < dconfig["jobRefresh"] then
+        return
+    end
+    lastJobScan = now
+    local cgjobs = likwid.getCgroupJobs(dconfig["jobCgroup"], dconfig["jobPrefix"])
+    if cgjobs == nil then
+        print("Cannot read job cgroups in "..dconfig["jobCgroup"])
+        return
+    end
+    jobs = {}
+    for id, cpus in pairs(cgjobs) do
+        local threads = {}
+        for _, cpu in pairs(cpus) do
+            if cpu2thread[cpu] ~= nil then
+                table.insert(threads, cpu2thread[cpu])
             end
         end
+        if #threads > 0 then
+            jobs[id] = threads
+        end
+    end
+end
 
+local function is_core_counter(counter)
+    return counter:match("^FIXC%d") or counter:match("^PMC%d") or counter:match("^TMP%d")
+end
 
-        if gdata["Metrics"] then
-            local threadOutput = {}
-            for i, metric in pairs(gdata["Metrics"]) do
-                for thread=1, likwid.getNumberOfThreads() do
-                    if threadOutput[thread] == nil then
-                        threadOutput[thread] = {}
-                    end
-                    local result = likwid.calculate_metric(metric["formula"], threadResults[thread])
-                    threadOutput[thread][metric["description"]] = result
-                end
+-- Calculate the metrics of each job. Core counters are summed up over the
+-- CPUs of a job (thermal counters are averaged). Uncore counters are summed
+-- up per socket and apportioned by the share of the job at the unhalted
+-- core cycles (FIXC1) of the socket, or by the share of CPUs if the group
+-- does not measure FIXC1.
+local function calc_jobs(gdata, threadResults)
+    local jobOutput = {}
+    if next(jobs) == nil or not gdata["Metrics"] then
+        return jobOutput
+    end
+    local weight = {}
+    local socketWeight = {}
+    local socketThreads = {}
+    local socketUncore = {}
+    for thread=1, likwid.getNumberOfThreads() do
+        local socket = cpu2socket[cpulist[thread]]
+        weight[thread] = threadResults[thread]["FIXC1"] or 0
+        socketWeight[socket] = (socketWeight[socket] or 0) + weight[thread]
+        socketThreads[socket] = (socketThreads[socket] or 0) + 1
+        if socketUncore[socket] == nil then
+            socketUncore[socket] = {}
+        end
+        for counter, value in pairs(threadResults[thread]) do
+            if counter ~= "time" and counter ~= "inverseClock" and not is_core_counter(counter) then
+                socketUncore[socket][counter] = (socketUncore[socket][counter] or 0) + value
             end
-            output = {}
-            output["Timestamp"] = os.date("%m/%d/%Y_%X",cur_time)
-            for i, metric in pairs(gdata["Metrics"]) do
-                itemlist = likwid.stringsplit(metric["description"], "%s+", nil, "%s+")
-                func = itemlist[1]
-                table.remove(itemlist, 1)
-                desc = table.concat(itemlist," ")
-                if func == "AVG" then
-                    output[metric["description"]:gsub(" ","_")] = calc_avg(metric["description"], threadOutput)
-                elseif func == "SUM" then
-                    output[metric["description"]:gsub(" ","_")] = calc_sum(metric["description"], threadOutput)
-                elseif func == "MIN" then
-                    output[metric["description"]:gsub(" ","_")] = calc_min(metric["description"], threadOutput)
-                elseif func == "MAX" then
-                    output[metric["description"]:gsub(" ","_")] = calc_max(metric["description"], threadOutput)
-                elseif func == "ONCE" then
-                    output[metric["description"]:gsub(" ","_")] = threadOutput[1][metric["description"]]
-                else
-                    for thread=1, likwid.getNumberOfThreads() do
-                        output["T"..cpulist[thread] .. "_" .. metric["description"]] = threadOutput[thread][metric["description"]]
-                    end
+        end
+    end
+    for id, threads in pairs(jobs) do
+        local counters = {}
+        local share = {}
+        counters["time"] = threadResults[1]["time"]
+        counters["inverseClock"] = threadResults[1]["inverseClock"]
+        for _, thread in pairs(threads) do
+            local socket = cpu2socket[cpulist[thread]]
+            if socketWeight[socket] > 0 then
+                share[socket] = (share[socket] or 0) + weight[thread]/socketWeight[socket]
+            else
+                share[socket] = (share[socket] or 0) + 1.0/socketThreads[socket]
+            end
+            for counter, value in pairs(threadResults[thread]) do
+                if counter ~= "time" and counter ~= "inverseClock" and is_core_counter(counter) then
+                    counters[counter] = (counters[counter] or 0) + value
                 end
             end
-            if dconfig["logPath"] ~= nil then
-                logfile(groupID, output)
+        end
+        for counter, value in pairs(counters) do
+            if counter:match("^TMP%d") then
+                counters[counter] = value/#threads
             end
-            if dconfig["syslog"] then
-                logger(output)
+        end
+        for socket, factor in pairs(share) do
+            for counter, value in pairs(socketUncore[socket]) do
+                counters[counter] = (counters[counter] or 0) + factor * value
             end
-            if dconfig["gmetric"] then
-                gmetric(gdata, output)
+        end
+        for _, event in pairs(gdata["Events"]) do
+            if counters[event["Counter"]] == nil then
+                counters[event["Counter"]] = 0
             end
-            if dconfig["rrd"] then
-                rrd(gdata, output)
+        end
+        jobOutput[id] = {}
+        for i, metric in pairs(gdata["Metrics"]) do
+            jobOutput[id][metric["description"]] = likwid.calculate_metric(metric["formula"], counters)
+        end
+    end
+    return jobOutput
+end
+
+-- Evaluate the counter results of one measurement interval and send the
+-- metrics to all output backends
+local function evaluate_group(groupID, gdata, threadResults, cur_time, sendMeta)
+    if not gdata["Metrics"] then
+        return
+    end
+    local threadOutput = {}
+    for i, metric in pairs(gdata["Metrics"]) do
+        for thread=1, likwid.getNumberOfThreads() do
+            if threadOutput[thread] == nil then
+                threadOutput[thread] = {}
+            end
+            local result = likwid.calculate_metric(metric["formula"], threadResults[thread])
+            threadOutput[thread][metric["description"]] = result
+        end
+    end
+    local aggregates = calc_aggregates(gdata, threadOutput, cpulist)
+    output = {}
+    output["Timestamp"] = os.date("%m/%d/%Y_%X",cur_time)
+    for i, metric in pairs(gdata["Metrics"]) do
+        itemlist = likwid.stringsplit(metric["description"], "%s+", nil, "%s+")
+        func = itemlist[1]
+        table.remove(itemlist, 1)
+        desc = table.concat(itemlist," ")
+        if func == "AVG" then
+            output[metric["description"]:gsub(" ","_")] = aggregates[metric["description"]]["node"]["avg"]
+        elseif func == "SUM" then
+            output[metric["description"]:gsub(" ","_")] = aggregates[metric["description"]]["node"]["sum"]
+        elseif func == "MIN" then
+            output[metric["description"]:gsub(" ","_")] = aggregates[metric["description"]]["node"]["min"]
+        elseif func == "MAX" then
+            output[metric["description"]:gsub(" ","_")] = aggregates[metric["description"]]["node"]["max"]
+        elseif func == "ONCE" then
+            output[metric["description"]:gsub(" ","_")] = threadOutput[1][metric["description"]]
+        else
+            for thread=1, likwid.getNumberOfThreads() do
+                output["T"..cpulist[thread] .. "_" .. metric["description"]] = threadOutput[thread][metric["description"]]
             end
-            if dconfig["stdout"] then
-                for i,o in pairs(output) do
-                    print(i,o)
+        end
+    end
+    update_jobs()
+    local jobOutput = calc_jobs(gdata, threadResults)
+    for id, results in pairs(jobOutput) do
+        for i, metric in pairs(gdata["Metrics"]) do
+            local key = "J"..id.."_"..metric_name(metric["description"])
+            output[key] = results[metric["description"]]
+            jobKeys[key] = true
+        end
+    end
+    if dconfig["logPath"] ~= nil then
+        logfile(groupID, output)
+    end
+    if dconfig["endpoint"] ~= nil or dconfig["shmName"] ~= nil then
+        publish(groupID, exposition(gdata, threadOutput, aggregates, jobOutput, cpulist, cur_time), cur_time)
+    end
+    local metrics = sorted_metrics(output)
+    if dconfig["syslog"] then
+        logger(gdata, metrics)
+    end
+    if dconfig["gmetric"] then
+        gmetric(gdata, metrics, sendMeta)
+    end
+    if dconfig["tsPath"] ~= nil then
+        tsfile(gdata, metrics)
+    end
+    if dconfig["rrd"] then
+        rrd(gdata, output)
+    end
+    if dconfig["stdout"] then
+        for i,o in pairs(output) do
+            print(i,o)
+        end
+        print(likwid.hline)
+    end
+end
+
+-- Collect the counter values of all threads for the metric calculation.
+-- getter is likwid.getResult for a stopped group or likwid.getLastResult
+-- for the difference between the last two reads of a running group.
+local function collect_results(groupID, gdata, getter, time)
+    local threadResults = {}
+    local clock = likwid_getCpuClock();
+    for event=1, likwid.getNumberOfEvents(groupID) do
+        for thread=1, likwid.getNumberOfThreads() do
+            if threadResults[thread] == nil then
+                threadResults[thread] = {}
+            end
+            threadResults[thread]["time"] = time
+            threadResults[thread]["inverseClock"] = 1.0/clock;
+            local result = getter(groupID, event, thread)
+            if gdata["Events"][event]["Counter"]:match("PWR%d") then
+                dname = gdata["Events"][event]["Event"]:match("PWR_(%a+)_ENERGY")
+                if power["domains"][dname]["supportInfo"] then
+                    if result ~= 0 and result/time > power["domains"][dname]["maxPower"]*1E-6 then
+                        result = power["domains"][dname]["tdp"]*1E-6 * time
+                    end
                 end
-                print(likwid.hline)
             end
+            threadResults[thread][gdata["Events"][event]["Counter"]] = result
         end
     end
+    return threadResults
+end
+
+likwid.catchSignal()
+local interval = 0
+if dconfig["continuous"] then
+    -- Counters keep running, they are read at fixed ticks and evaluated
+    -- with the difference to the previous read. The counters are only
+    -- reprogrammed when the next group is activated.
+    local numGroups = #dconfig["groupData"]
+    local groupID = 1
+    local ticks = 0
+    local tick = 0
+    likwid.setupCounters(groupID)
+    likwid.startCounters()
+    local t0 = likwid.startClock()
+    while likwid.getSignalState() == 0 do
+        tick = tick + 1
+        local elapsed = likwid.getClock(t0, likwid.stopClock())
+        if elapsed > tick * dconfig["duration"] then
+            -- Skip ticks that were missed, e.g. due to slow output backends
+            tick = math.ceil(elapsed / dconfig["duration"])
+        end
+        local wait = tick * dconfig["duration"] - elapsed
+        if wait > 0 and likwid.sleep(wait * 1E6) > 0 then
+            break
+        end
+        local cur_time = os.time()
+        local sendMeta = (interval % dconfig["gangliaMetaInterval"] == 0)
+        interval = interval + 1
+        ticks = ticks + 1
+        local rotate = (numGroups > 1 and ticks >= dconfig["rotate"])
+        -- The final read of stopCounters covers the interval until the switch
+        if rotate then
+            likwid.stopCounters()
+        else
+            likwid.readCounters()
+        end
+        local measuredID = groupID
+        local gdata = dconfig["groupData"][measuredID]
+        local threadResults = collect_results(measuredID, gdata, likwid.getLastResult, likwid.getLastTimeOfGroup(measuredID))
+        if rotate then
+            groupID = (groupID % numGroups) + 1
+            likwid.setupCounters(groupID)
+            likwid.startCounters()
+            ticks = 0
+        end
+        evaluate_group(measuredID, gdata, threadResults, cur_time, sendMeta)
+    end
+    likwid.stopCounters()
+else
+    while likwid.getSignalState() == 0 do
+        local sendMeta = (interval % dconfig["gangliaMetaInterval"] == 0)
+        interval = interval + 1
+
+        for groupID,gdata in pairs(dconfig["groupData"]) do
+            local old_mtime = likwid_getRuntimeOfGroup(groupID)
+            local cur_time = os.time()
+            likwid.setupCounters(groupID)
+
+            -- Perform the measurement
+            likwid.startCounters()
+            likwid.sleep(dconfig["duration"] * 1E6)
+            likwid.stopCounters()
+
+            local mtime = likwid_getRuntimeOfGroup(groupID)
+            local threadResults = collect_results(groupID, gdata, likwid.getResult, mtime - old_mtime)
+            evaluate_group(groupID, gdata, threadResults, cur_time, sendMeta)
+        end
+    end
+end
+
+-- Close output backends
+if dconfig["syslog"] then
+    likwid.syslogClose()
+end
+if dconfig["gmetric"] then
+    likwid.gangliaClose()
+end
+for group, handle in pairs(tsconfig) do
+    likwid.tsClose(handle)
+end
+if rrdpipe ~= nil then
+    rrdpipe:close()
+end
+if dconfig["endpoint"] then
+    likwid.endpointClose()
+end
+if dconfig["shmName"] then
+    likwid.shmClose()
 end
 
 -- Finalize likwid perfctr
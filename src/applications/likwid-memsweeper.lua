@@ -43,6 +43,12 @@ local function examples()
     print("likwid-memsweeper -c 1-2")
     print("To clean specific domains:")
     print("likwid-memsweeper -c 0,1-2")
+    print("To drop the page cache and compact all domains:")
+    print("likwid-memsweeper -r")
+    print("To show the NUMA placement of the pages of process 1234:")
+    print("likwid-memsweeper -a 1234")
+    print("To move all pages of process 1234 to NUMA domain 1:")
+    print("likwid-memsweeper -a 1234 -m 1")
 
 end
 
@@ -53,6 +59,10 @@ local function usage()
     print("-h\t\t Help message")
     print("-v\t\t Version information")
     print("-c <list>\t Specify NUMA domain ID to clean up")
+    print("-r, --reclaim\t Drop page cache and compact memory instead of sweeping,")
+    print("\t\t falls back to sweeping if not permitted")
+    print("-a, --audit <pid>\t Print the NUMA placement of the pages of a process")
+    print("-m, --migrate <id>\t Migrate the pages of the audited process to a NUMA domain")
     print("")
     examples()
 end
@@ -65,7 +75,43 @@ for i,_ in pairs(numainfo["nodes"]) do
     end
 end
 
-for opt,arg in likwid.getopt(arg, {"c:", "h", "v", "help", "version"}) do
+local function formatSize(bytes)
+    if bytes >= 1024*1024*1024 then
+        return string.format("%.1f GB", bytes / (1024*1024*1024))
+    elseif bytes >= 1024*1024 then
+        return string.format("%.1f MB", bytes / (1024*1024))
+    end
+    return string.format("%.0f kB", bytes / 1024)
+end
+
+local function printAudit(audit)
+    local header = string.format("%-18s %-10s %-16s", "Address", "Size", "Policy")
+    for d=0,#numainfo["nodes"]-1 do
+        header = header .. string.format(" %10s", "Domain "..tostring(d))
+    end
+    print(header .. "  Mapping")
+    for _, m in pairs(audit["mappings"]) do
+        local total = 0
+        local line = string.format("0x%-16x %-10s %-16s", m["start"], formatSize(m["size"]), m["policy"])
+        for d=0,#numainfo["nodes"]-1 do
+            total = total + m["pages"][d]
+            line = line .. string.format(" %10s", formatSize(m["pages"][d] * m["pageSize"]))
+        end
+        if total > 0 then
+            print(line .. "  " .. m["name"])
+        end
+    end
+    local line = string.format("%-18s %-10s %-16s", "Total", "", "")
+    for d=0,#numainfo["nodes"]-1 do
+        line = line .. string.format(" %10s", formatSize(audit["memory"][d]))
+    end
+    print(line)
+end
+
+reclaim = false
+audit_pid = nil
+migrate_domain = nil
+for opt,arg in likwid.getopt(arg, {"a:", "c:", "h", "m:", "r", "v", "audit:", "help", "migrate:", "reclaim", "version"}) do
     if opt == "h" or opt == "help" then
         usage()
         os.exit(0)
@@ -74,6 +120,20 @@ for opt,arg in likwid.getopt(arg, {"c:", "h", "v", "help", "version"}) do
         os.exit(0)
     elseif (opt == "c") then
         num_nodes, nodes = likwid.nodestr_to_nodelist(arg)
+    elseif opt == "r" or opt == "reclaim" then
+        reclaim = true
+    elseif opt == "a" or opt == "audit" then
+        audit_pid = tonumber(arg)
+        if audit_pid == nil then
+            print("Process ID must be a number")
+            os.exit(1)
+        end
+    elseif opt == "m" or opt == "migrate" then
+        migrate_domain = tonumber(arg)
+        if migrate_domain == nil or migrate_domain < 0 or migrate_domain >= #numainfo["nodes"] then
+            print("Invalid NUMA domain "..arg)
+            os.exit(1)
+        end
     elseif opt == "?" then
         print("Invalid commandline option -"..arg)
         os.exit(1)
@@ -83,7 +143,31 @@ for opt,arg in likwid.getopt(arg, {"c:", "h", "v", "help", "version"}) do
     end
 end
 
-for i,socket in pairs(nodes) do
-    likwid.memSweepDomain(socket)
+if audit_pid then
+    local audit = likwid.auditNumaPages(audit_pid)
+    if audit == nil then
+        print("Cannot read NUMA placement of process "..tostring(audit_pid))
+        likwid.putNumaInfo()
+        os.exit(1)
+    end
+    printAudit(audit)
+    if migrate_domain then
+        local moved, err = likwid.migrateNumaPages(audit_pid, migrate_domain)
+        if moved == nil then
+            print("Cannot migrate pages: "..err)
+            likwid.putNumaInfo()
+            os.exit(1)
+        end
+        print(string.format("Moved %d pages to domain %d", moved, migrate_domain))
+        printAudit(likwid.auditNumaPages(audit_pid))
+    end
+elseif migrate_domain then
+    print("Option -m requires -a <pid>")
+    likwid.putNumaInfo()
+    os.exit(1)
+elseif reclaim then
+    likwid.memReclaimDomains(nodes)
+else
+    likwid.memSweepDomains(nodes)
 end
 likwid.putNumaInfo()
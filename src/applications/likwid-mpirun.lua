@@ -100,12 +100,17 @@ local debug = false
 local use_marker = false
 local use_csv = false
 local force = false
+local merge_prefix = nil
 if os.getenv("LIKWID_FORCE") ~= nil then
     force = true
 end
 
 local LIKWID_PIN="<INSTALLED_PREFIX>/bin/likwid-pin"
 local LIKWID_PERFCTR="<INSTALLED_PREFIX>/bin/likwid-perfctr"
+local LIKWID_MPIRUN="<INSTALLED_PREFIX>/bin/likwid-mpirun"
+-- Time in seconds the first rank of a node waits for the result records of
+-- the other local ranks before merging them
+local MERGE_TIMEOUT = 30
 
 local MPIROOT = os.getenv("MPIHOME")
 if MPIROOT == nil then
@@ -918,6 +923,14 @@ local function checkLikwid()
         end
         f:close()
     end
+    f = io.popen("which likwid-mpirun 2>/dev/null", "r")
+    if f ~= nil then
+        local s = f:read("*line")
+        if s ~= nil and s ~= LIKWID_MPIRUN then
+            LIKWID_MPIRUN = s
+        end
+        f:close()
+    end
 end
 
 local function writeWrapperScript(scriptname, execStr, hosts, outputname)
@@ -969,6 +982,7 @@ local function writeWrapperScript(scriptname, execStr, hosts, outputname)
     if outputname:sub(1,1) ~= "/" then
         outputname = os.getenv("PWD").."/"..outputname
     end
+    local mergeprefix = outputname:match("^(.*)_%%r_%%h%.lrec$")
 
     for i=1,#cpuexprs do
         local cmd = {}
@@ -1035,6 +1049,10 @@ local function writeWrapperScript(scriptname, execStr, hosts, outputname)
         print("NODE_EXEC: "..commands[1])
     end
     f:write("\t"..commands[1].."\n")
+    if #perf > 0 and mergeprefix then
+        -- The first local rank merges the result records of its node
+        f:write("\t"..LIKWID_MPIRUN.." -mergenode "..mergeprefix.." -np $LOCALSIZE\n")
+    end
 
     for i=2,#commands do
         f:write("elif [ \"$LOCALRANK\" -eq "..tostring(i-1).." ]; then\n")
@@ -1066,209 +1084,114 @@ local function listdir(dir, infilepart)
 end
 
 
-local function parseOutputFile(filename)
-    local rank = 0
-    local host = nil
-    local cpulist = {}
-    local eventlist = {}
-    local counterlist = {}
-    local idx = 1
-    local gidx = 0
-    local results = {}
-    local f = io.open(filename, "r")
-    if f == nil then
-        print("ERROR: Cannot open output file "..filename)
-        os.exit(1)
-    end
-    rank, host = filename:match("output_%d+_(%d+)_(%g+).csv")
+local function isRecord(filename)
+    return filename:match("%.lrec$") ~= nil
+end
 
-    local t = f:read("*all")
-    f:close()
-    if t:len() == 0 then
-        print("Error Output file "..filename.." is empty")
-        os.exit(1)
-    end
-    for i, line in pairs(likwid.stringsplit(t, "\n")) do
-        if (not line:match("^-")) and
-           (not line:match("^CPU type:")) and
-           (not line:match("^CPU name:")) and
-           (not line:match("^TABLE")) and
-           (not line:match("^STRUCT")) and
-           (not line:match("^%s*$")) and
-           (not line:match("STAT")) then
-            if line:match("^Event") and not line:match("Sum,Min,Max,Avg") then
-                linelist = likwid.stringsplit(line,",")
-                table.remove(linelist,1)
-                table.remove(linelist,1)
-                for _, cpustr in pairs(linelist) do
-                    local test = tonumber(cpustr:match("Core (%d+)"))
-                    if test ~= nil then
-                        for _cpu in pairs(cpulist) do
-                            if tonumber(cpu) == test then test = -1 end
-                        end
-                        if test >= 0 then
-                            table.insert(cpulist, test)
-                        end
-                    end
-                end
-                gidx = gidx + 1
-                idx = 1
-                if results[gidx] == nil then
-                    results[gidx] = {}
-                    eventlist[gidx] = {}
-                    counterlist[gidx] = {}
-                    results[gidx]["time"] = {}
-                end
-            elseif not line:match("^CPU clock:") and not line:match("Sum,Min,Max,Avg") then
-                linelist = likwid.stringsplit(line,",")
-                event = linelist[1]
-                counter = linelist[2]
-                table.remove(linelist,1)
-                table.remove(linelist,1)
-                for j=#linelist,1,-1 do
-                    if linelist[j] == "" then
-                        table.remove(linelist, j)
-                    end
-                end
-                if results[gidx][idx] == nil then
-                    results[gidx][idx] = {}
-                end
-                for j, value in pairs(linelist) do
-                    if event:match("[Rr]untime") then
-                        results[gidx]["time"][cpulist[j]] = tonumber(value)
-                    else
-                        results[gidx][idx][cpulist[j]] = tonumber(value)
-                    end
-                end
-                if not event:match("[Rr]untime") then
-                    table.insert(eventlist[gidx], idx, event)
-                    table.insert(counterlist[gidx], idx, counter)
-                    idx = idx + 1
-                end
-            elseif line:match("^CPU clock:") then
-                results["clock"] = line:match("^CPU clock:,([%d.]+)")
-                results["clock"] = tonumber(results["clock"])*1.E09
+-- Waits until count result records of the local host exist or MERGE_TIMEOUT
+-- is reached and merges them into one node record. Records that are not
+-- merged here are merged by the launching likwid-mpirun.
+local function mergeNodeRecords(prefix, count)
+    local dir, base = prefix:match("^(.*)/([^/]+)$")
+    if dir == nil then
+        dir = os.getenv("PWD")
+        base = prefix
+    end
+    local hostpart = "_"..likwid.gethostname()..".lrec"
+    local files = {}
+    local waited = 0
+    while true do
+        files = {}
+        for _, file in pairs(listdir(dir, base.."_")) do
+            if file:sub(-hostpart:len()) == hostpart and
+               not file:find(base.."_node_", 1, true) then
+                table.insert(files, file)
             end
         end
+        if #files >= count or waited >= MERGE_TIMEOUT * 1.E06 then
+            break
+        end
+        likwid.sleep(100000)
+        waited = waited + 100000
+    end
+    if #files == 0 then
+        return
+    end
+    local ret = likwid.mergeResultRecords(dir.."/"..base.."_node"..hostpart, files)
+    if ret < 0 then
+        print(string.format("ERROR: Cannot merge result records of host %s: error %d", likwid.gethostname(), ret))
+        return
+    end
+    for _, file in pairs(files) do
+        os.remove(file)
     end
-    return host, tonumber(rank), results, cpulist
 end
 
-local function parseMarkerOutputFile(filename)
-    local rank = 0
-    local host = nil
-    local cpulist = {}
-    local eventlist = {}
-    local counterlist = {}
-    local idx = 1
-    
-    local results = {}
-    local f = io.open(filename, "r")
-    if f == nil then
-        print("ERROR: Cannot open output file "..filename)
-        os.exit(1)
-    end
-    rank, host = filename:match("output_%d+_(%d+)_(%g+).csv")
-    local t = f:read("*all")
-    f:close()
-    local parse_reg_info = false
-    local parse_reg_output = false
-    local current_region = nil
-    local gidx = 0
-    local gname = ""
-    local clock = 0
-
-    for i, line in pairs(likwid.stringsplit(t, "\n")) do
-        if (not line:match("^-")) and
-           (not line:match("^CPU type:")) and
-           (not line:match("^CPU name:")) and
-           (not line:match("^TABLE")) and
-           (not line:match("STAT")) then
-
-            if line:match("^STRUCT,Info") and not parse_reg_info then
-                parse_reg_info = true
-            elseif line:match("^Event") and not line:match("Sum,Min,Max,Avg") then
-                parse_reg_info = false
-                parse_reg_output = true
-                idx = 1
-            elseif line:match("^Event") and line:match("Sum,Min,Max,Avg") then
-                parse_reg_output = false
-            elseif line:match("^CPU clock:,") then
-                clock = line:match("^CPU clock:,([%d.]+)")
-                clock = tonumber(clock)*1.E09
-            elseif parse_reg_info and line:match("^%d+,%g+") then
-                gidx, gname, current_region = line:match("^(%d+),(%g+),(%g+)")
-                gidx = tonumber(gidx)
-                if results[current_region] == nil then
-                    results[current_region] = {}
-                end
-                if results[current_region][gidx] == nil then
-                    results[current_region][gidx] = {}
-                    results[current_region][gidx]["name"] = gname
-                    results[current_region][gidx]["time"] = {}
-                    results[current_region][gidx]["calls"] = {}
-                end
-            elseif parse_reg_info and line:match("^Region Info") then
-                linelist = likwid.stringsplit(line,",")
-                table.remove(linelist,1)
-                for _, cpustr in pairs(linelist) do
-                    if cpustr:match("Core %d+") then
-                        local test = tonumber(cpustr:match("Core (%d+)"))
-                        if test ~= nil then
-                            for _,cpu in pairs(cpulist) do
-                                if test == cpu then test = -1 end
-                            end
-                            if test >= 0 then
-                                table.insert(cpulist, test)
-                            end
-                        end
-                    end
-                end
-            elseif parse_reg_info and line:match("^RDTSC") then
-                linelist = likwid.stringsplit(line,",")
-                table.remove(linelist,1)
-                for i, time in pairs(linelist) do
-                    if time ~= "" then
-                        results[current_region][gidx]["time"][cpulist[i]] = tonumber(time)
-                    end
-                end
-            elseif parse_reg_info and line:match("^call count") then
-                linelist = likwid.stringsplit(line,",")
-                table.remove(linelist,1)
-                for j, calls in pairs(linelist) do
-                    if calls:match("%d+") then
-                        if calls ~= "" then
-                            results[current_region][gidx]["calls"][cpulist[j]] = tonumber(calls)
-                        end
-                    end
-                end
-            elseif parse_reg_output then
-                linelist = likwid.stringsplit(line,",")
-                table.remove(linelist,1)
-                table.remove(linelist,1)
-                for j=#linelist,1,-1 do
-                    if linelist[j] == "" then
-                        table.remove(linelist, j)
-                    end
-                end
-                if results[current_region][gidx][idx] == nil then
-                    results[current_region][gidx][idx] = {}
-                end
-                for j, value in pairs(linelist) do
-                    results[current_region][gidx][idx][cpulist[j]] = tonumber(value)
-                end
-                idx = idx + 1
+local function scopeColumns(tab, label, section, nrEvents)
+    local columns = {{label.." Min"}, {label.." Max"}, {label.." Avg"}}
+    local fields = {"min", "max", "avg"}
+    local rows = {"time"}
+    if use_marker then
+        table.insert(rows, "calls")
+    end
+    for e=1,nrEvents do
+        table.insert(rows, e)
+    end
+    for i, field in pairs(fields) do
+        for _, row in pairs(rows) do
+            local value = 0
+            if section and section[row] then
+                value = section[row][field]
             end
+            table.insert(columns[i], value)
         end
+        table.insert(tab, columns[i])
     end
-    for region, data in pairs(results) do
-        results[region]["clock"] = clock
-    end
+end
 
-    return host, tonumber(rank), results, cpulist
+-- Builds the min/max/avg tables of the ranks, nodes and the whole run for
+-- one group out of the statistics of the merged result records
+local function scopeTables(gidx, gdata, records, region)
+    local desc = {"Event", "Runtime (RDTSC) [s]"}
+    local counters = {"Counter", "TSC"}
+    if use_marker then
+        table.insert(desc, "Region calls")
+        table.insert(counters, "CTR")
+    end
+    for i=1,#gdata["Events"] do
+        table.insert(desc, gdata["Events"][i]["Event"])
+        table.insert(counters, gdata["Events"][i]["Counter"])
+    end
+    local function section(scope)
+        if scope and scope["regions"][region] then
+            return scope["regions"][region][gidx]
+        end
+        return nil
+    end
+    local tables = {}
+    local multicpu = false
+    local ranktab = {desc, counters}
+    for _, rank in pairs(records["ranks"]) do
+        if #rank["cpus"] > 1 then
+            multicpu = true
+        end
+        scopeColumns(ranktab, rank["hostname"]..":"..tostring(rank["rank"]), section(rank["stats"]), #gdata["Events"])
+    end
+    if multicpu then
+        table.insert(tables, ranktab)
+    end
+    local nodetab = {desc, counters}
+    for _, node in pairs(records["nodes"]) do
+        scopeColumns(nodetab, node["hostname"], section(node), #gdata["Events"])
+    end
+    table.insert(tables, nodetab)
+    local globaltab = {desc, counters}
+    scopeColumns(globaltab, "Global", section(records["global"]), #gdata["Events"])
+    table.insert(tables, globaltab)
+    return tables
 end
 
-function printMpiOutput(group_list, all_results)
+function printMpiOutput(group_list, all_results, records, region)
 
     if #group_list == 0 or likwid.tablelength(all_results) == 0 then
         return
@@ -1352,7 +1275,7 @@ function printMpiOutput(group_list, all_results)
                     counterlist["time"] = all_results[rank]["results"][gidx]["time"][cpu]
                     counterlist["inverseClock"] = 1.0/all_results[rank]["results"]["clock"]
                     tmpList = {all_results[rank]["hostname"]..":"..tostring(rank)..":"..tostring(cpu)}
-                    for j=1,#groupdata["Metrics"] do
+                    for j=1,#gdata["Metrics"] do
                         local tmp = likwid.calculate_metric(gdata["Metrics"][j]["formula"], counterlist)
                         if tostring(tmp):len() > 12 then
                             tmp = string.format("%e",tmp)
@@ -1367,6 +1290,10 @@ function printMpiOutput(group_list, all_results)
                 secondtab_combined = likwid.tableToMinMaxAvgSum(secondtab, 1, 1)
             end
         end
+        local scopetabs = {}
+        if records then
+            scopetabs = scopeTables(gidx, gdata, records, region)
+        end
         if use_csv then
             local maxLineFields = #firsttab
             if #firsttab_combined > maxLineFields then maxLineFields = #firsttab_combined end
@@ -1374,6 +1301,9 @@ function printMpiOutput(group_list, all_results)
                 if #secondtab > maxLineFields then maxLineFields = #secondtab end
                 if #secondtab_combined > maxLineFields then maxLineFields = #secondtab_combined end
             end
+            for _, tab in pairs(scopetabs) do
+                if #tab > maxLineFields then maxLineFields = #tab end
+            end
             print("Group,"..tostring(gidx) .. string.rep(",", maxLineFields  - 2))
             likwid.printcsv(firsttab, maxLineFields)
             if total_threads > 1 then likwid.printcsv(firsttab_combined, maxLineFields) end
@@ -1381,6 +1311,9 @@ function printMpiOutput(group_list, all_results)
                 likwid.printcsv(secondtab, maxLineFields)
                 if total_threads > 1 then likwid.printcsv(secondtab_combined, maxLineFields) end
             end
+            for _, tab in pairs(scopetabs) do
+                likwid.printcsv(tab, maxLineFields)
+            end
         else
             print("Group: "..tostring(gidx))
             likwid.printtable(firsttab)
@@ -1389,6 +1322,9 @@ function printMpiOutput(group_list, all_results)
                 likwid.printtable(secondtab)
                 if total_threads > 1 then likwid.printtable(secondtab_combined) end
             end
+            for _, tab in pairs(scopetabs) do
+                likwid.printtable(tab)
+            end
         end
     end
 end
@@ -1398,7 +1334,7 @@ if #arg == 0 then
     os.exit(0)
 end
 
-for opt,arg in likwid.getopt(arg, {"n:","np:", "nperdomain:","pin:","hostfile:","h","help","v","g:","group:","mpi:","omp:","d","m","O","debug","marker","version","s:","skip:","f"}) do
+for opt,arg in likwid.getopt(arg, {"n:","np:", "nperdomain:","pin:","hostfile:","h","help","v","g:","group:","mpi:","omp:","d","m","O","debug","marker","version","s:","skip:","f","mergenode:"}) do
     if (type(arg) == "string") then
         local s,e = arg:find("-")
         if s == 1 then
@@ -1447,6 +1383,9 @@ for opt,arg in likwid.getopt(arg, {"n:","np:", "nperdomain:","pin:","hostfile:",
         omptype = arg
     elseif opt == "s" or opt == "skip" then
         skipStr = "-s "..arg
+    elseif opt == "mergenode" then
+        -- Internal option, called by the wrapper script on every node
+        merge_prefix = arg
     elseif opt == "?" then
         print("Invalid commandline option -"..arg)
         os.exit(1)
@@ -1456,6 +1395,10 @@ for opt,arg in likwid.getopt(arg, {"n:","np:", "nperdomain:","pin:","hostfile:",
     end
 end
 
+if merge_prefix then
+    mergeNodeRecords(merge_prefix, np)
+    os.exit(0)
+end
 
 if np == 0 and nperdomain == nil and #cpuexprs == 0 then
     print("ERROR: No option -n/-np, -nperdomain or -pin")
@@ -1714,7 +1657,7 @@ local nrNodes = getNumberOfNodes(newhosts)
 local pid = likwid.getpid()
 local hostfilename = string.format(".hostfile_%s.txt", pid)
 local scriptfilename = string.format(".likwidscript_%s.txt", pid)
-local outfilename = string.format(os.getenv("PWD").."/.output_%s_%%r_%%h.csv", pid)
+local outfilename = string.format(os.getenv("PWD").."/.output_%s_%%r_%%h.lrec", pid)
 
 checkLikwid()
 
@@ -1727,45 +1670,63 @@ os.remove(scriptfilename)
 os.remove(hostfilename)
 
 infilepart = ".output_"..pid
-filelist = listdir(os.getenv("PWD"), infilepart)
+filelist = {}
+for _, file in pairs(listdir(os.getenv("PWD"), infilepart)) do
+    if isRecord(file) then
+        table.insert(filelist, file)
+    end
+end
+if #filelist == 0 then
+    os.exit(0)
+end
+if debug then
+    print(string.format("DEBUG: Merging %d result records", #filelist))
+end
+local records = likwid.readResultRecords(filelist)
+for _, file in pairs(filelist) do
+    os.remove(file)
+end
+if records == nil then
+    print("ERROR: Cannot read result records")
+    os.exit(1)
+end
+
 all_results = {}
-if not use_marker then
-    for i, file in pairs(filelist) do
-        local host, rank, results, cpulist = parseOutputFile(file)
-        if host ~= nil and rank ~= nil then
-            if all_results[rank] == nil then
-                all_results[rank] = {}
+local regions = {}
+local regionResults = {}
+for i, rank in pairs(records["ranks"]) do
+    local r = rank["rank"]
+    if r < 0 then
+        r = i - 1
+    end
+    all_results[r] = {}
+    all_results[r]["hostname"] = rank["hostname"]
+    all_results[r]["cpus"] = rank["cpus"]
+    for region, results in pairs(rank["regions"]) do
+        results["clock"] = rank["clock"]
+        if not use_marker then
+            for _, gdata in pairs(results) do
+                if type(gdata) == "table" then
+                    gdata["calls"] = nil
+                end
             end
-            all_results[rank]["hostname"] = host
-            all_results[rank]["results"] = results
-            all_results[rank]["cpus"] = cpulist
-            os.remove(file)
         end
-    end
-    if likwid.tablelength(all_results) > 0 then
-        printMpiOutput(grouplist, all_results)
-    end
-else
-    local tmpList = {}
-    for i, file in pairs(filelist) do
-        host, rank, results, cpulist = parseMarkerOutputFile(file)
-        if host ~= nil and rank ~= nil then
-            if all_results[rank] == nil then
-                all_results[rank] = {}
-            end
-            all_results[rank]["hostname"] = host
-            all_results[rank]["cpus"] = cpulist
-            tmpList[rank] = results
-            os.remove(file)
+        if regionResults[region] == nil then
+            regionResults[region] = {}
+            table.insert(regions, region)
         end
+        regionResults[region][r] = results
     end
-    if likwid.tablelength(all_results) > 0 then
-        for reg, _ in pairs(tmpList[0]) do
-            print("Region: "..reg)
-            for rank,_ in pairs(all_results) do
-                all_results[rank]["results"] = tmpList[rank][reg]
-            end
-            printMpiOutput(grouplist, all_results)
+end
+table.sort(regions)
+if likwid.tablelength(all_results) > 0 then
+    for _, region in pairs(regions) do
+        if use_marker then
+            print("Region: "..region)
+        end
+        for rank,_ in pairs(all_results) do
+            all_results[rank]["results"] = regionResults[region][rank]
         end
+        printMpiOutput(grouplist, all_results, records, region)
     end
 end
@@ -64,10 +64,15 @@ local function usage()
     print("-i, --info\t\t Print CPU info")
     print("-T <time>\t\t Switch eventsets with given frequency")
     print("-f, --force\t\t Force overwrite of registers if they are in use")
+    print("--overflow <time>\t Poll counters for overflows with given frequency in s, ms or us or 'auto'")
     print("Modes:")
     print("-S <time>\t\t Stethoscope mode with duration in s, ms or us, e.g 20ms")
     print("-t <time>\t\t Timeline mode with frequency in s, ms or us, e.g. 300ms")
     print("-m, --marker\t\t Use Marker API inside code")
+    print("--stream <file>\t\t Marker API: Append region snapshots of likwid_markerFlush() to file")
+    print("--flush <time>\t\t Marker API: Snapshot the regions with given frequency and print them")
+    print("-P <period>\t\t Sampling mode, record the instruction pointer every <period> events")
+    print("\t\t\t of the first core counter event in the event set")
     print("Output options:")
     print("-o, --output <file>\t Store output to file. (Optional: Apply text filter according to filename suffix)")
     print("-O\t\t\t Output easily parseable CSV instead of fancy tables")
@@ -111,15 +116,21 @@ use_stethoscope = false
 use_timeline = false
 daemon_run = 0
 use_wrapper = false
+use_sampling = false
+sample_period = 0
 duration = 2.E06
 switch_interval = 5
 output = ""
 use_csv = false
 execString = nil
 outfile = nil
+use_record = false
 forceOverwrite = 0
 gotC = false
-markerFile = string.format("/tmp/likwid_%d.txt",likwid.getpid())
+markerFile = string.format("/tmp/likwid_%d.dat",likwid.getpid())
+streamFile = nil
+remove_stream = false
+flush_interval = nil
 print_stdout = print
 cpuClock = 1
 likwid.catchSignal()
@@ -129,7 +140,7 @@ if #arg == 0 then
     os.exit(0)
 end
 
-for opt,arg in likwid.getopt(arg, {"a", "c:", "C:", "e", "E:", "g:", "h", "H", "i", "m", "M:", "o:", "O", "P", "s:", "S:", "t:", "v", "V:", "T:", "f", "group:", "help", "info", "version", "verbose:", "output:", "skip:", "marker", "force"}) do
+for opt,arg in likwid.getopt(arg, {"a", "c:", "C:", "e", "E:", "g:", "h", "H", "i", "m", "M:", "o:", "O", "P:", "s:", "S:", "t:", "v", "V:", "T:", "f", "group:", "help", "info", "version", "verbose:", "output:", "skip:", "marker", "force", "overflow:", "stream:", "flush:"}) do
     if (type(arg) == "string") then
         local s,e = arg:find("-");
         if s == 1 then
@@ -208,17 +219,38 @@ for opt,arg in likwid.getopt(arg, {"a", "c:", "C:", "e", "E:", "g:", "h", "H", "
         if string.match(arg, "%.") then
             suffix = string.match(arg, ".-[^\\/]-%.?([^%.\\/]*)$")
         end
-        if suffix ~= "txt" then
+        if suffix ~= "txt" and suffix ~= "lrec" then
             use_csv = true
         end
         outfile = arg:gsub("%%h", likwid.gethostname())
         outfile = outfile:gsub("%%p", likwid.getpid())
         outfile = outfile:gsub("%%j", likwid.getjid())
         outfile = outfile:gsub("%%r", likwid.getMPIrank())
-        io.output(outfile..".tmp")
-        print = function(...) for k,v in pairs({...}) do io.write(v .. "\n") end end
+        if suffix == "lrec" then
+            use_record = true
+            print = function(...) end
+        else
+            io.output(outfile..".tmp")
+            print = function(...) for k,v in pairs({...}) do io.write(v .. "\n") end end
+        end
     elseif (opt == "O") then
         use_csv = true
+    elseif (opt == "P") then
+        use_sampling = true
+        sample_period = tonumber(arg)
+        if sample_period == nil or sample_period < 1 then
+            print("Sampling period must be a positive number")
+            os.exit(1)
+        end
+    elseif opt == "overflow" then
+        if arg ~= "auto" and arg ~= "off" then
+            arg = tostring(likwid.parse_time(arg)).."us"
+        end
+        likwid.setenv("LIKWID_OVERFLOW_POLL", arg)
+    elseif opt == "stream" then
+        streamFile = arg
+    elseif opt == "flush" then
+        flush_interval = likwid.parse_time(arg)
     elseif opt == "?" then
         print("Invalid commandline option -"..arg)
         os.exit(1)
@@ -444,6 +476,16 @@ if use_stethoscope == false and use_timeline == false and use_marker == false th
     use_wrapper = true
 end
 
+if use_sampling and (use_stethoscope or use_timeline or use_marker) then
+    print_stdout("Sampling mode cannot be combined with stethoscope, timeline or marker mode")
+    os.exit(1)
+end
+
+if use_record and (use_sampling or use_stethoscope or use_timeline) then
+    print_stdout("Result records (-o <file>.lrec) are only supported in wrapper and marker mode")
+    os.exit(1)
+end
+
 if use_wrapper and likwid.tablelength(arg)-2 == 0 and print_info == false then
     print_stdout("No Executable can be found on commandline")
     usage()
@@ -554,7 +596,9 @@ if #group_ids == 0 then
 end
 
 activeGroup = group_ids[1]
-likwid.setupCounters(activeGroup)
+if not use_sampling then
+    likwid.setupCounters(activeGroup)
+end
 if outfile == nil then
     print_stdout(likwid.hline)
 end
@@ -567,6 +611,17 @@ if use_marker == true then
     likwid.setenv("LIKWID_EVENTS", str)
     likwid.setenv("LIKWID_THREADS", table.concat(cpulist,","))
     likwid.setenv("LIKWID_FORCE", "-1")
+    if flush_interval ~= nil and streamFile == nil then
+        streamFile = string.format("/tmp/likwid_%d.stream",likwid.getpid())
+        remove_stream = true
+    end
+    if streamFile ~= nil then
+        os.remove(streamFile)
+        likwid.setenv("LIKWID_MARKER_STREAM", streamFile)
+    end
+    if flush_interval ~= nil then
+        likwid.setenv("LIKWID_MARKER_INTERVAL", tostring(flush_interval * 1.E-06))
+    end
 end
 
 execString = table.concat(arg," ",1, likwid.tablelength(arg)-2)
@@ -607,7 +662,42 @@ end
 
 io.stdout:flush()
 local int_results = {}
-if use_wrapper or use_timeline then
+if use_sampling then
+    local eventIdx = likwid.startSampling(activeGroup, sample_period)
+    if eventIdx < 0 then
+        print_stdout("Error starting sampling for group "..group_list[activeGroup]["GroupString"])
+        likwid.finalize()
+        likwid.putTopology()
+        likwid.putConfiguration()
+        os.exit(1)
+    end
+    local pid = nil
+    if pin_cpus then
+        pid = likwid.startProgram(execString, #cpulist, cpulist)
+    else
+        pid = likwid.startProgram(execString, 0, cpulist)
+    end
+    if not pid then
+        print_stdout("Failed to execute command: ".. execString)
+    end
+    while true do
+        if likwid.getSignalState() ~= 0 then
+            likwid.killProgram()
+            break
+        end
+        local remain = likwid.sleep(duration)
+        if remain > 0 or not likwid.checkProgram() then
+            io.stdout:flush()
+            break
+        end
+    end
+    likwid.stopSampling()
+    io.stdout:flush()
+    if outfile == nil then
+        print_stdout(likwid.hline)
+    end
+    likwid.printSamplingOutput(likwid.getSamplingResults(), group_list[activeGroup], eventIdx, sample_period)
+elseif use_wrapper or use_timeline then
     local start = likwid.startClock()
     local stop = 0
     local alltime = 0
@@ -618,6 +708,10 @@ if use_wrapper or use_timeline then
     if use_wrapper and #group_ids == 1 then
         duration = 30.E06
     end
+    if use_marker and flush_interval ~= nil then
+        duration = flush_interval
+    end
+    local last_record = 0
 
     local ret = likwid.startCounters()
     if ret < 0 then
@@ -711,6 +805,15 @@ if use_wrapper or use_timeline then
         else
             likwid.readCounters()
         end
+        if use_marker and flush_interval ~= nil then
+            local groups, results, record, nr_records, timestamp = likwid.getMarkerResults(streamFile, group_list, cpulist, -1)
+            if record ~= nil and record > last_record and #groups > 0 then
+                print_stdout(likwid.hline)
+                print_stdout(string.format("Marker API snapshot %d at %s", record, os.date("%c", math.floor(timestamp))))
+                likwid.print_markerOutput(groups, results, group_list, cpulist)
+                last_record = record
+            end
+        end
         if #group_ids > 1 then
             likwid.switchGroup(activeGroup + 1)
             activeGroup = likwid.getIdOfActiveGroup()
@@ -738,23 +841,38 @@ elseif use_marker then
     end
 end
 
-local ret = likwid.stopCounters()
-if ret < 0 then
-    print_stdout(string.format("Error stopping counters for thread %d.",ret * (-1)))
-    likwid.finalize()
-    likwid.putTopology()
-    likwid.putConfiguration()
-    os.exit(1)
-end
-io.stdout:flush()
-if outfile == nil then
-    print_stdout(likwid.hline)
+if not use_sampling then
+    local ret = likwid.stopCounters()
+    if ret < 0 then
+        print_stdout(string.format("Error stopping counters for thread %d.",ret * (-1)))
+        likwid.finalize()
+        likwid.putTopology()
+        likwid.putConfiguration()
+        os.exit(1)
+    end
+    io.stdout:flush()
+    if outfile == nil then
+        print_stdout(likwid.hline)
+    end
 end
 
 
-if use_marker == true then
+if use_record then
+    record = {rank = tonumber(likwid.getMPIrank()) or -1,
+              hostname = likwid.gethostname(),
+              clock = cpuClock,
+              cpus = cpulist,
+              sections = {}}
+end
+
+if use_sampling then
+    -- Output already printed after the sampling run
+elseif use_marker == true then
     groups, results = likwid.getMarkerResults(markerFile, group_list, cpulist)
     os.remove(markerFile)
+    if remove_stream then
+        os.remove(streamFile)
+    end
     if #groups == 0 and #results == 0 then
         likwid.finalize()
         likwid.putTopology()
@@ -762,15 +880,48 @@ if use_marker == true then
         os.exit(1)
     end
     likwid.print_markerOutput(groups, results, group_list, cpulist)
+    if use_record then
+        for g, gdata in pairs(groups) do
+            for r, rdata in pairs(gdata) do
+                local events = {}
+                for e=1, #group_list[g]["Events"] do
+                    events[e] = {}
+                    for t=1, #cpulist do
+                        if results[g][r][e] and results[g][r][e][t] then
+                            events[e][t] = results[g][r][e][t]["Value"]
+                        end
+                    end
+                end
+                table.insert(record["sections"], {region = rdata["Name"], group = g,
+                                                  time = rdata["Time"], calls = rdata["Count"],
+                                                  events = events})
+            end
+        end
+    end
 elseif use_timeline == false then
     results = likwid.getResults()
     for g,gr in pairs(group_list) do
         gr["runtime"] = likwid.getRuntimeOfGroup(g)
     end
     likwid.printOutput(results, group_list, cpulist)
+    if use_record then
+        for g, gr in pairs(group_list) do
+            local time = {}
+            for t=1, #cpulist do
+                time[t] = gr["runtime"]
+            end
+            table.insert(record["sections"], {region = "", group = g, time = time,
+                                              calls = {}, events = results[g]})
+        end
+    end
 end
 
-if outfile then
+if use_record then
+    local ret = likwid.writeResultRecord(outfile, record)
+    if ret < 0 then
+        print_stdout(string.format("Failed to write result record %s: error %d", outfile, ret))
+    end
+elseif outfile then
     local suffix = ""
     if string.match(outfile,"%.") then
         suffix = string.match(outfile, ".-[^\\/]-%.?([^%.\\/]*)$")
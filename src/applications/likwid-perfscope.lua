@@ -4,8 +4,8 @@
  *
  *      Filename:  likwid-perfscope.lua
  *
- *      Description:  An application to use the timeline mode of likwid-perfctr to generate
- *                    realtime plots using feedGnuplot
+ *      Description:  An application to generate realtime plots of hardware performance
+ *                    counter measurements using gnuplot
  *
  *      Version:   <VERSION>
  *      Released:  <DATE>
@@ -34,8 +34,8 @@ package.path = '<INSTALLED_PREFIX>/share/lua/?.lua;' .. package.path
 
 local likwid = require("likwid")
 
-PERFCTR="<INSTALLED_BINPREFIX>/likwid-perfctr"
-FEEDGNUPLOT="<INSTALLED_BINPREFIX>/feedGnuplot"
+PERFSCOPE="<INSTALLED_BINPREFIX>/likwid-perfscope"
+GNUPLOT="gnuplot"
 
 local predefined_plots = {
     FLOPS_DP = {
@@ -122,12 +122,12 @@ end
 local function examples()
     print("Examples:")
     print("Run command on CPU 2 and measure performance group TEST:")
-    print("likwid-perfscope -C 2 -g TEST -f 1s ./a.out")
+    print("likwid-perfscope -C 2 -g TEST -t 1s ./a.out")
 end
 
 local function usage()
     version()
-    print("A tool to generate pictures on-the-fly from likwid-perfctr measurements\n")
+    print("A tool to generate pictures on-the-fly from hardware performance counter measurements\n")
     print("Options:")
     print("-h, --help\t\t Help message")
     print("-v, --version\t\t Version information")
@@ -136,25 +136,36 @@ local function usage()
     print("-c <list>\t\t Processor ids to measure, e.g. 1,2-4,8")
     print("-C <list>\t\t Processor ids to pin threads and measure, e.g. 1,2-4,8")
     print("-g, --group <string>\t Preconfigured plot group or custom event set string with plot config. See man page for information.")
-    print("-t, --time <time>\t Frequency in s, ms or us, e.g. 300ms, for the timeline mode of likwid-perfctr")
-    print("-d, --dump\t\t Print output as it is send to feedGnuplot.")
-    print("-p, --plotdump\t\t Use dump functionality of feedGnuplot. Plots out plot configurations plus data to directly submit to gnuplot")
-    print("--host <host>\t\t Run likwid-perfctr on the selected host using SSH. Evaluation and plotting is done locally.")
+    print("-t, --time <time>\t Frequency in s, ms or us, e.g. 300ms, for reading the counters")
+    print("-r, --range <seconds>\t Plot only the last <seconds> of the measurement")
+    print("-F, --fps <fps>\t\t Maximal number of plot updates per second (default: 5)")
+    print("-d, --dump\t\t Print the plotted values to stdout.")
+    print("-p, --plotdump\t\t Write plot configurations plus data to stdout to directly submit to gnuplot")
+    print("-o, --output <file>\t Write all samples as binary records to <file>")
+    print("--host <host>\t\t Run the measurement on the selected host using SSH. Plotting is done locally.")
     print("\t\t\t This can be used for machines that have no gnuplot installed. All paths must be similar to the local machine.")
     print("\n")
     examples()
 end
 
 local function test_gnuplot()
-    cmd = "which gnuplot"
-    f = io.popen(cmd)
+    local f = io.popen("which "..GNUPLOT.." 2>/dev/null")
     if f ~= nil then
+        local path = f:read("*line")
         io.close(f)
-        return true
+        return path ~= nil
     end
     return false
 end
 
+local function quote(str)
+    return "'"..tostring(str):gsub("'", "'\\''").."'"
+end
+
+local function gnuplot_string(str)
+    return "\""..tostring(str):gsub("\\", "\\\\"):gsub("\"", "\\\"").."\""
+end
+
 local eventStrings = {}
 local terminal = "x11"
 local num_cpus = 0
@@ -169,6 +180,9 @@ local plotdump = false
 local nrgroups, allgroups = likwid.get_groups()
 local mfreq = 1.0
 local plotrange = 0
+local fps = 5
+local outfile = nil
+local cpustr = nil
 local host = nil
 
 if #arg == 0 then
@@ -176,7 +190,7 @@ if #arg == 0 then
     os.exit(0)
 end
 
-for opt,arg in likwid.getopt(arg, {"h","v","g:","C:","c:","t:","r:","a","d","p","help", "version","group:","time:","dump","range:","plotdump","all", "host:"}) do
+for opt,arg in likwid.getopt(arg, {"h","v","g:","C:","c:","t:","r:","F:","o:","a","d","p","help", "version","group:","time:","dump","range:","fps:","output:","plotdump","all", "host:"}) do
     if opt == "h" or opt == "help" then
         usage()
         os.exit(0)
@@ -187,8 +201,10 @@ for opt,arg in likwid.getopt(arg, {"h","v","g:","C:","c:","t:","r:","a","d","p",
         table.insert(eventStrings, arg)
     elseif (opt == "c") then
         num_cpus, cpulist = likwid.cpustr_to_cpulist(arg)
+        cpustr = arg
     elseif (opt == "C") then
         num_cpus, cpulist = likwid.cpustr_to_cpulist(arg)
+        cpustr = arg
         pinning = true
     elseif opt == "t" or opt == "time" then
         timeline = arg
@@ -199,6 +215,14 @@ for opt,arg in likwid.getopt(arg, {"h","v","g:","C:","c:","t:","r:","a","d","p",
         plotdump = true
     elseif opt == "r" or opt == "range" then
         plotrange = tonumber(arg)
+    elseif opt == "F" or opt == "fps" then
+        fps = tonumber(arg)
+        if fps == nil or fps <= 0 then
+            print("ERROR: Frame rate must be a positive number")
+            os.exit(1)
+        end
+    elseif opt == "o" or opt == "output" then
+        outfile = arg
     elseif opt == "a" or opt == "all" then
         print_configs = true
     elseif opt == "host" then
@@ -236,7 +260,7 @@ if print_configs then
     os.exit(0)
 end
 
-if not test_gnuplot() then
+if not plotdump and not test_gnuplot() then
     print("GnuPlot not available")
     os.exit(1)
 end
@@ -251,8 +275,44 @@ if #arg == 0 then
     os.exit(1)
 end
 
+if host ~= nil then
+    -- The remote side measures and writes the gnuplot stream, the local
+    -- gnuplot only draws it.
+    local remote = {PERFSCOPE, "-p", "-t", timeline, "-F", fps}
+    if pinning then
+        table.insert(remote, "-C")
+    else
+        table.insert(remote, "-c")
+    end
+    table.insert(remote, cpustr)
+    if plotrange > 0 then
+        table.insert(remote, "-r")
+        table.insert(remote, plotrange)
+    end
+    if outfile then
+        table.insert(remote, "-o")
+        table.insert(remote, outfile)
+    end
+    for i, event_def in pairs(eventStrings) do
+        table.insert(remote, "-g")
+        table.insert(remote, event_def)
+    end
+    for i=1,#arg do
+        table.insert(remote, arg[i])
+    end
+    for i=1,#remote do
+        remote[i] = quote(remote[i])
+    end
+    local ret = os.execute(string.format("ssh %s %s | %s -persist", quote(host), quote(table.concat(remote, " ")), GNUPLOT))
+    if ret then
+        os.exit(0)
+    end
+    os.exit(1)
+end
+
 for i, event_def in pairs(eventStrings) do
     local eventlist = likwid.stringsplit(event_def,",")
+    local outopts = ""
     event_string = nil
     plotgroup = nil
     plotgroupconfig = nil
@@ -391,171 +451,275 @@ for i, event_def in pairs(eventStrings) do
     end
 end
 
-cmd = ""
-if host ~= nil then
-    cmd = cmd .. "ssh "..host.. " \"/bin/bash -c \\\" "
+
+local config = likwid.getConfiguration()
+local access_flags = "e"
+if config["daemonMode"] == 0 then
+    access_flags = "rw"
 end
-cmd = cmd .. " " ..PERFCTR
-if pinning then
-    cmd = cmd .. string.format(" -C %s",table.concat(cpulist,","))
-else
-    cmd = cmd .. string.format(" -c %s",table.concat(cpulist,","))
+cpuinfo = likwid.getCpuInfo()
+cputopo = likwid.getCpuTopology()
+if not likwid.msr_available(access_flags) then
+    print("MSR device files not available or not accessible")
+    os.exit(1)
 end
-cmd = cmd .. string.format(" -t %s", timeline)
 
-for i, group in pairs(group_list) do
-    cmd = cmd .. " -g "..group["eventstring"]
+local function cleanup()
+    likwid.finalize()
+    likwid.putTopology()
+    likwid.putConfiguration()
 end
-cmd = cmd .. " ".. table.concat(arg, " ")
--- since io.popen can only read stdout we swap stdout and stderr
--- application output is written to stderr, we catch stdout
-cmd = cmd .. " 3>&1 1>&2 2>&3 3>&-"
-if host ~= nil then
-    cmd = cmd .. " \\\" \" "
+
+if likwid.init(num_cpus, cpulist) < 0 then
+    likwid.putTopology()
+    likwid.putConfiguration()
+    os.exit(1)
 end
-perfctr = assert (io.popen (cmd))
 
+-- Register the event sets and compile all plotted formulas once. The
+-- formulas get the event counts as v[1..n], the measurement time as v[n+1]
+-- and the inverse clock as v[n+2].
+local clock = likwid.getCpuClock()
+for i, group in pairs(group_list) do
+    local gid = likwid.addEventSet(group["eventstring"])
+    if gid < 0 then
+        cleanup()
+        os.exit(1)
+    end
+    group["id"] = gid
+    local names = {}
+    for k, counter in pairs(group["counterlist"]) do
+        names[k] = counter
+    end
+    table.insert(names, "time")
+    table.insert(names, "inverseClock")
+    group["series"] = {}
+    group["values"] = {}
+    for f, fdesc in pairs(group["formulas"]) do
+        local formula = fdesc["formula"]
+        if fdesc["index"] ~= nil then
+            formula = group["gdata"]["Metrics"][fdesc["index"]]["formula"]
+        end
+        fdesc["func"] = likwid.compile_metric(formula, names)
+        if fdesc["func"] == nil then
+            cleanup()
+            os.exit(1)
+        end
+        for c, cpu in pairs(cpulist) do
+            local title = fdesc["name"]
+            if #cpulist > 1 then
+                title = "C"..cpu..": "..title
+            end
+            table.insert(group["series"], {title=title,
+                y2=(group["y2title"] ~= nil and f-1 == tonumber(group["y2funcindex"]))})
+        end
+    end
+    if #group["series"] == 0 then
+        print(string.format("ERROR: No metric to plot for group %d", i))
+        cleanup()
+        os.exit(1)
+    end
+end
 
+-- Open one plot per group. When writing to stdout, all groups share one
+-- stream and are drawn as multiplot in each frame.
+local capacity = 0
+if plotrange > 0 then
+    capacity = math.ceil(plotrange / mfreq) + 2
+end
+local shared = plotdump
 for i, group in pairs(group_list) do
-    gnucmd = string.format("%s --stream %f --with linespoints --domain --nodataid", FEEDGNUPLOT, mfreq/#group_list)
-    if plotrange > 0 then
-        gnucmd = gnucmd .. string.format(" --xlen %d", plotrange)
-    else
-        gnucmd = gnucmd .. " --xmin 0"
+    local cmd = "-"
+    if not shared then
+        cmd = GNUPLOT.." 1>/dev/null 2>&1"
+    end
+    group["plot"] = likwid.plotOpen(cmd, group["series"], capacity)
+    if group["plot"] < 0 then
+        print("ERROR: Cannot open plot for group "..tostring(i))
+        cleanup()
+        os.exit(1)
     end
-    if group["title"] ~= nil then
+    if outfile ~= nil then
+        local fname = outfile
         if #group_list > 1 then
-            gnucmd = gnucmd .. string.format(" --title %q", "Group "..i..": "..group["title"])
-        else
-            gnucmd = gnucmd .. string.format(" --title %q", group["title"])
+            fname = string.format("%s.%d", outfile, i)
+        end
+        if likwid.plotRecord(group["plot"], fname) < 0 then
+            print("ERROR: Cannot open output file "..fname)
+            cleanup()
+            os.exit(1)
         end
     end
-    if group["xtitle"] ~= nil then
-        gnucmd = gnucmd .. string.format(" --xlabel %q", group["xtitle"])
-    else
-        gnucmd = gnucmd .. string.format(" --xlabel %q", "Time")
+    local setup = {}
+    local title = group["title"]
+    if title ~= nil and #group_list > 1 then
+        title = "Group "..i..": "..title
     end
+    if title ~= nil then
+        table.insert(setup, "set title "..gnuplot_string(title))
+    end
+    table.insert(setup, "set xlabel "..gnuplot_string(group["xtitle"] or "Time"))
     if group["ytitle"] ~= nil then
-        gnucmd = gnucmd .. string.format(" --ylabel %q", group["ytitle"])
+        table.insert(setup, "set ylabel "..gnuplot_string(group["ytitle"]))
     end
     if group["y2title"] ~= nil then
-        gnucmd = gnucmd .. string.format(" --y2 %d --y2label %q", group["y2funcindex"], group["y2title"])
+        table.insert(setup, "set y2label "..gnuplot_string(group["y2title"]))
+        table.insert(setup, "set ytics nomirror")
+        table.insert(setup, "set y2tics")
+    else
+        table.insert(setup, "unset y2label")
+        table.insert(setup, "unset y2tics")
+        table.insert(setup, "set ytics mirror")
     end
-    if group["formulas"] then
-        if #cpulist == 1 then
-            for f, fdesc in pairs(group["formulas"]) do
-                gnucmd = gnucmd .. string.format(" --legend %d %q", f-1, fdesc["name"])
-            end
-        else
-            local curveID = 0
-            for c,cpu in pairs(cpulist) do
-                for f, fdesc in pairs(group["formulas"]) do
-                    gnucmd = gnucmd .. string.format(" --legend %d %q", curveID, "C"..cpu..": "..fdesc["name"])
-                    curveID = curveID + 1
-                end
-            end
+    table.insert(setup, "set key outside bmargin bottom")
+    table.insert(setup, "set grid")
+    group["setup"] = table.concat(setup, "\n").."\n"
+    if not shared then
+        likwid.plotCommand(group["plot"], group["setup"])
+    end
+end
+
+local function draw(alltime)
+    local xmin = 0
+    local xrange = "set xrange [0:*]\n"
+    if plotrange > 0 and alltime > plotrange then
+        xmin = alltime - plotrange
+        xrange = string.format("set xrange [%f:%f]\n", xmin, alltime)
+    end
+    if shared and #group_list > 1 then
+        likwid.plotCommand(group_list[1]["plot"], string.format("set multiplot layout %d,1\n", #group_list))
+    end
+    for i, group in pairs(group_list) do
+        if shared then
+            likwid.plotCommand(group["plot"], group["setup"])
         end
+        likwid.plotCommand(group["plot"], xrange)
+        likwid.plotFrame(group["plot"], xmin)
     end
-    gnucmd = gnucmd .. " --set 'key outside bmargin bottom'"
-    if plotdump then
-        gnucmd = gnucmd .. " --dump"
-    else
-        gnucmd = gnucmd .. " 1>/dev/null 2>&1"
+    if shared and #group_list > 1 then
+        likwid.plotCommand(group_list[1]["plot"], "unset multiplot\n")
     end
-    group_list[i]["output"] = assert(io.popen(gnucmd,"w"))
 end
 
-
-likwid.catchSignal()
-local mtime = {}
-for i,g in pairs(group_list) do
-    local str = "0 "
-    for k,t in pairs(cpulist) do
-        for j,c in pairs(g["formulas"]) do
-            str = str .."0 "
-        end
+if pinning then
+    local omp_threads = os.getenv("OMP_NUM_THREADS")
+    if omp_threads == nil then
+        likwid.setenv("OMP_NUM_THREADS",tostring(num_cpus))
     end
-    mtime[i] = nil
-    g["output"]:write(str.."\n")
-    g["output"]:flush()
-    if dump then
-        print(tostring(i).." ".. str)
+    if num_cpus > 1 then
+        local preload = os.getenv("LD_PRELOAD")
+        local pinString = tostring(cpulist[2])
+        for i=3,#cpulist do
+            pinString = pinString .. "," .. cpulist[i]
+        end
+        pinString = pinString .. "," .. cpulist[1]
+        likwid.setenv("KMP_AFFINITY","disabled")
+        likwid.setenv("LIKWID_PIN", pinString)
+        likwid.setenv("LIKWID_SILENT","true")
+        if os.getenv("CILK_NWORKERS") == nil then
+            likwid.setenv("CILK_NWORKERS", tostring(num_cpus))
+        end
+        if preload == nil then
+            likwid.setenv("LD_PRELOAD",likwid.pinlibpath)
+        else
+            likwid.setenv("LD_PRELOAD",likwid.pinlibpath .. ":" .. preload)
+        end
     end
 end
+local ldpath = os.getenv("LD_LIBRARY_PATH")
+local libpath = likwid.pinlibpath:match("([/%g]+)/%g+.so")
+if ldpath == nil then
+    likwid.setenv("LD_LIBRARY_PATH", libpath)
+elseif not ldpath:match(libpath) then
+    likwid.setenv("LD_LIBRARY_PATH", libpath..":"..ldpath)
+end
 
+likwid.catchSignal()
+local activeGroup = group_list[1]["id"]
+likwid.setupCounters(activeGroup)
+if likwid.startCounters() < 0 then
+    print("ERROR: Cannot start counters")
+    cleanup()
+    os.exit(1)
+end
+local execString = table.concat(arg, " ")
+local pid = nil
+if pinning then
+    pid = likwid.startProgram(execString, #cpulist, cpulist)
+else
+    pid = likwid.startProgram(execString, 0, cpulist)
+end
+if not pid then
+    print("Failed to execute command: ".. execString)
+    likwid.stopCounters()
+    cleanup()
+    os.exit(1)
+end
 
-olddata = {}
-oldmetric = {}
-local perfctr_exited = false
-local oldtime = 0
-local clock = likwid.getCpuClock()
+local duration = likwid.parse_time(timeline)
+local frametime = 1.0 / fps
+local alltime = 0
+local lastframe = 0
+local values = {}
+local nr_threads = #cpulist
 while true do
-    local l = perfctr:read("*line")
-    if l == nil or l:match("^%s*$") then
+    if likwid.getSignalState() ~= 0 then
+        likwid.killProgram()
         break
-    elseif l:match("^ERROR") then
-        perfctr_exited = true
+    end
+    local remain = likwid.sleep(duration)
+    if remain > 0 or not likwid.checkProgram() then
         break
     end
-    if l:match("^%d+,%d+,%d+,[%d.]+,%d+") then
-        local data = {}
-        local diff = {}
-        linelist = likwid.stringsplit(l, ",")
-        group = tonumber(linelist[1])
-        nr_events = tonumber(linelist[2])
-        nr_threads = tonumber(linelist[3])
-        time = tonumber(linelist[4])
-        table.remove(linelist, 1)
-        table.remove(linelist, 1)
-        table.remove(linelist, 1)
-        table.remove(linelist, 1)
-
-        for i=1,nr_events do
-            if data[i] == nil then data[i] = {} end
-            for j=1,nr_threads do
-                data[i][j] = tonumber(linelist[1])
-                table.remove(linelist, 1)
-            end
+    likwid.readCounters()
+    local group = nil
+    for i, g in pairs(group_list) do
+        if g["id"] == activeGroup then
+            group = g
+            break
         end
-
-        str = tostring(time)
-        for f, flist in pairs(group_list[group]["formulas"]) do
-            if flist["index"] ~= nil then
-                for i=1,nr_threads do
-                    str = str .." ".. data[flist["index"]][i]
-                end
-            else
-                counterlist = {}
-                counterlist["time"] = mfreq
-                counterlist["inverseClock"] = 1.0/clock
-                for i=1,nr_threads do
-                    for e=1, nr_events do
-                        counterlist[group_list[group]["counterlist"][e]] = data[e][i]
-                    end
-                    str = str .." ".. tostring(likwid.calculate_metric(flist["formula"], counterlist))
-                end
+    end
+    local nr_events = #group["counterlist"]
+    local time = likwid.getLastTimeOfGroup(activeGroup)
+    alltime = alltime + time
+    local idx = 1
+    for f, fdesc in pairs(group["formulas"]) do
+        for t=1,nr_threads do
+            for e=1,nr_events do
+                values[e] = likwid.getLastResult(activeGroup, e, t)
             end
+            values[nr_events+1] = time
+            values[nr_events+2] = 1.0/clock
+            group["values"][idx] = fdesc["func"](values)
+            idx = idx + 1
         end
-        
-        group_list[group]["output"]:write(str.."\n")
-        group_list[group]["output"]:flush()
-        if dump then
-            print(tostring(group).." ".. str)
-        end
-        oldtime = time
+    end
+    likwid.plotAdd(group["plot"], alltime, group["values"])
+    if dump then
+        print(tostring(group["id"]).." "..tostring(alltime).." "..table.concat(group["values"], " "))
+    end
+    if alltime - lastframe >= frametime then
+        draw(alltime)
+        lastframe = alltime
+    end
+    if #group_list > 1 then
+        likwid.switchGroup(activeGroup + 1)
+        activeGroup = likwid.getIdOfActiveGroup()
     end
 end
+likwid.stopCounters()
+draw(alltime)
 
-if perfctr_exited == false then
+if not shared then
     while likwid.getSignalState() == 0 do
         likwid.sleep(1E6)
     end
+    for i, group in pairs(group_list) do
+        likwid.plotCommand(group["plot"], "exit\n")
+    end
 end
 for i, group in pairs(group_list) do
-    group["output"]:write("exit\n")
-    io.close(group["output"])
+    likwid.plotClose(group["plot"])
 end
-io.close(perfctr)
-
-
-
+cleanup()
+os.exit(0)
@@ -49,6 +49,8 @@ local function examples()
     print("\t3. Logical numbering inside socket.\n\t   e.g. -c S0:0-1 for the first 2 physical cores of the socket")
     print("\t4. Logical numbering inside last level cache group.\n\t   e.g. -c C0:0-3  for the first 4 physical cores in the first LLC")
     print("\t5. Logical numbering inside NUMA domain.\n\t   e.g. -c M0:0-3 for the first 4 physical cores in the first NUMA domain")
+    print("\t6. Logical numbering inside L2 cache tile.\n\t   e.g. -c T0:0-1 for the first 2 physical cores sharing the first L2 cache")
+    print("\t7. Logical numbering inside physical core.\n\t   e.g. -c P0:0-1 for the first 2 SMT threads of the first core")
     print("\tYou can also mix domains separated by  @,\n\te.g. -c S0:0-3@S1:0-3 for the 4 first physical cores on both sockets.")
     print("3. Expressions based thread list generation with compact processor numbering.")
     print("Example usage expression: likwid-pin.lua -c E:N:8 ./myApp")
@@ -58,11 +60,18 @@ local function examples()
     print("\t1. -c E:<thread domain>:<number of threads>")
     print("\t2. -c E:<thread domain>:<number of threads>:<chunk size>:<stride>")
     print("\tFor two SMT threads per core on a SMT 4 machine use e.g. -c E:N:122:2:4")
+    print("\t3. -c E:<thread domain>:<number of threads>:<chunk size>:<stride>:<SMT threads>")
+    print("\tFor one thread per physical core in the fourth L2 tile use e.g. -c E:T3:4:1:1:0")
     print("4. Scatter policy among thread domain type.")
     print("Example usage scatter: likwid-pin.lua -c M:scatter ./myApp")
     print("This will generate a thread to processor mapping scattered among all memory domains")
     print("with physical cores first.")
     print("")
+    print("5. Dynamic placement policies for applications that create and destroy threads at runtime.")
+    print("Example usage policy: likwid-pin.lua -c N:0-7 --policy compact ./myApp")
+    print("Each new thread is placed on the least-loaded CPU of the list and the CPU is freed")
+    print("again when the thread exits.")
+    print("")
     print("likwid-pin sets OMP_NUM_THREADS with as many threads as specified")
     print("in your pin expression if OMP_NUM_THREADS is not present in your environment.")
 end
@@ -75,9 +84,16 @@ local function usage()
     print("-v, --version\t\t Version information")
     print("-V, --verbose <level>\t Verbose output, 0 (only errors), 1 (info), 2 (details), 3 (developer)")
     print("-i\t\t\t Set numa interleave policy with all involved numa nodes")
+    print("-I, --interleave <list>\t Interleave memory over the given NUMA domains, e.g. 0:3,1:1")
+    print("\t\t\t Optional weights after the colon, large allocations are spread")
+    print("\t\t\t in 2 MB chunks according to the weights when the first thread starts")
     print("-S, --sweep\t\t Sweep memory and LLC of involved NUMA nodes")
     print("-c <list>\t\t Comma separated processor IDs or expression")
     print("-s, --skip <hex>\t Bitmask with threads to skip")
+    print("--policy <name>\t\t Thread placement policy, default is static (round-robin over the list)")
+    print("\t\t\t balance: least-loaded CPU in the NUMA domain of the creating thread")
+    print("\t\t\t compact: least-loaded CPU, filling cores and caches one after another")
+    print("\t\t\t spread: least-loaded CPU, spreading across sockets, then cores")
     print("-p\t\t\t Print available domains with mapping on physical IDs")
     print("\t\t\t If used together with -p option outputs a physical processor IDs.")
     print("-d <string>\t\t Delimiter used for using -p to output physical processor list, default is comma.")
@@ -86,15 +102,98 @@ local function usage()
     examples()
 end
 
+-- Orders the CPU list for the dynamic placement policies and returns the
+-- NUMA domain of every CPU. compact keeps CPUs sharing the last level cache
+-- and the cores (L2) together, spread alternates between the sockets and
+-- takes the physical cores before their SMT threads.
+local function placement_order(cpus, policy)
+    local hwthreads = {}
+    local llc = {}
+    local numa = {}
+    local order = {}
+    local domains = {}
+    for _, hwt in pairs(cputopo["threadPool"]) do
+        hwthreads[hwt["apicId"]] = hwt
+    end
+    for _, domain in pairs(affinity["domains"]) do
+        local typ, idx = domain["tag"]:match("^([CM])(%d+)$")
+        for _, cpu in pairs(domain["processorList"]) do
+            if typ == "C" then
+                llc[cpu] = tonumber(idx)
+            elseif typ == "M" then
+                numa[cpu] = tonumber(idx)
+            end
+        end
+    end
+    local function key(cpu)
+        local hwt = hwthreads[cpu]
+        return {hwt["packageId"], llc[cpu] or 0, hwt["coreId"], hwt["threadId"], cpu}
+    end
+    local function less(a, b)
+        local ka, kb = key(a), key(b)
+        for i=1,#ka do
+            if ka[i] ~= kb[i] then
+                return ka[i] < kb[i]
+            end
+        end
+        return false
+    end
+    for i, cpu in pairs(cpus) do
+        order[i] = cpu
+    end
+    if policy == "compact" then
+        table.sort(order, less)
+    elseif policy == "spread" then
+        local sockets = {}
+        local socketIds = {}
+        for _, cpu in pairs(order) do
+            local pkg = hwthreads[cpu]["packageId"]
+            if sockets[pkg] == nil then
+                sockets[pkg] = {}
+                table.insert(socketIds, pkg)
+            end
+            table.insert(sockets[pkg], cpu)
+        end
+        table.sort(socketIds)
+        for _, pkg in pairs(socketIds) do
+            table.sort(sockets[pkg], function(a, b)
+                local ta, tb = hwthreads[a]["threadId"], hwthreads[b]["threadId"]
+                if ta ~= tb then
+                    return ta < tb
+                end
+                return less(a, b)
+            end)
+        end
+        order = {}
+        local i = 1
+        while #order < #cpus do
+            for _, pkg in pairs(socketIds) do
+                if sockets[pkg][i] ~= nil then
+                    table.insert(order, sockets[pkg][i])
+                end
+            end
+            i = i + 1
+        end
+    end
+    for i, cpu in pairs(order) do
+        domains[i] = numa[cpu] or 0
+    end
+    return order, domains
+end
+
 delimiter = ','
 quiet = 0
 sweep_sockets = false
 interleaved_policy = false
+interleave_domains = nil
+interleave_weights = nil
+interleave_weighted = false
 print_domains = false
 cpu_list = {}
 skip_mask = "0x0"
 affinity = nil
 num_threads = 0
+policy = "static"
 
 config = likwid.getConfiguration()
 cputopo = likwid.getCpuTopology()
@@ -105,7 +204,7 @@ if (#arg == 0) then
     os.exit(0)
 end
 
-for opt,arg in likwid.getopt(arg, {"c:", "d:", "h", "i", "p", "q", "s:", "S", "t:", "v", "V:", "verbose:", "help", "version", "skip","sweep", "quiet"}) do
+for opt,arg in likwid.getopt(arg, {"c:", "d:", "h", "i", "I:", "p", "q", "s:", "S", "t:", "v", "V:", "verbose:", "help", "version", "skip","sweep", "quiet", "policy:", "interleave:"}) do
     if opt == "h" or opt == "help" then
         usage()
         likwid.putTopology()
@@ -147,6 +246,28 @@ for opt,arg in likwid.getopt(arg, {"c:", "d:", "h", "i", "p", "q", "s:", "S", "t
         sweep_sockets = true
     elseif (opt == "i") then
         interleaved_policy = true
+    elseif opt == "I" or opt == "interleave" then
+        interleave_domains = {}
+        interleave_weights = {}
+        local numainfo = likwid.getNumaInfo()
+        for entry in arg:gmatch("[^,]+") do
+            local d, w = entry:match("^(%d+):?(%d*)$")
+            d = tonumber(d)
+            w = tonumber(w) or 1
+            if d == nil or d >= numainfo["numberOfNodes"] or w < 1 then
+                print("Invalid interleave entry " .. entry .. ", format is <domain>[:<weight>]")
+                likwid.putNumaInfo()
+                likwid.putTopology()
+                likwid.putAffinityInfo()
+                likwid.putConfiguration()
+                os.exit(1)
+            end
+            if w ~= 1 then
+                interleave_weighted = true
+            end
+            table.insert(interleave_domains, d)
+            table.insert(interleave_weights, string.format("%d:%d", numainfo["nodes"][d+1]["id"], w))
+        end
     elseif (opt == "p") then
         print_domains = true
     elseif opt == "s" or opt == "skip" then
@@ -156,6 +277,22 @@ for opt,arg in likwid.getopt(arg, {"c:", "d:", "h", "i", "p", "q", "s:", "S", "t
             os.exit(1)
         end
         skip_mask = arg
+    elseif opt == "policy" then
+        if arg ~= "static" and arg ~= "balance" and arg ~= "compact" and arg ~= "spread" then
+            print("Unknown placement policy " .. arg .. ", available are static, balance, compact and spread")
+            likwid.putTopology()
+            likwid.putAffinityInfo()
+            likwid.putConfiguration()
+            os.exit(1)
+        end
+        if arg ~= "static" and affinity == nil then
+            print("Option --policy " .. arg .. " is not supported for unknown processor!")
+            likwid.putTopology()
+            likwid.putAffinityInfo()
+            likwid.putConfiguration()
+            os.exit(1)
+        end
+        policy = arg
     elseif opt == "q" or opt == "quiet" then
         likwid.setenv("LIKWID_SILENT","true")
         quiet = 1
@@ -210,6 +347,16 @@ if interleaved_policy then
     likwid.setMemInterleaved(num_threads, cpu_list)
 end
 
+if interleave_domains then
+    print("Set mem_policy to interleaved over domains " .. table.concat(interleave_domains, ","))
+    if not likwid.setMemInterleavedDomains(interleave_domains) then
+        print("Failed to set interleave policy")
+    end
+    if interleave_weighted then
+        likwid.setenv("LIKWID_INTERLEAVE", table.concat(interleave_weights, ","))
+    end
+end
+
 if sweep_sockets then
     print("Sweeping memory")
     likwid.memSweep(num_threads, cpu_list)
@@ -225,6 +372,10 @@ end
 
 if num_threads > 1 then
     local preload = os.getenv("LD_PRELOAD")
+    local domains = nil
+    if policy ~= "static" then
+        cpu_list, domains = placement_order(cpu_list, policy)
+    end
     local pinString = tostring(cpu_list[2])
     for i=3,likwid.tablelength(cpu_list) do
         pinString = pinString .. "," .. cpu_list[i]
@@ -232,6 +383,16 @@ if num_threads > 1 then
     pinString = pinString .. "," .. cpu_list[1]
     skipString = skip_mask
 
+    if domains ~= nil then
+        local domainString = table.concat(domains, ",", 2)
+        if #domains > 1 then
+            domainString = domainString .. ","
+        end
+        domainString = domainString .. tostring(domains[1])
+        likwid.setenv("LIKWID_PIN_POLICY", policy)
+        likwid.setenv("LIKWID_PIN_DOMAINS", domainString)
+    end
+
     likwid.setenv("KMP_AFFINITY","disabled")
     likwid.setenv("LIKWID_PIN", pinString)
     if os.getenv("CILK_NWORKERS") == nil then
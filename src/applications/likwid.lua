@@ -53,12 +53,20 @@ likwid.setupCounters = likwid_setupCounters
 likwid.startCounters = likwid_startCounters
 likwid.stopCounters = likwid_stopCounters
 likwid.readCounters = likwid_readCounters
+likwid.startSampling = likwid_startSampling
+likwid.stopSampling = likwid_stopSampling
+likwid.getSamplingResults = likwid_getSamplingResults
 likwid.switchGroup = likwid_switchGroup
 likwid.finalize = likwid_finalize
 likwid.getEventsAndCounters = likwid_getEventsAndCounters
 likwid.getResult = likwid_getResult
 likwid.getNumberOfGroups = likwid_getNumberOfGroups
 likwid.getRuntimeOfGroup = likwid_getRuntimeOfGroup
+likwid.getLastResult = likwid_getLastResult
+likwid.getLastTimeOfGroup = likwid_getLastTimeOfGroup
+likwid.isUncoreCounter = likwid_isUncoreCounter
+likwid.getAggregates = likwid_getAggregates
+likwid.aggregateValues = likwid_aggregateValues
 likwid.getIdOfActiveGroup = likwid_getIdOfActiveGroup
 likwid.getNumberOfEvents = likwid_getNumberOfEvents
 likwid.getNumberOfThreads = likwid_getNumberOfThreads
@@ -68,6 +76,7 @@ likwid.putTopology = likwid_putTopology
 likwid.getNumaInfo = likwid_getNumaInfo
 likwid.putNumaInfo = likwid_putNumaInfo
 likwid.setMemInterleaved = likwid_setMemInterleaved
+likwid.setMemInterleavedDomains = likwid_setMemInterleavedDomains
 likwid.getAffinityInfo = likwid_getAffinityInfo
 likwid.putAffinityInfo = likwid_putAffinityInfo
 likwid.getPowerInfo = likwid_getPowerInfo
@@ -90,9 +99,37 @@ likwid.initTemp = likwid_initTemp
 likwid.readTemp = likwid_readTemp
 likwid.memSweep = likwid_memSweep
 likwid.memSweepDomain = likwid_memSweepDomain
+likwid.memSweepDomains = likwid_memSweepDomains
+likwid.memReclaimDomains = likwid_memReclaimDomains
+likwid.auditNumaPages = likwid_auditNumaPages
+likwid.migrateNumaPages = likwid_migrateNumaPages
 likwid.pinProcess = likwid_pinProcess
 likwid.setenv = likwid_setenv
 likwid.getpid = likwid_getpid
+likwid.gangliaOpen = likwid_gangliaOpen
+likwid.gangliaSend = likwid_gangliaSend
+likwid.gangliaClose = likwid_gangliaClose
+likwid.syslogOpen = likwid_syslogOpen
+likwid.syslogSend = likwid_syslogSend
+likwid.syslogClose = likwid_syslogClose
+likwid.tsOpen = likwid_tsOpen
+likwid.tsWrite = likwid_tsWrite
+likwid.tsClose = likwid_tsClose
+likwid.endpointOpen = likwid_endpointOpen
+likwid.endpointClose = likwid_endpointClose
+likwid.shmOpen = likwid_shmOpen
+likwid.shmClose = likwid_shmClose
+likwid.publish = likwid_publish
+likwid.getCgroupJobs = likwid_getCgroupJobs
+likwid.writeResultRecord = likwid_writeResultRecord
+likwid.mergeResultRecords = likwid_mergeResultRecords
+likwid.readResultRecords = likwid_readResultRecords
+likwid.plotOpen = likwid_plotOpen
+likwid.plotRecord = likwid_plotRecord
+likwid.plotCommand = likwid_plotCommand
+likwid.plotAdd = likwid_plotAdd
+likwid.plotFrame = likwid_plotFrame
+likwid.plotClose = likwid_plotClose
 likwid.setVerbosity = likwid_setVerbosity
 likwid.access = likwid_access
 likwid.startProgram = likwid_startProgram
@@ -301,6 +338,38 @@ end
 
 likwid.calculate_metric = calculate_metric
 
+local function compile_metric(formula, counter_names)
+    local function cmp(a,b)
+        return counter_names[a]:len() > counter_names[b]:len()
+    end
+    local order = {}
+    for i=1,#counter_names do
+        table.insert(order, i)
+    end
+    table.sort(order, cmp)
+    for _,i in pairs(order) do
+        local pattern = string.gsub(counter_names[i], "[%^%$%(%)%%%.%[%]%*%+%-%?]", "%%%0")
+        formula = string.gsub(formula, pattern, "#"..tostring(i).."#")
+    end
+    local check = string.gsub(formula, "#%d+#", "")
+    for c in check:gmatch"." do
+        if c ~= "+" and c ~= "-" and  c ~= "*" and  c ~= "/" and c ~= "(" and c ~= ")" and c ~= "." and c ~= " " and c:lower() ~= "e" and tonumber(c) == nil then
+            print("Not all formula entries can be substituted with measured values")
+            print("Current formula: "..formula)
+            return nil
+        end
+    end
+    formula = string.gsub(formula, "#(%d+)#", "v[%1]")
+    local func = loadstring("local v = ... local r = (" .. formula .. ") "..
+                            "if r ~= r or r == math.huge or r == -math.huge then return 0 end return r")
+    if not func then
+        print("Cannot compile formula "..formula)
+    end
+    return func
+end
+
+likwid.compile_metric = compile_metric
+
 local function printtable(tab)
     local nr_columns = tablelength(tab)
     if nr_columns == 0 then
@@ -422,21 +491,56 @@ end
 
 likwid.stringsplit = stringsplit
 
+local group_catalogs = {}
+
+local function get_group_catalog(arch)
+    if group_catalogs[arch] == nil then
+        group_catalogs[arch] = false
+        local chunk = loadfile(likwid.groupfolder .. "/" .. arch .. "/catalog.lua", "t", {})
+        if chunk ~= nil then
+            local ok, catalog = pcall(chunk)
+            if ok and type(catalog) == "table" and catalog["names"] ~= nil and catalog["groups"] ~= nil then
+                group_catalogs[arch] = catalog
+            end
+        end
+    end
+    return group_catalogs[arch]
+end
+
+local function copy_groupdata(src)
+    local dst = {}
+    for k, v in pairs(src) do
+        if type(v) == "table" then
+            dst[k] = copy_groupdata(v)
+        else
+            dst[k] = v
+        end
+    end
+    return dst
+end
+
 local function get_groups()
     groups = {}
     local cpuinfo = likwid.getCpuInfo()
     if cpuinfo == nil then return 0, {} end
-    local f = io.popen("ls " .. likwid.groupfolder .. "/" .. cpuinfo["short_name"] .."/*.txt 2>/dev/null")
-    if f ~= nil then
-        t = stringsplit(f:read("*a"),"\n")
-        f:close()
-        for i, a in pairs(t) do
-            if a ~= "" then
-                table.insert(groups,a:sub((a:match'^.*()/')+1,a:len()-4))
+    local catalog = get_group_catalog(cpuinfo["short_name"])
+    if catalog then
+        for i, a in pairs(catalog["names"]) do
+            table.insert(groups, a)
+        end
+    else
+        local f = io.popen("ls " .. likwid.groupfolder .. "/" .. cpuinfo["short_name"] .."/*.txt 2>/dev/null")
+        if f ~= nil then
+            t = stringsplit(f:read("*a"),"\n")
+            f:close()
+            for i, a in pairs(t) do
+                if a ~= "" then
+                    table.insert(groups,a:sub((a:match'^.*()/')+1,a:len()-4))
+                end
             end
         end
     end
-    f = io.popen("ls " ..os.getenv("HOME") .. "/.likwid/groups/" .. cpuinfo["short_name"] .."/*.txt 2>/dev/null")
+    local f = io.popen("ls " ..os.getenv("HOME") .. "/.likwid/groups/" .. cpuinfo["short_name"] .."/*.txt 2>/dev/null")
     if f ~= nil then
         t = stringsplit(f:read("*a"),"\n")
         f:close()
@@ -504,7 +608,12 @@ local function get_groupdata(group)
         if (a == group) then group_exist = 1 end
     end
     if (group_exist == 0) then return new_groupdata(group, cpuinfo["perf_num_fixed_ctr"]) end
-    
+
+    local catalog = get_group_catalog(cpuinfo["short_name"])
+    if catalog and catalog["groups"][group] ~= nil then
+        return copy_groupdata(catalog["groups"][group])
+    end
+
     local f = io.open(likwid.groupfolder .. "/" .. cpuinfo["short_name"] .. "/" .. group .. ".txt", "r")
     if f == nil then
         f = io.open(os.getenv("HOME") .. "/.likwid/groups/" .. cpuinfo["short_name"] .."/" .. group .. ".txt", "r")
@@ -634,7 +743,10 @@ local function min_max_avg(values)
     return min, max, sum/count
 end
 
-local function tableMinMaxAvgSum(inputtable, skip_cols, skip_lines)
+-- Aggregate the lines of a table over the columns. If the CPU of each column
+-- is given, the aggregation is done by the library, lines flagged in uncore
+-- are aggregated over the sockets instead of the CPUs.
+local function tableMinMaxAvgSum(inputtable, skip_cols, skip_lines, cpulist, uncore)
     local outputtable = {}
     local nr_columns = #inputtable
     if nr_columns == 0 then
@@ -654,6 +766,26 @@ local function tableMinMaxAvgSum(inputtable, skip_cols, skip_lines)
         sumOfLine[i-skip_lines+1] = 0
         avgOfLine[i-skip_lines+1] = 0
     end
+    if cpulist ~= nil and #cpulist >= nr_columns-skip_cols then
+        local cpus = {}
+        for j=skip_cols+1,nr_columns do
+            table.insert(cpus, cpulist[j-skip_cols])
+        end
+        for i=skip_lines+1, nr_lines do
+            local values = {}
+            for j=skip_cols+1,nr_columns do
+                values[j-skip_cols] = tonumber(inputtable[j][i]) or 0
+            end
+            local res = likwid_aggregateValues(cpus, values, uncore ~= nil and uncore[i], "node")
+            if res ~= nil then
+                minOfLine[i-skip_lines+1] = res[1]["min"]
+                maxOfLine[i-skip_lines+1] = res[1]["max"]
+                sumOfLine[i-skip_lines+1] = res[1]["sum"]
+                avgOfLine[i-skip_lines+1] = res[1]["avg"]
+            end
+        end
+        nr_columns = skip_cols
+    end
     for j=skip_cols+1,nr_columns do
         for i=skip_lines+1, nr_lines do
             local res = tonumber(inputtable[j][i])
@@ -693,6 +825,39 @@ end
 
 likwid.tableToMinMaxAvgSum = tableMinMaxAvgSum
 
+-- A metric is read per socket if all counters in its formula are uncore
+-- counters
+local function isUncoreMetric(formula, events)
+    local found = false
+    for _, event in pairs(events) do
+        local counter = event["Counter"]
+        if formula:match("%f[%w]"..counter:gsub("%W", "%%%0").."%f[%W]") then
+            if not likwid_isUncoreCounter(counter) then
+                return false
+            end
+            found = true
+        end
+    end
+    return found
+end
+
+likwid.isUncoreMetric = isUncoreMetric
+
+-- Flags for the lines of the event and metric tables of a group
+local function uncoreLines(groupData, skip_lines)
+    local events = {}
+    local metrics = {}
+    for e, event in pairs(groupData["Events"]) do
+        events[e + skip_lines] = likwid_isUncoreCounter(event["Counter"])
+    end
+    if groupData["Metrics"] then
+        for m, metric in pairs(groupData["Metrics"]) do
+            metrics[m + 1] = isUncoreMetric(metric["formula"], groupData["Events"])
+        end
+    end
+    return events, metrics
+end
+
 local function printOutput(results, groupData, cpulist)
     local nr_groups = #groupData
     local maxLineFields = 0
@@ -742,8 +907,9 @@ local function printOutput(results, groupData, cpulist)
             table.insert(firsttab, tmpList)
         end
         
+        local uncoreEvents, uncoreMetrics = uncoreLines(groupData[groupID], #firsttab[1] - #groupData[groupID]["Events"])
         if #cpulist > 1 then
-            firsttab_combined = tableMinMaxAvgSum(firsttab, 2, 1)
+            firsttab_combined = tableMinMaxAvgSum(firsttab, 2, 1, cpulist, uncoreEvents)
         end
 
         if groupData[groupID]["Metrics"] then
@@ -773,7 +939,7 @@ local function printOutput(results, groupData, cpulist)
             end
 
             if #cpulist > 1 then
-                secondtab_combined = tableMinMaxAvgSum(secondtab, 1, 1)
+                secondtab_combined = tableMinMaxAvgSum(secondtab, 1, 1, cpulist, uncoreMetrics)
             end
         end
         maxLineFields = math.max(#firsttab, #firsttab_combined,
@@ -825,6 +991,35 @@ end
 
 likwid.printOutput = printOutput
 
+local function printSamplingOutput(results, groupData, eventIdx, period)
+    local event = groupData["Events"][eventIdx]
+    local tab = {{"Symbol"},{"Module"},{"Samples"},{"Share [%]"}}
+    for i, sym in pairs(results["symbols"]) do
+        local share = 0
+        if results["samples"] > 0 then
+            share = 100.0 * sym["count"] / results["samples"]
+        end
+        table.insert(tab[1], sym["symbol"])
+        table.insert(tab[2], sym["module"])
+        table.insert(tab[3], tostring(sym["count"]))
+        table.insert(tab[4], string.format("%.2f", share))
+    end
+    if use_csv then
+        print(string.format("STRUCT,Info,4,"))
+        print(string.format("Event:,%s:%s,,",event["Event"], event["Counter"]))
+        print(string.format("Period:,%d,,", period))
+        print(string.format("Samples:,%d,Lost:,%d", results["samples"], results["lost"]))
+        print(string.format("TABLE,Sampling,%s,%d",event["Event"],#tab[1]-1))
+        likwid.printcsv(tab, 4)
+    else
+        print(string.format("Sampled event %s:%s every %d events", event["Event"], event["Counter"], period))
+        print(string.format("Samples: %d, lost: %d", results["samples"], results["lost"]))
+        likwid.printtable(tab)
+    end
+end
+
+likwid.printSamplingOutput = printSamplingOutput
+
 
 local function printMarkerOutput(groups, results, groupData, cpulist)
     local nr_groups = #groups
@@ -846,7 +1041,13 @@ local function printMarkerOutput(groups, results, groupData, cpulist)
                 local secondtab = {}
                 local secondtab_combined = {}
 
+                local nested = groups[g][r]["Nested"]
+                local exclusivetab = {}
+
                 infotab[1] = {"Region Info","RDTSC Runtime [s]","call count"}
+                if nested then
+                    table.insert(infotab[1], "exclusive Runtime [s]")
+                end
                 for thread=1, nr_threads do
                     if cpulist[thread] ~= nil and
                        groups[g][r]["Time"][thread] ~= nil and
@@ -855,6 +1056,9 @@ local function printMarkerOutput(groups, results, groupData, cpulist)
                         table.insert(tmpList, "Core "..tostring(cpulist[thread]))
                         table.insert(tmpList, string.format("%.6f", groups[g][r]["Time"][thread]))
                         table.insert(tmpList, tostring(groups[g][r]["Count"][thread]))
+                        if nested then
+                            table.insert(tmpList, string.format("%.6f", groups[g][r]["ExclusiveTime"][thread]))
+                        end
                         table.insert(infotab, tmpList)
                     else
                         print(string.format("Cannot find thread %d in CPU list, in time list or in call count list", thread))
@@ -889,9 +1093,24 @@ local function printMarkerOutput(groups, results, groupData, cpulist)
                     end
                     table.insert(firsttab, tmpList)
                 end
+                if nested then
+                    exclusivetab[1] = {"Exclusive Event"}
+                    exclusivetab[2] = firsttab[2]
+                    for e=1,nr_events do
+                        table.insert(exclusivetab[1],groupData[g]["Events"][e]["Event"])
+                    end
+                    for t=1,nr_threads do
+                        local tmpList = {"Core "..tostring(cpulist[t])}
+                        for e=1,nr_events do
+                            table.insert(tmpList, string.format("%e",results[g][r][e][t]["Exclusive"] or 0))
+                        end
+                        table.insert(exclusivetab, tmpList)
+                    end
+                end
 
+                local uncoreEvents, uncoreMetrics = uncoreLines(groupData[g], 1)
                 if #cpulist > 1 then
-                    firsttab_combined = tableMinMaxAvgSum(firsttab, 2, 1)
+                    firsttab_combined = tableMinMaxAvgSum(firsttab, 2, 1, cpulist, uncoreEvents)
                 end
 
 
@@ -924,11 +1143,11 @@ local function printMarkerOutput(groups, results, groupData, cpulist)
                     end
 
                     if #cpulist > 1 then
-                        secondtab_combined = tableMinMaxAvgSum(secondtab, 1, 1)
+                        secondtab_combined = tableMinMaxAvgSum(secondtab, 1, 1, cpulist, uncoreMetrics)
                     end
                 end
                 maxLineFields = math.max(#infotab, #firsttab, #firsttab_combined,
-                                         #secondtab, #secondtab_combined, 2)
+                                         #exclusivetab, #secondtab, #secondtab_combined, 2)
                 
                 if use_csv then
                     str = tostring(g)..","..groupName..","..groups[g][r]["Name"]
@@ -969,6 +1188,14 @@ local function printMarkerOutput(groups, results, groupData, cpulist)
                 else
                     likwid.printtable(firsttab)
                 end
+                if nested then
+                    if use_csv then
+                        print(string.format("TABLE,Group %d Raw Exclusive,%s,%d%s",g,groupName,#exclusivetab[1]-1,string.rep(",",maxLineFields-3)))
+                        likwid.printcsv(exclusivetab, maxLineFields)
+                    else
+                        likwid.printtable(exclusivetab)
+                    end
+                end
                 if #cpulist > 1 then
                     if use_csv then
                         print(string.format("TABLE,Group %d Raw Stat,%s,%d%s",g,groupName,#firsttab_combined[1]-1,string.rep(",",maxLineFields-3)))
@@ -1020,7 +1247,8 @@ end
 
 likwid.getResults = getResults
 
-local function getMarkerResults(filename, group_list, cpulist)
+-- Reader for marker files in the text format of older LIKWID versions
+local function getMarkerResultsText(filename, group_list, cpulist)
     local cpuinfo = likwid_getCpuInfo()
     local ctr_and_events = likwid_getEventsAndCounters()
     local group_data = {}
@@ -1168,6 +1396,97 @@ local function getMarkerResults(filename, group_list, cpulist)
     return group_data, results
 end
 
+-- The optional record selects a snapshot of a stream file, negative values
+-- count from the last one. Returns also the record, the number of records
+-- and the time of the snapshot.
+local function getMarkerResults(filename, group_list, cpulist, record)
+    local group_data = {}
+    local results = {}
+    local handle, nr_threads, nr_regions, nr_groups, rec, nr_records, timestamp = likwid_markerFileOpen(filename, record)
+    if handle < 0 then
+        if record ~= nil then
+            return {},{}
+        end
+        return getMarkerResultsText(filename, group_list, cpulist)
+    end
+    -- Snapshots list only the threads that already entered a region
+    if nr_threads > #cpulist or (record == nil and nr_threads ~= #cpulist) then
+        print(string.format("Marker file lists only %d cpus, but perfctr configured %d cpus", nr_threads, #cpulist))
+        likwid_markerFileClose(handle)
+        return {},{}
+    end
+    if nr_regions == 0 then
+        print("No region results can be found in marker API output file")
+        print("This happens when the application runs only on different CPUs as specified for likwid-perfctr")
+        likwid_markerFileClose(handle)
+        return {},{}
+    end
+    if nr_groups == 0 then
+        print("No group listed in the marker API output file")
+        likwid_markerFileClose(handle)
+        return {},{}
+    end
+    local cpu2thread = {}
+    for i, cpu in pairs(cpulist) do
+        cpu2thread[cpu] = i
+    end
+    for r=1, nr_regions do
+        local region = likwid_markerFileRegion(handle, r)
+        if region == nil or group_list[region["group"]] == nil then
+            print(string.format("Cannot read region %d from marker file %s", r, filename))
+        else
+            local g = region["group"]
+            if group_data[g] == nil then
+                group_data[g] = {}
+                results[g] = {}
+            end
+            group_data[g][r] = {}
+            group_data[g][r]["ID"] = g
+            group_data[g][r]["Name"] = region["tag"]:match("^(.*)-%d+$") or region["tag"]
+            group_data[g][r]["Time"] = {}
+            group_data[g][r]["ExclusiveTime"] = {}
+            group_data[g][r]["Count"] = {}
+            results[g][r] = {}
+            for e=1, region["events"] do
+                results[g][r][e] = {}
+            end
+            for t=1, #cpulist do
+                group_data[g][r]["Time"][t] = 0
+                group_data[g][r]["ExclusiveTime"][t] = 0
+                group_data[g][r]["Count"][t] = 0
+                for e=1, region["events"] do
+                    results[g][r][e][t] = {Value = 0, Exclusive = 0, Counter = group_list[g]["Events"][e]["Counter"]}
+                end
+            end
+            for i, cpu in pairs(region["cpus"]) do
+                local t = cpu2thread[cpu] or i
+                group_data[g][r]["Time"][t] = region["time"][i]
+                group_data[g][r]["ExclusiveTime"][t] = region["exclusiveTime"][i]
+                group_data[g][r]["Count"][t] = region["count"][i]
+                for e=1, region["events"] do
+                    results[g][r][e][t] = {}
+                    results[g][r][e][t]["Value"] = region["counters"][e][i]
+                    results[g][r][e][t]["Exclusive"] = region["exclusiveCounters"][e][i]
+                    results[g][r][e][t]["Counter"] = group_list[g]["Events"][e]["Counter"]
+                end
+            end
+        end
+    end
+    -- Regions with nested regions report their exclusive values as well
+    for g, regions in pairs(group_data) do
+        for r, region in pairs(regions) do
+            for r2, region2 in pairs(regions) do
+                if region2["Name"]:sub(1, region["Name"]:len()+1) == region["Name"].."/" then
+                    region["Nested"] = true
+                    break
+                end
+            end
+        end
+    end
+    likwid_markerFileClose(handle)
+    return group_data, results, rec, nr_records, timestamp
+end
+
 likwid.getMarkerResults = getMarkerResults
 
 
@@ -38,7 +38,7 @@
 
 #include <configuration.h>
 
-Configuration config = {NULL,NULL,NULL,-1,MAX_NUM_THREADS,MAX_NUM_NODES};
+Configuration config = {NULL,NULL,NULL,-1,MAX_NUM_THREADS,MAX_NUM_NODES,NULL};
 int init_config = 0;
 
 static int default_configuration(void)
@@ -174,6 +174,12 @@ int init_configuration(void)
             strcpy(config.topologyCfgFileName, value);
             config.topologyCfgFileName[strlen(value)] = '\0';
         }
+        else if (strcmp(name, "topology_cache") == 0)
+        {
+            config.topologyCacheFileName = (char*)malloc((strlen(value)+1) * sizeof(char));
+            strcpy(config.topologyCacheFileName, value);
+            config.topologyCacheFileName[strlen(value)] = '\0';
+        }
         else if (strcmp(name, "daemon_path") == 0)
         {
             config.daemonPath = (char*)malloc((strlen(value)+1) * sizeof(char));
@@ -199,6 +205,17 @@ int init_configuration(void)
                 config.daemonMode = ACCESSMODE_DIRECT;
             }
         }
+        else if (strcmp(name, "hwloc") == 0)
+        {
+            if (strcmp(value, "always") == 0)
+            {
+                config.hwlocMode = HWLOC_MODE_ALWAYS;
+            }
+            else if (strcmp(value, "lazy") == 0)
+            {
+                config.hwlocMode = HWLOC_MODE_LAZY;
+            }
+        }
         else if (strcmp(name, "max_threads") == 0)
         {
             config.maxNumThreads = atoi(value);
@@ -216,6 +233,24 @@ int init_configuration(void)
     return 0;
 }
 
+/* hwloc is only used for the detection of topology, NUMA and PCI devices if
+ * requested by the hwloc option or the LIKWID_HWLOC environment variable,
+ * otherwise only if the native backend fails */
+int config_useHwloc(void)
+{
+#ifdef LIKWID_USE_HWLOC
+    char* env = getenv("LIKWID_HWLOC");
+
+    if (env != NULL)
+    {
+        return (strcmp(env, "always") == 0);
+    }
+    return (config.hwlocMode == HWLOC_MODE_ALWAYS);
+#else
+    return 0;
+#endif
+}
+
 Configuration_t get_configuration(void)
 {
     if (init_config == 1)
@@ -243,6 +278,11 @@ int destroy_configuration(void)
     {
         free(config.daemonPath);
     }
+    if (config.topologyCacheFileName != NULL)
+    {
+        free(config.topologyCacheFileName);
+        config.topologyCacheFileName = NULL;
+    }
     init_config = 0;
     return 0;
 }
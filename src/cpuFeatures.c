@@ -47,7 +47,7 @@
 
 /* #####   EXPORTED VARIABLES   ########################################### */
 
-static uint64_t cpuFeatureMask[MAX_NUM_THREADS] = {0x0ULL};
+static uint64_t* cpuFeatureMask = NULL;
 static int features_initialized = 0;
 
 /* #####   MACROS  -  LOCAL TO THIS SOURCE FILE   ######################### */
@@ -230,6 +230,12 @@ cpuFeatures_init()
     }
 
     topology_init();
+    cpuFeatureMask = (uint64_t*) calloc(cpuid_topology.numHWThreads, sizeof(uint64_t));
+    if (cpuFeatureMask == NULL)
+    {
+        fprintf(stderr, "Cannot allocate feature flags of %d CPUs\n", cpuid_topology.numHWThreads);
+        return;
+    }
     if (!HPMinitialized())
     {
         HPMinit();
@@ -288,6 +294,10 @@ cpuFeatures_enable(int cpu, CpuFeature type, int print)
     uint64_t flags;
     uint32_t reg = MSR_IA32_MISC_ENABLE;
     int newOffsets = 0;
+    if (!features_initialized)
+    {
+        return -EINVAL;
+    }
     if (IF_FLAG(type))
     {
         return 0;
@@ -414,6 +424,10 @@ cpuFeatures_disable(int cpu, CpuFeature type, int print)
     uint64_t flags;
     uint32_t reg = MSR_IA32_MISC_ENABLE;
     int newOffsets = 0;
+    if (!features_initialized)
+    {
+        return -EINVAL;
+    }
     if (!IF_FLAG(type))
     {
         return 0;
@@ -536,6 +550,10 @@ cpuFeatures_disable(int cpu, CpuFeature type, int print)
 
 int cpuFeatures_get(int cpu, CpuFeature type)
 {
+    if (!features_initialized)
+    {
+        return -EINVAL;
+    }
     if ((type >= FEAT_HW_PREFETCHER) && (type < CPUFEATURES_MAX))
     {
         if (IF_FLAG(type))
@@ -155,6 +155,7 @@ static int cpustr_to_cpulist_expression(bstring bcpustr, int* cpulist, int lengt
     int count = 0;
     int stride = 0;
     int chunk = 0;
+    int smtmask = ~0;
     if (bstrchrp(bcpustr, 'E', 0) != 0)
     {
         fprintf(stderr, "Not a valid CPU expression\n");
@@ -169,12 +170,29 @@ static int cpustr_to_cpulist_expression(bstring bcpustr, int* cpulist, int lengt
         stride = 1;
         chunk = 1;
     }
-    else if (strlist->qty == 5)
+    else if (strlist->qty == 5 || strlist->qty == 6)
     {
         bdomain = bstrcpy(strlist->entry[1]);
         count = atoi(bdata(strlist->entry[2]));
         chunk = atoi(bdata(strlist->entry[3]));
         stride = atoi(bdata(strlist->entry[4]));
+        if (strlist->qty == 6)
+        {
+            /* Select only the given SMT threads of each core, e.g. 1 or 0,1 */
+            struct bstrList* smtlist = bsplit(strlist->entry[5], ',');
+            smtmask = 0;
+            for (int i=0; i<smtlist->qty; i++)
+            {
+                smtmask |= (1<<atoi(bdata(smtlist->entry[i])));
+            }
+            bstrListDestroy(smtlist);
+        }
+    }
+    else
+    {
+        fprintf(stderr, "ERROR: Invalid expression, should look like E:<domain>:<count>[:<chunk>:<stride>[:<SMT threads>]]\n");
+        bstrListDestroy(strlist);
+        return 0;
     }
     for (int i=0; i<affinity->numberOfAffinityDomains; i++)
     {
@@ -187,6 +205,38 @@ static int cpustr_to_cpulist_expression(bstring bcpustr, int* cpulist, int lengt
     if (domainidx < 0)
     {
         fprintf(stderr, "Cannot find domain %s\n", bdata(bdomain));
+        bdestroy(bdomain);
+        bstrListDestroy(strlist);
+        return 0;
+    }
+    bdestroy(bdomain);
+    if ((chunk <= 0) || (stride <= 0))
+    {
+        fprintf(stderr, "ERROR: Chunk size and stride must be positive\n");
+        bstrListDestroy(strlist);
+        return 0;
+    }
+    int *inlist = malloc(affinity->domains[domainidx].numberOfProcessors * sizeof(int));
+    if (inlist == NULL)
+    {
+        bstrListDestroy(strlist);
+        return -ENOMEM;
+    }
+    int numProcs = 0;
+    for (int i=0; i<affinity->domains[domainidx].numberOfProcessors; i++)
+    {
+        int cpu = affinity->domains[domainidx].processorList[i];
+        if (smtmask & (1<<cpuid_topology->threadPool[cpu].threadId))
+        {
+            inlist[numProcs] = cpu;
+            numProcs++;
+        }
+    }
+    if (numProcs == 0)
+    {
+        fprintf(stderr, "No HW threads with the selected SMT threads in domain %s\n",
+                bdata(affinity->domains[domainidx].tag));
+        free(inlist);
         bstrListDestroy(strlist);
         return 0;
     }
@@ -194,24 +244,23 @@ static int cpustr_to_cpulist_expression(bstring bcpustr, int* cpulist, int lengt
     int insert = 0;
     for (int i=0;i<count;i++)
     {
-        for (int j=0;j<chunk && offset+j<affinity->domains[domainidx].numberOfProcessors;j++)
+        for (int j=0;j<chunk && offset+j<numProcs;j++)
         {
-            cpulist[insert] = affinity->domains[domainidx].processorList[offset + j];
+            cpulist[insert] = inlist[offset + j];
             insert++;
             if (insert == length)
                 goto expression_done;
         }
         offset += stride;
-        if (offset >= affinity->domains[domainidx].numberOfProcessors)
+        if (offset >= numProcs)
         {
             offset = 0;
         }
         if (insert >= count)
             goto expression_done;
     }
-    bstrListDestroy(strlist);
-    return 0;
 expression_done:
+    free(inlist);
     bstrListDestroy(strlist);
     return insert;
 }
@@ -472,7 +521,9 @@ int cpustr_to_cpulist(char* cpustring, int* cpulist, int length)
             if (((bstrchrp(strlist->entry[i], 'N', 0) == 0) ||
                 (bstrchrp(strlist->entry[i], 'S', 0) == 0) ||
                 (bstrchrp(strlist->entry[i], 'C', 0) == 0) ||
-                (bstrchrp(strlist->entry[i], 'M', 0) == 0)) &&
+                (bstrchrp(strlist->entry[i], 'M', 0) == 0) ||
+                (bstrchrp(strlist->entry[i], 'T', 0) == 0) ||
+                (bstrchrp(strlist->entry[i], 'P', 0) == 0)) &&
                 (bstrchrp(strlist->entry[i], ':', 0) != BSTR_ERR))
             {
                 bstring newstr = bformat("L:");
@@ -493,7 +544,9 @@ int cpustr_to_cpulist(char* cpustring, int* cpulist, int length)
         else if (((bstrchrp(strlist->entry[i], 'N', 0) == 0) ||
             (bstrchrp(strlist->entry[i], 'S', 0) == 0) ||
             (bstrchrp(strlist->entry[i], 'C', 0) == 0) ||
-            (bstrchrp(strlist->entry[i], 'M', 0) == 0)) &&
+            (bstrchrp(strlist->entry[i], 'M', 0) == 0) ||
+            (bstrchrp(strlist->entry[i], 'T', 0) == 0) ||
+            (bstrchrp(strlist->entry[i], 'P', 0) == 0)) &&
             (bstrchrp(strlist->entry[i], ':', 0) != BSTR_ERR))
         {
             bstring newstr = bformat("L:");
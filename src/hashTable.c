@@ -34,6 +34,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <pthread.h>
+#include <sched.h>
 
 #include <ghash.h>
 #include <bstrlib.h>
@@ -41,37 +42,148 @@
 #include <hashTable.h>
 #include <likwid.h>
 
+/* The regions of a thread are additionally kept in a list. New regions are
+ * published at its head, so hashTable_snapshot can walk the list while the
+ * thread keeps inserting regions. */
 typedef struct {
     pthread_t tid;
     uint32_t coreId;
     GHashTable* hashTable;
-} ThreadList;
+    LikwidThreadResults* regions;
+} CACHELINE_ALIGNED ThreadList;
 
-
-static ThreadList* threadList[MAX_NUM_THREADS];
+/* One entry per HW thread of the system, sized in hashTable_init */
+static ThreadList** threadList = NULL;
+static int numberOfThreadSlots = 0;
 
 /* ======================================================================== */
 
+static LikwidResults* allocResults(uint32_t numberOfRegions, uint32_t numberOfThreads)
+{
+    LikwidResults* results;
+    results = (LikwidResults*) malloc(numberOfRegions * sizeof(LikwidResults));
+    if (!results)
+    {
+        fprintf(stderr, "Failed to allocate %lu bytes for the results\n", numberOfRegions * sizeof(LikwidResults));
+    }
+    else
+    {
+        for ( uint32_t i=0; i < numberOfRegions; i++ )
+        {
+            results[i].tag = NULL;
+            results[i].time = (double*) malloc(numberOfThreads * sizeof(double));
+            if (!results[i].time)
+            {
+                fprintf(stderr, "Failed to allocate %lu bytes for the time storage\n", numberOfThreads * sizeof(double));
+                break;
+            }
+            results[i].exclusiveTime = (double*) malloc(numberOfThreads * sizeof(double));
+            if (!results[i].exclusiveTime)
+            {
+                fprintf(stderr, "Failed to allocate %lu bytes for the exclusive time storage\n", numberOfThreads * sizeof(double));
+                break;
+            }
+            results[i].count = (uint32_t*) malloc(numberOfThreads * sizeof(uint32_t));
+            if (!results[i].count)
+            {
+                fprintf(stderr, "Failed to allocate %lu bytes for the count storage\n", numberOfThreads * sizeof(uint32_t));
+                break;
+            }
+            results[i].cpulist = (int*) malloc(numberOfThreads * sizeof(int));
+            if (!results[i].count)
+            {
+                fprintf(stderr, "Failed to allocate %lu bytes for the cpulist storage\n", numberOfThreads * sizeof(int));
+                break;
+            }
+            results[i].counters = (double**) malloc(numberOfThreads * sizeof(double*));
+            if (!results[i].counters)
+            {
+                fprintf(stderr, "Failed to allocate %lu bytes for the counter result storage\n", numberOfThreads * sizeof(double*));
+                break;
+            }
+            results[i].exclusiveCounters = (double**) malloc(numberOfThreads * sizeof(double*));
+            if (!results[i].exclusiveCounters)
+            {
+                fprintf(stderr, "Failed to allocate %lu bytes for the exclusive counter result storage\n", numberOfThreads * sizeof(double*));
+                break;
+            }
+
+            for ( uint32_t j=0; j < numberOfThreads; j++ )
+            {
+                results[i].time[j] = 0.0;
+                results[i].exclusiveTime[j] = 0.0;
+                results[i].count[j] = 0;
+                results[i].cpulist[j] = -1;
+                results[i].counters[j] = (double*) malloc(NUM_PMC * sizeof(double));
+                results[i].exclusiveCounters[j] = (double*) malloc(NUM_PMC * sizeof(double));
+                if ((!results[i].counters[j]) || (!results[i].exclusiveCounters[j]))
+                {
+                    fprintf(stderr, "Failed to allocate %lu bytes for the counter result storage for thread %d\n", 2 * NUM_PMC * sizeof(double), j);
+                    break;
+                }
+                else
+                {
+                    for ( uint32_t k=0; k < NUM_PMC; k++ )
+                    {
+                        results[i].counters[j][k] = 0.0;
+                        results[i].exclusiveCounters[j][k] = 0.0;
+                    }
+                }
+            }
+        }
+    }
+    return results;
+}
+
+static ThreadList* newThreadList(int coreID)
+{
+    ThreadList* resPtr = NULL;
+    if (posix_memalign((void**) &resPtr, CACHELINE_SIZE, sizeof(ThreadList)) != 0)
+    {
+        fprintf(stderr, "Failed to allocate %lu bytes for the regions of CPU %d\n", sizeof(ThreadList), coreID);
+        return NULL;
+    }
+    /* initialize structure */
+    resPtr->tid =  pthread_self();
+    resPtr->coreId  = coreID;
+    resPtr->hashTable = g_hash_table_new(g_str_hash, g_str_equal);
+    resPtr->regions = NULL;
+    return resPtr;
+}
+
 void hashTable_init()
 {
-    for (int i=0; i<MAX_NUM_THREADS; i++)
+    CpuTopology_t topo = get_cpuTopology();
+    if (threadList != NULL)
+    {
+        free(threadList);
+    }
+    numberOfThreadSlots = topo->numHWThreads;
+    threadList = (ThreadList**) calloc(numberOfThreadSlots, sizeof(ThreadList*));
+    if (threadList == NULL)
     {
-        threadList[i] = NULL;
+        fprintf(stderr, "Failed to allocate %lu bytes for the thread list\n", numberOfThreadSlots * sizeof(ThreadList*));
+        numberOfThreadSlots = 0;
     }
 }
 
 void hashTable_initThread(int coreID)
 {
-    ThreadList* resPtr = threadList[coreID];
+    ThreadList* resPtr;
+    if ((coreID < 0) || (coreID >= numberOfThreadSlots))
+    {
+        return;
+    }
+    resPtr = threadList[coreID];
     /* check if thread was already initialized */
     if (resPtr == NULL)
     {
-        resPtr = (ThreadList*) malloc(sizeof(ThreadList));
-        /* initialize structure */
-        resPtr->tid =  pthread_self();
-        resPtr->coreId  = coreID;
-        resPtr->hashTable = g_hash_table_new(g_str_hash, g_str_equal);
-        threadList[coreID] = resPtr;
+        resPtr = newThreadList(coreID);
+        if (resPtr == NULL)
+        {
+            return;
+        }
+        __atomic_store_n(&threadList[coreID], resPtr, __ATOMIC_RELEASE);
     }
 }
 
@@ -83,12 +195,8 @@ int hashTable_get(bstring label, LikwidThreadResults** resEntry)
     /* check if thread was already initialized */
     if (resPtr == NULL)
     {
-        resPtr = (ThreadList*) malloc(sizeof(ThreadList));
-        /* initialize structure */
-        resPtr->tid =  pthread_self();
-        resPtr->coreId  = coreID;
-        resPtr->hashTable = g_hash_table_new(g_str_hash, g_str_equal);
-        threadList[coreID] = resPtr;
+        resPtr = newThreadList(coreID);
+        __atomic_store_n(&threadList[coreID], resPtr, __ATOMIC_RELEASE);
     }
 
     (*resEntry) = g_hash_table_lookup(resPtr->hashTable, (gpointer) bdata(label));
@@ -99,17 +207,24 @@ int hashTable_get(bstring label, LikwidThreadResults** resEntry)
         (*resEntry) = (LikwidThreadResults*) malloc(sizeof(LikwidThreadResults));
         (*resEntry)->label = bstrcpy (label);
         (*resEntry)->time = 0.0;
+        (*resEntry)->exclusiveTime = 0.0;
+        (*resEntry)->groupID = 0;
+        (*resEntry)->cpuID = coreID;
         (*resEntry)->count = 0;
+        (*resEntry)->active = 0;
+        (*resEntry)->seq = 0;
         for (int i=0; i< NUM_PMC; i++)
         {
             (*resEntry)->PMcounters[i] = 0.0;
-            (*resEntry)->StartPMcounters[i] = 0.0;
+            (*resEntry)->ExclusivePMcounters[i] = 0.0;
         }
 
         g_hash_table_insert(
                 resPtr->hashTable,
                 (gpointer) g_strdup(bdata(label)),
                 (gpointer) (*resEntry));
+        (*resEntry)->next = resPtr->regions;
+        __atomic_store_n(&resPtr->regions, (*resEntry), __ATOMIC_RELEASE);
     }
 
     return coreID;
@@ -121,85 +236,41 @@ void hashTable_finalize(int* numThreads, int* numRegions, LikwidResults** result
     uint32_t numberOfThreads = 0;
     uint32_t numberOfRegions = 0;
     GHashTable* regionLookup;
+    GHashTableIter iter;
+    gpointer key, value;
 
+    /* Regions are keyed by their call path, threads reaching different
+     * paths have different regions. Count the union of all threads and
+     * number the regions in the order they are found. */
     regionLookup = g_hash_table_new(g_str_hash, g_str_equal);
-    /* determine number of active threads */
-    for (int i=0; i<MAX_NUM_THREADS; i++)
+    for (int i=0; i<numberOfThreadSlots; i++)
     {
         if (threadList[i] != NULL)
         {
             numberOfThreads++;
-            uint32_t threadNumberOfRegions = g_hash_table_size(threadList[i]->hashTable);
-
-            /*  Determine maximum number of regions */
-            if (numberOfRegions < threadNumberOfRegions)
+            g_hash_table_iter_init (&iter, threadList[i]->hashTable);
+            while (g_hash_table_iter_next (&iter, &key, &value))
             {
-                numberOfRegions = threadNumberOfRegions;
+                if (g_hash_table_lookup(regionLookup, key) == NULL)
+                {
+                    numberOfRegions++;
+                    g_hash_table_insert(regionLookup, key, (gpointer)(uintptr_t) numberOfRegions);
+                }
             }
         }
     }
 
     /* allocate data structures */
-    (*results) = (LikwidResults*) malloc(numberOfRegions * sizeof(LikwidResults));
-    if (!(*results))
+    (*results) = allocResults(numberOfRegions, numberOfThreads);
+    if ((*results) == NULL)
     {
-        fprintf(stderr, "Failed to allocate %lu bytes for the results\n", numberOfRegions * sizeof(LikwidResults));
+        g_hash_table_destroy(regionLookup);
+        (*numThreads) = 0;
+        (*numRegions) = 0;
+        return;
     }
-    else
-    {
-        for ( uint32_t i=0; i < numberOfRegions; i++ )
-        {
-            (*results)[i].time = (double*) malloc(numberOfThreads * sizeof(double));
-            if (!(*results)[i].time)
-            {
-                fprintf(stderr, "Failed to allocate %lu bytes for the time storage\n", numberOfThreads * sizeof(double));
-                break;
-            }
-            (*results)[i].count = (uint32_t*) malloc(numberOfThreads * sizeof(uint32_t));
-            if (!(*results)[i].count)
-            {
-                fprintf(stderr, "Failed to allocate %lu bytes for the count storage\n", numberOfThreads * sizeof(uint32_t));
-                break;
-            }
-            (*results)[i].cpulist = (int*) malloc(numberOfThreads * sizeof(int));
-            if (!(*results)[i].count)
-            {
-                fprintf(stderr, "Failed to allocate %lu bytes for the cpulist storage\n", numberOfThreads * sizeof(int));
-                break;
-            }
-            (*results)[i].counters = (double**) malloc(numberOfThreads * sizeof(double*));
-            if (!(*results)[i].counters)
-            {
-                fprintf(stderr, "Failed to allocate %lu bytes for the counter result storage\n", numberOfThreads * sizeof(double*));
-                break;
-            }
 
-            for ( uint32_t j=0; j < numberOfThreads; j++ )
-            {
-                (*results)[i].time[j] = 0.0;
-                (*results)[i].count[j] = 0;
-                (*results)[i].cpulist[j] = -1;
-                (*results)[i].counters[j] = (double*) malloc(NUM_PMC * sizeof(double));
-                if (!(*results)[i].counters)
-                {
-                    fprintf(stderr, "Failed to allocate %lu bytes for the counter result storage for thread %d\n", NUM_PMC * sizeof(double), j);
-                    break;
-                }
-                else
-                {
-                    for ( uint32_t k=0; k < NUM_PMC; k++ )
-                    {
-                        (*results)[i].counters[j][k] = 0.0;
-                    }
-                }
-            }
-        }
-    }
-
-    uint32_t regionIds[numberOfRegions];
-    uint32_t currentRegion = 0;
-
-    for (int core=0; core<MAX_NUM_THREADS; core++)
+    for (int core=0; core<numberOfThreadSlots; core++)
     {
         ThreadList* resPtr = threadList[core];
 
@@ -207,44 +278,153 @@ void hashTable_finalize(int* numThreads, int* numRegions, LikwidResults** result
         {
             LikwidThreadResults* threadResult  = NULL;
 
-            GHashTableIter iter;
-            gpointer key, value;
-
             g_hash_table_iter_init (&iter, resPtr->hashTable);
 
             /* iterate over all regions in thread */
             while (g_hash_table_iter_next (&iter, &key, &value))
             {
                 threadResult = (LikwidThreadResults*) value;
-                uint32_t* regionId = (uint32_t*) g_hash_table_lookup(regionLookup, key);
+                uint32_t regionId = (uintptr_t) g_hash_table_lookup(regionLookup, key) - 1;
 
                 /* is region not yet registered */
-                if ( regionId == NULL )
+                if ((*results)[regionId].tag == NULL)
                 {
-                    (*results)[currentRegion].tag = bstrcpy (threadResult->label);
-                    (*results)[currentRegion].groupID = threadResult->groupID;
-                    regionIds[currentRegion] = currentRegion;
-                    regionId = regionIds + currentRegion;
-                    g_hash_table_insert(regionLookup, g_strdup(key), (regionIds+currentRegion));
-                    currentRegion++;
+                    (*results)[regionId].tag = bstrcpy (threadResult->label);
+                    (*results)[regionId].groupID = threadResult->groupID;
                 }
 
-                (*results)[*regionId].count[threadId] = threadResult->count;
-                (*results)[*regionId].time[threadId] = threadResult->time;
-                (*results)[*regionId].cpulist[threadId] = threadResult->cpuID;
+                (*results)[regionId].count[threadId] = threadResult->count;
+                (*results)[regionId].time[threadId] = threadResult->time;
+                (*results)[regionId].exclusiveTime[threadId] = threadResult->exclusiveTime;
+                (*results)[regionId].cpulist[threadId] = threadResult->cpuID;
 
                 for ( int j=0; j < NUM_PMC; j++ )
                 {
-                    (*results)[*regionId].counters[threadId][j] = threadResult->PMcounters[j];
+                    (*results)[regionId].counters[threadId][j] = threadResult->PMcounters[j];
+                    (*results)[regionId].exclusiveCounters[threadId][j] = threadResult->ExclusivePMcounters[j];
                 }
             }
 
             threadId++;
         }
     }
+    g_hash_table_destroy(regionLookup);
 
     (*numThreads) = numberOfThreads;
     (*numRegions) = numberOfRegions;
 }
 
+/* Copies the results of a region consistently without blocking the thread
+ * that updates it. The copy is retried while the sequence counter shows a
+ * running or finished update. */
+static void copyThreadResults(LikwidThreadResults* entry, LikwidThreadResults* copy)
+{
+    uint32_t seq;
+    do
+    {
+        seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+        {
+            sched_yield();
+            continue;
+        }
+        copy->time = entry->time;
+        copy->exclusiveTime = entry->exclusiveTime;
+        copy->groupID = entry->groupID;
+        copy->cpuID = entry->cpuID;
+        copy->count = entry->count;
+        memcpy(copy->PMcounters, entry->PMcounters, NUM_PMC * sizeof(double));
+        memcpy(copy->ExclusivePMcounters, entry->ExclusivePMcounters, NUM_PMC * sizeof(double));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || (seq != __atomic_load_n(&entry->seq, __ATOMIC_RELAXED)));
+}
 
+void hashTable_snapshot(int* numThreads, int* numRegions, LikwidResults** results)
+{
+    uint32_t numberOfThreads = 0;
+    uint32_t numberOfRegions = 0;
+    LikwidThreadResults** heads;
+    LikwidThreadResults copy;
+    GHashTable* regionLookup;
+
+    heads = (LikwidThreadResults**) malloc(numberOfThreadSlots * sizeof(LikwidThreadResults*));
+    if (heads == NULL)
+    {
+        (*results) = NULL;
+        (*numThreads) = 0;
+        (*numRegions) = 0;
+        return;
+    }
+    /* Regions inserted after the heads are read are left for the next snapshot */
+    regionLookup = g_hash_table_new(g_str_hash, g_str_equal);
+    for (int i=0; i<numberOfThreadSlots; i++)
+    {
+        ThreadList* resPtr = __atomic_load_n(&threadList[i], __ATOMIC_ACQUIRE);
+        if (resPtr != NULL)
+        {
+            heads[numberOfThreads] = __atomic_load_n(&resPtr->regions, __ATOMIC_ACQUIRE);
+            for (LikwidThreadResults* entry = heads[numberOfThreads]; entry != NULL; entry = entry->next)
+            {
+                if (g_hash_table_lookup(regionLookup, bdata(entry->label)) == NULL)
+                {
+                    numberOfRegions++;
+                    g_hash_table_insert(regionLookup, bdata(entry->label), (gpointer)(uintptr_t) numberOfRegions);
+                }
+            }
+            numberOfThreads++;
+        }
+    }
+
+    (*results) = allocResults(numberOfRegions, numberOfThreads);
+    if ((*results) != NULL)
+    {
+        for (uint32_t t=0; t<numberOfThreads; t++)
+        {
+            for (LikwidThreadResults* entry = heads[t]; entry != NULL; entry = entry->next)
+            {
+                uint32_t r = (uintptr_t) g_hash_table_lookup(regionLookup, bdata(entry->label)) - 1;
+                copyThreadResults(entry, &copy);
+                if ((*results)[r].tag == NULL)
+                {
+                    (*results)[r].tag = bstrcpy(entry->label);
+                    (*results)[r].groupID = copy.groupID;
+                }
+                (*results)[r].count[t] = copy.count;
+                (*results)[r].time[t] = copy.time;
+                (*results)[r].exclusiveTime[t] = copy.exclusiveTime;
+                (*results)[r].cpulist[t] = copy.cpuID;
+                memcpy((*results)[r].counters[t], copy.PMcounters, NUM_PMC * sizeof(double));
+                memcpy((*results)[r].exclusiveCounters[t], copy.ExclusivePMcounters, NUM_PMC * sizeof(double));
+            }
+        }
+    }
+    g_hash_table_destroy(regionLookup);
+    free(heads);
+
+    (*numThreads) = numberOfThreads;
+    (*numRegions) = numberOfRegions;
+}
+
+void hashTable_freeResults(int numThreads, int numRegions, LikwidResults* results)
+{
+    if (results == NULL)
+    {
+        return;
+    }
+    for (int i=0;i<numRegions; i++)
+    {
+        for (int j=0;j<numThreads; j++)
+        {
+            free(results[i].counters[j]);
+            free(results[i].exclusiveCounters[j]);
+        }
+        free(results[i].time);
+        free(results[i].exclusiveTime);
+        bdestroy(results[i].tag);
+        free(results[i].count);
+        free(results[i].cpulist);
+        free(results[i].counters);
+        free(results[i].exclusiveCounters);
+    }
+    free(results);
+}
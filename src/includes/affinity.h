@@ -35,11 +35,11 @@
 #include <types.h>
 #include <likwid.h>
 
-int socket_lock[MAX_NUM_NODES];
-int tile_lock[MAX_NUM_THREADS];
+extern int* socket_lock;
+extern int* tile_lock;
 extern AffinityDomains affinityDomains;
 
-extern int affinity_core2node_lookup[MAX_NUM_THREADS];
+extern int* affinity_core2node_lookup;
 
 extern int affinity_processGetProcessorId();
 extern int affinity_threadGetProcessorId();
@@ -0,0 +1,50 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  agent_cgroup.h
+ *
+ *      Description:  Header File of the cgroup cpuset scanner of likwid-agent
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+
+#ifndef LIKWID_AGENT_CGROUP
+#define LIKWID_AGENT_CGROUP
+
+/* Default prefix of the cgroup directories of batch jobs (Slurm) */
+#define AGENT_JOB_PREFIX "job_"
+/* Maximal directory depth below the cgroup root that is searched for jobs */
+#define AGENT_JOB_MAXDEPTH 4
+
+typedef struct {
+    char* id;
+    int numCpus;
+    int* cpus;
+} AgentJob;
+
+extern int agent_cgroupScan(const char* root, const char* prefix, AgentJob** jobs);
+extern void agent_cgroupFree(int numJobs, AgentJob* jobs);
+extern int agent_cgroupParseCpus(const char* str, int** cpus);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  agent_export.h
+ *
+ *      Description:  Header File of the native output backends of likwid-agent
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+
+#ifndef LIKWID_AGENT_EXPORT
+#define LIKWID_AGENT_EXPORT
+
+#include <stdint.h>
+
+/* Default Ganglia channel, same as the default udp_send_channel of gmond */
+#define AGENT_GANGLIA_HOST "239.2.11.71"
+#define AGENT_GANGLIA_PORT 8649
+/* Maximal size of one Ganglia XDR packet */
+#define AGENT_GANGLIA_PACKET_SIZE 1464
+/* Maximal number of Ganglia messages sent in one batch */
+#define AGENT_MAX_METRICS 4096
+/* Maximal length of one syslog message, longer batches are split */
+#define AGENT_SYSLOG_MSG_SIZE 1024
+/* Maximal number of open time series files */
+#define AGENT_MAX_TSFILES 64
+/* Default capacity of the shared memory segment for the published metrics */
+#define AGENT_SHM_SIZE (4*1024*1024)
+#define AGENT_SHM_MAGIC "LIKWIDAG"
+#define AGENT_SHM_VERSION 1
+/* Timeout in ms for the endpoint thread and for client requests */
+#define AGENT_ENDPOINT_TIMEOUT 500
+
+typedef struct {
+    const char* name;
+    const char* unit;
+    double value;
+} AgentMetric;
+
+/* Layout of the shared memory segment. Readers copy the data and retry
+ * if seq was odd or changed during the copy. */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    volatile uint64_t seq;
+    uint64_t timestamp;
+    uint64_t capacity;
+    uint64_t length;
+} AgentShmHeader;
+
+extern int agent_gangliaOpen(const char* host, int port);
+extern int agent_gangliaSend(const char* group, int tmax, int sendMeta,
+                             int numMetrics, AgentMetric* metrics);
+extern void agent_gangliaClose(void);
+
+extern int agent_syslogOpen(const char* prio);
+extern int agent_syslogSend(const char* group, int numMetrics, AgentMetric* metrics);
+extern void agent_syslogClose(void);
+
+extern int agent_tsOpen(const char* filename, int numMetrics, AgentMetric* metrics);
+extern int agent_tsWrite(int handle, uint64_t timestamp, int numMetrics, AgentMetric* metrics);
+extern void agent_tsClose(int handle);
+
+extern int agent_endpointOpen(const char* spec, const char* group);
+extern void agent_endpointClose(void);
+extern int agent_shmOpen(const char* name, size_t size);
+extern void agent_shmClose(void);
+extern int agent_publish(const char* text, size_t len, uint64_t timestamp);
+extern int agent_shmRead(const char* name, char* buf, size_t size);
+
+#endif
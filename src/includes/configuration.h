@@ -36,9 +36,15 @@
 #include <error.h>
 
 
+/* Values of config.hwlocMode */
+#define HWLOC_MODE_LAZY 0
+#define HWLOC_MODE_ALWAYS 1
+
 extern Configuration config;
 extern int init_config;
 
+extern int config_useHwloc(void);
+
 
 
 
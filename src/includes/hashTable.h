@@ -40,6 +40,8 @@ extern void hashTable_init();
 void hashTable_initThread(int coreID);
 extern int hashTable_get(bstring regionTag, LikwidThreadResults** result);
 extern void hashTable_finalize(int* numberOfThreads, int* numberOfRegions, LikwidResults** results);
+extern void hashTable_snapshot(int* numberOfThreads, int* numberOfRegions, LikwidResults** results);
+extern void hashTable_freeResults(int numberOfThreads, int numberOfRegions, LikwidResults* results);
 
 
 #endif /*CPUID_H*/
@@ -33,25 +33,51 @@
 
 #include <bstrlib.h>
 
+/* Results of one call path of a region on one CPU. time and PMcounters are
+ * inclusive, recursive calls are only accounted once. The exclusive values
+ * leave out the time and counts of nested regions. seq is odd while the
+ * results are updated, see hashTable_snapshot. */
 typedef struct LikwidThreadResults{
     bstring  label;
+    struct LikwidThreadResults* next;
+    uint32_t seq;
     double time;
-    TimerData startTime;
+    double exclusiveTime;
     int groupID;
     int cpuID;
+    int active;
     uint32_t count;
-    double StartPMcounters[NUM_PMC];
-    int StartOverflows[NUM_PMC];
     double PMcounters[NUM_PMC];
+    double ExclusivePMcounters[NUM_PMC];
 } LikwidThreadResults;
 
+/* A started region on the region stack of a thread */
+typedef struct {
+    bstring tag;
+    bstring path;
+    LikwidThreadResults* results;
+    TimerData startTime;
+    double StartPMcounters[NUM_PMC];
+    int StartOverflows[NUM_PMC];
+    double childTime;
+    double ChildPMcounters[NUM_PMC];
+} LikwidRegionFrame;
+
+typedef struct {
+    int depth;
+    int size;
+    LikwidRegionFrame* frames;
+} LikwidRegionStack;
+
 typedef struct {
     bstring  tag;
     int groupID;
     double*  time;
+    double*  exclusiveTime;
     uint32_t*  count;
     int* cpulist;
     double** counters;
+    double** exclusiveCounters;
 } LikwidResults;
 
 #endif /*LIBPERFCTR_H*/
@@ -77,6 +77,10 @@ Shortcut for likwid_markerGetResults() for \a regionTag if compiled with -DLIKWI
 Shortcut for likwid_markerNextGroup() if compiled with -DLIKWID_PERFMON. Otherwise no operation is performed
 */
 /*!
+\def LIKWID_MARKER_FLUSH
+Shortcut for likwid_markerFlush() if compiled with -DLIKWID_PERFMON. Otherwise no operation is performed
+*/
+/*!
 \def LIKWID_MARKER_CLOSE
 Shortcut for likwid_markerClose() if compiled with -DLIKWID_PERFMON. Otherwise no operation is performed
 */
@@ -89,6 +93,7 @@ Shortcut for likwid_markerClose() if compiled with -DLIKWID_PERFMON. Otherwise n
 #define LIKWID_MARKER_REGISTER(regionTag) likwid_markerRegisterRegion(regionTag)
 #define LIKWID_MARKER_START(regionTag) likwid_markerStartRegion(regionTag)
 #define LIKWID_MARKER_STOP(regionTag) likwid_markerStopRegion(regionTag)
+#define LIKWID_MARKER_FLUSH likwid_markerFlush()
 #define LIKWID_MARKER_CLOSE likwid_markerClose()
 #define LIKWID_MARKER_GET(regionTag, nevents, events, time, count) likwid_markerGetRegion(regionTag, nevents, events, time, count)
 #else
@@ -98,6 +103,7 @@ Shortcut for likwid_markerClose() if compiled with -DLIKWID_PERFMON. Otherwise n
 #define LIKWID_MARKER_REGISTER(regionTag)
 #define LIKWID_MARKER_START(regionTag)
 #define LIKWID_MARKER_STOP(regionTag)
+#define LIKWID_MARKER_FLUSH
 #define LIKWID_MARKER_CLOSE
 #define LIKWID_MARKER_GET(regionTag, nevents, events, time, count)
 #endif
@@ -146,6 +152,16 @@ Must be called in serial region of the application. It gathers all data of regio
 writes them out to a file (filepath in env variable LIKWID_FILEPATH).
 */
 extern void likwid_markerClose(void) __attribute__ ((visibility ("default") ));
+/*! \brief Write a snapshot of all regions
+
+Can be called at any time while the regions are measured. It appends the current results of
+all regions and threads as a record to the stream file (filepath in env variable
+LIKWID_MARKER_STREAM) without stopping or blocking the measurements of other threads. If the
+env variable LIKWID_MARKER_INTERVAL is set, a background thread flushes with the given
+interval in seconds. likwid_markerClose() appends a final record.
+@return Error code, 0 if no stream file is configured
+*/
+extern int likwid_markerFlush(void) __attribute__ ((visibility ("default") ));
 /*! \brief Register a measurement region
 
 Initializes the hashTable entry in order to reduce execution time of likwid_markerStartRegion()
@@ -156,7 +172,9 @@ extern int likwid_markerRegisterRegion(const char* regionTag) __attribute__ ((vi
 /*! \brief Start a measurement region
 
 Reads the values of all configured counters and saves the results under the name given
-in regionTag.
+in regionTag. Regions can be nested, a region started inside another region is stored
+under its call path, e.g. "outer/inner". Starting a region that is already running on the
+thread (recursion) continues the measurement of the running region.
 @param regionTag [in] Store data using this string
 @return Error code of start operation
 */
@@ -165,6 +183,7 @@ extern int likwid_markerStartRegion(const char* regionTag) __attribute__ ((visib
 
 Reads the values of all configured counters and saves the results under the name given
 in regionTag. The measurement data of the stopped region gets summed up in global region counters.
+The counts of nested regions are subtracted from the exclusive counts of the enclosing region.
 @param regionTag [in] Store data using this string
 @return Error code of stop operation
 */
@@ -172,7 +191,8 @@ extern int likwid_markerStopRegion(const char* regionTag) __attribute__ ((visibi
 
 /*! \brief Get accumulated data of a code region
 
-Get the accumulated data of the current thread for the given regionTag.
+Get the accumulated data of the current thread for the given regionTag. Inside of a
+started region, the nested region with the given tag is returned.
 @param regionTag [in] Print data using this string
 @param nr_events [in,out] Length of events array
 @param events [out] Events array for the intermediate results
@@ -275,6 +295,8 @@ typedef struct {
     AccessMode daemonMode; /*!< \brief Access mode to the MSR and PCI registers */
     int maxNumThreads; /*!< \brief Maximum number of HW threads */
     int maxNumNodes; /*!< \brief Maximum number of NUMA nodes */
+    char* topologyCacheFileName; /*!< \brief Path to the binary topology cache or 'none' */
+    int hwlocMode; /*!< \brief Use hwloc for all detections (1) or only if the native backends fail (0) */
 } Configuration;
 
 /** \brief Pointer for exporting the Configuration data structure */
@@ -407,6 +429,11 @@ typedef CpuTopology* CpuTopology_t;
 /*! \brief Initialize topology information
 
 CpuInfo_t and CpuTopology_t are initialized by either HWLOC, CPUID/ProcFS or topology file if present. The topology file name can be configured in the configuration file. Furthermore, the paths /etc/likwid_topo.cfg and &lt;PREFIX&gt;/etc/likwid_topo.cfg are checked.
+If no topology file is present, the information is read from a binary topology cache
+that is written automatically after the first complete discovery of CPU and NUMA topology
+and validated against the online CPUs/nodes, microcode version and boot ID. The path
+defaults to /tmp/likwid-topo-&lt;UID&gt;.cache and can be changed with topology_cache
+in the configuration file or the environment variable LIKWID_TOPOCACHE ('none' disables the cache).
 \sa CpuInfo_t and CpuTopology_t
 @return always 0
 */
@@ -501,6 +528,29 @@ extern void numa_setInterleaved(int* processorList, int numberOfProcessors) __at
 @param [in] domainId ID of NUMA node for the allocation
 */
 extern void numa_membind(void* ptr, size_t size, int domainId) __attribute__ ((visibility ("default") ));
+/*! \brief Set memory allocation policy to interleaved over a set of NUMA nodes
+
+Set the memory allocation policy of the process to interleave the pages
+uniformly over the NUMA nodes in \a domainList
+@param [in] domainList List of NUMA domain indices in NumaTopology_t (not the OS node IDs)
+@param [in] numberOfDomains Length of node list
+@return 0 or error code
+*/
+extern int numa_setInterleavedDomains(int* domainList, int numberOfDomains) __attribute__ ((visibility ("default") ));
+/*! \brief Interleave a memory range over NUMA nodes with weights
+
+The range is split in chunks of at least 2 MB that prefer the NUMA nodes in
+\a domainList, each node gets as many consecutive chunks as its weight before
+the next node follows. Pages that are already allocated are migrated. If a
+node runs out of memory, the pages are allocated on other nodes.
+@param [in] ptr Start pointer of memory
+@param [in] size Size of the memory range
+@param [in] domainList List of NUMA domain indices in NumaTopology_t (not the OS node IDs)
+@param [in] weights Weight of each node in \a domainList
+@param [in] numberOfDomains Length of node and weight list
+@return 0 or error code
+*/
+extern int numa_interleaveWeighted(void* ptr, size_t size, int* domainList, int* weights, int numberOfDomains) __attribute__ ((visibility ("default") ));
 /*! \brief Destroy NUMA information structure
 
 Destroys the NUMA information structure NumaTopology_t. Retrieved pointers
@@ -532,7 +582,7 @@ The AffinityDomain data structure describes a single domain in the current syste
 \extends AffinityDomains
 */
 typedef struct {
-    bstring tag; /*!< \brief Bstring with the ID for the affinity domain. Currently possible values: N (node), SX (socket/package X), CX (LLC cache domain X) and MX (memory domain X) */
+    bstring tag; /*!< \brief Bstring with the ID for the affinity domain. Currently possible values: N (node), SX (socket/package X), CX (LLC cache domain X), MX (memory domain X), TX (L2 cache tile X) and PX (physical core X) */
     uint32_t numberOfProcessors; /*!< \brief Number of HW threads in the domain and length of \a processorList */
     uint32_t numberOfCores; /*!< \brief Number of CPU cores in the domain */
     int*  processorList; /*!< \brief List of HW thread IDs in the domain */
@@ -556,6 +606,9 @@ typedef struct {
     uint32_t numberOfProcessorsPerCache; /*!< \brief Number of CPU cores per LLC cache in the system */
     uint32_t numberOfAffinityDomains; /*!< \brief Number of affinity domains in the current system  and length of \a domains array */
     AffinityDomain* domains; /*!< \brief List of all domains in the system */
+    uint32_t numberOfTileDomains; /*!< \brief Number of L2 cache tiles in the system */
+    uint32_t numberOfCoresPerTile; /*!< \brief Number of CPU cores sharing a L2 cache */
+    uint32_t numberOfCoreDomains; /*!< \brief Number of physical CPU cores in the system */
 } AffinityDomains;
 
 /** \brief Pointer for exporting the AffinityDomains data structure */
@@ -737,6 +790,56 @@ counters and start the counters.
 @return 0 on success and -(thread_id+1) for error
 */
 extern int perfmon_switchActiveGroup(int new_group) __attribute__ ((visibility ("default") ));
+/*! \brief Set the interval of the periodic overflow poller
+
+Counter overflows are detected when a counter is read and its value is smaller
+than at the previous read. If a counter wraps more than once between two reads,
+overflows are lost. With overflow polling enabled, one thread per socket reads
+the counters periodically while an event set is running, so that long measurements
+stay exact also for narrow (uncore) counters. The interval applies to the next
+start of the counters. The environment variable LIKWID_OVERFLOW_POLL sets the
+interval at perfmon_init() ('auto', 'off' or a time in s, ms or us).
+@param [in] interval Poll interval in microseconds, 0 disables polling and a negative
+value determines the interval from the counter widths and the CPU clock
+@return 0 on success, -EBUSY if the poller is currently running
+*/
+extern int perfmon_setOverflowPolling(int64_t interval) __attribute__ ((visibility ("default") ));
+/*! \brief Aggregated samples of a symbol
+
+Result entry of the sampling mode, see perfmon_startSampling()
+*/
+typedef struct {
+    char*       symbol; /*!< \brief Name of the function or [unknown] */
+    char*       module; /*!< \brief Executable or library containing the symbol, process name if unresolved */
+    uint64_t    count; /*!< \brief Number of samples attributed to the symbol */
+} PerfmonSampleSymbol;
+/*! \brief Start sampling of instruction pointers
+
+Programs the first core-local event (PMC, otherwise fixed counter) of the event set
+in overflow mode through perf_event on all CPUs given at perfmon_init(). Every
+\a period events the instruction pointer is recorded. The sampling replaces
+counting, the event set must not be set up or started at the same time. Requires
+root privileges or /proc/sys/kernel/perf_event_paranoid <= 0.
+@param [in] groupId ID of the event set containing the sampled event
+@param [in] period Number of events between two samples
+@return Index of the sampled event in the event set or negative error number
+*/
+extern int perfmon_startSampling(int groupId, uint64_t period) __attribute__ ((visibility ("default") ));
+/*! \brief Stop sampling and aggregate the samples by symbol
+
+@return 0 on success, negative error number otherwise
+*/
+extern int perfmon_stopSampling(void) __attribute__ ((visibility ("default") ));
+/*! \brief Get the results of the last sampling run
+
+The list is sorted by descending sample count and stays valid until the next
+perfmon_startSampling() or perfmon_finalize().
+@param [out] symbols List of symbols with their sample counts
+@param [out] samples Total number of samples
+@param [out] lost Number of samples lost because a ring buffer was full
+@return Number of entries in \a symbols
+*/
+extern int perfmon_getSamplingResults(PerfmonSampleSymbol** symbols, uint64_t* samples, uint64_t* lost) __attribute__ ((visibility ("default") ));
 /*! \brief Close the perfomance monitoring facility of LIKWID
 
 Deallocates all internal data that is used during performance monitoring. Also
@@ -753,6 +856,18 @@ overflows and if the counter values need to be calculated with multipliers.
 @return The counter result
 */
 extern double perfmon_getResult(int groupId, int eventId, int threadId) __attribute__ ((visibility ("default") ));
+/*! \brief Get the counter difference between the last two reads
+
+Every perfmon_readCounters() and the final read in perfmon_stopCounters() store
+the counter values since start. This function returns the difference to the
+previous read (or to the start), so running counters can be evaluated in
+intervals without stopping them. Thermal counters return the last value.
+@param [in] groupId ID of the group that should be read
+@param [in] eventId ID of the event that should be read
+@param [in] threadId ID of the thread/cpu that should be read
+@return The counter result of the last interval
+*/
+extern double perfmon_getLastResult(int groupId, int eventId, int threadId) __attribute__ ((visibility ("default") ));
 /*! \brief Get the number of configured event groups
 
 @return Number of groups
@@ -770,6 +885,12 @@ extern int perfmon_getNumberOfEvents(int groupId) __attribute__ ((visibility ("d
 @return Time in seconds the event group was measured
 */
 extern double perfmon_getTimeOfGroup(int groupId) __attribute__ ((visibility ("default") ));
+/*! \brief Get the time between the last two reads of a group
+
+@param [in] groupId ID of group
+@return Time in seconds between the last two reads of all threads (or between start and the first read)
+*/
+extern double perfmon_getLastTimeOfGroup(int groupId) __attribute__ ((visibility ("default") ));
 /*! \brief Get the ID of the currently set up event group
 
 @return Number of active group
@@ -781,6 +902,65 @@ extern int perfmon_getIdOfActiveGroup(void) __attribute__ ((visibility ("default
 */
 extern int perfmon_getNumberOfThreads(void) __attribute__ ((visibility ("default") ));
 
+/*! \brief Scopes for the aggregation of per-thread results
+*/
+typedef enum {
+    AGGREGATE_SOCKET = 0, /*!< \brief One aggregate per CPU socket */
+    AGGREGATE_NUMA, /*!< \brief One aggregate per NUMA domain */
+    AGGREGATE_NODE, /*!< \brief One aggregate over all threads */
+    NUM_AGGREGATE_SCOPES
+} AggregateScope;
+/*! \brief Aggregated result of one domain
+
+Core counters are aggregated over the threads of a domain. Uncore counters are
+only read by one thread per socket, so they are first summed up per socket and
+then aggregated over the sockets of a domain.
+*/
+typedef struct {
+    int domain; /*!< \brief ID of the socket or NUMA domain, 0 for the node */
+    int count; /*!< \brief Number of aggregated threads (core) or sockets (uncore) */
+    double sum; /*!< \brief Sum of all values */
+    double min; /*!< \brief Minimal value */
+    double max; /*!< \brief Maximal value */
+    double avg; /*!< \brief Average value */
+} AggregateResult;
+/*! \brief Check whether a counter register is counting per socket
+
+@param [in] counter Name of the counter register, e.g. MBOX0C0
+@return 1 for uncore (and power) counters, 0 for core-local counters
+*/
+extern int perfmon_isUncoreCounter(const char* counter) __attribute__ ((visibility ("default") ));
+/*! \brief Get the number of domains of an aggregation scope
+
+Only domains containing at least one thread given at perfmon_init() are counted.
+@param [in] scope Aggregation scope
+@return Number of domains or negative error number
+*/
+extern int perfmon_getNumberOfAggregates(AggregateScope scope) __attribute__ ((visibility ("default") ));
+/*! \brief Aggregate all events of a group
+
+@param [in] groupId ID of the group
+@param [in] scope Aggregation scope
+@param [in] last Aggregate perfmon_getLastResult() instead of perfmon_getResult()
+@param [out] results Results of each event and domain, event-major with
+perfmon_getNumberOfAggregates() entries per event
+@return Number of domains or negative error number
+*/
+extern int perfmon_aggregateGroup(int groupId, AggregateScope scope, int last, AggregateResult* results) __attribute__ ((visibility ("default") ));
+/*! \brief Aggregate per-thread values, e.g. derived metrics or marker results
+
+@param [in] numCpus Number of CPUs in \a cpus and \a values
+@param [in] cpus List of CPU IDs
+@param [in] values Value of each CPU
+@param [in] uncore Values are read per socket (see perfmon_isUncoreCounter())
+@param [in] scope Aggregation scope
+@param [out] results Result of each domain, NULL to query the number of domains
+@param [in] maxResults Length of \a results
+@return Number of domains or negative error number
+*/
+extern int perfmon_aggregateValues(int numCpus, const int* cpus, const double* values, int uncore,
+                                   AggregateScope scope, AggregateResult* results, int maxResults) __attribute__ ((visibility ("default") ));
+
 
 /*! \brief Set verbosity of LIKWID library
 
@@ -815,6 +995,11 @@ typedef struct {
 } TimerData;
 
 /*! \brief Initialize timer by retrieving baseline frequency and cpu clock
+
+If the CPU provides an invariant TSC and the RDTSCP instruction, the timer uses
+LFENCE/RDTSCP instead of the serializing CPUID instruction and the clock is taken
+from the kernel, CPUID leaf 0x15 or a short calibration. Set the environment
+variable LIKWID_TIMER_CPUID to use the CPUID based timer anyway.
 */
 extern void timer_init( void ) __attribute__ ((visibility ("default") ));
 /*! \brief Return the measured interval in seconds
@@ -1109,6 +1294,24 @@ Sweeps (zeros) the memory of NUMA node with ID \a domainId
 @param [in] domainId NUMA node ID
 */
 extern void memsweep_domain(int domainId) __attribute__ ((visibility ("default") ));
+/*! \brief Sweeping the memory of multiple NUMA nodes
+
+Sweeps (zeros) the memory of all NUMA nodes in \a domainList concurrently
+@param [in] domainList List of NUMA node IDs
+@param [in] numberOfDomains Number of NUMA nodes in list
+*/
+extern void memsweep_domainList(int* domainList, int numberOfDomains) __attribute__ ((visibility ("default") ));
+/*! \brief Reclaiming the memory of multiple NUMA nodes
+
+Drops the page cache and compacts the memory of all NUMA nodes in \a domainList
+and prints the free memory of each node before and after. If the page cache
+cannot be dropped (e.g. missing permissions), the nodes are swept like with
+memsweep_domainList()
+@param [in] domainList List of NUMA node IDs
+@param [in] numberOfDomains Number of NUMA nodes in list
+@return 0 if the page cache was dropped or the nodes were swept, error code otherwise
+*/
+extern int memsweep_reclaimDomains(int* domainList, int numberOfDomains) __attribute__ ((visibility ("default") ));
 /*! \brief Sweeping the memory of all NUMA nodes covered by CPU list
 
 Sweeps (zeros) the memory of all NUMA nodes containing the CPUs in \a processorList
@@ -0,0 +1,97 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  markerfile.h
+ *
+ *      Description:  Header File of the binary Marker API result file
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+#ifndef LIKWID_MARKERFILE
+#define LIKWID_MARKERFILE
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <types.h>
+
+#define MARKER_MAGIC "LIKWIDMF"
+#define MARKER_VERSION 3
+/* Maximal number of concurrently opened marker files */
+#define MARKER_MAX_FILES 16
+
+/* Record header, followed by numRegions region entries, the string table
+ * with the NUL-terminated region tags and the data of each region. All
+ * offsets are counted from the start of the record. A marker file holds
+ * one record, a stream file the records appended by every flush. */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t numThreads;
+    uint32_t numRegions;
+    uint32_t numGroups;
+    uint64_t stringOffset;
+    uint64_t stringSize;
+    uint64_t recordSize;
+    double timestamp;
+} MarkerHeader;
+
+/* The data of a region is 8 byte aligned and contains the arrays
+ * int32_t cpus[numThreads] (padded to 8 bytes), uint64_t count[numThreads],
+ * double time[numThreads], double counters[numThreads][numEvents],
+ * double exclusiveTime[numThreads] and
+ * double exclusiveCounters[numThreads][numEvents]. The tag of a nested
+ * region is its call path, the tags of the enclosing regions joined by '/'. */
+typedef struct {
+    uint64_t tagOffset;
+    uint64_t dataOffset;
+    int32_t groupId;
+    uint32_t numEvents;
+} MarkerRegion;
+
+/* Pointers into the mapped data of a region */
+typedef struct {
+    const char* tag;
+    int groupId;
+    int numEvents;
+    const int32_t* cpus;
+    const uint64_t* count;
+    const double* time;
+    const double* counters;
+    const double* exclusiveTime;
+    const double* exclusiveCounters;
+} MarkerFileRegion;
+
+extern int markerfile_write(const char* filename, int numThreads, int numRegions,
+                            int numGroups, LikwidResults* results, const int* numEvents);
+extern int markerfile_append(const char* filename, double timestamp, int numThreads, int numRegions,
+                             int numGroups, LikwidResults* results, const int* numEvents);
+extern int markerfile_open(const char* filename);
+extern int markerfile_openRecord(const char* filename, int record);
+extern int markerfile_getInfo(int handle, int* numThreads, int* numRegions, int* numGroups);
+extern int markerfile_getRecordInfo(int handle, int* record, int* numRecords, double* timestamp);
+extern int markerfile_getRegion(int handle, int region, MarkerFileRegion* data);
+extern void markerfile_close(int handle);
+
+#endif
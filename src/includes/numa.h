@@ -49,6 +49,8 @@ struct numa_functions {
     int (*numa_init) (void);
     void (*numa_setInterleaved) (int*, int);
     void (*numa_membind) (void*, size_t, int);
+    int (*numa_setInterleavedDomains) (int*, int);
+    int (*numa_interleaveWeighted) (void*, size_t, int*, int*, int);
 };
 
 
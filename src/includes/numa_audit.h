@@ -0,0 +1,66 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  numa_audit.h
+ *
+ *      Description:  Header File of the NUMA page placement auditor
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+
+#ifndef LIKWID_NUMA_AUDIT
+#define LIKWID_NUMA_AUDIT
+
+#include <stdint.h>
+
+/* Pages per move_pages call when migrating */
+#define AUDIT_BATCH 1024
+/* Maximal number of threads migrating pages */
+#define AUDIT_MAX_THREADS 16
+
+/* One mapping of the process. pages holds the number of pages on each
+ * NUMA domain (index in numa_info.nodes) */
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    char* name;
+    char* policy;
+    uint64_t pageSize;
+    uint64_t* pages;
+} AuditMapping;
+
+/* All mappings of a process, memory holds the bytes on each NUMA domain */
+typedef struct {
+    int pid;
+    int numDomains;
+    int numMappings;
+    AuditMapping* mappings;
+    uint64_t* memory;
+} AuditProcess;
+
+extern int numa_auditProcess(int pid, AuditProcess* audit);
+extern int numa_auditMigrate(AuditProcess* audit, int domainId, int numThreads, uint64_t* moved);
+extern void numa_auditFree(AuditProcess* audit);
+
+#endif
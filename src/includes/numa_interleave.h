@@ -0,0 +1,131 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  numa_interleave.h
+ *
+ *      Description:  Weighted interleaving of memory ranges by chunked mbind.
+ *                    Used by the NUMA module and the pthread wrapper library.
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+
+#ifndef LIKWID_NUMA_INTERLEAVE
+#define LIKWID_NUMA_INTERLEAVE
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#ifdef HAS_MEMPOLICY
+#include <linux/mempolicy.h>
+#endif
+
+/* Minimal size of the chunks that prefer one node, a node with weight w gets
+ * w consecutive chunks per round */
+#define NUMA_INTERLEAVE_CHUNK (2*1024*1024UL)
+/* Every chunk is a separate VMA, larger ranges use larger chunks to stay
+ * far below vm.max_map_count */
+#define NUMA_INTERLEAVE_MAXCHUNKS 1024
+/* The pthread wrapper applies the weights only to anonymous mappings of at
+ * least this size, smaller ones follow the process policy */
+#define NUMA_INTERLEAVE_MINSIZE (64*1024*1024UL)
+/* Number of nodes that fit in the node mask */
+#define NUMA_INTERLEAVE_MAXNODES (8*sizeof(unsigned long))
+
+/* Places [ptr, ptr+size) in chunks on the given OS node IDs according to
+ * their weights. The chunks only prefer their node, so memory pressure on
+ * one node spills to the others instead of invoking the OOM killer. Pages
+ * that are already present are only moved if flags contains MPOL_MF_MOVE.
+ * Returns 0 or -errno of the failing mbind, the range is then reset to the
+ * default policy */
+static inline int
+numa_mbindWeighted(void* ptr, size_t size, int* nodes, int* weights, int count, unsigned int flags)
+{
+#ifdef HAS_MEMPOLICY
+    int node = 0;
+    int round = 0;
+    uintptr_t pagesize = sysconf(_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)ptr) & ~(pagesize - 1);
+    uintptr_t first = start;
+    uintptr_t end = (uintptr_t)ptr + size;
+    uintptr_t chunk = NUMA_INTERLEAVE_CHUNK;
+
+    while ((end - start) / chunk > NUMA_INTERLEAVE_MAXCHUNKS)
+    {
+        chunk *= 2;
+    }
+
+    if (count <= 0)
+    {
+        return -EINVAL;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if ((nodes[i] < 0) || (nodes[i] >= (int)NUMA_INTERLEAVE_MAXNODES) || (weights[i] < 0))
+        {
+            return -EINVAL;
+        }
+    }
+    while (start < end)
+    {
+        unsigned long mask;
+        uintptr_t len;
+        /* Skip nodes without weight, at least one has to be left */
+        for (int i = 0; (weights[node] == 0) && (i < count); i++)
+        {
+            node = (node + 1) % count;
+            round = 0;
+        }
+        if (weights[node] == 0)
+        {
+            return -EINVAL;
+        }
+        mask = 1UL << nodes[node];
+        len = chunk;
+        if (len > end - start)
+        {
+            len = end - start;
+        }
+        if (syscall(SYS_mbind, start, len, MPOL_PREFERRED, &mask, NUMA_INTERLEAVE_MAXNODES+1, flags) < 0)
+        {
+            int ret = -errno;
+            /* Do not leave a partially placed range */
+            syscall(SYS_mbind, first, end - first, MPOL_DEFAULT, NULL, 0, 0);
+            return ret;
+        }
+        start += len;
+        if (++round >= weights[node])
+        {
+            node = (node + 1) % count;
+            round = 0;
+        }
+    }
+    return 0;
+#else
+    return -ENOSYS;
+#endif
+}
+
+#endif
@@ -32,8 +32,11 @@
 #define LIKWID_NUMA_PROC
 
 extern int proc_numa_init(void);
+extern void nodeMeminfo(int node, uint64_t* totalMemory, uint64_t* freeMemory);
 extern void proc_numa_membind(void* ptr, size_t size, int domainId);
 extern void proc_numa_setInterleaved(int* processorList, int numberOfProcessors);
+extern int proc_numa_setInterleavedDomains(int* domainList, int numberOfDomains);
+extern int proc_numa_interleaveWeighted(void* ptr, size_t size, int* domainList, int* weights, int numberOfDomains);
 
 
 #endif
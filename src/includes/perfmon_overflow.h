@@ -0,0 +1,51 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  perfmon_overflow.h
+ *
+ *      Description:  Header File of the periodic counter overflow poller
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+#ifndef LIKWID_PERFMON_OVERFLOW
+#define LIKWID_PERFMON_OVERFLOW
+
+#include <stdint.h>
+
+/* Lower and upper bound of the automatically determined poll interval in us */
+#define OVERFLOW_POLL_MIN 1000
+#define OVERFLOW_POLL_MAX 10000000
+/* Assumed upper bound of counter increments per cycle for the automatic
+ * poll interval */
+#define OVERFLOW_POLL_INCS_PER_CYCLE 8
+
+extern int perfmon_overflowInit(int numThreads);
+extern void perfmon_overflowFinalize(void);
+extern int perfmon_overflowStart(int groupId);
+extern void perfmon_overflowStop(void);
+extern void perfmon_overflowLockThread(int thread_id);
+extern void perfmon_overflowUnlockThread(int thread_id);
+extern int64_t perfmon_overflowParseInterval(const char* str);
+
+#endif
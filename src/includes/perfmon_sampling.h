@@ -0,0 +1,75 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  perfmon_sampling.h
+ *
+ *      Description:  Header File of the perf_event based sampling module
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+#ifndef LIKWID_PERFMON_SAMPLING
+#define LIKWID_PERFMON_SAMPLING
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* Number of data pages of the ring buffer per CPU, must be a power of 2 */
+#define SAMPLING_DATA_PAGES 128
+/* Timeout in ms of the collector thread if no buffer reaches its watermark */
+#define SAMPLING_POLL_TIMEOUT 100
+/* Initial size of the per CPU sample tables, must be a power of 2 */
+#define SAMPLING_TABLE_SIZE 4096
+
+/* Aggregated sample count of one instruction pointer of one process */
+typedef struct {
+    uint64_t ip;
+    pid_t pid;
+    uint64_t count;
+} SampleEntry;
+
+/* Executable mapping of a process, taken from PERF_RECORD_MMAP or /proc/<pid>/maps */
+typedef struct {
+    pid_t pid;
+    uint64_t start;
+    uint64_t len;
+    uint64_t pgoff;
+    char* filename;
+} SampleMapping;
+
+/* Ring buffer and sample table of one measured CPU */
+typedef struct {
+    int cpu;
+    int fd;
+    void* base;
+    size_t mapSize;
+    uint64_t samples;
+    uint64_t lost;
+    SampleEntry* table;
+    size_t tableSize;
+    size_t tableUsed;
+} SampleBuffer;
+
+extern void perfmon_finalizeSampling(void);
+
+#endif
@@ -173,6 +173,23 @@ typedef struct {
     PerfmonEventOption options[NUM_EVENT_OPTIONS]; /*!< \brief List of options */
 } PerfmonEvent;
 
+/*! \brief Perfect hash table for the event list of an architecture
+
+The table is generated at build time from the event files. The bucket of an
+event name selects the displacement that is used as seed for the second hash
+which points to a slot. A slot holds the index of the first event with that
+name in the event list, further events with the same name but different
+counter limits are chained through \a next.
+\extends PerfmonEvent
+*/
+typedef struct {
+    int             numBuckets; /*!< \brief Number of buckets */
+    int             numSlots; /*!< \brief Number of slots */
+    uint32_t*       displacement; /*!< \brief Seed of the slot hash for each bucket, 0 for empty buckets */
+    int*            slots; /*!< \brief Index of the first event for each slot, -1 for empty slots */
+    int*            next; /*!< \brief Index of the next event with the same name, -1 at the end */
+} PerfmonEventHash;
+
 /*! \brief Structure describing performance monitoring counter data
 
 Each event holds one of these structures for each thread to store the counter
@@ -186,6 +203,8 @@ typedef struct {
     uint64_t    startData; /*!< \brief Start data from the counter */
     uint64_t    counterData; /*!< \brief Intermediate data from the counters */
     double      fullData; /*!< \brief Aggregated data from the counters */
+    double      snapshot; /*!< \brief Result since start at the last read */
+    double      lastResult; /*!< \brief Difference between the last two reads */
 } PerfmonCounter;
 
 
@@ -212,6 +231,8 @@ typedef struct {
     TimerData             timer; /*!< \brief Time information how long the counters were running */
     double                rdtscTime; /*!< \brief Evaluation of the Time information in seconds */
     double                runTime; /*!< \brief Sum of all time information in seconds that the group was running */
+    double                snapshotTime; /*!< \brief Time in seconds since start at the last read */
+    double                lastTime; /*!< \brief Time in seconds between the last two reads */
     __uint128_t           regTypeMask; /*!< \brief Bitmask for easy checks which types are included in the eventSet */
     GroupState            state; /*!< \brief Current state of the event group (configured, started, none) */
 } PerfmonEventSet;
@@ -240,6 +261,9 @@ are defined as a box. */
 extern BoxMap* box_map;
 /** \brief List of events available for the current architecture */
 extern PerfmonEvent* eventHash;
+/** \brief Perfect hash over the event names of the current architecture,
+generated at build time by perl/gen_events.pl */
+extern PerfmonEventHash* eventLookup;
 /** \brief List of PCI devices available for the current architecture */
 extern PciDevice* pci_devices;
 /** @}*/
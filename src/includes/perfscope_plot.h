@@ -0,0 +1,54 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  perfscope_plot.h
+ *
+ *      Description:  Header File of the binary gnuplot stream of likwid-perfscope
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+#ifndef LIKWID_PERFSCOPE_PLOT
+#define LIKWID_PERFSCOPE_PLOT
+
+/* Maximal number of open plot streams */
+#define PLOT_MAX_STREAMS 16
+/* Maximal number of curves in one plot */
+#define PLOT_MAX_SERIES 64
+/* Initial number of samples of unbounded streams */
+#define PLOT_INITIAL_SAMPLES 1024
+
+/* One curve of a plot */
+typedef struct {
+    const char* title;
+    int y2;
+} PlotSeries;
+
+extern int plot_open(const char* command, int numSeries, PlotSeries* series, int capacity);
+extern int plot_record(int handle, const char* filename);
+extern int plot_command(int handle, const char* text);
+extern int plot_add(int handle, double time, int numValues, double* values);
+extern int plot_frame(int handle, double xmin);
+extern void plot_close(int handle);
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  result_record.h
+ *
+ *      Description:  Header File of the binary result records of likwid-mpirun
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+#ifndef LIKWID_RESULT_RECORD
+#define LIKWID_RESULT_RECORD
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RECORD_MAGIC "LIKWIDRR"
+#define RECORD_VERSION 1
+/* Maximal number of threads loading and reducing records */
+#define RECORD_MAX_THREADS 16
+
+/* File header, followed by numRanks rank entries and numNodes node scopes.
+ * Each entry is prefixed by its size as uint64_t. */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t numRanks;
+    uint32_t numNodes;
+    uint32_t reserved;
+} RecordHeader;
+
+/* Mergeable statistics of one value over a set of CPUs */
+typedef struct {
+    double count;
+    double min;
+    double max;
+    double sum;
+} RecordStat;
+
+/* Results of one group (and marker region) of one rank. region is an empty
+ * string for measurements without marker API. values holds numEvents rows
+ * of numCpus values */
+typedef struct {
+    char* region;
+    int group;
+    int numEvents;
+    double* time;
+    double* calls;
+    double* values;
+} RecordSection;
+
+typedef struct {
+    int rank;
+    char* hostname;
+    double clock;
+    int numCpus;
+    int* cpus;
+    int numSections;
+    RecordSection* sections;
+} RecordRank;
+
+typedef struct {
+    char* region;
+    int group;
+    int numEvents;
+    RecordStat time;
+    RecordStat calls;
+    RecordStat* events;
+} RecordStatSection;
+
+/* Statistics of a set of ranks, a node or all nodes (hostname is NULL) */
+typedef struct {
+    char* hostname;
+    int numRanks;
+    int numCpus;
+    int numSections;
+    RecordStatSection* sections;
+} RecordScope;
+
+/* A merged record. The rank entries are kept encoded and point into the
+ * mapped input files, merging only moves the pointers. */
+typedef struct {
+    int numRanks;
+    int rankSize;
+    const char** rankData;
+    size_t* rankLength;
+    int numNodes;
+    RecordScope* nodes;
+    int numMaps;
+    void** maps;
+    size_t* mapLength;
+} ResultRecord;
+
+extern int record_writeRank(const char* filename, RecordRank* rank);
+extern int record_decodeRank(const char* data, size_t length, RecordRank* rank);
+extern void record_freeRank(RecordRank* rank);
+extern int record_rankScope(RecordRank* rank, RecordScope* scope);
+extern int record_mergeScope(RecordScope* dest, RecordScope* src);
+extern void record_freeScope(RecordScope* scope);
+extern int record_merge(int numFiles, const char** files, ResultRecord** record);
+extern int record_write(const char* filename, ResultRecord* record);
+extern void record_free(ResultRecord* record);
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  topology_cache.h
+ *
+ *      Description:  Header File of the binary topology cache
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+#ifndef LIKWID_TOPOLOGY_CACHE
+#define LIKWID_TOPOLOGY_CACHE
+
+#include <stdint.h>
+
+#define TOPOCACHE_MAGIC "LIKWIDTC"
+#define TOPOCACHE_VERSION 1
+
+/* Set by topology_init() if the topology was discovered for the whole system
+ * and the cache should be written as soon as the NUMA information is complete */
+extern int topocache_pending;
+/* Set by topology_cacheRead() if cpuid_info, cpuid_topology and numa_info
+ * were filled from the cache file */
+extern int topocache_loaded;
+
+extern int topology_cacheRead(void);
+extern int topology_cacheWrite(void);
+
+#endif
@@ -36,7 +36,7 @@
 
 void cpuid_init_cpuInfo(cpu_set_t cpuSet);
 void cpuid_init_cpuFeatures(void);
-void cpuid_init_nodeTopology(cpu_set_t cpuSet);
+int cpuid_init_nodeTopology(cpu_set_t cpuSet);
 void cpuid_init_cacheTopology(void);
 
 
@@ -44,7 +44,7 @@ int likwid_hwloc_record_objs_of_type_below_obj(hwloc_topology_t t, hwloc_obj_t o
 
 void hwloc_init_cpuInfo(cpu_set_t cpuSet);
 void hwloc_init_cpuFeatures(void);
-void hwloc_init_nodeTopology(cpu_set_t cpuSet);
+int hwloc_init_nodeTopology(cpu_set_t cpuSet);
 void hwloc_init_cacheTopology(void);
 
 
@@ -44,7 +44,7 @@
 
 void proc_init_cpuInfo(cpu_set_t cpuSet);
 void proc_init_cpuFeatures(void);
-void proc_init_nodeTopology(cpu_set_t cpuSet);
+int proc_init_nodeTopology(cpu_set_t cpuSet);
 void proc_init_cacheTopology(void);
 
 
@@ -74,6 +74,11 @@ typedef struct {
 #define STRINGIFY(x) #x
 #define TOSTRING(x) STRINGIFY(x)
 
+/* Per-CPU entries that are written at runtime are aligned to full cachelines
+ * so that the entries of different CPUs never share a line */
+#define CACHELINE_SIZE 64
+#define CACHELINE_ALIGNED __attribute__ ((aligned (CACHELINE_SIZE)))
+
 #define likely(x)       __builtin_expect(!!(x), 1)
 #define unlikely(x)     __builtin_expect(!!(x), 0)
 
@@ -33,6 +33,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/wait.h>
@@ -40,6 +41,8 @@
 #include <sched.h>
 #include <pthread.h>
 #include <inttypes.h>
+#include <dlfcn.h>
+#include <time.h>
 
 #include <likwid.h>
 #include <bitUtil.h>
@@ -52,21 +55,37 @@
 #include <access.h>
 
 #include <perfmon.h>
+#include <markerfile.h>
+
+/* #####   LOCAL TYPE DEFINITIONS   ####################################### */
+
+/* Lock of a CPU for threads sharing the CPU, padded to a full cacheline */
+typedef struct {
+    pthread_mutex_t lock;
+} CACHELINE_ALIGNED ThreadLock;
 
 /* #####   VARIABLES  -  LOCAL TO THIS SOURCE FILE   ###################### */
 
-int socket_lock[MAX_NUM_NODES];
 static int likwid_init = 0;
 static int numberOfGroups = 0;
 static int* groups;
-static int threads2Cpu[MAX_NUM_THREADS];
-static pthread_t threads2Pthread[MAX_NUM_THREADS];
-static int realThreads2Cpu[MAX_NUM_THREADS] = { [ 0 ... (MAX_NUM_THREADS-1)] = -1};
+static int* threads2Cpu = NULL;
 static int num_cpus = 0;
 static int registered_cpus = 0;
 static pthread_mutex_t globalLock = PTHREAD_MUTEX_INITIALIZER;
 static int use_locks = 0;
-static pthread_mutex_t threadLocks[MAX_NUM_THREADS] = { [ 0 ... (MAX_NUM_THREADS-1)] = PTHREAD_MUTEX_INITIALIZER};
+static ThreadLock* threadLocks = NULL;
+static int num_threadLocks = 0;
+static pthread_key_t regionStackKey;
+static pthread_once_t regionStackOnce = PTHREAD_ONCE_INIT;
+static char* stream_file = NULL;
+static double flush_interval = 0.0;
+static int flush_running = 0;
+static int flush_stop = 0;
+static pthread_t flush_thread;
+static pthread_mutex_t flushLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t flushThreadLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flushThreadCond = PTHREAD_COND_INITIALIZER;
 
 /* #####   MACROS  -  LOCAL TO THIS SOURCE FILE   ######################### */
 
@@ -79,7 +98,7 @@ static int getProcessorID(cpu_set_t* cpu_set)
 {
     int processorId;
 
-    for (processorId=0;processorId<MAX_NUM_THREADS;processorId++)
+    for (processorId=0;processorId<CPU_SETSIZE;processorId++)
     {
         if (CPU_ISSET(processorId,cpu_set))
         {
@@ -128,6 +147,162 @@ calculateMarkerResult(RegisterIndex index, uint64_t start, uint64_t stop, int ov
     return result;
 }
 
+static void
+freeRegionStack(void* ptr)
+{
+    LikwidRegionStack* stack = (LikwidRegionStack*) ptr;
+    for (int i=0; i<stack->depth; i++)
+    {
+        bdestroy(stack->frames[i].tag);
+        bdestroy(stack->frames[i].path);
+    }
+    free(stack->frames);
+    free(stack);
+}
+
+static void
+createRegionStackKey(void)
+{
+    pthread_key_create(&regionStackKey, freeRegionStack);
+}
+
+/* Every thread keeps its own stack of started regions */
+static LikwidRegionStack*
+getRegionStack(void)
+{
+    LikwidRegionStack* stack;
+    pthread_once(&regionStackOnce, createRegionStackKey);
+    stack = pthread_getspecific(regionStackKey);
+    if (stack == NULL)
+    {
+        stack = (LikwidRegionStack*) malloc(sizeof(LikwidRegionStack));
+        if (stack == NULL)
+        {
+            return NULL;
+        }
+        stack->depth = 0;
+        stack->size = 0;
+        stack->frames = NULL;
+        pthread_setspecific(regionStackKey, stack);
+    }
+    return stack;
+}
+
+/* Returns the position of the innermost started region with the given tag */
+static int
+findRegionFrame(LikwidRegionStack* stack, const char* regionTag)
+{
+    if (stack == NULL)
+    {
+        return -1;
+    }
+    for (int i=stack->depth-1; i>=0; i--)
+    {
+        if (strcmp(bdata(stack->frames[i].tag), regionTag) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* The call path of a region is the path of the enclosing region extended by
+ * '/' and the region tag. A recursive call of a region that is already on the
+ * stack reuses the call path of the started region. */
+static bstring
+getRegionPath(LikwidRegionStack* stack, const char* regionTag)
+{
+    bstring path;
+    int pos = findRegionFrame(stack, regionTag);
+    if (pos >= 0)
+    {
+        return bstrcpy(stack->frames[pos].path);
+    }
+    if (stack->depth == 0)
+    {
+        return bfromcstr(regionTag);
+    }
+    path = bstrcpy(stack->frames[stack->depth-1].path);
+    bconchar(path, '/');
+    bcatcstr(path, regionTag);
+    return path;
+}
+
+/* Seqlock of the region results, the sequence counter is odd while a thread
+ * updates its results */
+static inline void
+beginResultsUpdate(LikwidThreadResults* results)
+{
+    __atomic_store_n(&results->seq, results->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void
+endResultsUpdate(LikwidThreadResults* results)
+{
+    __atomic_store_n(&results->seq, results->seq + 1, __ATOMIC_RELEASE);
+}
+
+static int*
+getNumberOfEvents(void)
+{
+    int* numEvents = malloc(groupSet->numberOfActiveGroups * sizeof(int));
+    if (numEvents != NULL)
+    {
+        for (int i=0; i<groupSet->numberOfActiveGroups; i++)
+        {
+            numEvents[i] = groupSet->groups[i].numberOfEvents;
+        }
+    }
+    return numEvents;
+}
+
+static void*
+flushRegions(void* arg)
+{
+    struct timespec deadline;
+    pthread_mutex_lock(&flushThreadLock);
+    while (!flush_stop)
+    {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += (time_t)flush_interval;
+        deadline.tv_nsec += (long)((flush_interval - (time_t)flush_interval) * 1E9);
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        if (pthread_cond_timedwait(&flushThreadCond, &flushThreadLock, &deadline) == ETIMEDOUT)
+        {
+            pthread_mutex_unlock(&flushThreadLock);
+            likwid_markerFlush();
+            pthread_mutex_lock(&flushThreadLock);
+        }
+    }
+    pthread_mutex_unlock(&flushThreadLock);
+    return NULL;
+}
+
+/* The flush thread is created with the pthread_create of the C library, the
+ * pthread-overload library should not pin it to one of the application CPUs */
+static int
+startFlushThread(void)
+{
+    int (*create)(pthread_t*, const pthread_attr_t*, void* (*)(void*), void*);
+    create = dlsym(RTLD_NEXT, "pthread_create");
+    if (create == NULL)
+    {
+        create = pthread_create;
+    }
+    flush_stop = 0;
+    if (create(&flush_thread, NULL, flushRegions, NULL) != 0)
+    {
+        return -EFAULT;
+    }
+    flush_running = 1;
+    return 0;
+}
+
 /* #####   FUNCTION DEFINITIONS  -  EXPORTED FUNCTIONS   ################## */
 
 void likwid_markerInit(void)
@@ -172,7 +347,16 @@ void likwid_markerInit(void)
     affinity_init();
     hashTable_init();
 
-    for(int i=0; i<MAX_NUM_NODES; i++) socket_lock[i] = LOCK_INIT;
+    num_threadLocks = cpuid_topology.numHWThreads;
+    if (posix_memalign((void**) &threadLocks, CACHELINE_SIZE, num_threadLocks * sizeof(ThreadLock)) != 0)
+    {
+        fprintf(stderr,"Cannot allocate space for the locks of %d CPUs.\n", num_threadLocks);
+        exit(EXIT_FAILURE);
+    }
+    for (i=0; i<num_threadLocks; i++)
+    {
+        pthread_mutex_init(&threadLocks[i].lock, NULL);
+    }
 
     HPMmode(atoi(modeStr));
 
@@ -186,6 +370,12 @@ void likwid_markerInit(void)
     threadTokens = bstrListCreate();
     threadTokens = bsplit(bThreadStr,',');
     num_cpus = threadTokens->qty;
+    threads2Cpu = (int*) malloc(num_cpus * sizeof(int));
+    if (!threads2Cpu)
+    {
+        fprintf(stderr,"Cannot allocate space for the CPU list.\n");
+        exit(EXIT_FAILURE);
+    }
     for (i=0; i<num_cpus; i++)
     {
         threads2Cpu[i] = ownatoi(bdata(threadTokens->entry[i]));
@@ -247,6 +437,16 @@ void likwid_markerInit(void)
     }
 
     groupSet->activeGroup = 0;
+
+    stream_file = getenv("LIKWID_MARKER_STREAM");
+    if ((stream_file != NULL) && (getenv("LIKWID_MARKER_INTERVAL") != NULL))
+    {
+        flush_interval = atof(getenv("LIKWID_MARKER_INTERVAL"));
+        if ((flush_interval > 0) && (startFlushThread() < 0))
+        {
+            fprintf(stderr, "Cannot start thread to flush the Marker API regions\n");
+        }
+    }
 }
 
 void likwid_markerThreadInit(void)
@@ -292,28 +492,70 @@ void likwid_markerNextGroup(void)
     return;
 }
 
-/* File format
- * 1 numberOfThreads numberOfRegions
- * 2 regionID:regionTag0
- * 3 regionID:regionTag1
- * 4 regionID threadID countersvalues(space separated)
- * 5 regionID threadID countersvalues
- */
+int likwid_markerFlush(void)
+{
+    int ret = 0;
+    int* numEvents = NULL;
+    LikwidResults* results = NULL;
+    int numberOfThreads = 0;
+    int numberOfRegions = 0;
+    struct timeval now;
+
+    if ( ! likwid_init )
+    {
+        return -EFAULT;
+    }
+    if (stream_file == NULL)
+    {
+        return 0;
+    }
+    numEvents = getNumberOfEvents();
+    if (numEvents == NULL)
+    {
+        return -ENOMEM;
+    }
+    pthread_mutex_lock(&flushLock);
+    hashTable_snapshot(&numberOfThreads, &numberOfRegions, &results);
+    gettimeofday(&now, NULL);
+    ret = markerfile_append(stream_file, now.tv_sec + now.tv_usec * 1E-6,
+                            numberOfThreads, numberOfRegions, numberOfGroups, results, numEvents);
+    pthread_mutex_unlock(&flushLock);
+    if (ret < 0)
+    {
+        fprintf(stderr, "Cannot append to file %s: %s\n", stream_file, strerror(-ret));
+    }
+    hashTable_freeResults(numberOfThreads, numberOfRegions, results);
+    free(numEvents);
+    return ret;
+}
+
+/* The results are written in the binary format described in markerfile.h:
+ * a header, the region table, the string table of the region tags and the
+ * per-thread arrays of each region */
 void likwid_markerClose(void)
 {
-    FILE *file = NULL;
+    int ret = 0;
+    int* numEvents = NULL;
     LikwidResults* results = NULL;
     int numberOfThreads = 0;
     int numberOfRegions = 0;
     char* markerfile = NULL;
-    int lineidx = 0;
-    char line[1024];
 
     if ( ! likwid_init )
     {
         fprintf(stderr, "LIKWID not properly initialized\n");
         return;
     }
+    if (flush_running)
+    {
+        pthread_mutex_lock(&flushThreadLock);
+        flush_stop = 1;
+        pthread_cond_signal(&flushThreadCond);
+        pthread_mutex_unlock(&flushThreadLock);
+        pthread_join(flush_thread, NULL);
+        flush_running = 0;
+    }
+    likwid_markerFlush();
     hashTable_finalize(&numberOfThreads, &numberOfRegions, &results);
     if ((numberOfThreads == 0)||(numberOfThreads == 0))
     {
@@ -326,64 +568,35 @@ void likwid_markerClose(void)
         fprintf(stderr, "Is the application executed with LIKWID wrapper? No file path for the Marker API output defined.\n");
         return;
     }
-    file = fopen(markerfile,"w");
-
-    if (file != NULL)
+    numEvents = getNumberOfEvents();
+    if (numEvents != NULL)
     {
         DEBUG_PRINT(DEBUGLEV_DEVELOP, Creating Marker file %s with %d regions %d groups and %d threads, markerfile, numberOfRegions, numberOfGroups, numberOfThreads);
-        fprintf(file,"%d %d %d\n",numberOfThreads, numberOfRegions, numberOfGroups);
-        DEBUG_PRINT(DEBUGLEV_DEVELOP, %d %d %d, numberOfThreads, numberOfRegions, numberOfGroups);
-        for (int i=0; i<numberOfRegions; i++)
-        {
-            fprintf(file,"%d:%s\n",i,bdata(results[i].tag));
-            DEBUG_PRINT(DEBUGLEV_DEVELOP, %d:%s, i,bdata(results[i].tag));
-        }
-        for (int i=0; i<numberOfRegions; i++)
-        {
-            for (int j=0; j<numberOfThreads; j++)
-            {
-                fprintf(file,"%d ",i);
-                fprintf(file,"%d ",results[i].groupID);
-                fprintf(file,"%d ",results[i].cpulist[j]);
-                fprintf(file,"%u ",results[i].count[j]);
-                fprintf(file,"%e ",results[i].time[j]);
-                fprintf(file,"%d ",groupSet->groups[results[i].groupID].numberOfEvents);
-                lineidx = sprintf(&(line[0]), "%d %d %d %u %e %d ", i, results[i].groupID,results[i].cpulist[j],results[i].count[j],results[i].time[j],groupSet->groups[results[i].groupID].numberOfEvents);
-                for (int k=0; k<groupSet->groups[results[i].groupID].numberOfEvents; k++)
-                {
-                    fprintf(file,"%e ",results[i].counters[j][k]);
-                    lineidx += sprintf(&(line[lineidx]), "%e ", results[i].counters[j][k]);
-                }
-                fprintf(file,"\n");
-                DEBUG_PRINT(DEBUGLEV_DEVELOP, %s,line);
-            }
-        }
-        fclose(file);
+        ret = markerfile_write(markerfile, numberOfThreads, numberOfRegions, numberOfGroups, results, numEvents);
+        free(numEvents);
     }
     else
     {
-        fprintf(stderr, "Cannot open file %s\n", markerfile);
-        fprintf(stderr, "%s", strerror(errno));
+        ret = -ENOMEM;
     }
-
-    for (int i=0;i<numberOfRegions; i++)
+    if (ret < 0)
     {
-        for (int j=0;j<numberOfThreads; j++)
-        {
-            free(results[i].counters[j]);
-        }
-        free(results[i].time);
-        bdestroy(results[i].tag);
-        free(results[i].count);
-        free(results[i].counters);
+        fprintf(stderr, "Cannot write file %s\n", markerfile);
+        fprintf(stderr, "%s\n", strerror(-ret));
     }
 
-    if (results != NULL)
-    {
-        free(results);
-    }
+    hashTable_freeResults(numberOfThreads, numberOfRegions, results);
     likwid_init = 0;
     HPMfinalize();
+    for (int i=0; i<num_threadLocks; i++)
+    {
+        pthread_mutex_destroy(&threadLocks[i].lock);
+    }
+    free(threadLocks);
+    threadLocks = NULL;
+    num_threadLocks = 0;
+    free(threads2Cpu);
+    threads2Cpu = NULL;
 }
 
 int likwid_markerRegisterRegion(const char* regionTag)
@@ -392,13 +605,18 @@ int likwid_markerRegisterRegion(const char* regionTag)
     {
         return -EFAULT;
     }
-    TimerData timer;
-    bstring tag = bfromcstralloc(100, regionTag);
     LikwidThreadResults* results;
+    LikwidRegionStack* stack = getRegionStack();
+    if (stack == NULL)
+    {
+        return -ENOMEM;
+    }
+    bstring tag = getRegionPath(stack, regionTag);
     char groupSuffix[10];
     sprintf(groupSuffix, "-%d", groupSet->activeGroup);
     bcatcstr(tag, groupSuffix);
     int cpu_id = hashTable_get(tag, &results);
+    results->cpuID = cpu_id;
     bdestroy(tag);
     return 0;
 }
@@ -415,34 +633,66 @@ int likwid_markerStartRegion(const char* regionTag)
     {
         return -EFAULT;
     }
-
-    bstring tag = bfromcstralloc(100, regionTag);
+    LikwidRegionStack* stack = getRegionStack();
+    if (stack == NULL)
+    {
+        return -ENOMEM;
+    }
+    if (stack->depth == stack->size)
+    {
+        int size = (stack->size > 0 ? 2 * stack->size : 8);
+        LikwidRegionFrame* frames = realloc(stack->frames, size * sizeof(LikwidRegionFrame));
+        if (frames == NULL)
+        {
+            return -ENOMEM;
+        }
+        stack->frames = frames;
+        stack->size = size;
+    }
+    LikwidRegionFrame* frame = &stack->frames[stack->depth];
     LikwidThreadResults* results;
     char groupSuffix[10];
+    frame->tag = bfromcstr(regionTag);
+    frame->path = getRegionPath(stack, regionTag);
+    bstring tag = bstrcpy(frame->path);
     sprintf(groupSuffix, "-%d", groupSet->activeGroup);
     bcatcstr(tag, groupSuffix);
-    
+    if (use_locks == 1)
+    {
+        pthread_mutex_lock(&threadLocks[myCPU].lock);
+    }
+
     int cpu_id = hashTable_get(tag, &results);
     int thread_id = getThreadID(cpu_id);
-    perfmon_readCountersCpu(cpu_id);
     results->cpuID = cpu_id;
+    results->active++;
+    frame->results = results;
+    frame->childTime = 0.0;
+    stack->depth++;
+    bdestroy(tag);
+
+    perfmon_readCountersCpu(cpu_id);
     for(int i=0;i<groupSet->groups[groupSet->activeGroup].numberOfEvents;i++)
     {
         DEBUG_PRINT(DEBUGLEV_DEVELOP, START [%s] READ EVENT [%d=%d] EVENT %d VALUE %llu , regionTag, thread_id, cpu_id, i,
                         LLU_CAST groupSet->groups[groupSet->activeGroup].events[i].threadCounter[thread_id].counterData);
-        //groupSet->groups[groupSet->activeGroup].events[i].threadCounter[thread_id].startData =
-        //        groupSet->groups[groupSet->activeGroup].events[i].threadCounter[thread_id].counterData;
-        results->StartPMcounters[i] = groupSet->groups[groupSet->activeGroup].events[i].threadCounter[thread_id].counterData;
-        results->StartOverflows[i] = groupSet->groups[groupSet->activeGroup].events[i].threadCounter[thread_id].overflows;
+        frame->StartPMcounters[i] = groupSet->groups[groupSet->activeGroup].events[i].threadCounter[thread_id].counterData;
+        frame->StartOverflows[i] = groupSet->groups[groupSet->activeGroup].events[i].threadCounter[thread_id].overflows;
+        frame->ChildPMcounters[i] = 0.0;
     }
-    
-    bdestroy(tag);
-    timer_start(&(results->startTime));
+    if (use_locks == 1)
+    {
+        pthread_mutex_unlock(&threadLocks[myCPU].lock);
+    }
+    timer_start(&(frame->startTime));
     return 0;
 }
 
 
-
+/* Stopping a region accounts the counts since its start inclusively to its call
+ * path and hands them to the enclosing region, which subtracts them from its
+ * exclusive counts. The parent therefore needs no own counter read at the
+ * boundaries of its children. */
 int likwid_markerStopRegion(const char* regionTag)
 {
     if (! likwid_init)
@@ -453,6 +703,7 @@ int likwid_markerStopRegion(const char* regionTag)
     TimerData timestamp;
     timer_stop(&timestamp);
     double result = 0.0;
+    double time = 0.0;
     int cpu_id;
     int myCPU = likwid_getProcessorId();
     if (getThreadID(myCPU) < 0)
@@ -460,47 +711,85 @@ int likwid_markerStopRegion(const char* regionTag)
         return -EFAULT;
     }
     int thread_id;
-    bstring tag = bfromcstr(regionTag);
-    char groupSuffix[100];
     LikwidThreadResults* results;
-    sprintf(groupSuffix, "-%d", groupSet->activeGroup);
-    bcatcstr(tag, groupSuffix);
+    LikwidRegionFrame* frame;
+    LikwidRegionFrame* parent = NULL;
+    LikwidRegionStack* stack = getRegionStack();
+    int pos = findRegionFrame(stack, regionTag);
+    if (pos < 0)
+    {
+        fprintf(stderr, "WARN: Stopping region %s that was not started\n", regionTag);
+        return -EFAULT;
+    }
+    frame = &stack->frames[pos];
+    if (pos > 0)
+    {
+        parent = &stack->frames[pos-1];
+    }
     if (use_locks == 1)
     {
-        pthread_mutex_lock(&threadLocks[myCPU]);
+        pthread_mutex_lock(&threadLocks[myCPU].lock);
     }
-    
-    cpu_id = hashTable_get(tag, &results);
+
+    results = frame->results;
+    cpu_id = results->cpuID;
     thread_id = getThreadID(cpu_id);
+    perfmon_readCountersCpu(cpu_id);
+
+    beginResultsUpdate(results);
     results->groupID = groupSet->activeGroup;
-    results->startTime.stop.int64 = timestamp.stop.int64;
-    results->time += timer_print(&(results->startTime));
+    results->active--;
     results->count++;
-    bdestroy(tag);
-    
-    perfmon_readCountersCpu(cpu_id);
-    
+    frame->startTime.stop.int64 = timestamp.stop.int64;
+    time = timer_print(&(frame->startTime));
+    if (results->active == 0)
+    {
+        results->time += time;
+    }
+    results->exclusiveTime += time - frame->childTime;
+    if (parent != NULL)
+    {
+        parent->childTime += time;
+    }
+
     for(int i=0;i<groupSet->groups[groupSet->activeGroup].numberOfEvents;i++)
     {
         DEBUG_PRINT(DEBUGLEV_DEVELOP, STOP [%s] READ EVENT [%d=%d] EVENT %d VALUE %llu, regionTag, thread_id, cpu_id, i,
                         LLU_CAST groupSet->groups[groupSet->activeGroup].events[i].threadCounter[thread_id].counterData);
-        result = calculateMarkerResult(groupSet->groups[groupSet->activeGroup].events[i].index, results->StartPMcounters[i],
+        result = calculateMarkerResult(groupSet->groups[groupSet->activeGroup].events[i].index, frame->StartPMcounters[i],
                                         groupSet->groups[groupSet->activeGroup].events[i].threadCounter[thread_id].counterData,
                                         groupSet->groups[groupSet->activeGroup].events[i].threadCounter[thread_id].overflows - 
-                                        results->StartOverflows[i]);
+                                        frame->StartOverflows[i]);
         if (counter_map[groupSet->groups[groupSet->activeGroup].events[i].index].type != THERMAL)
         {
-            results->PMcounters[i] += result;
+            if (results->active == 0)
+            {
+                results->PMcounters[i] += result;
+            }
+            results->ExclusivePMcounters[i] += result - frame->ChildPMcounters[i];
+            if (parent != NULL)
+            {
+                parent->ChildPMcounters[i] += result;
+            }
         }
         else
         {
             results->PMcounters[i] = result;
+            results->ExclusivePMcounters[i] = result;
         }
     }
+    endResultsUpdate(results);
     if (use_locks == 1)
     {
-        pthread_mutex_unlock(&threadLocks[myCPU]);
+        pthread_mutex_unlock(&threadLocks[myCPU].lock);
     }
+
+    /* Regions stopped out of order are removed from the middle of the stack,
+     * the regions started after them are accounted to the next outer region */
+    bdestroy(frame->tag);
+    bdestroy(frame->path);
+    memmove(frame, frame + 1, (stack->depth - pos - 1) * sizeof(LikwidRegionFrame));
+    stack->depth--;
     return 0;
 }
 
@@ -518,13 +807,22 @@ void likwid_markerGetRegion(const char* regionTag, int* nr_events, double* event
     int cpu_id;
     int myCPU = likwid_getProcessorId();
     int thread_id;
-    bstring tag = bfromcstr(regionTag);
+    LikwidRegionStack* stack = getRegionStack();
+    if (stack == NULL)
+    {
+        *nr_events = 0;
+        *time = 0;
+        *count = 0;
+        return;
+    }
+    bstring tag = getRegionPath(stack, regionTag);
     char groupSuffix[100];
     LikwidThreadResults* results;
     sprintf(groupSuffix, "-%d", groupSet->activeGroup);
     bcatcstr(tag, groupSuffix);
 
     cpu_id = hashTable_get(tag, &results);
+    bdestroy(tag);
     thread_id = getThreadID(myCPU);
     *count = results->count;
     *time = results->time;
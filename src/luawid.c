@@ -31,6 +31,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <sys/types.h>
@@ -45,6 +46,13 @@
 #include <likwid.h>
 #include <tree.h>
 #include <access.h>
+#include <configuration.h>
+#include <agent_export.h>
+#include <agent_cgroup.h>
+#include <result_record.h>
+#include <numa_audit.h>
+#include <perfscope_plot.h>
+#include <markerfile.h>
 
 #ifdef COLOR
 #include <textcolor.h>
@@ -87,12 +95,18 @@ static int lua_likwid_getConfiguration(lua_State* L)
             lua_pushstring(L, "topologyFile");
             lua_pushnil(L);
             lua_settable(L,-3);
+            lua_pushstring(L, "topologyCache");
+            lua_pushnil(L);
+            lua_settable(L,-3);
             lua_pushstring(L, "daemonPath");
             lua_pushnil(L);
             lua_settable(L,-3);
             lua_pushstring(L, "daemonMode");
             lua_pushinteger(L, -1);
             lua_settable(L,-3);
+            lua_pushstring(L, "hwlocMode");
+            lua_pushinteger(L, config_useHwloc());
+            lua_settable(L,-3);
             lua_pushstring(L, "maxNumThreads");
             lua_pushinteger(L, MAX_NUM_THREADS);
             lua_settable(L,-3);
@@ -113,12 +127,18 @@ static int lua_likwid_getConfiguration(lua_State* L)
     lua_pushstring(L, "topologyFile");
     lua_pushstring(L, configfile->topologyCfgFileName);
     lua_settable(L,-3);
+    lua_pushstring(L, "topologyCache");
+    lua_pushstring(L, configfile->topologyCacheFileName);
+    lua_settable(L,-3);
     lua_pushstring(L, "daemonPath");
     lua_pushstring(L, configfile->daemonPath);
     lua_settable(L,-3);
     lua_pushstring(L, "daemonMode");
     lua_pushinteger(L, (int)configfile->daemonMode);
     lua_settable(L,-3);
+    lua_pushstring(L, "hwlocMode");
+    lua_pushinteger(L, config_useHwloc());
+    lua_settable(L,-3);
     lua_pushstring(L, "maxNumThreads");
     lua_pushinteger(L, configfile->maxNumThreads);
     lua_settable(L,-3);
@@ -274,6 +294,70 @@ static int lua_likwid_readCounters(lua_State* L)
     return 1;
 }
 
+static int lua_likwid_startSampling(lua_State* L)
+{
+    int ret;
+    int groupId = lua_tonumber(L,1);
+    uint64_t period = (uint64_t)lua_tonumber(L,2);
+    if (perfmon_isInitialized == 0)
+    {
+        return 0;
+    }
+    ret = perfmon_startSampling(groupId-1, period);
+    if (ret >= 0)
+    {
+        ret++;
+    }
+    lua_pushnumber(L,ret);
+    return 1;
+}
+
+static int lua_likwid_stopSampling(lua_State* L)
+{
+    int ret;
+    if (perfmon_isInitialized == 0)
+    {
+        return 0;
+    }
+    ret = perfmon_stopSampling();
+    lua_pushnumber(L,ret);
+    return 1;
+}
+
+static int lua_likwid_getSamplingResults(lua_State* L)
+{
+    int i, num;
+    uint64_t samples = 0, lost = 0;
+    PerfmonSampleSymbol* symbols = NULL;
+    num = perfmon_getSamplingResults(&symbols, &samples, &lost);
+    lua_newtable(L);
+    lua_pushstring(L,"samples");
+    lua_pushunsigned(L,samples);
+    lua_settable(L,-3);
+    lua_pushstring(L,"lost");
+    lua_pushunsigned(L,lost);
+    lua_settable(L,-3);
+    lua_pushstring(L,"symbols");
+    lua_newtable(L);
+    for (i=0;i<num;i++)
+    {
+        lua_pushunsigned(L,i+1);
+        lua_newtable(L);
+        lua_pushstring(L,"symbol");
+        lua_pushstring(L,symbols[i].symbol);
+        lua_settable(L,-3);
+        lua_pushstring(L,"module");
+        lua_pushstring(L,symbols[i].module);
+        lua_settable(L,-3);
+        lua_pushstring(L,"count");
+        lua_pushunsigned(L,symbols[i].count);
+        lua_settable(L,-3);
+        lua_settable(L,-3);
+    }
+    lua_settable(L,-3);
+    return 1;
+}
+
 static int lua_likwid_switchGroup(lua_State* L)
 {
     int ret = -1;
@@ -343,6 +427,18 @@ static int lua_likwid_getResult(lua_State* L)
     return 1;
 }
 
+static int lua_likwid_getLastResult(lua_State* L)
+{
+    int groupId, eventId, threadId;
+    double result = 0;
+    groupId = lua_tonumber(L,1);
+    eventId = lua_tonumber(L,2);
+    threadId = lua_tonumber(L,3);
+    result = perfmon_getLastResult(groupId-1, eventId-1, threadId-1);
+    lua_pushnumber(L,result);
+    return 1;
+}
+
 static int lua_likwid_getNumberOfGroups(lua_State* L)
 {
     int number;
@@ -381,6 +477,20 @@ static int lua_likwid_getRuntimeOfGroup(lua_State* L)
     return 1;
 }
 
+static int lua_likwid_getLastTimeOfGroup(lua_State* L)
+{
+    double time;
+    int groupId;
+    if (perfmon_isInitialized == 0)
+    {
+        return 0;
+    }
+    groupId = lua_tonumber(L,1);
+    time = perfmon_getLastTimeOfGroup(groupId-1);
+    lua_pushnumber(L, time);
+    return 1;
+}
+
 static int lua_likwid_getNumberOfEvents(lua_State* L)
 {
     int number, groupId;
@@ -945,6 +1055,27 @@ static int lua_likwid_setMemInterleaved(lua_State* L)
     return 0;
 }
 
+static int lua_likwid_setMemInterleavedDomains(lua_State* L)
+{
+    int i;
+    int nrDomains;
+    if (!lua_istable(L, 1)) {
+      lua_pushstring(L,"No table given as first argument");
+      lua_error(L);
+    }
+    nrDomains = lua_rawlen(L, 1);
+    luaL_argcheck(L, nrDomains > 0, 1, "Domain list must not be empty");
+    int domains[nrDomains];
+    for (i = 1; i <= nrDomains; i++)
+    {
+        lua_rawgeti(L,1,i);
+        domains[i-1] = lua_tointeger(L,-1);
+        lua_pop(L,1);
+    }
+    lua_pushboolean(L, numa_setInterleavedDomains(domains, nrDomains) == 0);
+    return 1;
+}
+
 static int lua_likwid_getAffinityInfo(lua_State* L)
 {
     int i,j;
@@ -1014,6 +1145,15 @@ static int lua_likwid_getAffinityInfo(lua_State* L)
     lua_pushstring(L,"numberOfProcessorsPerCache");
     lua_pushunsigned(L,affinity->numberOfProcessorsPerCache);
     lua_settable(L,-3);
+    lua_pushstring(L,"numberOfTileDomains");
+    lua_pushunsigned(L,affinity->numberOfTileDomains);
+    lua_settable(L,-3);
+    lua_pushstring(L,"numberOfCoresPerTile");
+    lua_pushunsigned(L,affinity->numberOfCoresPerTile);
+    lua_settable(L,-3);
+    lua_pushstring(L,"numberOfCoreDomains");
+    lua_pushunsigned(L,affinity->numberOfCoreDomains);
+    lua_settable(L,-3);
     lua_pushstring(L,"domains");
     lua_newtable(L);
     for(i=0;i<affinity->numberOfAffinityDomains;i++)
@@ -1048,13 +1188,15 @@ static int lua_likwid_cpustr_to_cpulist(lua_State* L)
 {
     int ret = 0;
     char* cpustr = (char *)luaL_checkstring(L, 1);
-    int* cpulist = (int*) malloc(MAX_NUM_THREADS * sizeof(int));
+    topology_init();
+    CpuTopology_t topo = get_cpuTopology();
+    int* cpulist = (int*) malloc(topo->numHWThreads * sizeof(int));
     if (cpulist == NULL)
     {
         lua_pushstring(L,"Cannot allocate data for the CPU list");
         lua_error(L);
     }
-    ret = cpustr_to_cpulist(cpustr, cpulist, MAX_NUM_THREADS);
+    ret = cpustr_to_cpulist(cpustr, cpulist, topo->numHWThreads);
     if (ret <= 0)
     {
         lua_pushstring(L,"Cannot parse cpustring");
@@ -1076,13 +1218,15 @@ static int lua_likwid_nodestr_to_nodelist(lua_State* L)
 {
     int ret = 0;
     char* nodestr = (char *)luaL_checkstring(L, 1);
-    int* nodelist = (int*) malloc(MAX_NUM_NODES * sizeof(int));
+    numa_init();
+    NumaTopology_t numa = get_numaTopology();
+    int* nodelist = (int*) malloc(numa->numberOfNodes * sizeof(int));
     if (nodelist == NULL)
     {
         lua_pushstring(L,"Cannot allocate data for the node list");
         lua_error(L);
     }
-    ret = nodestr_to_nodelist(nodestr, nodelist, MAX_NUM_NODES);
+    ret = nodestr_to_nodelist(nodestr, nodelist, numa->numberOfNodes);
     if (ret <= 0)
     {
         lua_pushstring(L,"Cannot parse node string");
@@ -1104,13 +1248,15 @@ static int lua_likwid_sockstr_to_socklist(lua_State* L)
 {
     int ret = 0;
     char* sockstr = (char *)luaL_checkstring(L, 1);
-    int* socklist = (int*) malloc(MAX_NUM_NODES * sizeof(int));
+    topology_init();
+    CpuTopology_t topo = get_cpuTopology();
+    int* socklist = (int*) malloc(topo->numSockets * sizeof(int));
     if (socklist == NULL)
     {
         lua_pushstring(L,"Cannot allocate data for the socket list");
         lua_error(L);
     }
-    ret = nodestr_to_nodelist(sockstr, socklist, MAX_NUM_NODES);
+    ret = sockstr_to_socklist(sockstr, socklist, topo->numSockets);
     if (ret <= 0)
     {
         lua_pushstring(L,"Cannot parse socket string");
@@ -1527,7 +1673,7 @@ static int lua_likwid_startProgram(lua_State* L)
     char  *argv[4096];
     exec = (char *)luaL_checkstring(L, 1);
     int nrThreads = luaL_checknumber(L,2);
-    int cpus[MAX_NUM_THREADS];
+    int cpus[MAX(nrThreads, (int)cpuid_topology.numHWThreads)];
     cpu_set_t cpuset;
     if (nrThreads > 0)
     {
@@ -1620,6 +1766,165 @@ static int lua_likwid_memSweepDomain(lua_State* L)
     return 0;
 }
 
+static int lua_likwid_memSweepDomains(lua_State* L)
+{
+    int i;
+    int nrDomains;
+    if (!lua_istable(L, 1)) {
+      lua_pushstring(L,"No table given as first argument");
+      lua_error(L);
+    }
+    nrDomains = lua_rawlen(L, 1);
+    luaL_argcheck(L, nrDomains > 0, 1, "Domain list must not be empty");
+    int domains[nrDomains];
+    for (i = 1; i <= nrDomains; i++)
+    {
+        lua_rawgeti(L,1,i);
+        domains[i-1] = lua_tointeger(L,-1);
+        lua_pop(L,1);
+    }
+    memsweep_domainList(domains, nrDomains);
+    return 0;
+}
+
+static int lua_likwid_memReclaimDomains(lua_State* L)
+{
+    int i;
+    int nrDomains;
+    if (!lua_istable(L, 1)) {
+      lua_pushstring(L,"No table given as first argument");
+      lua_error(L);
+    }
+    nrDomains = lua_rawlen(L, 1);
+    luaL_argcheck(L, nrDomains > 0, 1, "Domain list must not be empty");
+    int domains[nrDomains];
+    for (i = 1; i <= nrDomains; i++)
+    {
+        lua_rawgeti(L,1,i);
+        domains[i-1] = lua_tointeger(L,-1);
+        lua_pop(L,1);
+    }
+    lua_pushboolean(L, memsweep_reclaimDomains(domains, nrDomains) == 0);
+    return 1;
+}
+
+static int lua_likwid_auditNumaPages(lua_State* L)
+{
+    int i, j;
+    AuditProcess audit;
+    int pid = luaL_checknumber(L,1);
+    luaL_argcheck(L, pid > 0, 1, "Process ID must be greater than 0");
+    if (topology_isInitialized == 0)
+    {
+        topology_init();
+        topology_isInitialized = 1;
+        cpuinfo = get_cpuInfo();
+        cputopo = get_cpuTopology();
+    }
+    if (numa_isInitialized == 0)
+    {
+        numa_init();
+        numa_isInitialized = 1;
+        numainfo = get_numaTopology();
+    }
+    if (numa_auditProcess(pid, &audit) < 0)
+    {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_newtable(L);
+    lua_pushstring(L,"pid");
+    lua_pushnumber(L,pid);
+    lua_settable(L,-3);
+    lua_pushstring(L,"numberOfMappings");
+    lua_pushnumber(L,audit.numMappings);
+    lua_settable(L,-3);
+    lua_pushstring(L,"memory");
+    lua_newtable(L);
+    for (j = 0; j < audit.numDomains; j++)
+    {
+        lua_pushnumber(L,j);
+        lua_pushnumber(L,audit.memory[j]);
+        lua_settable(L,-3);
+    }
+    lua_settable(L,-3);
+    lua_pushstring(L,"mappings");
+    lua_newtable(L);
+    for (i = 0; i < audit.numMappings; i++)
+    {
+        AuditMapping* m = &audit.mappings[i];
+        lua_pushnumber(L,i+1);
+        lua_newtable(L);
+        lua_pushstring(L,"start");
+        lua_pushnumber(L,m->start);
+        lua_settable(L,-3);
+        lua_pushstring(L,"size");
+        lua_pushnumber(L,m->end - m->start);
+        lua_settable(L,-3);
+        lua_pushstring(L,"name");
+        lua_pushstring(L,m->name);
+        lua_settable(L,-3);
+        lua_pushstring(L,"policy");
+        lua_pushstring(L,m->policy);
+        lua_settable(L,-3);
+        lua_pushstring(L,"pageSize");
+        lua_pushnumber(L,m->pageSize);
+        lua_settable(L,-3);
+        lua_pushstring(L,"pages");
+        lua_newtable(L);
+        for (j = 0; j < audit.numDomains; j++)
+        {
+            lua_pushnumber(L,j);
+            lua_pushnumber(L,m->pages[j]);
+            lua_settable(L,-3);
+        }
+        lua_settable(L,-3);
+        lua_settable(L,-3);
+    }
+    lua_settable(L,-3);
+    numa_auditFree(&audit);
+    return 1;
+}
+
+static int lua_likwid_migrateNumaPages(lua_State* L)
+{
+    int ret;
+    uint64_t moved = 0;
+    AuditProcess audit;
+    int pid = luaL_checknumber(L,1);
+    int domain = luaL_checknumber(L,2);
+    int nrThreads = luaL_optinteger(L,3,AUDIT_MAX_THREADS);
+    luaL_argcheck(L, pid > 0, 1, "Process ID must be greater than 0");
+    luaL_argcheck(L, domain >= 0, 2, "Domain ID must be greater or equal 0");
+    if (topology_isInitialized == 0)
+    {
+        topology_init();
+        topology_isInitialized = 1;
+        cpuinfo = get_cpuInfo();
+        cputopo = get_cpuTopology();
+    }
+    if (numa_isInitialized == 0)
+    {
+        numa_init();
+        numa_isInitialized = 1;
+        numainfo = get_numaTopology();
+    }
+    ret = numa_auditProcess(pid, &audit);
+    if (ret == 0)
+    {
+        ret = numa_auditMigrate(&audit, domain, nrThreads, &moved);
+        numa_auditFree(&audit);
+    }
+    if (ret < 0)
+    {
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(-ret));
+        return 2;
+    }
+    lua_pushnumber(L, moved);
+    return 1;
+}
+
 static int lua_likwid_pinProcess(lua_State* L)
 {
     int cpuID = luaL_checknumber(L,-2);
@@ -1834,6 +2139,833 @@ static int lua_likwid_cpuFeatures_disable(lua_State* L)
     return 1;
 }
 
+static AgentMetric* lua_likwid_agentMetrics(lua_State* L, int idx, int* numMetrics)
+{
+    int i;
+    int num = 0;
+    AgentMetric* metrics = NULL;
+
+    luaL_checktype(L, idx, LUA_TTABLE);
+    num = luaL_len(L, idx);
+    metrics = (AgentMetric*) lua_newuserdata(L, (num > 0 ? num : 1) * sizeof(AgentMetric));
+    for (i = 0; i < num; i++)
+    {
+        lua_rawgeti(L, idx, i+1);
+        lua_getfield(L, -1, "name");
+        metrics[i].name = lua_tostring(L, -1);
+        lua_pop(L, 1);
+        lua_getfield(L, -1, "unit");
+        metrics[i].unit = lua_tostring(L, -1);
+        lua_pop(L, 1);
+        lua_getfield(L, -1, "value");
+        metrics[i].value = lua_tonumber(L, -1);
+        lua_pop(L, 1);
+        if (metrics[i].name == NULL)
+        {
+            metrics[i].name = "";
+        }
+        /* The strings stay referenced by the metric table on the stack */
+        lua_pop(L, 1);
+    }
+    *numMetrics = num;
+    return metrics;
+}
+
+static int lua_likwid_gangliaOpen(lua_State* L)
+{
+    const char* host = luaL_optstring(L, 1, AGENT_GANGLIA_HOST);
+    int port = luaL_optinteger(L, 2, AGENT_GANGLIA_PORT);
+    lua_pushinteger(L, agent_gangliaOpen(host, port));
+    return 1;
+}
+
+static int lua_likwid_gangliaSend(lua_State* L)
+{
+    int numMetrics = 0;
+    const char* group = lua_tostring(L, 1);
+    int tmax = luaL_checkinteger(L, 2);
+    int sendMeta = lua_toboolean(L, 3);
+    AgentMetric* metrics = lua_likwid_agentMetrics(L, 4, &numMetrics);
+    lua_pushinteger(L, agent_gangliaSend(group, tmax, sendMeta, numMetrics, metrics));
+    return 1;
+}
+
+static int lua_likwid_gangliaClose(lua_State* L)
+{
+    agent_gangliaClose();
+    return 0;
+}
+
+static int lua_likwid_syslogOpen(lua_State* L)
+{
+    lua_pushinteger(L, agent_syslogOpen(lua_tostring(L, 1)));
+    return 1;
+}
+
+static int lua_likwid_syslogSend(lua_State* L)
+{
+    int numMetrics = 0;
+    const char* group = lua_tostring(L, 1);
+    AgentMetric* metrics = lua_likwid_agentMetrics(L, 2, &numMetrics);
+    lua_pushinteger(L, agent_syslogSend(group, numMetrics, metrics));
+    return 1;
+}
+
+static int lua_likwid_syslogClose(lua_State* L)
+{
+    agent_syslogClose();
+    return 0;
+}
+
+static int lua_likwid_tsOpen(lua_State* L)
+{
+    int numMetrics = 0;
+    const char* filename = luaL_checkstring(L, 1);
+    AgentMetric* metrics = lua_likwid_agentMetrics(L, 2, &numMetrics);
+    lua_pushinteger(L, agent_tsOpen(filename, numMetrics, metrics));
+    return 1;
+}
+
+static int lua_likwid_tsWrite(lua_State* L)
+{
+    int numMetrics = 0;
+    int handle = luaL_checkinteger(L, 1);
+    uint64_t timestamp = (uint64_t) luaL_checknumber(L, 2);
+    AgentMetric* metrics = lua_likwid_agentMetrics(L, 3, &numMetrics);
+    lua_pushinteger(L, agent_tsWrite(handle, timestamp, numMetrics, metrics));
+    return 1;
+}
+
+static int lua_likwid_tsClose(lua_State* L)
+{
+    agent_tsClose(luaL_checkinteger(L, 1));
+    return 0;
+}
+
+static int lua_likwid_endpointOpen(lua_State* L)
+{
+    const char* spec = luaL_checkstring(L, 1);
+    const char* group = luaL_optstring(L, 2, NULL);
+    lua_pushinteger(L, agent_endpointOpen(spec, group));
+    return 1;
+}
+
+static int lua_likwid_endpointClose(lua_State* L)
+{
+    agent_endpointClose();
+    return 0;
+}
+
+static int lua_likwid_shmOpen(lua_State* L)
+{
+    const char* name = luaL_checkstring(L, 1);
+    size_t size = (size_t) luaL_optnumber(L, 2, AGENT_SHM_SIZE);
+    lua_pushinteger(L, agent_shmOpen(name, size));
+    return 1;
+}
+
+static int lua_likwid_shmClose(lua_State* L)
+{
+    agent_shmClose();
+    return 0;
+}
+
+static int lua_likwid_publish(lua_State* L)
+{
+    size_t len = 0;
+    const char* text = luaL_checklstring(L, 1, &len);
+    uint64_t timestamp = (uint64_t) luaL_optnumber(L, 2, 0);
+    lua_pushinteger(L, agent_publish(text, len, timestamp));
+    return 1;
+}
+
+static int lua_likwid_getCgroupJobs(lua_State* L)
+{
+    int i, j;
+    AgentJob* jobs = NULL;
+    const char* root = luaL_checkstring(L, 1);
+    const char* prefix = luaL_optstring(L, 2, AGENT_JOB_PREFIX);
+    int numJobs = agent_cgroupScan(root, prefix, &jobs);
+    if (numJobs < 0)
+    {
+        return 0;
+    }
+    lua_newtable(L);
+    for (i = 0; i < numJobs; i++)
+    {
+        lua_pushstring(L, jobs[i].id);
+        lua_newtable(L);
+        for (j = 0; j < jobs[i].numCpus; j++)
+        {
+            lua_pushinteger(L, j+1);
+            lua_pushinteger(L, jobs[i].cpus[j]);
+            lua_settable(L, -3);
+        }
+        lua_settable(L, -3);
+    }
+    agent_cgroupFree(numJobs, jobs);
+    return 1;
+}
+
+static void lua_likwid_recordArray(lua_State* L, int idx, double* values, int num)
+{
+    int i;
+    for (i = 0; i < num; i++)
+    {
+        values[i] = 0;
+        if (lua_istable(L, idx))
+        {
+            lua_rawgeti(L, idx, i+1);
+            values[i] = lua_tonumber(L, -1);
+            lua_pop(L, 1);
+        }
+    }
+}
+
+static int lua_likwid_writeResultRecord(lua_State* L)
+{
+    int i, s, e;
+    int ret = -ENOMEM;
+    RecordRank rank;
+    const char* filename = luaL_checkstring(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+
+    memset(&rank, 0, sizeof(RecordRank));
+    lua_getfield(L, 2, "rank");
+    rank.rank = (lua_isnumber(L, -1) ? lua_tointeger(L, -1) : -1);
+    lua_pop(L, 1);
+    lua_getfield(L, 2, "clock");
+    rank.clock = lua_tonumber(L, -1);
+    lua_pop(L, 1);
+    /* The strings stay referenced by the record table */
+    lua_getfield(L, 2, "hostname");
+    rank.hostname = (char*) lua_tostring(L, -1);
+    lua_pop(L, 1);
+    lua_getfield(L, 2, "cpus");
+    luaL_checktype(L, -1, LUA_TTABLE);
+    rank.numCpus = luaL_len(L, -1);
+    rank.cpus = (int*) malloc((rank.numCpus > 0 ? rank.numCpus : 1) * sizeof(int));
+    if (rank.cpus == NULL)
+    {
+        lua_pop(L, 1);
+        goto cleanup;
+    }
+    for (i = 0; i < rank.numCpus; i++)
+    {
+        lua_rawgeti(L, -1, i+1);
+        rank.cpus[i] = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+    }
+    lua_pop(L, 1);
+    lua_getfield(L, 2, "sections");
+    luaL_checktype(L, -1, LUA_TTABLE);
+    rank.numSections = luaL_len(L, -1);
+    if (rank.numSections > 0)
+    {
+        rank.sections = (RecordSection*) calloc(rank.numSections, sizeof(RecordSection));
+        if (rank.sections == NULL)
+        {
+            lua_pop(L, 1);
+            goto cleanup;
+        }
+    }
+    for (s = 0; s < rank.numSections; s++)
+    {
+        RecordSection* sec = &rank.sections[s];
+        lua_rawgeti(L, -1, s+1);
+        lua_getfield(L, -1, "region");
+        sec->region = (char*) (lua_isstring(L, -1) ? lua_tostring(L, -1) : "");
+        lua_pop(L, 1);
+        lua_getfield(L, -1, "group");
+        sec->group = lua_tointeger(L, -1);
+        lua_pop(L, 1);
+        lua_getfield(L, -1, "events");
+        sec->numEvents = (lua_istable(L, -1) ? luaL_len(L, -1) : 0);
+        sec->time = (double*) malloc((rank.numCpus > 0 ? rank.numCpus : 1) * sizeof(double));
+        sec->calls = (double*) malloc((rank.numCpus > 0 ? rank.numCpus : 1) * sizeof(double));
+        sec->values = (double*) malloc((sec->numEvents * rank.numCpus > 0 ? sec->numEvents * rank.numCpus : 1) * sizeof(double));
+        if (sec->time == NULL || sec->calls == NULL || sec->values == NULL)
+        {
+            lua_pop(L, 3);
+            goto cleanup;
+        }
+        for (e = 0; e < sec->numEvents; e++)
+        {
+            lua_rawgeti(L, -1, e+1);
+            lua_likwid_recordArray(L, lua_gettop(L), &sec->values[e * rank.numCpus], rank.numCpus);
+            lua_pop(L, 1);
+        }
+        lua_pop(L, 1);
+        lua_getfield(L, -1, "time");
+        lua_likwid_recordArray(L, lua_gettop(L), sec->time, rank.numCpus);
+        lua_pop(L, 1);
+        lua_getfield(L, -1, "calls");
+        lua_likwid_recordArray(L, lua_gettop(L), sec->calls, rank.numCpus);
+        lua_pop(L, 2);
+    }
+    lua_pop(L, 1);
+    ret = record_writeRank(filename, &rank);
+cleanup:
+    for (s = 0; rank.sections && s < rank.numSections; s++)
+    {
+        free(rank.sections[s].time);
+        free(rank.sections[s].calls);
+        free(rank.sections[s].values);
+    }
+    free(rank.sections);
+    free(rank.cpus);
+    lua_pushinteger(L, ret);
+    return 1;
+}
+
+static const char** lua_likwid_recordFiles(lua_State* L, int idx, int* numFiles)
+{
+    int i;
+    const char** files = NULL;
+
+    if (lua_isstring(L, idx))
+    {
+        files = (const char**) lua_newuserdata(L, sizeof(char*));
+        files[0] = lua_tostring(L, idx);
+        *numFiles = 1;
+        return files;
+    }
+    luaL_checktype(L, idx, LUA_TTABLE);
+    *numFiles = luaL_len(L, idx);
+    files = (const char**) lua_newuserdata(L, (*numFiles > 0 ? *numFiles : 1) * sizeof(char*));
+    for (i = 0; i < *numFiles; i++)
+    {
+        lua_rawgeti(L, idx, i+1);
+        files[i] = lua_tostring(L, -1);
+        if (files[i] == NULL)
+        {
+            files[i] = "";
+        }
+        /* The strings stay referenced by the file table */
+        lua_pop(L, 1);
+    }
+    return files;
+}
+
+static void lua_likwid_pushRecordStat(lua_State* L, RecordStat* stat)
+{
+    lua_newtable(L);
+    lua_pushstring(L, "count");
+    lua_pushnumber(L, stat->count);
+    lua_settable(L, -3);
+    lua_pushstring(L, "min");
+    lua_pushnumber(L, stat->min);
+    lua_settable(L, -3);
+    lua_pushstring(L, "max");
+    lua_pushnumber(L, stat->max);
+    lua_settable(L, -3);
+    lua_pushstring(L, "sum");
+    lua_pushnumber(L, stat->sum);
+    lua_settable(L, -3);
+    lua_pushstring(L, "avg");
+    lua_pushnumber(L, (stat->count > 0 ? stat->sum / stat->count : 0));
+    lua_settable(L, -3);
+}
+
+/* Pushes the table regions[region][group] of a section, creates both levels if needed */
+static void lua_likwid_pushRecordSection(lua_State* L, int regions, const char* region, int group)
+{
+    lua_getfield(L, regions, region);
+    if (lua_isnil(L, -1))
+    {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, regions, region);
+    }
+    lua_rawgeti(L, -1, group);
+    if (lua_isnil(L, -1))
+    {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, -3, group);
+    }
+    lua_remove(L, -2);
+}
+
+static void lua_likwid_pushRecordScope(lua_State* L, RecordScope* scope)
+{
+    int s, e;
+    int regions;
+
+    lua_newtable(L);
+    if (scope->hostname)
+    {
+        lua_pushstring(L, "hostname");
+        lua_pushstring(L, scope->hostname);
+        lua_settable(L, -3);
+    }
+    lua_pushstring(L, "ranks");
+    lua_pushinteger(L, scope->numRanks);
+    lua_settable(L, -3);
+    lua_pushstring(L, "cpus");
+    lua_pushinteger(L, scope->numCpus);
+    lua_settable(L, -3);
+    lua_newtable(L);
+    regions = lua_gettop(L);
+    for (s = 0; s < scope->numSections; s++)
+    {
+        RecordStatSection* sec = &scope->sections[s];
+        lua_likwid_pushRecordSection(L, regions, sec->region, sec->group);
+        lua_likwid_pushRecordStat(L, &sec->time);
+        lua_setfield(L, -2, "time");
+        lua_likwid_pushRecordStat(L, &sec->calls);
+        lua_setfield(L, -2, "calls");
+        for (e = 0; e < sec->numEvents; e++)
+        {
+            lua_likwid_pushRecordStat(L, &sec->events[e]);
+            lua_rawseti(L, -2, e+1);
+        }
+        lua_pop(L, 1);
+    }
+    lua_setfield(L, -2, "regions");
+}
+
+static void lua_likwid_pushRecordRank(lua_State* L, RecordRank* rank)
+{
+    int i, s, e;
+    int regions;
+
+    lua_newtable(L);
+    lua_pushstring(L, "rank");
+    lua_pushinteger(L, rank->rank);
+    lua_settable(L, -3);
+    lua_pushstring(L, "hostname");
+    lua_pushstring(L, rank->hostname);
+    lua_settable(L, -3);
+    lua_pushstring(L, "clock");
+    lua_pushnumber(L, rank->clock);
+    lua_settable(L, -3);
+    lua_newtable(L);
+    for (i = 0; i < rank->numCpus; i++)
+    {
+        lua_pushinteger(L, rank->cpus[i]);
+        lua_rawseti(L, -2, i+1);
+    }
+    lua_setfield(L, -2, "cpus");
+    lua_newtable(L);
+    regions = lua_gettop(L);
+    for (s = 0; s < rank->numSections; s++)
+    {
+        RecordSection* sec = &rank->sections[s];
+        lua_likwid_pushRecordSection(L, regions, sec->region, sec->group);
+        lua_newtable(L);
+        for (i = 0; i < rank->numCpus; i++)
+        {
+            lua_pushnumber(L, sec->time[i]);
+            lua_rawseti(L, -2, rank->cpus[i]);
+        }
+        lua_setfield(L, -2, "time");
+        lua_newtable(L);
+        for (i = 0; i < rank->numCpus; i++)
+        {
+            lua_pushnumber(L, sec->calls[i]);
+            lua_rawseti(L, -2, rank->cpus[i]);
+        }
+        lua_setfield(L, -2, "calls");
+        for (e = 0; e < sec->numEvents; e++)
+        {
+            lua_newtable(L);
+            for (i = 0; i < rank->numCpus; i++)
+            {
+                lua_pushnumber(L, sec->values[e * rank->numCpus + i]);
+                lua_rawseti(L, -2, rank->cpus[i]);
+            }
+            lua_rawseti(L, -2, e+1);
+        }
+        lua_pop(L, 1);
+    }
+    lua_setfield(L, -2, "regions");
+}
+
+static int lua_likwid_mergeResultRecords(lua_State* L)
+{
+    int ret;
+    int numFiles = 0;
+    ResultRecord* record = NULL;
+    const char* filename = luaL_checkstring(L, 1);
+    const char** files = lua_likwid_recordFiles(L, 2, &numFiles);
+
+    ret = record_merge(numFiles, files, &record);
+    if (ret == 0)
+    {
+        ret = record_write(filename, record);
+        if (ret == 0)
+        {
+            ret = record->numRanks;
+        }
+        record_free(record);
+    }
+    lua_pushinteger(L, ret);
+    return 1;
+}
+
+static int lua_likwid_readResultRecords(lua_State* L)
+{
+    int i;
+    int numFiles = 0;
+    ResultRecord* record = NULL;
+    RecordScope global;
+    const char** files = lua_likwid_recordFiles(L, 1, &numFiles);
+
+    if (record_merge(numFiles, files, &record) < 0)
+    {
+        return 0;
+    }
+    lua_newtable(L);
+    lua_newtable(L);
+    for (i = 0; i < record->numRanks; i++)
+    {
+        RecordRank rank;
+        RecordScope scope;
+        if (record_decodeRank(record->rankData[i], record->rankLength[i], &rank) < 0)
+        {
+            continue;
+        }
+        lua_likwid_pushRecordRank(L, &rank);
+        if (record_rankScope(&rank, &scope) == 0)
+        {
+            lua_likwid_pushRecordScope(L, &scope);
+            lua_setfield(L, -2, "stats");
+            record_freeScope(&scope);
+        }
+        lua_rawseti(L, -2, luaL_len(L, -2) + 1);
+        record_freeRank(&rank);
+    }
+    lua_setfield(L, -2, "ranks");
+    memset(&global, 0, sizeof(RecordScope));
+    lua_newtable(L);
+    for (i = 0; i < record->numNodes; i++)
+    {
+        lua_likwid_pushRecordScope(L, &record->nodes[i]);
+        lua_rawseti(L, -2, i+1);
+        record_mergeScope(&global, &record->nodes[i]);
+    }
+    lua_setfield(L, -2, "nodes");
+    lua_likwid_pushRecordScope(L, &global);
+    lua_setfield(L, -2, "global");
+    record_freeScope(&global);
+    record_free(record);
+    return 1;
+}
+
+static AggregateScope lua_likwid_checkScope(lua_State* L, int index)
+{
+    static const char* const scopes[] = {"socket", "numa", "node", NULL};
+    return (AggregateScope)luaL_checkoption(L, index, "node", scopes);
+}
+
+static void lua_likwid_pushAggregate(lua_State* L, AggregateResult* result)
+{
+    lua_newtable(L);
+    lua_pushinteger(L, result->domain);
+    lua_setfield(L, -2, "domain");
+    lua_pushinteger(L, result->count);
+    lua_setfield(L, -2, "count");
+    lua_pushnumber(L, result->sum);
+    lua_setfield(L, -2, "sum");
+    lua_pushnumber(L, result->min);
+    lua_setfield(L, -2, "min");
+    lua_pushnumber(L, result->max);
+    lua_setfield(L, -2, "max");
+    lua_pushnumber(L, result->avg);
+    lua_setfield(L, -2, "avg");
+}
+
+static int lua_likwid_isUncoreCounter(lua_State* L)
+{
+    lua_pushboolean(L, perfmon_isUncoreCounter(luaL_checkstring(L, 1)));
+    return 1;
+}
+
+static int lua_likwid_getAggregates(lua_State* L)
+{
+    int e, d;
+    int numEvents, numDomains;
+    AggregateResult* results = NULL;
+    int groupId = luaL_checkinteger(L, 1);
+    AggregateScope scope = lua_likwid_checkScope(L, 2);
+    int last = lua_toboolean(L, 3);
+
+    if (perfmon_isInitialized == 0)
+    {
+        return 0;
+    }
+    numEvents = perfmon_getNumberOfEvents(groupId-1);
+    numDomains = perfmon_getNumberOfAggregates(scope);
+    if (numEvents <= 0 || numDomains <= 0)
+    {
+        return 0;
+    }
+    results = malloc(numEvents * numDomains * sizeof(AggregateResult));
+    if (results == NULL)
+    {
+        return 0;
+    }
+    if (perfmon_aggregateGroup(groupId-1, scope, last, results) < 0)
+    {
+        free(results);
+        return 0;
+    }
+    lua_newtable(L);
+    for (e = 0; e < numEvents; e++)
+    {
+        lua_newtable(L);
+        for (d = 0; d < numDomains; d++)
+        {
+            lua_likwid_pushAggregate(L, &results[e * numDomains + d]);
+            lua_rawseti(L, -2, d+1);
+        }
+        lua_rawseti(L, -2, e+1);
+    }
+    free(results);
+    return 1;
+}
+
+static int lua_likwid_aggregateValues(lua_State* L)
+{
+    int i;
+    int ret;
+    int numCpus;
+    int* cpus = NULL;
+    double* values = NULL;
+    AggregateResult* results = NULL;
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    numCpus = luaL_len(L, 1);
+    if (numCpus == 0)
+    {
+        return 0;
+    }
+    cpus = malloc(numCpus * sizeof(int));
+    values = malloc(numCpus * sizeof(double));
+    results = malloc(numCpus * sizeof(AggregateResult));
+    if (cpus == NULL || values == NULL || results == NULL)
+    {
+        free(cpus);
+        free(values);
+        free(results);
+        return 0;
+    }
+    for (i = 0; i < numCpus; i++)
+    {
+        lua_rawgeti(L, 1, i+1);
+        cpus[i] = lua_tointeger(L, -1);
+        lua_rawgeti(L, 2, i+1);
+        values[i] = lua_tonumber(L, -1);
+        lua_pop(L, 2);
+    }
+    ret = perfmon_aggregateValues(numCpus, cpus, values, lua_toboolean(L, 3),
+                                  lua_likwid_checkScope(L, 4), results, numCpus);
+    if (ret > 0)
+    {
+        lua_newtable(L);
+        for (i = 0; i < ret; i++)
+        {
+            lua_likwid_pushAggregate(L, &results[i]);
+            lua_rawseti(L, -2, i+1);
+        }
+    }
+    free(cpus);
+    free(values);
+    free(results);
+    return (ret > 0 ? 1 : 0);
+}
+
+static int lua_likwid_plotOpen(lua_State* L)
+{
+    int i;
+    int ret;
+    int numSeries;
+    PlotSeries series[PLOT_MAX_SERIES];
+    const char* command = luaL_optstring(L, 1, NULL);
+    int capacity = luaL_optinteger(L, 3, 0);
+
+    luaL_checktype(L, 2, LUA_TTABLE);
+    numSeries = luaL_len(L, 2);
+    if (numSeries > PLOT_MAX_SERIES)
+    {
+        return luaL_error(L, "Cannot plot more than %d curves", PLOT_MAX_SERIES);
+    }
+    for (i = 0; i < numSeries; i++)
+    {
+        lua_rawgeti(L, 2, i+1);
+        luaL_checktype(L, -1, LUA_TTABLE);
+        lua_getfield(L, -1, "title");
+        series[i].title = lua_tostring(L, -1);
+        lua_pop(L, 1);
+        lua_getfield(L, -1, "y2");
+        series[i].y2 = lua_toboolean(L, -1);
+        lua_pop(L, 2);
+    }
+    /* The titles are copied by plot_open, the table still anchors them */
+    ret = plot_open(command, numSeries, series, capacity);
+    lua_pushinteger(L, ret);
+    return 1;
+}
+
+static int lua_likwid_plotRecord(lua_State* L)
+{
+    lua_pushinteger(L, plot_record(luaL_checkinteger(L, 1), luaL_checkstring(L, 2)));
+    return 1;
+}
+
+static int lua_likwid_plotCommand(lua_State* L)
+{
+    lua_pushinteger(L, plot_command(luaL_checkinteger(L, 1), luaL_checkstring(L, 2)));
+    return 1;
+}
+
+static int lua_likwid_plotAdd(lua_State* L)
+{
+    int i;
+    int numValues;
+    double values[PLOT_MAX_SERIES];
+    int handle = luaL_checkinteger(L, 1);
+    double time = luaL_checknumber(L, 2);
+
+    luaL_checktype(L, 3, LUA_TTABLE);
+    numValues = luaL_len(L, 3);
+    if (numValues > PLOT_MAX_SERIES)
+    {
+        numValues = PLOT_MAX_SERIES;
+    }
+    for (i = 0; i < numValues; i++)
+    {
+        lua_rawgeti(L, 3, i+1);
+        values[i] = lua_tonumber(L, -1);
+        lua_pop(L, 1);
+    }
+    lua_pushinteger(L, plot_add(handle, time, numValues, values));
+    return 1;
+}
+
+static int lua_likwid_plotFrame(lua_State* L)
+{
+    lua_pushinteger(L, plot_frame(luaL_checkinteger(L, 1), luaL_optnumber(L, 2, 0.0)));
+    return 1;
+}
+
+static int lua_likwid_plotClose(lua_State* L)
+{
+    plot_close(luaL_checkinteger(L, 1));
+    return 0;
+}
+
+/* The optional record index counts from 1, negative indices from the last
+ * complete record of a stream file */
+static int lua_likwid_markerFileOpen(lua_State* L)
+{
+    int numThreads = 0, numRegions = 0, numGroups = 0;
+    int record = 0, numRecords = 0;
+    double timestamp = 0;
+    int index = luaL_optinteger(L, 2, 1);
+    int handle = markerfile_openRecord(luaL_checkstring(L, 1), (index > 0 ? index - 1 : index));
+
+    lua_pushinteger(L, handle);
+    if (handle < 0)
+    {
+        return 1;
+    }
+    markerfile_getInfo(handle, &numThreads, &numRegions, &numGroups);
+    markerfile_getRecordInfo(handle, &record, &numRecords, &timestamp);
+    lua_pushinteger(L, numThreads);
+    lua_pushinteger(L, numRegions);
+    lua_pushinteger(L, numGroups);
+    lua_pushinteger(L, record + 1);
+    lua_pushinteger(L, numRecords);
+    lua_pushnumber(L, timestamp);
+    return 7;
+}
+
+static int lua_likwid_markerFileRegion(lua_State* L)
+{
+    int t, e;
+    int numThreads = 0, numRegions = 0, numGroups = 0;
+    MarkerFileRegion region;
+    int handle = luaL_checkinteger(L, 1);
+
+    if (markerfile_getInfo(handle, &numThreads, &numRegions, &numGroups) < 0 ||
+        markerfile_getRegion(handle, luaL_checkinteger(L, 2) - 1, &region) < 0)
+    {
+        return 0;
+    }
+    lua_newtable(L);
+    lua_pushstring(L, region.tag);
+    lua_setfield(L, -2, "tag");
+    lua_pushinteger(L, region.groupId + 1);
+    lua_setfield(L, -2, "group");
+    lua_pushinteger(L, region.numEvents);
+    lua_setfield(L, -2, "events");
+    lua_newtable(L);
+    for (t = 0; t < numThreads; t++)
+    {
+        lua_pushinteger(L, region.cpus[t]);
+        lua_rawseti(L, -2, t+1);
+    }
+    lua_setfield(L, -2, "cpus");
+    lua_newtable(L);
+    for (t = 0; t < numThreads; t++)
+    {
+        lua_pushnumber(L, (lua_Number)region.count[t]);
+        lua_rawseti(L, -2, t+1);
+    }
+    lua_setfield(L, -2, "count");
+    lua_newtable(L);
+    for (t = 0; t < numThreads; t++)
+    {
+        lua_pushnumber(L, region.time[t]);
+        lua_rawseti(L, -2, t+1);
+    }
+    lua_setfield(L, -2, "time");
+    /* Counter values as [event][thread] */
+    lua_newtable(L);
+    for (e = 0; e < region.numEvents; e++)
+    {
+        lua_newtable(L);
+        for (t = 0; t < numThreads; t++)
+        {
+            lua_pushnumber(L, region.counters[t * region.numEvents + e]);
+            lua_rawseti(L, -2, t+1);
+        }
+        lua_rawseti(L, -2, e+1);
+    }
+    lua_setfield(L, -2, "counters");
+    lua_newtable(L);
+    for (t = 0; t < numThreads; t++)
+    {
+        lua_pushnumber(L, region.exclusiveTime[t]);
+        lua_rawseti(L, -2, t+1);
+    }
+    lua_setfield(L, -2, "exclusiveTime");
+    lua_newtable(L);
+    for (e = 0; e < region.numEvents; e++)
+    {
+        lua_newtable(L);
+        for (t = 0; t < numThreads; t++)
+        {
+            lua_pushnumber(L, region.exclusiveCounters[t * region.numEvents + e]);
+            lua_rawseti(L, -2, t+1);
+        }
+        lua_rawseti(L, -2, e+1);
+    }
+    lua_setfield(L, -2, "exclusiveCounters");
+    return 1;
+}
+
+static int lua_likwid_markerFileClose(lua_State* L)
+{
+    markerfile_close(luaL_checkinteger(L, 1));
+    return 0;
+}
+
 int __attribute__ ((visibility ("default") )) luaopen_liblikwid(lua_State* L){
     // Configuration functions
     lua_register(L, "likwid_getConfiguration", lua_likwid_getConfiguration);
@@ -1847,6 +2979,9 @@ int __attribute__ ((visibility ("default") )) luaopen_liblikwid(lua_State* L){
     lua_register(L, "likwid_startCounters",lua_likwid_startCounters);
     lua_register(L, "likwid_stopCounters",lua_likwid_stopCounters);
     lua_register(L, "likwid_readCounters",lua_likwid_readCounters);
+    lua_register(L, "likwid_startSampling",lua_likwid_startSampling);
+    lua_register(L, "likwid_stopSampling",lua_likwid_stopSampling);
+    lua_register(L, "likwid_getSamplingResults",lua_likwid_getSamplingResults);
     lua_register(L, "likwid_switchGroup",lua_likwid_switchGroup);
     lua_register(L, "likwid_finalize",lua_likwid_finalize);
     lua_register(L, "likwid_getEventsAndCounters", lua_likwid_getEventsAndCounters);
@@ -1854,6 +2989,11 @@ int __attribute__ ((visibility ("default") )) luaopen_liblikwid(lua_State* L){
     lua_register(L, "likwid_getResult",lua_likwid_getResult);
     lua_register(L, "likwid_getNumberOfGroups",lua_likwid_getNumberOfGroups);
     lua_register(L, "likwid_getRuntimeOfGroup", lua_likwid_getRuntimeOfGroup);
+    lua_register(L, "likwid_getLastResult",lua_likwid_getLastResult);
+    lua_register(L, "likwid_isUncoreCounter", lua_likwid_isUncoreCounter);
+    lua_register(L, "likwid_getAggregates", lua_likwid_getAggregates);
+    lua_register(L, "likwid_aggregateValues", lua_likwid_aggregateValues);
+    lua_register(L, "likwid_getLastTimeOfGroup", lua_likwid_getLastTimeOfGroup);
     lua_register(L, "likwid_getIdOfActiveGroup",lua_likwid_getIdOfActiveGroup);
     lua_register(L, "likwid_getNumberOfEvents",lua_likwid_getNumberOfEvents);
     lua_register(L, "likwid_getNumberOfThreads",lua_likwid_getNumberOfThreads);
@@ -1864,6 +3004,7 @@ int __attribute__ ((visibility ("default") )) luaopen_liblikwid(lua_State* L){
     lua_register(L, "likwid_getNumaInfo",lua_likwid_getNumaInfo);
     lua_register(L, "likwid_putNumaInfo",lua_likwid_putNumaInfo);
     lua_register(L, "likwid_setMemInterleaved", lua_likwid_setMemInterleaved);
+    lua_register(L, "likwid_setMemInterleavedDomains", lua_likwid_setMemInterleavedDomains);
     lua_register(L, "likwid_getAffinityInfo",lua_likwid_getAffinityInfo);
     lua_register(L, "likwid_putAffinityInfo",lua_likwid_putAffinityInfo);
     lua_register(L, "likwid_getPowerInfo",lua_likwid_getPowerInfo);
@@ -1894,11 +3035,42 @@ int __attribute__ ((visibility ("default") )) luaopen_liblikwid(lua_State* L){
     // MemSweep functions
     lua_register(L, "likwid_memSweep", lua_likwid_memSweep);
     lua_register(L, "likwid_memSweepDomain", lua_likwid_memSweepDomain);
+    lua_register(L, "likwid_memSweepDomains", lua_likwid_memSweepDomains);
+    lua_register(L, "likwid_memReclaimDomains", lua_likwid_memReclaimDomains);
+    lua_register(L, "likwid_auditNumaPages", lua_likwid_auditNumaPages);
+    lua_register(L, "likwid_migrateNumaPages", lua_likwid_migrateNumaPages);
     // Pinning functions
     lua_register(L, "likwid_pinProcess", lua_likwid_pinProcess);
     // Helper functions
     lua_register(L, "likwid_setenv", lua_likwid_setenv);
     lua_register(L, "likwid_getpid", lua_likwid_getpid);
+    // Output backends of likwid-agent
+    lua_register(L, "likwid_gangliaOpen", lua_likwid_gangliaOpen);
+    lua_register(L, "likwid_gangliaSend", lua_likwid_gangliaSend);
+    lua_register(L, "likwid_gangliaClose", lua_likwid_gangliaClose);
+    lua_register(L, "likwid_syslogOpen", lua_likwid_syslogOpen);
+    lua_register(L, "likwid_syslogSend", lua_likwid_syslogSend);
+    lua_register(L, "likwid_syslogClose", lua_likwid_syslogClose);
+    lua_register(L, "likwid_tsOpen", lua_likwid_tsOpen);
+    lua_register(L, "likwid_tsWrite", lua_likwid_tsWrite);
+    lua_register(L, "likwid_tsClose", lua_likwid_tsClose);
+    lua_register(L, "likwid_endpointOpen", lua_likwid_endpointOpen);
+    lua_register(L, "likwid_endpointClose", lua_likwid_endpointClose);
+    lua_register(L, "likwid_shmOpen", lua_likwid_shmOpen);
+    lua_register(L, "likwid_shmClose", lua_likwid_shmClose);
+    lua_register(L, "likwid_publish", lua_likwid_publish);
+    lua_register(L, "likwid_getCgroupJobs", lua_likwid_getCgroupJobs);
+    // Result record functions
+    lua_register(L, "likwid_writeResultRecord", lua_likwid_writeResultRecord);
+    lua_register(L, "likwid_mergeResultRecords", lua_likwid_mergeResultRecords);
+    lua_register(L, "likwid_readResultRecords", lua_likwid_readResultRecords);
+    // Plot functions
+    lua_register(L, "likwid_plotOpen", lua_likwid_plotOpen);
+    lua_register(L, "likwid_plotRecord", lua_likwid_plotRecord);
+    lua_register(L, "likwid_plotCommand", lua_likwid_plotCommand);
+    lua_register(L, "likwid_plotAdd", lua_likwid_plotAdd);
+    lua_register(L, "likwid_plotFrame", lua_likwid_plotFrame);
+    lua_register(L, "likwid_plotClose", lua_likwid_plotClose);
     lua_register(L, "likwid_access", lua_likwid_access);
     lua_register(L, "likwid_startProgram", lua_likwid_startProgram);
     lua_register(L, "likwid_checkProgram", lua_likwid_checkProgram);
@@ -1912,6 +3084,9 @@ int __attribute__ ((visibility ("default") )) luaopen_liblikwid(lua_State* L){
     lua_register(L, "likwid_markerThreadInit", lua_likwid_markerThreadInit);
     lua_register(L, "likwid_markerNextGroup", lua_likwid_markerNext);
     lua_register(L, "likwid_markerClose", lua_likwid_markerClose);
+    lua_register(L, "likwid_markerFileOpen", lua_likwid_markerFileOpen);
+    lua_register(L, "likwid_markerFileRegion", lua_likwid_markerFileRegion);
+    lua_register(L, "likwid_markerFileClose", lua_likwid_markerFileClose);
     lua_register(L, "likwid_registerRegion", lua_likwid_registerRegion);
     lua_register(L, "likwid_startRegion", lua_likwid_startRegion);
     lua_register(L, "likwid_stopRegion", lua_likwid_stopRegion);
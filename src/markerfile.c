@@ -0,0 +1,448 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  markerfile.c
+ *
+ *      Description:  Binary result file of the Marker API. The file is written
+ *                    once at likwid_markerClose(), stream files get a record
+ *                    appended at every flush. Files are read through a read-only
+ *                    mapping, the arrays of each region are used in place.
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+/* #####   HEADER FILE INCLUDES   ######################################### */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <types.h>
+#include <error.h>
+#include <markerfile.h>
+
+/* #####   MACROS  -  LOCAL TO THIS SOURCE FILE   ######################### */
+
+#define MARKER_ALIGN(x) (((x) + 7) & ~((uint64_t)7))
+
+/* #####   LOCAL TYPE DEFINITIONS   ####################################### */
+
+typedef struct {
+    void* map;
+    size_t mapLength;
+    const char* base;
+    size_t length;
+    int record;
+    int numRecords;
+    const MarkerHeader* header;
+    const MarkerRegion* regions;
+    const char* strings;
+} MarkerFile;
+
+/* #####   VARIABLES  -  LOCAL TO THIS SOURCE FILE   ###################### */
+
+static MarkerFile* marker_files[MARKER_MAX_FILES];
+
+/* #####   FUNCTION DEFINITIONS  -  LOCAL TO THIS SOURCE FILE   ########### */
+
+static uint64_t
+marker_regionSize(int numThreads, int numEvents)
+{
+    return MARKER_ALIGN(numThreads * sizeof(int32_t)) +
+           numThreads * (sizeof(uint64_t) + 2 * sizeof(double)) +
+           2 * (uint64_t)numThreads * numEvents * sizeof(double);
+}
+
+static int
+marker_pad(FILE* fp, uint64_t size)
+{
+    static const char zero[8] = {0};
+    uint64_t pad = MARKER_ALIGN(size) - size;
+    if (pad > 0 && fwrite(zero, 1, pad, fp) != pad)
+    {
+        return -EIO;
+    }
+    return 0;
+}
+
+/* Returns the size of a complete record at the given position or 0 */
+static uint64_t
+marker_checkRecord(const char* base, uint64_t remain)
+{
+    const MarkerHeader* header = (const MarkerHeader*)base;
+    if ((remain < sizeof(MarkerHeader)) ||
+        (strncmp(header->magic, MARKER_MAGIC, sizeof(header->magic)) != 0) ||
+        (header->version != MARKER_VERSION) ||
+        (header->recordSize % 8 != 0) ||
+        (header->recordSize > remain) ||
+        (header->stringOffset != sizeof(MarkerHeader) + header->numRegions * sizeof(MarkerRegion)) ||
+        (header->stringOffset + header->stringSize > header->recordSize) ||
+        (header->stringSize > 0 && base[header->stringOffset + header->stringSize - 1] != '\0'))
+    {
+        return 0;
+    }
+    return header->recordSize;
+}
+
+static MarkerFile*
+marker_get(int handle)
+{
+    if ((handle < 0) || (handle >= MARKER_MAX_FILES))
+    {
+        return NULL;
+    }
+    return marker_files[handle];
+}
+
+static int
+marker_writeRecord(FILE* fp, double timestamp, int numThreads, int numRegions,
+                   int numGroups, LikwidResults* results, const int* numEvents)
+{
+    int i, j;
+    int ret = 0;
+    MarkerHeader header;
+    MarkerRegion region;
+    uint64_t offset = 0;
+    uint64_t stringSize = 0;
+    uint64_t* count = NULL;
+
+    for (i = 0; i < numRegions; i++)
+    {
+        stringSize += blength(results[i].tag) + 1;
+    }
+    count = malloc(numThreads * sizeof(uint64_t));
+    if (count == NULL)
+    {
+        return -ENOMEM;
+    }
+    memset(&header, 0, sizeof(MarkerHeader));
+    memcpy(header.magic, MARKER_MAGIC, sizeof(header.magic));
+    header.version = MARKER_VERSION;
+    header.numThreads = numThreads;
+    header.numRegions = numRegions;
+    header.numGroups = numGroups;
+    header.stringOffset = sizeof(MarkerHeader) + numRegions * sizeof(MarkerRegion);
+    header.stringSize = stringSize;
+    header.recordSize = MARKER_ALIGN(header.stringOffset + stringSize);
+    for (i = 0; i < numRegions; i++)
+    {
+        header.recordSize += marker_regionSize(numThreads, numEvents[results[i].groupID]);
+    }
+    header.timestamp = timestamp;
+    if (fwrite(&header, sizeof(MarkerHeader), 1, fp) != 1)
+    {
+        ret = -EIO;
+    }
+    /* Region table, the data follows the aligned string table */
+    offset = MARKER_ALIGN(header.stringOffset + stringSize);
+    stringSize = 0;
+    for (i = 0; ret == 0 && i < numRegions; i++)
+    {
+        memset(&region, 0, sizeof(MarkerRegion));
+        region.tagOffset = stringSize;
+        region.dataOffset = offset;
+        region.groupId = results[i].groupID;
+        region.numEvents = numEvents[results[i].groupID];
+        if (fwrite(&region, sizeof(MarkerRegion), 1, fp) != 1)
+        {
+            ret = -EIO;
+        }
+        stringSize += blength(results[i].tag) + 1;
+        offset += marker_regionSize(numThreads, region.numEvents);
+    }
+    for (i = 0; ret == 0 && i < numRegions; i++)
+    {
+        if (fwrite(bdata(results[i].tag), 1, blength(results[i].tag) + 1, fp) !=
+                (size_t)(blength(results[i].tag) + 1))
+        {
+            ret = -EIO;
+        }
+    }
+    if (ret == 0)
+    {
+        ret = marker_pad(fp, header.stringOffset + stringSize);
+    }
+    for (i = 0; ret == 0 && i < numRegions; i++)
+    {
+        int numRegionEvents = numEvents[results[i].groupID];
+        for (j = 0; j < numThreads; j++)
+        {
+            int32_t cpu = results[i].cpulist[j];
+            count[j] = results[i].count[j];
+            if (fwrite(&cpu, sizeof(int32_t), 1, fp) != 1)
+            {
+                ret = -EIO;
+            }
+        }
+        if (ret == 0)
+        {
+            ret = marker_pad(fp, numThreads * sizeof(int32_t));
+        }
+        if (ret == 0 &&
+            (fwrite(count, sizeof(uint64_t), numThreads, fp) != (size_t)numThreads ||
+             fwrite(results[i].time, sizeof(double), numThreads, fp) != (size_t)numThreads))
+        {
+            ret = -EIO;
+        }
+        for (j = 0; ret == 0 && j < numThreads; j++)
+        {
+            if (fwrite(results[i].counters[j], sizeof(double), numRegionEvents, fp) !=
+                    (size_t)numRegionEvents)
+            {
+                ret = -EIO;
+            }
+        }
+        if (ret == 0 &&
+            fwrite(results[i].exclusiveTime, sizeof(double), numThreads, fp) != (size_t)numThreads)
+        {
+            ret = -EIO;
+        }
+        for (j = 0; ret == 0 && j < numThreads; j++)
+        {
+            if (fwrite(results[i].exclusiveCounters[j], sizeof(double), numRegionEvents, fp) !=
+                    (size_t)numRegionEvents)
+            {
+                ret = -EIO;
+            }
+        }
+    }
+    free(count);
+    return ret;
+}
+
+/* #####   FUNCTION DEFINITIONS  -  EXPORTED FUNCTIONS   ################## */
+
+int
+markerfile_write(const char* filename, int numThreads, int numRegions,
+                 int numGroups, LikwidResults* results, const int* numEvents)
+{
+    int ret = 0;
+    FILE* fp = fopen(filename, "w");
+    if (fp == NULL)
+    {
+        return -errno;
+    }
+    ret = marker_writeRecord(fp, 0.0, numThreads, numRegions, numGroups, results, numEvents);
+    if (fclose(fp) != 0 && ret == 0)
+    {
+        ret = -EIO;
+    }
+    return ret;
+}
+
+/* Appends a record to a stream file. A record that is cut off because the
+ * process ends while writing is skipped by the reader. */
+int
+markerfile_append(const char* filename, double timestamp, int numThreads, int numRegions,
+                  int numGroups, LikwidResults* results, const int* numEvents)
+{
+    int ret = 0;
+    FILE* fp = fopen(filename, "a");
+    if (fp == NULL)
+    {
+        return -errno;
+    }
+    ret = marker_writeRecord(fp, timestamp, numThreads, numRegions, numGroups, results, numEvents);
+    if (fclose(fp) != 0 && ret == 0)
+    {
+        ret = -EIO;
+    }
+    return ret;
+}
+
+int
+markerfile_open(const char* filename)
+{
+    return markerfile_openRecord(filename, 0);
+}
+
+/* Opens the record with the given index, negative indices count from the last
+ * complete record of the file */
+int
+markerfile_openRecord(const char* filename, int record)
+{
+    int i;
+    int fd;
+    int handle = -1;
+    int numRecords = 0;
+    struct stat st;
+    void* map = NULL;
+    uint64_t offset = 0;
+    uint64_t recordSize = 0;
+    uint64_t recordOffset = 0;
+    MarkerFile* file = NULL;
+
+    for (i = 0; i < MARKER_MAX_FILES; i++)
+    {
+        if (marker_files[i] == NULL)
+        {
+            handle = i;
+            break;
+        }
+    }
+    if (handle < 0)
+    {
+        return -EMFILE;
+    }
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return -errno;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(MarkerHeader))
+    {
+        close(fd);
+        return -EINVAL;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return -errno;
+    }
+    while ((recordSize = marker_checkRecord((const char*)map + offset, st.st_size - offset)) > 0)
+    {
+        offset += recordSize;
+        numRecords++;
+    }
+    if (record < 0)
+    {
+        record += numRecords;
+    }
+    if ((record < 0) || (record >= numRecords))
+    {
+        munmap(map, st.st_size);
+        return -EINVAL;
+    }
+    for (i = 0; i < record; i++)
+    {
+        recordOffset += ((const MarkerHeader*)((const char*)map + recordOffset))->recordSize;
+    }
+    file = malloc(sizeof(MarkerFile));
+    if (file == NULL)
+    {
+        munmap(map, st.st_size);
+        return -ENOMEM;
+    }
+    file->map = map;
+    file->mapLength = st.st_size;
+    file->base = (const char*)map + recordOffset;
+    file->header = (const MarkerHeader*)file->base;
+    file->length = file->header->recordSize;
+    file->record = record;
+    file->numRecords = numRecords;
+    file->regions = (const MarkerRegion*)(file->base + sizeof(MarkerHeader));
+    file->strings = file->base + file->header->stringOffset;
+    marker_files[handle] = file;
+    return handle;
+}
+
+int
+markerfile_getInfo(int handle, int* numThreads, int* numRegions, int* numGroups)
+{
+    MarkerFile* file = marker_get(handle);
+    if (file == NULL)
+    {
+        return -EBADF;
+    }
+    *numThreads = file->header->numThreads;
+    *numRegions = file->header->numRegions;
+    *numGroups = file->header->numGroups;
+    return 0;
+}
+
+int
+markerfile_getRecordInfo(int handle, int* record, int* numRecords, double* timestamp)
+{
+    MarkerFile* file = marker_get(handle);
+    if (file == NULL)
+    {
+        return -EBADF;
+    }
+    *record = file->record;
+    *numRecords = file->numRecords;
+    *timestamp = file->header->timestamp;
+    return 0;
+}
+
+int
+markerfile_getRegion(int handle, int region, MarkerFileRegion* data)
+{
+    int numThreads;
+    const char* base = NULL;
+    const MarkerRegion* r = NULL;
+    MarkerFile* file = marker_get(handle);
+
+    if (file == NULL)
+    {
+        return -EBADF;
+    }
+    if ((region < 0) || (region >= (int)file->header->numRegions))
+    {
+        return -EINVAL;
+    }
+    r = &file->regions[region];
+    numThreads = file->header->numThreads;
+    if ((r->tagOffset >= file->header->stringSize) ||
+        (r->dataOffset % 8 != 0) ||
+        (r->dataOffset > file->length) ||
+        (marker_regionSize(numThreads, r->numEvents) > file->length - r->dataOffset))
+    {
+        return -EINVAL;
+    }
+    base = file->base + r->dataOffset;
+    data->tag = file->strings + r->tagOffset;
+    data->groupId = r->groupId;
+    data->numEvents = r->numEvents;
+    data->cpus = (const int32_t*)base;
+    base += MARKER_ALIGN(numThreads * sizeof(int32_t));
+    data->count = (const uint64_t*)base;
+    base += numThreads * sizeof(uint64_t);
+    data->time = (const double*)base;
+    base += numThreads * sizeof(double);
+    data->counters = (const double*)base;
+    base += (size_t)numThreads * r->numEvents * sizeof(double);
+    data->exclusiveTime = (const double*)base;
+    base += numThreads * sizeof(double);
+    data->exclusiveCounters = (const double*)base;
+    return 0;
+}
+
+void
+markerfile_close(int handle)
+{
+    MarkerFile* file = marker_get(handle);
+    if (file == NULL)
+    {
+        return;
+    }
+    munmap(file->map, file->mapLength);
+    free(file);
+    marker_files[handle] = NULL;
+}
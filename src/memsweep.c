@@ -32,7 +32,15 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <dirent.h>
 #include <sys/mman.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include <error.h>
 #include <types.h>
@@ -40,6 +48,7 @@
 #include <topology.h>
 #include <numa.h>
 #include <affinity.h>
+#include <numa_proc.h>
 
 extern void _loadData(uint32_t size, void* ptr);
 
@@ -48,6 +57,30 @@ extern void _loadData(uint32_t size, void* ptr);
 
 /* #####   MACROS  -  LOCAL TO THIS SOURCE FILE   ######################### */
 
+/* Pages are touched with non-temporal stores to keep the sweep from
+ * polluting the caches */
+#ifdef __SSE2__
+#define SWEEP_STORE(ptr) _mm_stream_si32((int*)(ptr), (int)0xEFEFEFEF)
+#define SWEEP_FENCE() _mm_sfence()
+#else
+#define SWEEP_STORE(ptr) *((volatile char*)(ptr)) = (char) 0xEF
+#define SWEEP_FENCE()
+#endif
+
+#define DROP_CACHES_FILE "/proc/sys/vm/drop_caches"
+#define COMPACT_MEMORY_FILE "/proc/sys/vm/compact_memory"
+
+/* #####   LOCAL TYPE DEFINITIONS   ####################################### */
+
+/* Page range of a domain that is touched and released by one worker, or
+ * the LLC of a socket for cleanup workers */
+typedef struct {
+    int cpu;
+    char* ptr;
+    size_t size;
+    pthread_t thread;
+    int started;
+} SweepWorker;
 
 /* #####   VARIABLES  -  LOCAL TO THIS SOURCE FILE   ###################### */
 
@@ -63,9 +96,10 @@ allocateOnNode(size_t size, int domainId)
 
 	ptr = mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, 0, 0);  
 
-	if (ptr == (char *)-1)
+	if (ptr == MAP_FAILED)
     {
-        ERROR;
+        ERROR_PRINT(Cannot allocate %g MB for domain %d, size / (1024.0 * 1024.0), domainId);
+        return NULL;
     }
 
     numa_membind(ptr, size, domainId);
@@ -73,15 +107,32 @@ allocateOnNode(size_t size, int domainId)
     return ptr;
 }
 
-static void 
-initMemory(size_t size, char* ptr, int domainId)
+static void
+pinWorker(int cpu)
+{
+    cpu_set_t set;
+
+    if (cpu >= 0)
+    {
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        sched_setaffinity(0, sizeof(cpu_set_t), &set);
+    }
+}
+
+static void*
+initMemory(void* arg)
 {
-    affinity_pinProcess(numa_info.nodes[domainId].processors[0]);
+    SweepWorker* worker = (SweepWorker*) arg;
 
-    for (size_t i=0; i < size; i += PAGE_ALIGNMENT)
+    pinWorker(worker->cpu);
+    for (size_t i=0; i < worker->size; i += PAGE_ALIGNMENT)
     {
-        ptr[i] = (char) 0xEF;
+        SWEEP_STORE(worker->ptr + i);
     }
+    SWEEP_FENCE();
+    munmap(worker->ptr, worker->size);
+    return NULL;
 }
 
 static int
@@ -99,18 +150,300 @@ findProcessor(uint32_t nodeId, uint32_t coreId)
     return 0;
 }
 
+static HWThread*
+findHWThread(int cpu)
+{
+    for (uint32_t i = 0; i < cpuid_topology.numHWThreads; i++)
+    {
+        if ((int)cpuid_topology.threadPool[i].apicId == cpu)
+        {
+            return &cpuid_topology.threadPool[i];
+        }
+    }
+    return NULL;
+}
+
+static int
+writeSysfs(const char* filename, const char* value)
+{
+    int ret = 0;
+    FILE* fp = fopen(filename, "w");
+
+    if (fp == NULL)
+    {
+        return -errno;
+    }
+    if (fputs(value, fp) < 0)
+    {
+        ret = -errno;
+    }
+    if ((fclose(fp) != 0) && (ret == 0))
+    {
+        ret = -errno;
+    }
+    return ret;
+}
+
+static int64_t
+readSysfs(const char* filename)
+{
+    long long value = -1;
+    FILE* fp = fopen(filename, "r");
+
+    if (fp != NULL)
+    {
+        if (fscanf(fp, "%lld", &value) != 1)
+        {
+            value = -1;
+        }
+        fclose(fp);
+    }
+    return (int64_t)value;
+}
+
+/* Free memory of a NUMA node in kB, 0 if the node has no meminfo file */
+static uint64_t
+freeNodeMemory(int domainId)
+{
+    char filename[128];
+    uint64_t totalMemory = 0;
+    uint64_t freeMemory = 0;
+
+    snprintf(filename, 127, "/sys/devices/system/node/node%d/meminfo",
+             numa_info.nodes[domainId].id);
+    if (access(filename, R_OK) == 0)
+    {
+        nodeMeminfo(numa_info.nodes[domainId].id, &totalMemory, &freeMemory);
+    }
+    return freeMemory;
+}
+
+/* Free and total size of the huge page pools of a NUMA node in kB */
+static void
+hugeNodeMemory(int domainId, uint64_t* freeMemory, uint64_t* totalMemory)
+{
+    DIR* dir;
+    struct dirent* de;
+    char dirname[128];
+    char filename[512];
+
+    *freeMemory = 0;
+    *totalMemory = 0;
+    snprintf(dirname, 127, "/sys/devices/system/node/node%d/hugepages",
+             numa_info.nodes[domainId].id);
+    dir = opendir(dirname);
+    if (dir == NULL)
+    {
+        return;
+    }
+    while ((de = readdir(dir)) != NULL)
+    {
+        unsigned long pagesize = 0;
+        int64_t nr, nfree;
+        if (sscanf(de->d_name, "hugepages-%lukB", &pagesize) != 1)
+        {
+            continue;
+        }
+        snprintf(filename, 511, "%s/%s/nr_hugepages", dirname, de->d_name);
+        nr = readSysfs(filename);
+        snprintf(filename, 511, "%s/%s/free_hugepages", dirname, de->d_name);
+        nfree = readSysfs(filename);
+        if ((nr > 0) && (nfree >= 0))
+        {
+            *totalMemory += nr * pagesize;
+            *freeMemory += nfree * pagesize;
+        }
+    }
+    closedir(dir);
+}
+
 /* evict all dirty cachelines from last level cache */
-static void cleanupCache(char* ptr)
+static void* cleanupCache(void* arg)
 {
+    SweepWorker* worker = (SweepWorker*) arg;
+
+    pinWorker(worker->cpu);
 #if defined(__x86_64__) || defined(__i386__)
+    _loadData(worker->size, worker->ptr);
+#endif
+    return NULL;
+}
+
+/* Runs the workers concurrently. If a worker thread cannot be created, its
+ * work is done by the calling thread. */
+static void
+runWorkers(SweepWorker* workers, int numWorkers, void* (*func)(void*))
+{
+    for (int i = 0; i < numWorkers; i++)
+    {
+        workers[i].started = 0;
+        if (pthread_create(&workers[i].thread, NULL, func, &workers[i]) == 0)
+        {
+            workers[i].started = 1;
+        }
+    }
+    for (int i = 0; i < numWorkers; i++)
+    {
+        if (workers[i].started)
+        {
+            pthread_join(workers[i].thread, NULL);
+        }
+        else
+        {
+            func(&workers[i]);
+        }
+    }
+}
+
+/* Cleans the LLC of all sockets in parallel, one worker per socket */
+static void
+cleanupCaches(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    int numWorkers = 0;
+    uint32_t* packages = NULL;
+    SweepWorker* workers = NULL;
     uint32_t cachesize = 2 * cpuid_topology.cacheLevels[cpuid_topology.numCacheLevels-1].size;
-    printf("Cleaning LLC with %g MB\n", (double)cachesize/(1024.0 * 1024.0));
-    _loadData(cachesize,ptr);
+
+    packages = (uint32_t*) malloc(cpuid_topology.numHWThreads * sizeof(uint32_t));
+    workers = (SweepWorker*) calloc(cpuid_topology.numHWThreads, sizeof(SweepWorker));
+    if ((packages == NULL) || (workers == NULL))
+    {
+        ERROR_PLAIN_PRINT(Cannot allocate cache cleanup workers);
+        free(packages);
+        free(workers);
+        return;
+    }
+    for (uint32_t i = 0; i < cpuid_topology.numHWThreads; i++)
+    {
+        HWThread* t = &cpuid_topology.threadPool[i];
+        int j;
+        if (!t->inCpuSet)
+        {
+            continue;
+        }
+        for (j = 0; j < numWorkers; j++)
+        {
+            if (packages[j] == t->packageId)
+            {
+                break;
+            }
+        }
+        if (j < numWorkers)
+        {
+            continue;
+        }
+        workers[numWorkers].ptr = mmap(0, cachesize, PROT_READ|PROT_WRITE,
+                                       MAP_PRIVATE|MAP_ANONYMOUS, 0, 0);
+        if (workers[numWorkers].ptr == MAP_FAILED)
+        {
+            ERRNO_PRINT;
+            continue;
+        }
+        packages[numWorkers] = t->packageId;
+        workers[numWorkers].cpu = t->apicId;
+        workers[numWorkers].size = cachesize;
+        numWorkers++;
+    }
+    printf("Cleaning LLC of %d sockets with %g MB\n", numWorkers,
+            (double)cachesize/(1024.0 * 1024.0));
+    runWorkers(workers, numWorkers, cleanupCache);
+    for (int i = 0; i < numWorkers; i++)
+    {
+        munmap(workers[i].ptr, workers[i].size);
+    }
+    free(packages);
+    free(workers);
 #else
     ERROR_PLAIN_PRINT(Cleanup cache is currently only available on X86 systems.);
 #endif
 }
 
+/* Sweeps the given domains concurrently with one worker per core of each
+ * domain. Every worker touches and releases its own page range. Domains
+ * whose memory cannot be allocated are skipped. */
+static int
+sweepDomains(int* domainList, int numberOfDomains)
+{
+    int ret = 0;
+    int numWorkers = 0;
+    int maxWorkers = 0;
+    SweepWorker* workers = NULL;
+
+    for (int d = 0; d < numberOfDomains; d++)
+    {
+        maxWorkers += numa_info.nodes[domainList[d]].numberOfProcessors + 1;
+    }
+    workers = (SweepWorker*) calloc(maxWorkers, sizeof(SweepWorker));
+    if (workers == NULL)
+    {
+        ERROR_PLAIN_PRINT(Cannot allocate sweep workers);
+        return -ENOMEM;
+    }
+
+    for (int d = 0; d < numberOfDomains; d++)
+    {
+        int domainId = domainList[d];
+        NumaNode* node = &numa_info.nodes[domainId];
+        int first = numWorkers;
+        int numCores = 0;
+        size_t pages, offset = 0;
+        char* ptr = NULL;
+        size_t size = node->totalMemory * 1024ULL * memoryFraction / 100ULL;
+        printf("Sweeping domain %d: Using %g MB of %g MB\n",
+                domainId,
+                size / (1024.0 * 1024.0),
+                node->totalMemory/ 1024.0);
+        if (size == 0)
+        {
+            continue;
+        }
+        ptr = (char*) allocateOnNode(size, domainId);
+        if (ptr == NULL)
+        {
+            ret = -ENOMEM;
+            continue;
+        }
+
+        /* One worker for the first hardware thread of each core. Domains
+         * without CPUs are touched by a single unpinned worker */
+        for (uint32_t i = 0; i < node->numberOfProcessors; i++)
+        {
+            HWThread* t = findHWThread(node->processors[i]);
+            if ((t == NULL) || (t->threadId == 0))
+            {
+                workers[numWorkers + numCores].cpu = node->processors[i];
+                numCores++;
+            }
+        }
+        if (numCores == 0)
+        {
+            workers[numWorkers].cpu = -1;
+            numCores = 1;
+        }
+
+        pages = (size + PAGE_ALIGNMENT - 1) / PAGE_ALIGNMENT;
+        if ((size_t)numCores > pages)
+        {
+            numCores = pages;
+        }
+        for (int i = 0; i < numCores; i++)
+        {
+            size_t count = (pages / numCores) + ((size_t)i < (pages % numCores) ? 1 : 0);
+            workers[first + i].ptr = ptr + offset;
+            workers[first + i].size = count * PAGE_ALIGNMENT;
+            offset += count * PAGE_ALIGNMENT;
+        }
+        workers[first + numCores - 1].size = size - (offset - workers[first + numCores - 1].size);
+        numWorkers += numCores;
+    }
+
+    runWorkers(workers, numWorkers, initMemory);
+    free(workers);
+    cleanupCaches();
+    return ret;
+}
+
 
 /* #####   FUNCTION DEFINITIONS  -  EXPORTED FUNCTIONS   ################## */
 
@@ -124,42 +457,120 @@ memsweep_setMemoryFraction(uint64_t fraction)
 void
 memsweep_node(void)
 {
+    int domains[numa_info.numberOfNodes];
+
     for ( uint32_t i=0; i < numa_info.numberOfNodes; i++)
     {
-        memsweep_domain(i);
+        domains[i] = i;
     }
+    sweepDomains(domains, numa_info.numberOfNodes);
 }
 
 
 void
 memsweep_domain(int domainId)
 {
-    char* ptr = NULL;
-    size_t size = numa_info.nodes[domainId].totalMemory * 1024ULL * memoryFraction / 100ULL;
-    printf("Sweeping domain %d: Using %g MB of %g MB\n",
-            domainId,
-            size / (1024.0 * 1024.0),
-            numa_info.nodes[domainId].totalMemory/ 1024.0);
-    ptr = (char*) allocateOnNode(size, domainId);
-    initMemory(size, ptr, domainId);
-    cleanupCache(ptr);
-    munmap(ptr, size);
+    sweepDomains(&domainId, 1);
+}
+
+void
+memsweep_domainList(int* domainList, int numberOfDomains)
+{
+    for (int i = 0; i < numberOfDomains; i++)
+    {
+        if ((domainList[i] < 0) || (domainList[i] >= (int)numa_info.numberOfNodes))
+        {
+            ERROR_PRINT(Invalid NUMA domain %d, domainList[i]);
+            return;
+        }
+    }
+    sweepDomains(domainList, numberOfDomains);
+}
+
+int
+memsweep_reclaimDomains(int* domainList, int numberOfDomains)
+{
+    int ret = 0;
+    char filename[128];
+    uint64_t before[numberOfDomains];
+    int compactAll = 0;
+
+    for (int i = 0; i < numberOfDomains; i++)
+    {
+        if ((domainList[i] < 0) || (domainList[i] >= (int)numa_info.numberOfNodes))
+        {
+            ERROR_PRINT(Invalid NUMA domain %d, domainList[i]);
+            return -EINVAL;
+        }
+        before[i] = freeNodeMemory(domainList[i]);
+    }
+
+    /* The kernel drops the page cache only system-wide, compaction is
+     * done per node if the node interface exists */
+    sync();
+    ret = writeSysfs(DROP_CACHES_FILE, "1");
+    if (ret < 0)
+    {
+        fprintf(stderr, "Cannot drop page cache: %s\n", strerror(-ret));
+    }
+    else
+    {
+        for (int i = 0; i < numberOfDomains; i++)
+        {
+            snprintf(filename, 127, "/sys/devices/system/node/node%d/compact",
+                     numa_info.nodes[domainList[i]].id);
+            if (writeSysfs(filename, "1") < 0)
+            {
+                compactAll = 1;
+            }
+        }
+        if ((compactAll) && (writeSysfs(COMPACT_MEMORY_FILE, "1") < 0))
+        {
+            DEBUG_PLAIN_PRINT(DEBUGLEV_INFO, Memory compaction not supported);
+        }
+    }
+
+    if (ret < 0)
+    {
+        printf("Falling back to sweeping with anonymous memory\n");
+        ret = sweepDomains(domainList, numberOfDomains);
+    }
+
+    for (int i = 0; i < numberOfDomains; i++)
+    {
+        uint64_t hugeFree, hugeTotal;
+        uint64_t after = freeNodeMemory(domainList[i]);
+        numa_info.nodes[domainList[i]].freeMemory = after;
+        printf("Domain %d: Free memory %g MB before, %g MB after\n",
+                domainList[i], before[i] / 1024.0, after / 1024.0);
+        hugeNodeMemory(domainList[i], &hugeFree, &hugeTotal);
+        if (hugeTotal > 0)
+        {
+            printf("Domain %d: %g MB of %g MB in huge pages are free\n",
+                    domainList[i], hugeFree / 1024.0, hugeTotal / 1024.0);
+        }
+    }
+    return ret;
 }
 
 void
 memsweep_threadGroup(int* processorList, int numberOfProcessors)
 {
+    int numDomains = 0;
+    int domains[numa_info.numberOfNodes];
+
     for (uint32_t i=0; i<numa_info.numberOfNodes; i++)
     {
         for (int j=0; j<numberOfProcessors; j++)
         {
             if (findProcessor(i,processorList[j]))
             {
-                memsweep_domain(i);
+                domains[numDomains++] = i;
                 break;
             }
         }
     }
+    sweepDomains(domains, numDomains);
 }
 
 
@@ -34,6 +34,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <sched.h>
@@ -53,6 +55,7 @@
 
 #include <numa.h>
 #include <numa_proc.h>
+#include <topology_cache.h>
 
 #ifdef LIKWID_USE_HWLOC
 #include <hwloc.h>
@@ -115,12 +118,28 @@ empty_numa_membind(void* ptr, size_t size, int domainId)
     return;
 }
 
+int
+empty_numa_setInterleavedDomains(int* domainList, int numberOfDomains)
+{
+    printf("MEMPOLICY NOT supported in kernel!\n");
+    return -ENOSYS;
+}
+
+int
+empty_numa_interleaveWeighted(void* ptr, size_t size, int* domainList, int* weights, int numberOfDomains)
+{
+    printf("MBIND NOT supported in kernel!\n");
+    return -ENOSYS;
+}
+
 
 const struct numa_functions numa_funcs = {
 #ifndef HAS_MEMPOLICY
     .numa_init = empty_numa_init,
     .numa_setInterleaved = empty_numa_setInterleaved,
-    .numa_membind = empty_numa_membind
+    .numa_membind = empty_numa_membind,
+    .numa_setInterleavedDomains = empty_numa_setInterleavedDomains,
+    .numa_interleaveWeighted = empty_numa_interleaveWeighted
 #else
 #ifdef LIKWID_USE_HWLOC
     .numa_init = hwloc_numa_init,
@@ -128,7 +147,9 @@ const struct numa_functions numa_funcs = {
     .numa_init = proc_numa_init,
 #endif
     .numa_setInterleaved = proc_numa_setInterleaved,
-    .numa_membind = proc_numa_membind
+    .numa_membind = proc_numa_membind,
+    .numa_setInterleavedDomains = proc_numa_setInterleavedDomains,
+    .numa_interleaveWeighted = proc_numa_interleaveWeighted
 #endif
 };
 
@@ -146,19 +167,72 @@ int numa_init(void)
         return 0;
     }
 
-    if ((config.topologyCfgFileName == NULL)||(access(config.topologyCfgFileName, R_OK) && numa_info.numberOfNodes <= 0))
+    if (topocache_loaded && numa_info.numberOfNodes > 0)
+    {
+        /* Structure is filled from the topology cache, only the free memory
+         * is not static */
+        for (int i=0;i<numa_info.numberOfNodes;i++)
+        {
+            uint64_t totalMemory = 0;
+            bstring filename = bformat("/sys/devices/system/node/node%d/meminfo", numa_info.nodes[i].id);
+            if (!access(bdata(filename), R_OK))
+            {
+                nodeMeminfo(numa_info.nodes[i].id, &totalMemory, &numa_info.nodes[i].freeMemory);
+            }
+            bdestroy(filename);
+        }
+    }
+    else if ((config.topologyCfgFileName == NULL)||(access(config.topologyCfgFileName, R_OK) && numa_info.numberOfNodes <= 0))
     {
         cpu_set_t cpuSet;
         CPU_ZERO(&cpuSet);
         sched_getaffinity(0,sizeof(cpu_set_t), &cpuSet);
+        struct timespec start, end;
+        char* backend = "procfs";
+        clock_gettime(CLOCK_MONOTONIC, &start);
         if (cpuid_topology.activeHWThreads < cpuid_topology.numHWThreads)
         {
             ret = proc_numa_init();
         }
+#ifdef LIKWID_USE_HWLOC
+        else if (!config_useHwloc())
+        {
+            /* hwloc is only loaded if the kernel does not export the NUMA
+             * nodes or they cannot be read */
+            ret = -ENOENT;
+            if (access("/sys/devices/system/node/node0/meminfo", R_OK) == 0)
+            {
+                ret = proc_numa_init();
+            }
+            if (ret < 0)
+            {
+                for (int i = 0; (numa_info.nodes != NULL) && (i < numa_info.numberOfNodes); i++)
+                {
+                    free(numa_info.nodes[i].processors);
+                    free(numa_info.nodes[i].distances);
+                }
+                free(numa_info.nodes);
+                numa_info.nodes = NULL;
+                numa_info.numberOfNodes = 0;
+                backend = "hwloc";
+                ret = funcs.numa_init();
+            }
+        }
+#endif
         else
         {
+#ifdef LIKWID_USE_HWLOC
+            backend = "hwloc";
+#endif
             ret = funcs.numa_init();
         }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        DEBUG_PRINT(DEBUGLEV_INFO, NUMA discovery with %s backend took %.3f ms, backend,
+                    ((end.tv_sec - start.tv_sec) * 1E3) + ((end.tv_nsec - start.tv_nsec) * 1E-6));
+        if ((ret == 0) && (topocache_pending))
+        {
+            topology_cacheWrite();
+        }
     }
     numaInitialized = 1;
     return ret;
@@ -176,6 +250,18 @@ void numa_membind(void* ptr, size_t size, int domainId)
     return funcs.numa_membind(ptr, size, domainId);
 }
 
+int numa_setInterleavedDomains(int* domainList, int numberOfDomains)
+{
+    const struct numa_functions funcs = numa_funcs;
+    return funcs.numa_setInterleavedDomains(domainList, numberOfDomains);
+}
+
+int numa_interleaveWeighted(void* ptr, size_t size, int* domainList, int* weights, int numberOfDomains)
+{
+    const struct numa_functions funcs = numa_funcs;
+    return funcs.numa_interleaveWeighted(ptr, size, domainList, weights, numberOfDomains);
+}
+
 #ifndef HAS_MEMPOLICY
 void numa_finalize(void)
 {
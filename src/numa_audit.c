@@ -0,0 +1,498 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  numa_audit.c
+ *
+ *      Description:  Auditor for the NUMA placement of the pages of a running
+ *                    process. The page counts per NUMA domain are taken from
+ *                    /proc/<pid>/numa_maps, mis-placed pages can be migrated
+ *                    with move_pages by multiple threads.
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+/* #####   HEADER FILE INCLUDES   ######################################### */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#ifdef HAS_MEMPOLICY
+#include <linux/mempolicy.h>
+#endif
+
+#include <types.h>
+#include <error.h>
+#include <numa.h>
+#include <topology.h>
+#include <numa_audit.h>
+
+/* #####   MACROS  -  LOCAL TO THIS SOURCE FILE   ######################### */
+
+#ifdef HAS_MEMPOLICY
+#define move_pages(pid, count, pages, nodes, status, flags) syscall(SYS_move_pages,pid,count,pages,nodes,status,flags)
+#endif
+
+/* #####   LOCAL TYPE DEFINITIONS   ####################################### */
+
+typedef struct {
+    AuditProcess* audit;
+    int domain;
+    int node;
+    int mapping;
+    uint64_t offset;
+    uint64_t moved;
+    int error;
+    pthread_mutex_t lock;
+} AuditMigration;
+
+/* #####   FUNCTION DEFINITIONS  -  LOCAL TO THIS SOURCE FILE   ########### */
+
+static int
+audit_domainIndex(int nodeId)
+{
+    for (uint32_t i = 0; i < numa_info.numberOfNodes; i++)
+    {
+        if ((int)numa_info.nodes[i].id == nodeId)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static AuditMapping*
+audit_findMapping(AuditProcess* audit, uint64_t addr)
+{
+    for (int i = 0; i < audit->numMappings; i++)
+    {
+        if ((addr >= audit->mappings[i].start) && (addr < audit->mappings[i].end))
+        {
+            return &audit->mappings[i];
+        }
+    }
+    return NULL;
+}
+
+/* The end addresses are not part of numa_maps, they are taken from maps */
+static void
+audit_readEnds(AuditProcess* audit)
+{
+    FILE* fp;
+    char filename[64];
+    char* line = NULL;
+    size_t len = 0;
+    unsigned long start, end;
+
+    snprintf(filename, sizeof(filename), "/proc/%d/maps", audit->pid);
+    fp = fopen(filename, "r");
+    if (fp == NULL)
+    {
+        return;
+    }
+    while (getline(&line, &len, fp) >= 0)
+    {
+        if (sscanf(line, "%lx-%lx", &start, &end) == 2)
+        {
+            for (int i = 0; i < audit->numMappings; i++)
+            {
+                if (audit->mappings[i].start == start)
+                {
+                    audit->mappings[i].end = end;
+                    break;
+                }
+            }
+        }
+    }
+    free(line);
+    fclose(fp);
+}
+
+/* Thread stacks are not labeled in numa_maps of recent kernels. The stack
+ * pointer of each thread is taken from its syscall file, the mapping
+ * containing it is the stack of the thread. */
+static void
+audit_labelStacks(AuditProcess* audit)
+{
+    DIR* dir;
+    struct dirent* de;
+    char filename[512];
+    char line[512];
+
+    snprintf(filename, sizeof(filename), "/proc/%d/task", audit->pid);
+    dir = opendir(filename);
+    if (dir == NULL)
+    {
+        return;
+    }
+    while ((de = readdir(dir)) != NULL)
+    {
+        FILE* fp;
+        char* tokens[16];
+        int numTokens = 0;
+        int tid = atoi(de->d_name);
+        AuditMapping* m;
+        if (tid <= 0)
+        {
+            continue;
+        }
+        snprintf(filename, sizeof(filename), "/proc/%d/task/%d/syscall", audit->pid, tid);
+        fp = fopen(filename, "r");
+        if (fp == NULL)
+        {
+            continue;
+        }
+        if (fgets(line, sizeof(line), fp) != NULL)
+        {
+            char* saveptr = NULL;
+            char* tok = strtok_r(line, " \n", &saveptr);
+            while ((tok != NULL) && (numTokens < 16))
+            {
+                tokens[numTokens++] = tok;
+                tok = strtok_r(NULL, " \n", &saveptr);
+            }
+        }
+        fclose(fp);
+        /* Format is "nr args... sp pc" or "-1 sp pc", running threads print "running" */
+        if (numTokens < 3)
+        {
+            continue;
+        }
+        m = audit_findMapping(audit, strtoull(tokens[numTokens-2], NULL, 16));
+        if ((m != NULL) && (strncmp(m->name, "[stack:", 7) != 0))
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "[stack:%d]", tid);
+            free(m->name);
+            m->name = strdup(name);
+        }
+    }
+    closedir(dir);
+}
+
+static int
+audit_parseLine(AuditProcess* audit, char* line, AuditMapping* m)
+{
+    char* saveptr = NULL;
+    char* tok;
+    char* name = NULL;
+
+    memset(m, 0, sizeof(AuditMapping));
+    m->pageSize = sysconf(_SC_PAGESIZE);
+    m->pages = (uint64_t*) calloc(audit->numDomains, sizeof(uint64_t));
+    if (m->pages == NULL)
+    {
+        return -ENOMEM;
+    }
+    tok = strtok_r(line, " \n", &saveptr);
+    if (tok == NULL)
+    {
+        free(m->pages);
+        return -EINVAL;
+    }
+    m->start = strtoull(tok, NULL, 16);
+    m->end = m->start;
+    tok = strtok_r(NULL, " \n", &saveptr);
+    m->policy = strdup(tok ? tok : "default");
+    while ((tok = strtok_r(NULL, " \n", &saveptr)) != NULL)
+    {
+        if (strncmp(tok, "file=", 5) == 0)
+        {
+            name = tok + 5;
+        }
+        else if ((strcmp(tok, "heap") == 0) && (name == NULL))
+        {
+            name = "[heap]";
+        }
+        else if ((strcmp(tok, "stack") == 0) && (name == NULL))
+        {
+            name = "[stack]";
+        }
+        else if (strncmp(tok, "kernelpagesize_kB=", 18) == 0)
+        {
+            m->pageSize = strtoull(tok + 18, NULL, 10) * 1024;
+        }
+        else if ((tok[0] == 'N') && (strchr(tok, '=') != NULL))
+        {
+            int domain = audit_domainIndex(atoi(tok + 1));
+            if (domain >= 0)
+            {
+                m->pages[domain] += strtoull(strchr(tok, '=') + 1, NULL, 10);
+            }
+        }
+    }
+    m->name = strdup(name ? name : "[anon]");
+    return 0;
+}
+
+/* Only private anonymous, heap and stack mappings with resident pages outside
+ * of the target domain are scanned. Reservations that were never touched
+ * (JVM and Go heaps, sanitizer shadow memory) can be terabytes large and
+ * would be queried page by page otherwise. */
+static int
+audit_isMigratable(AuditProcess* audit, AuditMapping* m, int domainId)
+{
+    uint64_t resident = 0;
+
+    if ((strcmp(m->name, "[anon]") != 0) && (strcmp(m->name, "[heap]") != 0) &&
+        (strncmp(m->name, "[stack", 6) != 0))
+    {
+        return 0;
+    }
+    for (int i = 0; i < audit->numDomains; i++)
+    {
+        resident += m->pages[i];
+    }
+    return ((resident > 0) && (resident != m->pages[domainId]));
+}
+
+static void*
+audit_migrateWorker(void* arg)
+{
+    AuditMigration* mig = (AuditMigration*) arg;
+    AuditProcess* audit = mig->audit;
+    void* pages[AUDIT_BATCH];
+    int nodes[AUDIT_BATCH];
+    int status[AUDIT_BATCH];
+    uint64_t moved = 0;
+
+    while (1)
+    {
+        AuditMapping* m;
+        uint64_t addr;
+        int count = 0;
+        int misplaced = 0;
+
+        /* Take the next batch of pages */
+        pthread_mutex_lock(&mig->lock);
+        while ((mig->mapping < audit->numMappings) &&
+               ((audit->mappings[mig->mapping].start + mig->offset >= audit->mappings[mig->mapping].end) ||
+                (!audit_isMigratable(audit, &audit->mappings[mig->mapping], mig->domain))))
+        {
+            mig->mapping++;
+            mig->offset = 0;
+        }
+        if ((mig->mapping >= audit->numMappings) || (mig->error))
+        {
+            pthread_mutex_unlock(&mig->lock);
+            break;
+        }
+        m = &audit->mappings[mig->mapping];
+        addr = m->start + mig->offset;
+        mig->offset += AUDIT_BATCH * m->pageSize;
+        pthread_mutex_unlock(&mig->lock);
+
+        for (; (count < AUDIT_BATCH) && (addr < m->end); count++, addr += m->pageSize)
+        {
+            pages[count] = (void*) addr;
+        }
+#ifdef HAS_MEMPOLICY
+        /* Query the current location and move only the mis-placed pages */
+        if (move_pages(audit->pid, count, pages, NULL, status, 0) < 0)
+        {
+            /* Missing permissions or a terminated process fail for all
+             * pages, stop the migration */
+            int err = errno;
+            if ((err == EPERM) || (err == ESRCH))
+            {
+                pthread_mutex_lock(&mig->lock);
+                mig->error = -err;
+                pthread_mutex_unlock(&mig->lock);
+            }
+            continue;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            if ((status[i] >= 0) && (status[i] != mig->node))
+            {
+                pages[misplaced] = pages[i];
+                nodes[misplaced] = mig->node;
+                misplaced++;
+            }
+        }
+        if (misplaced == 0)
+        {
+            continue;
+        }
+        if (move_pages(audit->pid, misplaced, pages, nodes, status, MPOL_MF_MOVE) < 0)
+        {
+            int err = errno;
+            if ((err == EPERM) || (err == ESRCH))
+            {
+                pthread_mutex_lock(&mig->lock);
+                mig->error = -err;
+                pthread_mutex_unlock(&mig->lock);
+            }
+            continue;
+        }
+        for (int i = 0; i < misplaced; i++)
+        {
+            if (status[i] == mig->node)
+            {
+                moved++;
+            }
+        }
+#else
+        (void)nodes;
+        (void)status;
+        (void)misplaced;
+#endif
+    }
+    pthread_mutex_lock(&mig->lock);
+    mig->moved += moved;
+    pthread_mutex_unlock(&mig->lock);
+    return NULL;
+}
+
+/* #####   FUNCTION DEFINITIONS  -  EXPORTED FUNCTIONS   ################## */
+
+int
+numa_auditProcess(int pid, AuditProcess* audit)
+{
+    FILE* fp;
+    char filename[64];
+    char* line = NULL;
+    size_t len = 0;
+    int ret = 0;
+
+    memset(audit, 0, sizeof(AuditProcess));
+    audit->pid = pid;
+    audit->numDomains = numa_info.numberOfNodes;
+    audit->memory = (uint64_t*) calloc(audit->numDomains, sizeof(uint64_t));
+    if (audit->memory == NULL)
+    {
+        return -ENOMEM;
+    }
+    snprintf(filename, sizeof(filename), "/proc/%d/numa_maps", pid);
+    fp = fopen(filename, "r");
+    if (fp == NULL)
+    {
+        ret = -errno;
+        ERROR_PRINT(Cannot open %s, filename);
+        numa_auditFree(audit);
+        return ret;
+    }
+    while (getline(&line, &len, fp) >= 0)
+    {
+        AuditMapping* tmp = (AuditMapping*) realloc(audit->mappings,
+                            (audit->numMappings + 1) * sizeof(AuditMapping));
+        if (tmp == NULL)
+        {
+            ret = -ENOMEM;
+            break;
+        }
+        audit->mappings = tmp;
+        if (audit_parseLine(audit, line, &audit->mappings[audit->numMappings]) == 0)
+        {
+            AuditMapping* m = &audit->mappings[audit->numMappings];
+            for (int i = 0; i < audit->numDomains; i++)
+            {
+                audit->memory[i] += m->pages[i] * m->pageSize;
+            }
+            audit->numMappings++;
+        }
+    }
+    free(line);
+    fclose(fp);
+    if (ret < 0)
+    {
+        numa_auditFree(audit);
+        return ret;
+    }
+    audit_readEnds(audit);
+    audit_labelStacks(audit);
+    return 0;
+}
+
+int
+numa_auditMigrate(AuditProcess* audit, int domainId, int numThreads, uint64_t* moved)
+{
+#ifdef HAS_MEMPOLICY
+    AuditMigration mig;
+    pthread_t threads[AUDIT_MAX_THREADS];
+    int started = 0;
+
+    if ((domainId < 0) || (domainId >= audit->numDomains))
+    {
+        return -EINVAL;
+    }
+    if (numThreads < 1)
+    {
+        numThreads = 1;
+    }
+    if (numThreads > AUDIT_MAX_THREADS)
+    {
+        numThreads = AUDIT_MAX_THREADS;
+    }
+    memset(&mig, 0, sizeof(AuditMigration));
+    mig.audit = audit;
+    mig.domain = domainId;
+    mig.node = numa_info.nodes[domainId].id;
+    pthread_mutex_init(&mig.lock, NULL);
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        if (pthread_create(&threads[started], NULL, audit_migrateWorker, &mig) == 0)
+        {
+            started++;
+        }
+    }
+    if (started == 0)
+    {
+        audit_migrateWorker(&mig);
+    }
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&mig.lock);
+    if (moved)
+    {
+        *moved = mig.moved;
+    }
+    return mig.error;
+#else
+    return -ENOSYS;
+#endif
+}
+
+void
+numa_auditFree(AuditProcess* audit)
+{
+    if (audit->mappings)
+    {
+        for (int i = 0; i < audit->numMappings; i++)
+        {
+            free(audit->mappings[i].name);
+            free(audit->mappings[i].policy);
+            free(audit->mappings[i].pages);
+        }
+        free(audit->mappings);
+    }
+    free(audit->memory);
+    memset(audit, 0, sizeof(AuditProcess));
+}
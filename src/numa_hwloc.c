@@ -220,10 +220,10 @@ int hwloc_numa_init(void)
         numa_info.nodes[0].numberOfProcessors = 0;
         numa_info.nodes[0].totalMemory = getTotalNodeMem(0);
         numa_info.nodes[0].freeMemory = getFreeNodeMem(0);
-        numa_info.nodes[0].processors = (uint32_t*) malloc(MAX_NUM_THREADS * sizeof(uint32_t));
+        numa_info.nodes[0].processors = (uint32_t*) malloc(cpuid_topology.numHWThreads * sizeof(uint32_t));
         if (!numa_info.nodes[0].processors)
         {
-            fprintf(stderr,"No memory to allocate %ld byte for processors array of NUMA node %d\n",MAX_NUM_THREADS * sizeof(uint32_t),0);
+            fprintf(stderr,"No memory to allocate %ld byte for processors array of NUMA node %d\n",cpuid_topology.numHWThreads * sizeof(uint32_t),0);
             return -1;
         }
         numa_info.nodes[0].distances = (uint32_t*) malloc(sizeof(uint32_t));
@@ -276,10 +276,10 @@ int hwloc_numa_init(void)
             
             /* freeMemory not detected by hwloc, do it the native way */
             numa_info.nodes[i].freeMemory = getFreeNodeMem(numa_info.nodes[i].id);
-            numa_info.nodes[i].processors = (uint32_t*) malloc(MAX_NUM_THREADS * sizeof(uint32_t));
+            numa_info.nodes[i].processors = (uint32_t*) malloc(cpuid_topology.numHWThreads * sizeof(uint32_t));
             if (!numa_info.nodes[i].processors)
             {
-                fprintf(stderr,"No memory to allocate %ld byte for processors array of NUMA node %d\n",MAX_NUM_THREADS * sizeof(uint32_t), i);
+                fprintf(stderr,"No memory to allocate %ld byte for processors array of NUMA node %d\n",cpuid_topology.numHWThreads * sizeof(uint32_t), i);
                 return -1;
             }
             d = 0;
@@ -42,6 +42,7 @@
 #endif
 
 #include <numa.h>
+#include <numa_interleave.h>
 #include <topology.h>
 
 /* #####   EXPORTED VARIABLES   ########################################### */
@@ -110,7 +111,7 @@ setConfiguredNodes(void)
 }
 
 
-static void
+void
 nodeMeminfo(int node, uint64_t* totalMemory, uint64_t* freeMemory)
 {
     FILE *fp;
@@ -167,7 +168,7 @@ nodeProcessorList(int node, uint32_t** list)
 //    int unitSize = (int) (sizeof(unsigned long)*8);
     int unitSize = (int) 32; /* 8 nibbles */
 
-    *list = (uint32_t*) malloc(MAX_NUM_THREADS * sizeof(uint32_t));
+    *list = (uint32_t*) malloc(cpuid_topology.numHWThreads * sizeof(uint32_t));
     if (!(*list))
     {
         return -ENOMEM;
@@ -204,7 +205,7 @@ nodeProcessorList(int node, uint32_t** list)
                 {
                     if (val&(1UL<<j))
                     {
-                        if (count < MAX_NUM_THREADS)
+                        if (count < cpuid_topology.numHWThreads)
                         {
                             (*list)[count] = (j+cursor);
                         }
@@ -288,7 +289,6 @@ nodeDistanceList(int node, int numberOfNodes, uint32_t** list)
 
 int proc_numa_init(void)
 {
-    int errno;
     uint32_t i;
 
     if (get_mempolicy(NULL, NULL, 0, 0, 0) < 0 && errno == ENOSYS)
@@ -299,7 +299,7 @@ int proc_numa_init(void)
     }
     /* First determine maximum number of nodes */
     numa_info.numberOfNodes = setConfiguredNodes()+1;
-    numa_info.nodes = (NumaNode*) malloc(numa_info.numberOfNodes * sizeof(NumaNode));
+    numa_info.nodes = (NumaNode*) calloc(numa_info.numberOfNodes, sizeof(NumaNode));
     if (!numa_info.nodes)
     {
         return -ENOMEM;
@@ -353,6 +353,44 @@ proc_numa_setInterleaved(int* processorList, int numberOfProcessors)
     }
 }
 
+int
+proc_numa_setInterleavedDomains(int* domainList, int numberOfDomains)
+{
+    unsigned long mask = 0UL;
+
+    for (int i = 0; i < numberOfDomains; i++)
+    {
+        if ((domainList[i] < 0) ||
+            (domainList[i] >= numa_info.numberOfNodes) ||
+            (numa_info.nodes[domainList[i]].id >= NUMA_INTERLEAVE_MAXNODES))
+        {
+            return -EINVAL;
+        }
+        mask |= (1UL<<numa_info.nodes[domainList[i]].id);
+    }
+    if (set_mempolicy(MPOL_INTERLEAVE, &mask, NUMA_INTERLEAVE_MAXNODES+1) < 0)
+    {
+        return -errno;
+    }
+    return 0;
+}
+
+int
+proc_numa_interleaveWeighted(void* ptr, size_t size, int* domainList, int* weights, int numberOfDomains)
+{
+    int nodes[numberOfDomains];
+
+    for (int i = 0; i < numberOfDomains; i++)
+    {
+        if ((domainList[i] < 0) || (domainList[i] >= numa_info.numberOfNodes))
+        {
+            return -EINVAL;
+        }
+        nodes[i] = numa_info.nodes[domainList[i]].id;
+    }
+    return numa_mbindWeighted(ptr, size, nodes, weights, numberOfDomains, MPOL_MF_MOVE);
+}
+
 void
 proc_numa_membind(void* ptr, size_t size, int domainId)
 {
@@ -47,6 +47,9 @@
 #include <registers.h>
 #include <topology.h>
 #include <access.h>
+#include <perfmon_overflow.h>
+#include <perfmon_sampling.h>
+#include <perfmon_aggregate.h>
 
 #include <perfmon_pm.h>
 #include <perfmon_atom.h>
@@ -69,6 +72,7 @@
 
 
 PerfmonEvent* eventHash = NULL;
+PerfmonEventHash* eventLookup = NULL;
 RegisterMap* counter_map = NULL;
 BoxMap* box_map = NULL;
 PciDevice* pci_devices = NULL;
@@ -77,7 +81,9 @@ int perfmon_numCoreCounters = 0;
 int perfmon_numArchEvents = 0;
 int perfmon_initialized = 0;
 int perfmon_verbosity = DEBUGLEV_ONLY_ERROR;
-uint64_t currentConfig[MAX_NUM_THREADS][NUM_PMC] = { 0 };
+uint64_t (*currentConfig)[NUM_PMC] = NULL;
+int* socket_lock = NULL;
+int* tile_lock = NULL;
 
 PerfmonGroupSet* groupSet = NULL;
 
@@ -230,51 +236,99 @@ getIndexAndType (bstring reg, RegisterIndex* index, RegisterType* type, int forc
 static int
 checkCounter(bstring counterName, const char* limit)
 {
-    int i;
-    struct bstrList* tokens;
-    int ret = FALSE;
-    bstring limitString = bfromcstr(limit);
+    const char* counter = bdata(counterName);
+    const char* token = limit;
 
-    tokens = bstrListCreate();
-    tokens = bsplit(limitString,'|');
-    for(i=0; i<tokens->qty; i++)
+    while (1)
     {
-        if(bstrncmp(counterName, tokens->entry[i], blength(tokens->entry[i])))
+        const char* end = strchr(token, '|');
+        size_t len = (end ? (size_t)(end - token) : strlen(token));
+        if (strncmp(counter, token, len) == 0)
         {
-            ret = FALSE;
+            return TRUE;
         }
-        else
+        if (!end)
         {
-            ret = TRUE;
             break;
         }
+        token = end + 1;
     }
-    bdestroy(limitString);
-    bstrListDestroy(tokens);
-    return ret;
+    return FALSE;
+}
+
+static uint32_t
+perfmon_hashString(uint32_t seed, const char* str)
+{
+    uint32_t hash = 2166136261U ^ seed;
+    while (*str)
+    {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619U;
+    }
+    return hash;
 }
 
 static int
-getEvent(bstring event_str, bstring counter_str, PerfmonEvent* event)
+getEventIndex(const char* name)
 {
-    int ret = FALSE;
-    int (*ownstrncmp)(const char *, const char *, size_t);
-    ownstrncmp = &strncmp;
-    for (int i=0; i< perfmon_numArchEvents; i++)
+    int index;
+    uint32_t disp;
+
+    if (eventLookup == NULL)
     {
-        if (biseqcstr(event_str, eventHash[i].name))
+        for (int i=0; i< perfmon_numArchEvents; i++)
         {
-            if (!checkCounter(counter_str, eventHash[i].limit))
+            if (strcmp(name, eventHash[i].name) == 0)
             {
-                continue;
+                return i;
             }
-            *event = eventHash[i];
-            ret = TRUE;
-            break;
         }
+        return -1;
+    }
+    disp = eventLookup->displacement[perfmon_hashString(0, name) % eventLookup->numBuckets];
+    if (disp == 0)
+    {
+        return -1;
+    }
+    index = eventLookup->slots[perfmon_hashString(disp, name) % eventLookup->numSlots];
+    if ((index < 0) || (strcmp(name, eventHash[index].name) != 0))
+    {
+        return -1;
     }
+    return index;
+}
 
-    return ret;
+static int
+getNextEventIndex(int index)
+{
+    if (eventLookup == NULL)
+    {
+        for (int i=index+1; i< perfmon_numArchEvents; i++)
+        {
+            if (strcmp(eventHash[index].name, eventHash[i].name) == 0)
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+    return eventLookup->next[index];
+}
+
+static int
+getEvent(bstring event_str, bstring counter_str, PerfmonEvent* event)
+{
+    int i;
+
+    for (i = getEventIndex(bdata(event_str)); i >= 0; i = getNextEventIndex(i))
+    {
+        if (checkCounter(counter_str, eventHash[i].limit))
+        {
+            *event = eventHash[i];
+            return TRUE;
+        }
+    }
+    return FALSE;
 }
 
 static int
@@ -575,6 +629,63 @@ calculateResult(int groupId, int eventId, int threadId)
     return result;
 }
 
+static double
+currentResult(int groupId, int eventId, int threadId)
+{
+    PerfmonEventSetEntry* event = &(groupSet->groups[groupId].events[eventId]);
+    PerfmonCounter* counter = &(event->threadCounter[threadId]);
+    RegisterType type = counter_map[event->index].type;
+    double result = 0.0;
+
+    if (type == THERMAL)
+    {
+        return (double)counter->counterData;
+    }
+    /* Same as calculateResult but leaves the overflow count untouched */
+    result = (double)counter->overflows * (double)perfmon_getMaxCounterValue(type);
+    result += (double)counter->counterData - (double)counter->startData;
+    if (type == POWER)
+    {
+        result *= power_getEnergyUnit(getCounterTypeOffset(event->index));
+    }
+    return result;
+}
+
+static void
+snapshotThread(int groupId, int threadId)
+{
+    int i;
+    PerfmonEventSet* eventSet = &groupSet->groups[groupId];
+
+    for (i = 0; i < eventSet->numberOfEvents; i++)
+    {
+        PerfmonCounter* counter = &(eventSet->events[i].threadCounter[threadId]);
+        double result = currentResult(groupId, i, threadId);
+        if (counter_map[eventSet->events[i].index].type == THERMAL)
+        {
+            counter->lastResult = result;
+        }
+        else
+        {
+            counter->lastResult = result - counter->snapshot;
+        }
+        counter->snapshot = result;
+    }
+}
+
+/* Takes the runtime of the group from its timer, the caller has to stop the
+ * timer before */
+static void
+snapshotTime(int groupId)
+{
+    PerfmonEventSet* eventSet = &groupSet->groups[groupId];
+    double time;
+
+    time = timer_print(&eventSet->timer);
+    eventSet->lastTime = time - eventSet->snapshotTime;
+    eventSet->snapshotTime = time;
+}
+
 int
 getCounterTypeOffset(int index)
 {
@@ -612,6 +723,7 @@ perfmon_init_maps(void)
                 case PENTIUM_M_BANIAS:
                 case PENTIUM_M_DOTHAN:
                     eventHash = pm_arch_events;
+                    eventLookup = &pm_arch_events_hash;
                     perfmon_numArchEvents = perfmon_numArchEvents_pm;
                     counter_map = pm_counter_map;
                     box_map = pm_box_map;
@@ -623,6 +735,7 @@ perfmon_init_maps(void)
                 case ATOM_22:
                 case ATOM:
                     eventHash = atom_arch_events;
+                    eventLookup = &atom_arch_events_hash;
                     perfmon_numArchEvents = perfmon_numArchEventsAtom;
                     counter_map = core2_counter_map;
                     perfmon_numCounters = perfmon_numCountersCore2;
@@ -636,6 +749,7 @@ perfmon_init_maps(void)
                 case ATOM_SILVERMONT_F:
                 case ATOM_SILVERMONT_AIR:
                     eventHash = silvermont_arch_events;
+                    eventLookup = &silvermont_arch_events_hash;
                     perfmon_numArchEvents = perfmon_numArchEventsSilvermont;
                     counter_map = silvermont_counter_map;
                     box_map = silvermont_box_map;
@@ -651,6 +765,7 @@ perfmon_init_maps(void)
                 case CORE2_65:
                 case CORE2_45:
                     eventHash = core2_arch_events;
+                    eventLookup = &core2_arch_events_hash;
                     perfmon_numArchEvents = perfmon_numArchEventsCore2;
                     counter_map = core2_counter_map;
                     perfmon_numCounters = perfmon_numCountersCore2;
@@ -659,6 +774,7 @@ perfmon_init_maps(void)
 
                 case NEHALEM_EX:
                     eventHash = nehalemEX_arch_events;
+                    eventLookup = &nehalemEX_arch_events_hash;
                     perfmon_numArchEvents = perfmon_numArchEventsNehalemEX;
                     counter_map = nehalemEX_counter_map;
                     perfmon_numCounters = perfmon_numCountersNehalemEX;
@@ -667,6 +783,7 @@ perfmon_init_maps(void)
 
                 case WESTMERE_EX:
                     eventHash = westmereEX_arch_events;
+                    eventLookup = &westmereEX_arch_events_hash;
                     perfmon_numArchEvents = perfmon_numArchEventsWestmereEX;
                     counter_map = westmereEX_counter_map;
                     perfmon_numCounters = perfmon_numCountersWestmereEX;
@@ -677,6 +794,7 @@ perfmon_init_maps(void)
                 case NEHALEM_LYNNFIELD:
                 case NEHALEM_LYNNFIELD_M:
                     eventHash = nehalem_arch_events;
+                    eventLookup = &nehalem_arch_events_hash;
                     perfmon_numArchEvents = perfmon_numArchEventsNehalem;
                     counter_map = nehalem_counter_map;
                     perfmon_numCounters = perfmon_numCountersNehalem;
@@ -686,6 +804,7 @@ perfmon_init_maps(void)
                 case NEHALEM_WESTMERE_M:
                 case NEHALEM_WESTMERE:
                     eventHash = westmere_arch_events;
+                    eventLookup = &westmere_arch_events_hash;
                     perfmon_numArchEvents = perfmon_numArchEventsWestmere;
                     counter_map = nehalem_counter_map;
                     perfmon_numCounters = perfmon_numCountersNehalem;
@@ -696,6 +815,7 @@ perfmon_init_maps(void)
                     pci_devices = ivybridgeEP_pci_devices;
                     box_map = ivybridgeEP_box_map;
                     eventHash = ivybridgeEP_arch_events;
+                    eventLookup = &ivybridgeEP_arch_events_hash;
                     perfmon_numArchEvents = perfmon_numArchEventsIvybridgeEP;
                     counter_map = ivybridgeEP_counter_map;
                     perfmon_numCounters = perfmon_numCountersIvybridgeEP;
@@ -703,6 +823,7 @@ perfmon_init_maps(void)
                     break;
                 case IVYBRIDGE:
                     eventHash = ivybridge_arch_events;
+                    eventLookup = &ivybridge_arch_events_hash;
                     box_map = ivybridge_box_map;
                     perfmon_numArchEvents = perfmon_numArchEventsIvybridge;
                     counter_map = ivybridge_counter_map;
@@ -712,6 +833,7 @@ perfmon_init_maps(void)
 
                 case HASWELL_EP:
                     eventHash = haswellEP_arch_events;
+                    eventLookup = &haswellEP_arch_events_hash;
                     perfmon_numArchEvents = perfmon_numArchEventsHaswellEP;
                     counter_map = haswellEP_counter_map;
                     perfmon_numCounters = perfmon_numCountersHaswellEP;
@@ -723,6 +845,7 @@ perfmon_init_maps(void)
                 case HASWELL_M1:
                 case HASWELL_M2:
                     eventHash = haswell_arch_events;
+                    eventLookup = &haswell_arch_events_hash;
                     perfmon_numArchEvents = perfmon_numArchEventsHaswell;
                     counter_map = haswell_counter_map;
                     perfmon_numCounters = perfmon_numCountersHaswell;
@@ -734,6 +857,7 @@ perfmon_init_maps(void)
                     pci_devices = sandybridgeEP_pci_devices;
                     box_map = sandybridgeEP_box_map;
                     eventHash = sandybridgeEP_arch_events;
+                    eventLookup = &sandybridgeEP_arch_events_hash;
                     perfmon_numArchEvents = perfmon_numArchEventsSandybridgeEP;
                     counter_map = sandybridgeEP_counter_map;
                     perfmon_numCounters = perfmon_numCountersSandybridgeEP;
@@ -742,6 +866,7 @@ perfmon_init_maps(void)
                 case SANDYBRIDGE:
                     box_map = sandybridge_box_map;
                     eventHash = sandybridge_arch_events;
+                    eventLookup = &sandybridge_arch_events_hash;
                     perfmon_numArchEvents = perfmon_numArchEventsSandybridge;
                     counter_map = sandybridge_counter_map;
                     perfmon_numCounters = perfmon_numCountersSandybridge;
@@ -752,6 +877,7 @@ perfmon_init_maps(void)
                 case BROADWELL_E:
                     box_map = broadwell_box_map;
                     eventHash = broadwell_arch_events;
+                    eventLookup = &broadwell_arch_events_hash;
                     counter_map = broadwell_counter_map;
                     perfmon_numArchEvents = perfmon_numArchEventsBroadwell;
                     perfmon_numCounters = perfmon_numCountersBroadwell;
@@ -760,6 +886,7 @@ perfmon_init_maps(void)
                 case BROADWELL_D:
                     box_map = broadwelld_box_map;
                     eventHash = broadwelld_arch_events;
+                    eventLookup = &broadwelld_arch_events_hash;
                     counter_map = broadwelld_counter_map;
                     perfmon_numArchEvents = perfmon_numArchEventsBroadwellD;
                     perfmon_numCounters = perfmon_numCountersBroadwellD;
@@ -770,6 +897,7 @@ perfmon_init_maps(void)
                 case SKYLAKE2:
                     box_map = skylake_box_map;
                     eventHash = skylake_arch_events;
+                    eventLookup = &skylake_arch_events_hash;
                     counter_map = skylake_counter_map;
                     perfmon_numArchEvents = perfmon_numArchEventsSkylake;
                     perfmon_numCounters = perfmon_numCountersSkylake;
@@ -788,6 +916,7 @@ perfmon_init_maps(void)
             {
                 case XEON_PHI:
                     eventHash = phi_arch_events;
+                    eventLookup = &phi_arch_events_hash;
                     perfmon_numArchEvents = perfmon_numArchEventsPhi;
                     counter_map = phi_counter_map;
                     box_map = phi_box_map;
@@ -802,6 +931,7 @@ perfmon_init_maps(void)
 
         case K8_FAMILY:
             eventHash = k8_arch_events;
+            eventLookup = &k8_arch_events_hash;
             perfmon_numArchEvents = perfmon_numArchEventsK8;
             counter_map = k10_counter_map;
             box_map = k10_box_map;
@@ -810,6 +940,7 @@ perfmon_init_maps(void)
 
         case K10_FAMILY:
             eventHash = k10_arch_events;
+            eventLookup = &k10_arch_events_hash;
             perfmon_numArchEvents = perfmon_numArchEventsK10;
             counter_map = k10_counter_map;
             box_map = k10_box_map;
@@ -818,6 +949,7 @@ perfmon_init_maps(void)
 
         case K15_FAMILY:
             eventHash = interlagos_arch_events;
+            eventLookup = &interlagos_arch_events_hash;
             perfmon_numArchEvents = perfmon_numArchEventsInterlagos;
             counter_map = interlagos_counter_map;
             box_map = interlagos_box_map;
@@ -826,6 +958,7 @@ perfmon_init_maps(void)
 
         case K16_FAMILY:
             eventHash = kabini_arch_events;
+            eventLookup = &kabini_arch_events_hash;
             perfmon_numArchEvents = perfmon_numArchEventsKabini;
             counter_map = kabini_counter_map;
             box_map = kabini_box_map;
@@ -1136,8 +1269,32 @@ perfmon_init(int nrThreads, int threadsToCpu[])
     groupSet->groups = NULL;
     groupSet->activeGroup = -1;
 
-    for(i=0; i<MAX_NUM_NODES; i++) socket_lock[i] = LOCK_INIT;
-    for(i=0; i<MAX_NUM_THREADS; i++) tile_lock[i] = LOCK_INIT;
+    /* The per-CPU configuration and the locks are sized by the topology.
+     * The tile locks are indexed by the core ID of a HW thread. */
+    int numberOfTiles = cpuid_topology.numHWThreads;
+    for(i=0; i<cpuid_topology.numHWThreads; i++)
+    {
+        numberOfTiles = MAX(numberOfTiles, (int)cpuid_topology.threadPool[i].coreId + 1);
+    }
+    currentConfig = calloc(cpuid_topology.numHWThreads, sizeof(*currentConfig));
+    socket_lock = (int*) malloc(cpuid_topology.numSockets * sizeof(int));
+    tile_lock = (int*) malloc(numberOfTiles * sizeof(int));
+    if ((currentConfig == NULL) || (socket_lock == NULL) || (tile_lock == NULL))
+    {
+        ERROR_PLAIN_PRINT(Cannot allocate per-CPU configuration);
+        free(currentConfig);
+        free(socket_lock);
+        free(tile_lock);
+        currentConfig = NULL;
+        socket_lock = NULL;
+        tile_lock = NULL;
+        free(groupSet->threads);
+        free(groupSet);
+        groupSet = NULL;
+        return -ENOMEM;
+    }
+    for(i=0; i<cpuid_topology.numSockets; i++) socket_lock[i] = LOCK_INIT;
+    for(i=0; i<numberOfTiles; i++) tile_lock[i] = LOCK_INIT;
 
     /* Initialize maps pointer to current architecture maps */
     perfmon_init_maps();
@@ -1179,6 +1336,14 @@ perfmon_init(int nrThreads, int threadsToCpu[])
         }
         initThreadArch(threadsToCpu[i]);
     }
+    if (perfmon_overflowInit(nrThreads) != 0)
+    {
+        ERROR_PLAIN_PRINT(Cannot allocate locks for overflow polling);
+    }
+    if (getenv("LIKWID_OVERFLOW_POLL") != NULL)
+    {
+        perfmon_setOverflowPolling(perfmon_overflowParseInterval(getenv("LIKWID_OVERFLOW_POLL")));
+    }
     perfmon_initialized = 1;
     return 0;
 }
@@ -1196,6 +1361,9 @@ perfmon_finalize(void)
     {
         return;
     }
+    perfmon_overflowFinalize();
+    perfmon_finalizeSampling();
+    perfmon_aggregateFinalize();
     for(group=0;group < groupSet->numberOfActiveGroups; group++)
     {
         
@@ -1217,10 +1385,12 @@ perfmon_finalize(void)
     groupSet->activeGroup = -1;
     if (groupSet)
         free(groupSet);
-    for (group=0; group < MAX_NUM_THREADS; group++)
-    {
-        memset(currentConfig[group], 0, NUM_PMC * sizeof(uint64_t));
-    }
+    free(currentConfig);
+    free(socket_lock);
+    free(tile_lock);
+    currentConfig = NULL;
+    socket_lock = NULL;
+    tile_lock = NULL;
     power_finalize();
     HPMfinalize();
     perfmon_initialized = 0;
@@ -1475,8 +1645,20 @@ __perfmon_startCounters(int groupId)
             return -groupSet->threads[i].thread_id-1;
         }
     }
+    for (i = 0; i < groupSet->groups[groupId].numberOfEvents; i++)
+    {
+        int j;
+        for (j = 0; j < groupSet->numberOfThreads; j++)
+        {
+            groupSet->groups[groupId].events[i].threadCounter[j].snapshot = 0;
+            groupSet->groups[groupId].events[i].threadCounter[j].lastResult = 0;
+        }
+    }
+    groupSet->groups[groupId].snapshotTime = 0;
+    groupSet->groups[groupId].lastTime = 0;
     groupSet->groups[groupId].state = STATE_START;
     timer_start(&groupSet->groups[groupId].timer);
+    perfmon_overflowStart(groupId);
     return 0;
 }
 
@@ -1531,6 +1713,7 @@ __perfmon_stopCounters(int groupId)
     int ret = 0;
     double result = 0.0;
 
+    perfmon_overflowStop();
     timer_stop(&groupSet->groups[groupId].timer);
 
     for (i = 0; i<groupSet->numberOfThreads; i++)
@@ -1542,6 +1725,12 @@ __perfmon_stopCounters(int groupId)
         }
     }
 
+    for (j=0; j<perfmon_getNumberOfThreads(); j++)
+    {
+        snapshotThread(groupId, j);
+    }
+    snapshotTime(groupId);
+
     for (i=0; i<perfmon_getNumberOfEvents(groupId); i++)
     {
         for (j=0; j<perfmon_getNumberOfThreads(); j++)
@@ -1629,20 +1818,28 @@ __perfmon_readCounters(int groupId, int threadId)
     {
         for (threadId = 0; threadId<groupSet->numberOfThreads; threadId++)
         {
+            perfmon_overflowLockThread(threadId);
             ret = perfmon_readCountersThread(threadId, &groupSet->groups[groupId]);
+            perfmon_overflowUnlockThread(threadId);
             if (ret)
             {
                 return -threadId-1;
             }
+            snapshotThread(groupId, threadId);
         }
+        timer_stop(&groupSet->groups[groupId].timer);
+        snapshotTime(groupId);
     }
     else if ((threadId >= 0) && (threadId < groupSet->numberOfThreads))
     {
+        perfmon_overflowLockThread(threadId);
         ret = perfmon_readCountersThread(threadId, &groupSet->groups[groupId]);
+        perfmon_overflowUnlockThread(threadId);
         if (ret)
         {
             return -threadId-1;
         }
+        snapshotThread(groupId, threadId);
     }
     return 0;
 }
@@ -1655,6 +1852,7 @@ int perfmon_readCounters(void)
 int perfmon_readCountersCpu(int cpu_id)
 {
     int i;
+    int ret;
     int thread_id = 0;
     if (perfmon_initialized != 1)
     {
@@ -1669,7 +1867,14 @@ int perfmon_readCountersCpu(int cpu_id)
             break;
         }
     }
-    return perfmon_readCountersThread(thread_id, &groupSet->groups[groupSet->activeGroup]);
+    perfmon_overflowLockThread(thread_id);
+    ret = perfmon_readCountersThread(thread_id, &groupSet->groups[groupSet->activeGroup]);
+    perfmon_overflowUnlockThread(thread_id);
+    if (ret == 0)
+    {
+        snapshotThread(groupSet->activeGroup, thread_id);
+    }
+    return ret;
 }
 
 int perfmon_readGroupCounters(int groupId)
@@ -1720,6 +1925,39 @@ perfmon_getResult(int groupId, int eventId, int threadId)
     return groupSet->groups[groupId].events[eventId].threadCounter[threadId].fullData;
 }
 
+double
+perfmon_getLastResult(int groupId, int eventId, int threadId)
+{
+    if (unlikely(groupSet == NULL))
+    {
+        return 0;
+    }
+    if (perfmon_initialized != 1)
+    {
+        ERROR_PLAIN_PRINT(Perfmon module not properly initialized);
+        return 0;
+    }
+    if (groupSet->numberOfActiveGroups == 0)
+    {
+        return 0;
+    }
+    if ((groupId < 0) && (groupSet->activeGroup >= 0))
+    {
+        groupId = groupSet->activeGroup;
+    }
+    if ((eventId < 0) || (eventId >= groupSet->groups[groupId].numberOfEvents))
+    {
+        printf("ERROR: EventID greater than defined events\n");
+        return 0;
+    }
+    if ((threadId < 0) || (threadId >= groupSet->numberOfThreads))
+    {
+        printf("ERROR: ThreadID greater than defined threads\n");
+        return 0;
+    }
+    return groupSet->groups[groupId].events[eventId].threadCounter[threadId].lastResult;
+}
+
 int __perfmon_switchActiveGroupThread(int thread_id, int new_group)
 {
     int ret;
@@ -1844,6 +2082,21 @@ perfmon_getTimeOfGroup(int groupId)
     return groupSet->groups[groupId].runTime;
 }
 
+double
+perfmon_getLastTimeOfGroup(int groupId)
+{
+    if (perfmon_initialized != 1)
+    {
+        ERROR_PLAIN_PRINT(Perfmon module not properly initialized);
+        return -EINVAL;
+    }
+    if (groupId < 0)
+    {
+        groupId = groupSet->activeGroup;
+    }
+    return groupSet->groups[groupId].lastTime;
+}
+
 uint64_t
 perfmon_getMaxCounterValue(RegisterType type)
 {
@@ -0,0 +1,415 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  perfmon_aggregate.c
+ *
+ *      Description:  Aggregation of per-thread results per socket, NUMA domain
+ *                    or node. The threads are sorted by domain and socket once,
+ *                    so each aggregation gathers the values into a contiguous
+ *                    buffer and reduces every domain in a single loop.
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+/* #####   HEADER FILE INCLUDES   ######################################### */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <types.h>
+#include <likwid.h>
+#include <error.h>
+#include <perfmon.h>
+#include <topology.h>
+#include <perfmon_aggregate.h>
+
+/* #####   LOCAL TYPE DEFINITIONS   ####################################### */
+
+/* Threads sorted by domain and socket. A unit is the set of threads of one
+ * socket inside a domain, uncore values are summed up per unit. */
+typedef struct {
+    int numThreads;
+    int numDomains;
+    int numUnits;
+    int* order;
+    int* domainIds;
+    int* threadStart;
+    int* unitStart;
+    int* domainUnits;
+    double* values;
+    double* units;
+    double* raw;
+} AggregateLayout;
+
+/* #####   VARIABLES  -  LOCAL TO THIS SOURCE FILE   ###################### */
+
+static AggregateLayout* aggregate_layouts[NUM_AGGREGATE_SCOPES];
+
+/* #####   FUNCTION DEFINITIONS  -  LOCAL TO THIS SOURCE FILE   ########### */
+
+static int
+aggregate_socketOf(int cpu)
+{
+    int i;
+    for (i = 0; i < cpuid_topology.numHWThreads; i++)
+    {
+        if (cpuid_topology.threadPool[i].apicId == cpu)
+        {
+            return cpuid_topology.threadPool[i].packageId;
+        }
+    }
+    return 0;
+}
+
+static int
+aggregate_numaOf(int cpu)
+{
+    int i, j;
+    NumaTopology_t numa = NULL;
+
+    if (numa_init() != 0)
+    {
+        return 0;
+    }
+    numa = get_numaTopology();
+    for (i = 0; i < numa->numberOfNodes; i++)
+    {
+        for (j = 0; j < numa->nodes[i].numberOfProcessors; j++)
+        {
+            if (numa->nodes[i].processors[j] == cpu)
+            {
+                return numa->nodes[i].id;
+            }
+        }
+    }
+    return 0;
+}
+
+static void
+aggregate_freeLayout(AggregateLayout* layout)
+{
+    if (layout == NULL)
+    {
+        return;
+    }
+    free(layout->order);
+    free(layout->domainIds);
+    free(layout->threadStart);
+    free(layout->unitStart);
+    free(layout->domainUnits);
+    free(layout->values);
+    free(layout->units);
+    free(layout->raw);
+    free(layout);
+}
+
+static AggregateLayout*
+aggregate_createLayout(int numCpus, const int* cpus, AggregateScope scope)
+{
+    int i, j;
+    int* domain = NULL;
+    int* socket = NULL;
+    AggregateLayout* layout = NULL;
+
+    layout = calloc(1, sizeof(AggregateLayout));
+    domain = malloc(numCpus * sizeof(int));
+    socket = malloc(numCpus * sizeof(int));
+    if (layout == NULL || domain == NULL || socket == NULL)
+    {
+        goto error;
+    }
+    layout->numThreads = numCpus;
+    layout->order = malloc(numCpus * sizeof(int));
+    layout->domainIds = malloc(numCpus * sizeof(int));
+    layout->threadStart = malloc((numCpus + 1) * sizeof(int));
+    layout->unitStart = malloc((numCpus + 1) * sizeof(int));
+    layout->domainUnits = malloc((numCpus + 1) * sizeof(int));
+    layout->values = malloc(numCpus * sizeof(double));
+    layout->units = malloc(numCpus * sizeof(double));
+    layout->raw = malloc(numCpus * sizeof(double));
+    if (layout->order == NULL || layout->domainIds == NULL ||
+        layout->threadStart == NULL || layout->unitStart == NULL ||
+        layout->domainUnits == NULL || layout->values == NULL ||
+        layout->units == NULL || layout->raw == NULL)
+    {
+        goto error;
+    }
+    for (i = 0; i < numCpus; i++)
+    {
+        socket[i] = aggregate_socketOf(cpus[i]);
+        switch (scope)
+        {
+            case AGGREGATE_SOCKET:
+                domain[i] = socket[i];
+                break;
+            case AGGREGATE_NUMA:
+                domain[i] = aggregate_numaOf(cpus[i]);
+                break;
+            default:
+                domain[i] = 0;
+                break;
+        }
+    }
+    /* Stable insertion sort by domain and socket, the lists are short and
+     * sorted only once */
+    for (i = 0; i < numCpus; i++)
+    {
+        int t = i;
+        for (j = i; j > 0; j--)
+        {
+            int o = layout->order[j-1];
+            if ((domain[o] < domain[t]) ||
+                ((domain[o] == domain[t]) && (socket[o] <= socket[t])))
+            {
+                break;
+            }
+            layout->order[j] = o;
+        }
+        layout->order[j] = t;
+    }
+    for (i = 0; i < numCpus; i++)
+    {
+        int t = layout->order[i];
+        int p = (i > 0 ? layout->order[i-1] : -1);
+        if ((p < 0) || (domain[p] != domain[t]))
+        {
+            layout->domainIds[layout->numDomains] = domain[t];
+            layout->threadStart[layout->numDomains] = i;
+            layout->domainUnits[layout->numDomains] = layout->numUnits;
+            layout->numDomains++;
+        }
+        if ((p < 0) || (domain[p] != domain[t]) || (socket[p] != socket[t]))
+        {
+            layout->unitStart[layout->numUnits] = i;
+            layout->numUnits++;
+        }
+    }
+    layout->threadStart[layout->numDomains] = numCpus;
+    layout->domainUnits[layout->numDomains] = layout->numUnits;
+    layout->unitStart[layout->numUnits] = numCpus;
+    free(domain);
+    free(socket);
+    return layout;
+error:
+    free(domain);
+    free(socket);
+    aggregate_freeLayout(layout);
+    return NULL;
+}
+
+static AggregateLayout*
+aggregate_getLayout(AggregateScope scope)
+{
+    int i;
+    int* cpus = NULL;
+
+    if (aggregate_layouts[scope] != NULL)
+    {
+        return aggregate_layouts[scope];
+    }
+    cpus = malloc(groupSet->numberOfThreads * sizeof(int));
+    if (cpus == NULL)
+    {
+        return NULL;
+    }
+    for (i = 0; i < groupSet->numberOfThreads; i++)
+    {
+        cpus[i] = groupSet->threads[i].processorId;
+    }
+    aggregate_layouts[scope] = aggregate_createLayout(groupSet->numberOfThreads, cpus, scope);
+    free(cpus);
+    return aggregate_layouts[scope];
+}
+
+static void
+aggregate_stat(const double* data, int count, AggregateResult* result)
+{
+    int i;
+    double sum = 0;
+    double min = (count > 0 ? data[0] : 0);
+    double max = min;
+
+    for (i = 0; i < count; i++)
+    {
+        sum += data[i];
+        min = (data[i] < min ? data[i] : min);
+        max = (data[i] > max ? data[i] : max);
+    }
+    result->count = count;
+    result->sum = sum;
+    result->min = min;
+    result->max = max;
+    result->avg = (count > 0 ? sum / count : 0);
+}
+
+static void
+aggregate_reduce(AggregateLayout* layout, const double* values, int uncore, AggregateResult* results)
+{
+    int i, d, u;
+    double* data = layout->values;
+    int* start = layout->threadStart;
+
+    for (i = 0; i < layout->numThreads; i++)
+    {
+        layout->values[i] = values[layout->order[i]];
+    }
+    if (uncore)
+    {
+        for (u = 0; u < layout->numUnits; u++)
+        {
+            double sum = 0;
+            for (i = layout->unitStart[u]; i < layout->unitStart[u+1]; i++)
+            {
+                sum += layout->values[i];
+            }
+            layout->units[u] = sum;
+        }
+        data = layout->units;
+        start = layout->domainUnits;
+    }
+    for (d = 0; d < layout->numDomains; d++)
+    {
+        aggregate_stat(&data[start[d]], start[d+1] - start[d], &results[d]);
+        results[d].domain = layout->domainIds[d];
+    }
+}
+
+/* #####   FUNCTION DEFINITIONS  -  EXPORTED FUNCTIONS   ################## */
+
+int
+perfmon_isUncoreCounter(const char* counter)
+{
+    int i;
+    if (counter_map == NULL)
+    {
+        return 0;
+    }
+    for (i = 0; i < perfmon_numCounters; i++)
+    {
+        if (strcmp(counter, counter_map[i].key) == 0)
+        {
+            RegisterType type = counter_map[i].type;
+            return ((type == POWER) || ((type >= UNCORE) && (type < NUM_UNITS)));
+        }
+    }
+    return 0;
+}
+
+int
+perfmon_getNumberOfAggregates(AggregateScope scope)
+{
+    AggregateLayout* layout = NULL;
+    if (groupSet == NULL)
+    {
+        return -EINVAL;
+    }
+    if ((scope < 0) || (scope >= NUM_AGGREGATE_SCOPES))
+    {
+        return -EINVAL;
+    }
+    layout = aggregate_getLayout(scope);
+    if (layout == NULL)
+    {
+        return -ENOMEM;
+    }
+    return layout->numDomains;
+}
+
+int
+perfmon_aggregateGroup(int groupId, AggregateScope scope, int last, AggregateResult* results)
+{
+    int e, t;
+    PerfmonEventSet* eventSet = NULL;
+    AggregateLayout* layout = NULL;
+    int numDomains = perfmon_getNumberOfAggregates(scope);
+
+    if (numDomains < 0)
+    {
+        return numDomains;
+    }
+    if ((groupId < 0) || (groupId >= groupSet->numberOfActiveGroups))
+    {
+        return -EINVAL;
+    }
+    layout = aggregate_layouts[scope];
+    eventSet = &groupSet->groups[groupId];
+    for (e = 0; e < eventSet->numberOfEvents; e++)
+    {
+        RegisterType type = eventSet->events[e].type;
+        for (t = 0; t < groupSet->numberOfThreads; t++)
+        {
+            layout->raw[t] = (last ? perfmon_getLastResult(groupId, e, t) :
+                                     perfmon_getResult(groupId, e, t));
+        }
+        aggregate_reduce(layout, layout->raw,
+                         (type == POWER) || ((type >= UNCORE) && (type < NUM_UNITS)),
+                         &results[e * numDomains]);
+    }
+    return numDomains;
+}
+
+int
+perfmon_aggregateValues(int numCpus, const int* cpus, const double* values, int uncore,
+                        AggregateScope scope, AggregateResult* results, int maxResults)
+{
+    int ret;
+    AggregateLayout* layout = NULL;
+
+    if ((numCpus <= 0) || (scope < 0) || (scope >= NUM_AGGREGATE_SCOPES))
+    {
+        return -EINVAL;
+    }
+    layout = aggregate_createLayout(numCpus, cpus, scope);
+    if (layout == NULL)
+    {
+        return -ENOMEM;
+    }
+    ret = layout->numDomains;
+    if (results != NULL)
+    {
+        if (maxResults < layout->numDomains)
+        {
+            ret = -ENOBUFS;
+        }
+        else
+        {
+            aggregate_reduce(layout, values, uncore, results);
+        }
+    }
+    aggregate_freeLayout(layout);
+    return ret;
+}
+
+void
+perfmon_aggregateFinalize(void)
+{
+    int i;
+    for (i = 0; i < NUM_AGGREGATE_SCOPES; i++)
+    {
+        aggregate_freeLayout(aggregate_layouts[i]);
+        aggregate_layouts[i] = NULL;
+    }
+}
@@ -0,0 +1,362 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  perfmon_overflow.c
+ *
+ *      Description:  Periodic counter overflow poller. While an event set is
+ *                    running, one thread per socket reads the counters of the
+ *                    measured CPUs often enough that no counter can wrap twice
+ *                    between two reads. The architecture read functions detect
+ *                    the wrap and increment the overflow count of the counter.
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+/* #####   HEADER FILE INCLUDES   ######################################### */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <types.h>
+#include <likwid.h>
+#include <error.h>
+#include <perfmon.h>
+#include <affinity.h>
+#include <perfmon_overflow.h>
+
+/* #####   EXPORTED VARIABLES   ########################################### */
+
+/* #####   LOCAL TYPE DEFINITIONS   ####################################### */
+
+typedef struct {
+    pthread_t thread;
+    int socket;
+    int groupId;
+    uint64_t interval;
+} OverflowPoller;
+
+/* #####   VARIABLES  -  LOCAL TO THIS SOURCE FILE   ###################### */
+
+static int64_t overflow_interval = 0;
+static int overflow_numThreads = 0;
+static pthread_mutex_t* overflow_threadLocks = NULL;
+
+static OverflowPoller* overflow_pollers = NULL;
+static int overflow_numPollers = 0;
+static int overflow_running = 0;
+static pthread_mutex_t overflow_runLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t overflow_runCond = PTHREAD_COND_INITIALIZER;
+
+/* #####   FUNCTION DEFINITIONS  -  LOCAL TO THIS SOURCE FILE   ########### */
+
+static uint64_t
+overflow_autoInterval(int groupId)
+{
+    int i;
+    double clock = (double) timer_getCpuClock();
+    double wrap = -1.0;
+    double interval = 0;
+    PerfmonEventSet* eventSet = &groupSet->groups[groupId];
+
+    if (clock <= 0)
+    {
+        clock = 3.E09;
+    }
+    for (i = 0; i < eventSet->numberOfEvents; i++)
+    {
+        int width = 48;
+        double tmp;
+        RegisterType type = eventSet->events[i].type;
+        if ((type == THERMAL) || (type == NOTYPE))
+        {
+            continue;
+        }
+        if (box_map && (box_map[type].regWidth > 0))
+        {
+            width = box_map[type].regWidth;
+        }
+        tmp = ldexp(1.0, width) / (clock * OVERFLOW_POLL_INCS_PER_CYCLE);
+        if ((wrap < 0) || (tmp < wrap))
+        {
+            wrap = tmp;
+        }
+    }
+    if (wrap < 0)
+    {
+        return OVERFLOW_POLL_MAX;
+    }
+    /* Poll four times per minimal wrap period */
+    interval = (wrap * 1.E06) / 4;
+    if (interval < OVERFLOW_POLL_MIN)
+    {
+        return OVERFLOW_POLL_MIN;
+    }
+    if (interval > OVERFLOW_POLL_MAX)
+    {
+        return OVERFLOW_POLL_MAX;
+    }
+    return (uint64_t) interval;
+}
+
+static void*
+overflow_poll(void* arg)
+{
+    int i;
+    int ret;
+    struct timespec deadline;
+    OverflowPoller* poller = (OverflowPoller*) arg;
+    PerfmonEventSet* eventSet = &groupSet->groups[poller->groupId];
+
+    pthread_mutex_lock(&overflow_runLock);
+    while (overflow_running)
+    {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += poller->interval / 1000000;
+        deadline.tv_nsec += (poller->interval % 1000000) * 1000;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        while (overflow_running &&
+               pthread_cond_timedwait(&overflow_runCond, &overflow_runLock, &deadline) != ETIMEDOUT);
+        if (!overflow_running)
+        {
+            break;
+        }
+        pthread_mutex_unlock(&overflow_runLock);
+        for (i = 0; i < groupSet->numberOfThreads; i++)
+        {
+            if (affinity_core2node_lookup[groupSet->threads[i].processorId] != poller->socket)
+            {
+                continue;
+            }
+            perfmon_overflowLockThread(i);
+            ret = perfmon_readCountersThread(i, eventSet);
+            perfmon_overflowUnlockThread(i);
+            if (ret)
+            {
+                DEBUG_PRINT(DEBUGLEV_DETAIL, Overflow poller failed to read counters of CPU %d,
+                            groupSet->threads[i].processorId);
+            }
+        }
+        pthread_mutex_lock(&overflow_runLock);
+    }
+    pthread_mutex_unlock(&overflow_runLock);
+    return NULL;
+}
+
+/* #####   FUNCTION DEFINITIONS  -  EXPORTED FUNCTIONS   ################## */
+
+int
+perfmon_setOverflowPolling(int64_t interval)
+{
+    if (overflow_running)
+    {
+        return -EBUSY;
+    }
+    overflow_interval = interval;
+    return 0;
+}
+
+int64_t
+perfmon_overflowParseInterval(const char* str)
+{
+    char* end = NULL;
+    double value;
+
+    if ((str == NULL) || (strlen(str) == 0) || (strcmp(str, "off") == 0))
+    {
+        return 0;
+    }
+    if (strcmp(str, "auto") == 0)
+    {
+        return -1;
+    }
+    value = strtod(str, &end);
+    if ((end == str) || (value < 0))
+    {
+        ERROR_PRINT(Cannot parse overflow poll interval %s, str);
+        return 0;
+    }
+    if (strcmp(end, "s") == 0)
+    {
+        value *= 1.E06;
+    }
+    else if (strcmp(end, "ms") == 0)
+    {
+        value *= 1.E03;
+    }
+    else if ((strlen(end) > 0) && (strcmp(end, "us") != 0))
+    {
+        ERROR_PRINT(Cannot parse overflow poll interval %s (unit must be s or ms or us), str);
+        return 0;
+    }
+    if ((value > 0) && (value < 1))
+    {
+        value = 1;
+    }
+    return (int64_t) value;
+}
+
+int
+perfmon_overflowInit(int numThreads)
+{
+    int i;
+
+    overflow_threadLocks = (pthread_mutex_t*) malloc(numThreads * sizeof(pthread_mutex_t));
+    if (overflow_threadLocks == NULL)
+    {
+        return -ENOMEM;
+    }
+    for (i = 0; i < numThreads; i++)
+    {
+        pthread_mutex_init(&overflow_threadLocks[i], NULL);
+    }
+    overflow_numThreads = numThreads;
+    return 0;
+}
+
+void
+perfmon_overflowFinalize(void)
+{
+    int i;
+
+    perfmon_overflowStop();
+    if (overflow_threadLocks)
+    {
+        for (i = 0; i < overflow_numThreads; i++)
+        {
+            pthread_mutex_destroy(&overflow_threadLocks[i]);
+        }
+        free(overflow_threadLocks);
+        overflow_threadLocks = NULL;
+    }
+    overflow_numThreads = 0;
+}
+
+void
+perfmon_overflowLockThread(int thread_id)
+{
+    if ((overflow_threadLocks) && (thread_id >= 0) && (thread_id < overflow_numThreads))
+    {
+        pthread_mutex_lock(&overflow_threadLocks[thread_id]);
+    }
+}
+
+void
+perfmon_overflowUnlockThread(int thread_id)
+{
+    if ((overflow_threadLocks) && (thread_id >= 0) && (thread_id < overflow_numThreads))
+    {
+        pthread_mutex_unlock(&overflow_threadLocks[thread_id]);
+    }
+}
+
+int
+perfmon_overflowStart(int groupId)
+{
+    int i, j;
+    int* sockets = NULL;
+    int numSockets = 0;
+    uint64_t interval;
+
+    if ((overflow_interval == 0) || (overflow_running) || (groupSet == NULL))
+    {
+        return 0;
+    }
+    interval = (overflow_interval < 0 ? overflow_autoInterval(groupId) : (uint64_t)overflow_interval);
+
+    sockets = (int*) malloc(groupSet->numberOfThreads * sizeof(int));
+    if (sockets == NULL)
+    {
+        return -ENOMEM;
+    }
+    for (i = 0; i < groupSet->numberOfThreads; i++)
+    {
+        int socket = affinity_core2node_lookup[groupSet->threads[i].processorId];
+        for (j = 0; j < numSockets; j++)
+        {
+            if (sockets[j] == socket)
+            {
+                break;
+            }
+        }
+        if (j == numSockets)
+        {
+            sockets[numSockets++] = socket;
+        }
+    }
+    overflow_pollers = (OverflowPoller*) malloc(numSockets * sizeof(OverflowPoller));
+    if (overflow_pollers == NULL)
+    {
+        free(sockets);
+        return -ENOMEM;
+    }
+
+    overflow_running = 1;
+    overflow_numPollers = 0;
+    for (i = 0; i < numSockets; i++)
+    {
+        overflow_pollers[i].socket = sockets[i];
+        overflow_pollers[i].groupId = groupId;
+        overflow_pollers[i].interval = interval;
+        if (pthread_create(&overflow_pollers[i].thread, NULL, overflow_poll, &overflow_pollers[i]) != 0)
+        {
+            ERROR_PRINT(Cannot start overflow poller for socket %d, sockets[i]);
+            break;
+        }
+        overflow_numPollers++;
+    }
+    free(sockets);
+    DEBUG_PRINT(DEBUGLEV_INFO, Started %d overflow poller(s) with interval %llu us,
+                overflow_numPollers, LLU_CAST interval);
+    return 0;
+}
+
+void
+perfmon_overflowStop(void)
+{
+    int i;
+
+    if (!overflow_pollers)
+    {
+        return;
+    }
+    pthread_mutex_lock(&overflow_runLock);
+    overflow_running = 0;
+    pthread_cond_broadcast(&overflow_runCond);
+    pthread_mutex_unlock(&overflow_runLock);
+    for (i = 0; i < overflow_numPollers; i++)
+    {
+        pthread_join(overflow_pollers[i].thread, NULL);
+    }
+    free(overflow_pollers);
+    overflow_pollers = NULL;
+    overflow_numPollers = 0;
+}
@@ -12,7 +12,7 @@
 #include <perfmon.h>
 #include <perfmon_perf.h>
 
-static int* cpu_event_fds[MAX_NUM_THREADS] = { NULL };
+static int** cpu_event_fds = NULL;
 
 const uint64_t configList[MAX_SW_EVENTS] = {
     [0x00] = PERF_COUNT_SW_CPU_CLOCK,
@@ -39,6 +39,14 @@ perf_event_open(struct perf_event_attr *hw_event, pid_t pid,
 
 int init_perf_event(int cpu_id)
 {
+    if (cpu_event_fds == NULL)
+    {
+        cpu_event_fds = (int**) calloc(cpuid_topology.numHWThreads, sizeof(int*));
+        if (cpu_event_fds == NULL)
+        {
+            return -ENOMEM;
+        }
+    }
     if (cpu_event_fds[cpu_id] == NULL)
     {
         cpu_event_fds[cpu_id] = (int*) malloc(MAX_SW_EVENTS * sizeof(int));
@@ -58,7 +66,7 @@ int setup_perf_event(int cpu_id, PerfmonEvent* event)
     {
         return -EINVAL;
     }
-    if (cpu_event_fds[cpu_id] == NULL)
+    if ((cpu_event_fds == NULL) || (cpu_event_fds[cpu_id] == NULL))
     {
         return -EFAULT;
     }
@@ -102,7 +110,7 @@ int read_perf_event(int cpu_id, uint64_t eventID, uint64_t *data)
     int ret = 0;
     long long tmp = 0;
     *data = 0x0ULL;
-    if ((cpu_event_fds[cpu_id] != NULL) && (cpu_event_fds[cpu_id][eventID] != -1))
+    if ((cpu_event_fds != NULL) && (cpu_event_fds[cpu_id] != NULL) && (cpu_event_fds[cpu_id][eventID] != -1))
     {
         ret = read(cpu_event_fds[cpu_id][eventID], &tmp, sizeof(long long));
         if (ret == sizeof(long long))
@@ -120,7 +128,7 @@ int read_perf_event(int cpu_id, uint64_t eventID, uint64_t *data)
 
 int stop_perf_event(int cpu_id, uint64_t eventID)
 {
-    if ((cpu_event_fds[cpu_id] != NULL) && (cpu_event_fds[cpu_id][eventID] != -1))
+    if ((cpu_event_fds != NULL) && (cpu_event_fds[cpu_id] != NULL) && (cpu_event_fds[cpu_id][eventID] != -1))
     {
         ioctl(cpu_event_fds[cpu_id][eventID], PERF_EVENT_IOC_DISABLE, 0);
     }
@@ -133,7 +141,7 @@ int stop_perf_event(int cpu_id, uint64_t eventID)
 
 int stop_all_perf_event(int cpu_id)
 {
-    if (cpu_event_fds[cpu_id] != NULL)
+    if ((cpu_event_fds != NULL) && (cpu_event_fds[cpu_id] != NULL))
     {
         for (int i = 0; i< MAX_SW_EVENTS; i++)
         {
@@ -148,7 +156,7 @@ int stop_all_perf_event(int cpu_id)
 
 int clear_perf_event(int cpu_id, uint64_t eventID)
 {
-    if ((cpu_event_fds[cpu_id] != NULL) && (cpu_event_fds[cpu_id][eventID] != -1))
+    if ((cpu_event_fds != NULL) && (cpu_event_fds[cpu_id] != NULL) && (cpu_event_fds[cpu_id][eventID] != -1))
     {
         ioctl(cpu_event_fds[cpu_id][eventID], PERF_EVENT_IOC_RESET, 0);
     }
@@ -161,7 +169,7 @@ int clear_perf_event(int cpu_id, uint64_t eventID)
 
 int clear_all_perf_event(int cpu_id)
 {
-    if (cpu_event_fds[cpu_id] != NULL)
+    if ((cpu_event_fds != NULL) && (cpu_event_fds[cpu_id] != NULL))
     {
         for (int i = 0; i< MAX_SW_EVENTS; i++)
         {
@@ -176,7 +184,7 @@ int clear_all_perf_event(int cpu_id)
 
 int start_perf_event(int cpu_id, uint64_t eventID)
 {
-    if ((cpu_event_fds[cpu_id] != NULL) && (cpu_event_fds[cpu_id][eventID] != -1))
+    if ((cpu_event_fds != NULL) && (cpu_event_fds[cpu_id] != NULL) && (cpu_event_fds[cpu_id][eventID] != -1))
     {
         ioctl(cpu_event_fds[cpu_id][eventID], PERF_EVENT_IOC_ENABLE, 0);
     }
@@ -189,7 +197,7 @@ int start_perf_event(int cpu_id, uint64_t eventID)
 
 int start_all_perf_event(int cpu_id)
 {
-    if (cpu_event_fds[cpu_id] != NULL)
+    if ((cpu_event_fds != NULL) && (cpu_event_fds[cpu_id] != NULL))
     {
         for (int i = 0; i< MAX_SW_EVENTS; i++)
         {
@@ -204,7 +212,7 @@ int start_all_perf_event(int cpu_id)
 
 int close_perf_event(int cpu_id, uint64_t eventID)
 {
-    if ((cpu_event_fds[cpu_id] != NULL) && (cpu_event_fds[cpu_id][eventID] != -1))
+    if ((cpu_event_fds != NULL) && (cpu_event_fds[cpu_id] != NULL) && (cpu_event_fds[cpu_id][eventID] != -1))
     {
         close(cpu_event_fds[cpu_id][eventID]);
         cpu_event_fds[cpu_id][eventID] = -1;
@@ -214,7 +222,7 @@ int close_perf_event(int cpu_id, uint64_t eventID)
 
 int finalize_perf_event(int cpu_id)
 {
-    if (cpu_event_fds[cpu_id] != NULL)
+    if ((cpu_event_fds != NULL) && (cpu_event_fds[cpu_id] != NULL))
     {
         for (int i = 0; i< MAX_SW_EVENTS; i++)
         {
@@ -0,0 +1,1060 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  perfmon_sampling.c
+ *
+ *      Description:  Sampling of instruction pointers with perf_event. One
+ *                    event of an event set is programmed in overflow mode on
+ *                    each measured CPU, the samples are collected from the
+ *                    per CPU ring buffers and aggregated by symbol.
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+/* #####   HEADER FILE INCLUDES   ######################################### */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include <types.h>
+#include <likwid.h>
+#include <error.h>
+#include <perfmon.h>
+#include <perfmon_sampling.h>
+
+/* #####   EXPORTED VARIABLES   ########################################### */
+
+extern int perfmon_initialized;
+
+/* #####   LOCAL TYPE DEFINITIONS   ####################################### */
+
+typedef struct {
+    uint64_t addr;
+    uint64_t size;
+    char* name;
+} ElfSymbol;
+
+typedef struct {
+    uint64_t offset;
+    uint64_t vaddr;
+    uint64_t filesz;
+} ElfLoad;
+
+typedef struct {
+    char* filename;
+    char* module;
+    int isExec;
+    ElfSymbol* symbols;
+    int numSymbols;
+    ElfLoad* loads;
+    int numLoads;
+} ElfImage;
+
+typedef struct {
+    pid_t pid;
+    char comm[16];
+} SampleComm;
+
+typedef struct {
+    const char* module;
+    const char* symbol;
+    uint64_t count;
+} SampleResolved;
+
+/* #####   VARIABLES  -  LOCAL TO THIS SOURCE FILE   ###################### */
+
+static SampleBuffer* sampling_buffers = NULL;
+static int sampling_numBuffers = 0;
+static size_t sampling_pageSize = 0;
+
+static SampleMapping* sampling_maps = NULL;
+static int sampling_numMaps = 0;
+static int sampling_maxMaps = 0;
+static pid_t* sampling_pids = NULL;
+static int sampling_numPids = 0;
+static int sampling_maxPids = 0;
+static SampleComm* sampling_comms = NULL;
+static int sampling_numComms = 0;
+static int sampling_maxComms = 0;
+static ElfImage* sampling_images = NULL;
+static int sampling_numImages = 0;
+
+static pthread_t sampling_thread;
+static volatile int sampling_running = 0;
+static char sampling_record[65536];
+
+static PerfmonSampleSymbol* sampling_results = NULL;
+static int sampling_numResults = 0;
+static uint64_t sampling_totalSamples = 0;
+static uint64_t sampling_lostSamples = 0;
+
+static char sampling_unknown[] = "[unknown]";
+
+/* #####   FUNCTION DEFINITIONS  -  LOCAL TO THIS SOURCE FILE   ########### */
+
+static long
+sampling_perfEventOpen(struct perf_event_attr *attr, pid_t pid, int cpu, int group_fd, unsigned long flags)
+{
+    return syscall(__NR_perf_event_open, attr, pid, cpu, group_fd, flags);
+}
+
+static int
+sampling_eventConfig(PerfmonEventSetEntry* entry, struct perf_event_attr* attr)
+{
+    int j;
+    PerfmonEvent* event = &entry->event;
+    uint64_t config = 0x0ULL;
+
+    attr->exclude_kernel = 1;
+    for (j = 0; j < event->numberOfOptions; j++)
+    {
+        if (event->options[j].type == EVENT_OPTION_COUNT_KERNEL)
+        {
+            attr->exclude_kernel = 0;
+        }
+    }
+    if (entry->type == FIXED)
+    {
+        /* The fixed counters have generic perf_event equivalents */
+        attr->type = PERF_TYPE_HARDWARE;
+        if (strcmp(counter_map[entry->index].key, "FIXC0") == 0)
+        {
+            attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+        }
+        else if (strcmp(counter_map[entry->index].key, "FIXC1") == 0)
+        {
+            attr->config = PERF_COUNT_HW_CPU_CYCLES;
+        }
+        else if (strcmp(counter_map[entry->index].key, "FIXC2") == 0)
+        {
+            attr->config = PERF_COUNT_HW_REF_CPU_CYCLES;
+        }
+        else
+        {
+            return -EINVAL;
+        }
+        return 0;
+    }
+    if (entry->type != PMC)
+    {
+        return -EINVAL;
+    }
+
+    attr->type = PERF_TYPE_RAW;
+    if (cpuid_info.isIntel)
+    {
+        config = (event->umask<<8) + event->eventId;
+        if ((event->cfgBits != 0) &&
+            (event->eventId != 0xB7) &&
+            (event->eventId != 0xBB))
+        {
+            config |= ((event->cmask<<8) + event->cfgBits)<<16;
+        }
+    }
+    else
+    {
+        config = ((uint64_t)(event->eventId>>8)<<32) + (event->umask<<8) + (event->eventId & ~(0xF00U));
+    }
+    for (j = 0; j < event->numberOfOptions; j++)
+    {
+        switch (event->options[j].type)
+        {
+            case EVENT_OPTION_EDGE:
+                config |= (1ULL<<18);
+                break;
+            case EVENT_OPTION_INVERT:
+                config |= (1ULL<<23);
+                break;
+            case EVENT_OPTION_ANYTHREAD:
+                config |= (1ULL<<21);
+                break;
+            case EVENT_OPTION_THRESHOLD:
+                config |= (event->options[j].value & 0xFFULL) << 24;
+                break;
+            case EVENT_OPTION_IN_TRANS:
+                config |= (1ULL<<32);
+                break;
+            case EVENT_OPTION_IN_TRANS_ABORT:
+                config |= (1ULL<<33);
+                break;
+            default:
+                break;
+        }
+    }
+    /* USR, OS, INT and EN bits are handled by the kernel */
+    config &= ~((1ULL<<16)|(1ULL<<17)|(1ULL<<20)|(1ULL<<22));
+    attr->config = config;
+    return 0;
+}
+
+static uint64_t
+sampling_hash(uint64_t ip, pid_t pid)
+{
+    return ((ip ^ ((uint64_t)pid << 40)) * 0x9E3779B97F4A7C15ULL) >> 20;
+}
+
+static int
+sampling_growTable(SampleBuffer* buf)
+{
+    size_t i;
+    size_t newSize = (buf->tableSize ? buf->tableSize * 2 : SAMPLING_TABLE_SIZE);
+    SampleEntry* newTable = (SampleEntry*) calloc(newSize, sizeof(SampleEntry));
+    if (newTable == NULL)
+    {
+        return -ENOMEM;
+    }
+    for (i = 0; i < buf->tableSize; i++)
+    {
+        if (buf->table[i].count > 0)
+        {
+            size_t h = sampling_hash(buf->table[i].ip, buf->table[i].pid) & (newSize - 1);
+            while (newTable[h].count > 0)
+            {
+                h = (h + 1) & (newSize - 1);
+            }
+            newTable[h] = buf->table[i];
+        }
+    }
+    free(buf->table);
+    buf->table = newTable;
+    buf->tableSize = newSize;
+    return 0;
+}
+
+static void
+sampling_addSample(SampleBuffer* buf, uint64_t ip, pid_t pid)
+{
+    size_t h;
+
+    if ((buf->tableUsed + 1) * 4 > buf->tableSize * 3)
+    {
+        if (sampling_growTable(buf) != 0)
+        {
+            buf->lost++;
+            return;
+        }
+    }
+    h = sampling_hash(ip, pid) & (buf->tableSize - 1);
+    while ((buf->table[h].count > 0) &&
+           ((buf->table[h].ip != ip) || (buf->table[h].pid != pid)))
+    {
+        h = (h + 1) & (buf->tableSize - 1);
+    }
+    if (buf->table[h].count == 0)
+    {
+        buf->table[h].ip = ip;
+        buf->table[h].pid = pid;
+        buf->tableUsed++;
+    }
+    buf->table[h].count++;
+}
+
+static void
+sampling_addMapping(pid_t pid, uint64_t start, uint64_t len, uint64_t pgoff, const char* filename)
+{
+    if (sampling_numMaps == sampling_maxMaps)
+    {
+        int newMax = (sampling_maxMaps ? sampling_maxMaps * 2 : 256);
+        SampleMapping* tmp = (SampleMapping*) realloc(sampling_maps, newMax * sizeof(SampleMapping));
+        if (tmp == NULL)
+        {
+            return;
+        }
+        sampling_maps = tmp;
+        sampling_maxMaps = newMax;
+    }
+    sampling_maps[sampling_numMaps].pid = pid;
+    sampling_maps[sampling_numMaps].start = start;
+    sampling_maps[sampling_numMaps].len = len;
+    sampling_maps[sampling_numMaps].pgoff = pgoff;
+    sampling_maps[sampling_numMaps].filename = strdup(filename);
+    if (sampling_maps[sampling_numMaps].filename != NULL)
+    {
+        sampling_numMaps++;
+    }
+}
+
+static void
+sampling_addComm(pid_t pid, const char* comm)
+{
+    int i;
+    for (i = 0; i < sampling_numComms; i++)
+    {
+        if (sampling_comms[i].pid == pid)
+        {
+            break;
+        }
+    }
+    if (i == sampling_numComms)
+    {
+        if (sampling_numComms == sampling_maxComms)
+        {
+            int newMax = (sampling_maxComms ? sampling_maxComms * 2 : 64);
+            SampleComm* tmp = (SampleComm*) realloc(sampling_comms, newMax * sizeof(SampleComm));
+            if (tmp == NULL)
+            {
+                return;
+            }
+            sampling_comms = tmp;
+            sampling_maxComms = newMax;
+        }
+        sampling_numComms++;
+    }
+    sampling_comms[i].pid = pid;
+    strncpy(sampling_comms[i].comm, comm, sizeof(sampling_comms[i].comm) - 1);
+    sampling_comms[i].comm[sizeof(sampling_comms[i].comm) - 1] = '\0';
+}
+
+/* Executable mappings created before the sampling started are not reported
+ * by perf_event, read them once from /proc for every sampled process */
+static void
+sampling_scanProcess(pid_t pid)
+{
+    int i;
+    FILE* fp;
+    char line[4096];
+    char path[4096];
+
+    for (i = 0; i < sampling_numPids; i++)
+    {
+        if (sampling_pids[i] == pid)
+        {
+            return;
+        }
+    }
+    if (sampling_numPids == sampling_maxPids)
+    {
+        int newMax = (sampling_maxPids ? sampling_maxPids * 2 : 64);
+        pid_t* tmp = (pid_t*) realloc(sampling_pids, newMax * sizeof(pid_t));
+        if (tmp == NULL)
+        {
+            return;
+        }
+        sampling_pids = tmp;
+        sampling_maxPids = newMax;
+    }
+    sampling_pids[sampling_numPids++] = pid;
+
+    snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+    fp = fopen(path, "r");
+    if (fp)
+    {
+        if (fgets(line, sizeof(line), fp) != NULL)
+        {
+            line[strcspn(line, "\n")] = '\0';
+            sampling_addComm(pid, line);
+        }
+        fclose(fp);
+    }
+    snprintf(path, sizeof(path), "/proc/%d/maps", pid);
+    fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        return;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        unsigned long long start, end, pgoff;
+        char perms[8];
+        path[0] = '\0';
+        if (sscanf(line, "%llx-%llx %7s %llx %*s %*s %4095s", &start, &end, perms, &pgoff, path) < 4)
+        {
+            continue;
+        }
+        if ((perms[2] == 'x') && (path[0] == '/'))
+        {
+            sampling_addMapping(pid, start, end - start, pgoff, path);
+        }
+    }
+    fclose(fp);
+}
+
+static void
+sampling_copy(SampleBuffer* buf, uint64_t offset, void* dest, size_t size)
+{
+    uint64_t dataSize = SAMPLING_DATA_PAGES * sampling_pageSize;
+    char* data = (char*)buf->base + sampling_pageSize;
+    uint64_t start = offset & (dataSize - 1);
+    size_t first = (start + size > dataSize ? dataSize - start : size);
+
+    memcpy(dest, data + start, first);
+    if (first < size)
+    {
+        memcpy((char*)dest + first, data, size - first);
+    }
+}
+
+static void
+sampling_drain(SampleBuffer* buf)
+{
+    struct perf_event_mmap_page* meta = (struct perf_event_mmap_page*) buf->base;
+    struct perf_event_header header;
+    uint64_t head, tail;
+
+    head = meta->data_head;
+    __sync_synchronize();
+    tail = meta->data_tail;
+    while (tail + sizeof(header) <= head)
+    {
+        sampling_copy(buf, tail, &header, sizeof(header));
+        if ((header.size < sizeof(header)) || (tail + header.size > head))
+        {
+            break;
+        }
+        sampling_copy(buf, tail, sampling_record, header.size);
+        switch (header.type)
+        {
+            case PERF_RECORD_SAMPLE:
+            {
+                uint64_t ip = *(uint64_t*)(sampling_record + sizeof(header));
+                uint32_t pid = *(uint32_t*)(sampling_record + sizeof(header) + sizeof(uint64_t));
+                buf->samples++;
+                if ((int)pid > 0)
+                {
+                    sampling_scanProcess(pid);
+                }
+                sampling_addSample(buf, ip, pid);
+                break;
+            }
+            case PERF_RECORD_MMAP:
+            {
+                char* rec = sampling_record + sizeof(header);
+                uint32_t pid = *(uint32_t*)rec;
+                uint64_t* vals = (uint64_t*)(rec + 2*sizeof(uint32_t));
+                char* filename = rec + 2*sizeof(uint32_t) + 3*sizeof(uint64_t);
+                sampling_record[header.size - 1] = '\0';
+                if (filename[0] == '/')
+                {
+                    sampling_addMapping(pid, vals[0], vals[1], vals[2], filename);
+                }
+                break;
+            }
+            case PERF_RECORD_COMM:
+            {
+                char* rec = sampling_record + sizeof(header);
+                sampling_record[header.size - 1] = '\0';
+                sampling_addComm(*(uint32_t*)rec, rec + 2*sizeof(uint32_t));
+                break;
+            }
+            case PERF_RECORD_LOST:
+            {
+                uint64_t* vals = (uint64_t*)(sampling_record + sizeof(header));
+                buf->lost += vals[1];
+                break;
+            }
+            default:
+                break;
+        }
+        tail += header.size;
+    }
+    __sync_synchronize();
+    meta->data_tail = tail;
+}
+
+static void*
+sampling_collect(void* arg)
+{
+    int i;
+    struct pollfd* fds = (struct pollfd*) malloc(sampling_numBuffers * sizeof(struct pollfd));
+    if (fds == NULL)
+    {
+        return NULL;
+    }
+    for (i = 0; i < sampling_numBuffers; i++)
+    {
+        fds[i].fd = sampling_buffers[i].fd;
+        fds[i].events = POLLIN;
+    }
+    while (sampling_running)
+    {
+        poll(fds, sampling_numBuffers, SAMPLING_POLL_TIMEOUT);
+        for (i = 0; i < sampling_numBuffers; i++)
+        {
+            sampling_drain(&sampling_buffers[i]);
+        }
+    }
+    free(fds);
+    return NULL;
+}
+
+static int
+sampling_compareSymbols(const void* a, const void* b)
+{
+    const ElfSymbol* sa = (const ElfSymbol*) a;
+    const ElfSymbol* sb = (const ElfSymbol*) b;
+    if (sa->addr < sb->addr) return -1;
+    if (sa->addr > sb->addr) return 1;
+    return 0;
+}
+
+static void
+sampling_readElf(ElfImage* image)
+{
+    int i, fd;
+    struct stat st;
+    char* map;
+    Elf64_Ehdr* ehdr;
+    Elf64_Shdr* shdr;
+    Elf64_Shdr* symtab = NULL;
+
+    fd = open(image->filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+    if ((fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(Elf64_Ehdr)))
+    {
+        close(fd);
+        return;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return;
+    }
+    ehdr = (Elf64_Ehdr*) map;
+    if ((memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0) ||
+        (ehdr->e_ident[EI_CLASS] != ELFCLASS64) ||
+        (ehdr->e_phoff + ehdr->e_phnum * sizeof(Elf64_Phdr) > (uint64_t)st.st_size) ||
+        (ehdr->e_shoff + ehdr->e_shnum * sizeof(Elf64_Shdr) > (uint64_t)st.st_size))
+    {
+        munmap(map, st.st_size);
+        return;
+    }
+    image->isExec = (ehdr->e_type == ET_EXEC);
+
+    image->loads = (ElfLoad*) malloc(ehdr->e_phnum * sizeof(ElfLoad));
+    for (i = 0; (image->loads != NULL) && (i < ehdr->e_phnum); i++)
+    {
+        Elf64_Phdr* phdr = (Elf64_Phdr*)(map + ehdr->e_phoff) + i;
+        if (phdr->p_type == PT_LOAD)
+        {
+            image->loads[image->numLoads].offset = phdr->p_offset;
+            image->loads[image->numLoads].vaddr = phdr->p_vaddr;
+            image->loads[image->numLoads].filesz = phdr->p_filesz;
+            image->numLoads++;
+        }
+    }
+
+    shdr = (Elf64_Shdr*)(map + ehdr->e_shoff);
+    for (i = 0; i < ehdr->e_shnum; i++)
+    {
+        if (shdr[i].sh_type == SHT_SYMTAB)
+        {
+            symtab = &shdr[i];
+            break;
+        }
+        if ((shdr[i].sh_type == SHT_DYNSYM) && (symtab == NULL))
+        {
+            symtab = &shdr[i];
+        }
+    }
+    if ((symtab != NULL) && (symtab->sh_link < ehdr->e_shnum) &&
+        (symtab->sh_offset + symtab->sh_size <= (uint64_t)st.st_size) &&
+        (symtab->sh_entsize == sizeof(Elf64_Sym)))
+    {
+        Elf64_Shdr* strtab = &shdr[symtab->sh_link];
+        Elf64_Sym* syms = (Elf64_Sym*)(map + symtab->sh_offset);
+        int numSyms = symtab->sh_size / sizeof(Elf64_Sym);
+        image->symbols = (ElfSymbol*) malloc(numSyms * sizeof(ElfSymbol));
+        for (i = 0; (image->symbols != NULL) && (i < numSyms); i++)
+        {
+            int type = ELF64_ST_TYPE(syms[i].st_info);
+            if (((type != STT_FUNC) && (type != STT_GNU_IFUNC)) ||
+                (syms[i].st_value == 0) ||
+                (syms[i].st_name >= strtab->sh_size) ||
+                (strtab->sh_offset + strtab->sh_size > (uint64_t)st.st_size))
+            {
+                continue;
+            }
+            image->symbols[image->numSymbols].addr = syms[i].st_value;
+            image->symbols[image->numSymbols].size = syms[i].st_size;
+            image->symbols[image->numSymbols].name = strdup(map + strtab->sh_offset + syms[i].st_name);
+            if (image->symbols[image->numSymbols].name != NULL)
+            {
+                image->numSymbols++;
+            }
+        }
+        if (image->numSymbols > 0)
+        {
+            qsort(image->symbols, image->numSymbols, sizeof(ElfSymbol), sampling_compareSymbols);
+        }
+    }
+    munmap(map, st.st_size);
+}
+
+static ElfImage*
+sampling_getImage(const char* filename)
+{
+    int i;
+    ElfImage* tmp;
+    const char* module;
+
+    for (i = 0; i < sampling_numImages; i++)
+    {
+        if (strcmp(sampling_images[i].filename, filename) == 0)
+        {
+            return &sampling_images[i];
+        }
+    }
+    tmp = (ElfImage*) realloc(sampling_images, (sampling_numImages + 1) * sizeof(ElfImage));
+    if (tmp == NULL)
+    {
+        return NULL;
+    }
+    sampling_images = tmp;
+    tmp = &sampling_images[sampling_numImages];
+    memset(tmp, 0, sizeof(ElfImage));
+    tmp->filename = strdup(filename);
+    module = strrchr(filename, '/');
+    tmp->module = strdup(module ? module + 1 : filename);
+    if ((tmp->filename == NULL) || (tmp->module == NULL))
+    {
+        free(tmp->filename);
+        free(tmp->module);
+        return NULL;
+    }
+    sampling_numImages++;
+    sampling_readElf(tmp);
+    return tmp;
+}
+
+static const char*
+sampling_lookupSymbol(ElfImage* image, uint64_t addr)
+{
+    int low = 0;
+    int high = image->numSymbols - 1;
+    int found = -1;
+
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        if (image->symbols[mid].addr <= addr)
+        {
+            found = mid;
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+    if (found < 0)
+    {
+        return NULL;
+    }
+    if ((image->symbols[found].size > 0) &&
+        (addr >= image->symbols[found].addr + image->symbols[found].size))
+    {
+        return NULL;
+    }
+    return image->symbols[found].name;
+}
+
+static void
+sampling_resolve(SampleEntry* entry, SampleResolved* res)
+{
+    int i;
+    res->count = entry->count;
+    res->module = sampling_unknown;
+    res->symbol = sampling_unknown;
+
+    for (i = sampling_numMaps - 1; i >= 0; i--)
+    {
+        SampleMapping* map = &sampling_maps[i];
+        if ((map->pid == entry->pid) &&
+            (entry->ip >= map->start) && (entry->ip < map->start + map->len))
+        {
+            ElfImage* image = sampling_getImage(map->filename);
+            uint64_t addr = entry->ip;
+            const char* name;
+            if (image == NULL)
+            {
+                return;
+            }
+            res->module = image->module;
+            if (!image->isExec)
+            {
+                int j;
+                uint64_t offset = entry->ip - map->start + map->pgoff;
+                addr = offset;
+                for (j = 0; j < image->numLoads; j++)
+                {
+                    if ((offset >= image->loads[j].offset) &&
+                        (offset < image->loads[j].offset + image->loads[j].filesz))
+                    {
+                        addr = offset - image->loads[j].offset + image->loads[j].vaddr;
+                        break;
+                    }
+                }
+            }
+            name = sampling_lookupSymbol(image, addr);
+            if (name)
+            {
+                res->symbol = name;
+            }
+            return;
+        }
+    }
+    for (i = 0; i < sampling_numComms; i++)
+    {
+        if (sampling_comms[i].pid == entry->pid)
+        {
+            res->module = sampling_comms[i].comm;
+            return;
+        }
+    }
+}
+
+static int
+sampling_compareResolvedName(const void* a, const void* b)
+{
+    const SampleResolved* ra = (const SampleResolved*) a;
+    const SampleResolved* rb = (const SampleResolved*) b;
+    int ret = strcmp(ra->module, rb->module);
+    if (ret == 0)
+    {
+        ret = strcmp(ra->symbol, rb->symbol);
+    }
+    return ret;
+}
+
+static int
+sampling_compareResolvedCount(const void* a, const void* b)
+{
+    const SampleResolved* ra = (const SampleResolved*) a;
+    const SampleResolved* rb = (const SampleResolved*) b;
+    if (ra->count > rb->count) return -1;
+    if (ra->count < rb->count) return 1;
+    return sampling_compareResolvedName(a, b);
+}
+
+static void
+sampling_freeResults(void)
+{
+    int i;
+    for (i = 0; i < sampling_numResults; i++)
+    {
+        free(sampling_results[i].symbol);
+        free(sampling_results[i].module);
+    }
+    free(sampling_results);
+    sampling_results = NULL;
+    sampling_numResults = 0;
+    sampling_totalSamples = 0;
+    sampling_lostSamples = 0;
+}
+
+static void
+sampling_freeState(void)
+{
+    int i, j;
+    for (i = 0; i < sampling_numBuffers; i++)
+    {
+        if (sampling_buffers[i].base)
+        {
+            munmap(sampling_buffers[i].base, sampling_buffers[i].mapSize);
+        }
+        if (sampling_buffers[i].fd >= 0)
+        {
+            close(sampling_buffers[i].fd);
+        }
+        free(sampling_buffers[i].table);
+    }
+    free(sampling_buffers);
+    sampling_buffers = NULL;
+    sampling_numBuffers = 0;
+    for (i = 0; i < sampling_numMaps; i++)
+    {
+        free(sampling_maps[i].filename);
+    }
+    free(sampling_maps);
+    sampling_maps = NULL;
+    sampling_numMaps = 0;
+    sampling_maxMaps = 0;
+    free(sampling_pids);
+    sampling_pids = NULL;
+    sampling_numPids = 0;
+    sampling_maxPids = 0;
+    free(sampling_comms);
+    sampling_comms = NULL;
+    sampling_numComms = 0;
+    sampling_maxComms = 0;
+    for (i = 0; i < sampling_numImages; i++)
+    {
+        for (j = 0; j < sampling_images[i].numSymbols; j++)
+        {
+            free(sampling_images[i].symbols[j].name);
+        }
+        free(sampling_images[i].symbols);
+        free(sampling_images[i].loads);
+        free(sampling_images[i].filename);
+        free(sampling_images[i].module);
+    }
+    free(sampling_images);
+    sampling_images = NULL;
+    sampling_numImages = 0;
+}
+
+static int
+sampling_aggregate(void)
+{
+    int i, k;
+    size_t j, n = 0;
+    SampleResolved* list;
+
+    for (i = 0; i < sampling_numBuffers; i++)
+    {
+        n += sampling_buffers[i].tableUsed;
+        sampling_totalSamples += sampling_buffers[i].samples;
+        sampling_lostSamples += sampling_buffers[i].lost;
+    }
+    if (n == 0)
+    {
+        return 0;
+    }
+    list = (SampleResolved*) malloc(n * sizeof(SampleResolved));
+    if (list == NULL)
+    {
+        return -ENOMEM;
+    }
+    n = 0;
+    for (i = 0; i < sampling_numBuffers; i++)
+    {
+        for (j = 0; j < sampling_buffers[i].tableSize; j++)
+        {
+            if (sampling_buffers[i].table[j].count > 0)
+            {
+                sampling_resolve(&sampling_buffers[i].table[j], &list[n++]);
+            }
+        }
+    }
+    qsort(list, n, sizeof(SampleResolved), sampling_compareResolvedName);
+    k = 0;
+    for (j = 1; j < n; j++)
+    {
+        if (sampling_compareResolvedName(&list[k], &list[j]) == 0)
+        {
+            list[k].count += list[j].count;
+        }
+        else
+        {
+            list[++k] = list[j];
+        }
+    }
+    n = k + 1;
+    qsort(list, n, sizeof(SampleResolved), sampling_compareResolvedCount);
+
+    sampling_results = (PerfmonSampleSymbol*) malloc(n * sizeof(PerfmonSampleSymbol));
+    if (sampling_results == NULL)
+    {
+        free(list);
+        return -ENOMEM;
+    }
+    for (j = 0; j < n; j++)
+    {
+        sampling_results[j].symbol = strdup(list[j].symbol);
+        sampling_results[j].module = strdup(list[j].module);
+        sampling_results[j].count = list[j].count;
+    }
+    sampling_numResults = n;
+    free(list);
+    return 0;
+}
+
+/* #####   FUNCTION DEFINITIONS  -  EXPORTED FUNCTIONS   ################## */
+
+int
+perfmon_startSampling(int groupId, uint64_t period)
+{
+    int i, ret;
+    int eventId = -1;
+    struct perf_event_attr attr;
+    PerfmonEventSet* eventSet;
+
+    if ((perfmon_initialized != 1) || (groupSet == NULL))
+    {
+        ERROR_PLAIN_PRINT(Perfmon module not properly initialized);
+        return -EINVAL;
+    }
+    if ((groupId < 0) || (groupId >= groupSet->numberOfActiveGroups) || (period == 0))
+    {
+        return -EINVAL;
+    }
+    if (sampling_running)
+    {
+        return -EBUSY;
+    }
+    eventSet = &groupSet->groups[groupId];
+    for (i = 0; i < eventSet->numberOfEvents; i++)
+    {
+        if (eventSet->events[i].type == PMC)
+        {
+            eventId = i;
+            break;
+        }
+        if ((eventSet->events[i].type == FIXED) && (eventId < 0))
+        {
+            eventId = i;
+        }
+    }
+    if (eventId < 0)
+    {
+        ERROR_PLAIN_PRINT(Sampling requires a core-local event in the event set);
+        return -EINVAL;
+    }
+
+    memset(&attr, 0, sizeof(struct perf_event_attr));
+    attr.size = sizeof(struct perf_event_attr);
+    if (sampling_eventConfig(&eventSet->events[eventId], &attr) != 0)
+    {
+        ERROR_PRINT(Event %s cannot be used for sampling, eventSet->events[eventId].event.name);
+        return -EINVAL;
+    }
+    attr.sample_period = period;
+    attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID;
+    attr.disabled = 1;
+    attr.exclude_hv = 1;
+    attr.mmap = 1;
+    attr.comm = 1;
+    attr.watermark = 1;
+
+    sampling_freeResults();
+    sampling_pageSize = sysconf(_SC_PAGESIZE);
+    attr.wakeup_watermark = (SAMPLING_DATA_PAGES * sampling_pageSize) / 4;
+    sampling_buffers = (SampleBuffer*) calloc(groupSet->numberOfThreads, sizeof(SampleBuffer));
+    if (sampling_buffers == NULL)
+    {
+        return -ENOMEM;
+    }
+    for (i = 0; i < groupSet->numberOfThreads; i++)
+    {
+        SampleBuffer* buf = &sampling_buffers[i];
+        buf->cpu = groupSet->threads[i].processorId;
+        buf->fd = -1;
+        sampling_numBuffers++;
+        buf->fd = sampling_perfEventOpen(&attr, -1, buf->cpu, -1, 0);
+        if (buf->fd < 0)
+        {
+            ret = -errno;
+            ERROR_PRINT(Cannot open sampling event on CPU %d (requires root or perf_event_paranoid <= 0), buf->cpu);
+            sampling_freeState();
+            return ret;
+        }
+        buf->mapSize = (SAMPLING_DATA_PAGES + 1) * sampling_pageSize;
+        buf->base = mmap(NULL, buf->mapSize, PROT_READ|PROT_WRITE, MAP_SHARED, buf->fd, 0);
+        if (buf->base == MAP_FAILED)
+        {
+            ret = -errno;
+            buf->base = NULL;
+            ERROR_PRINT(Cannot map sampling buffer of CPU %d, buf->cpu);
+            sampling_freeState();
+            return ret;
+        }
+        if (sampling_growTable(buf) != 0)
+        {
+            sampling_freeState();
+            return -ENOMEM;
+        }
+    }
+
+    sampling_running = 1;
+    if (pthread_create(&sampling_thread, NULL, sampling_collect, NULL) != 0)
+    {
+        sampling_running = 0;
+        sampling_freeState();
+        return -EAGAIN;
+    }
+    for (i = 0; i < sampling_numBuffers; i++)
+    {
+        ioctl(sampling_buffers[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    DEBUG_PRINT(DEBUGLEV_INFO, Sampling event %s every %llu events on %d CPUs,
+                eventSet->events[eventId].event.name, LLU_CAST period, sampling_numBuffers);
+    return eventId;
+}
+
+int
+perfmon_stopSampling(void)
+{
+    int i, ret;
+
+    if (!sampling_running)
+    {
+        return -EINVAL;
+    }
+    for (i = 0; i < sampling_numBuffers; i++)
+    {
+        ioctl(sampling_buffers[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    sampling_running = 0;
+    pthread_join(sampling_thread, NULL);
+    for (i = 0; i < sampling_numBuffers; i++)
+    {
+        sampling_drain(&sampling_buffers[i]);
+    }
+    ret = sampling_aggregate();
+    sampling_freeState();
+    return ret;
+}
+
+int
+perfmon_getSamplingResults(PerfmonSampleSymbol** symbols, uint64_t* samples, uint64_t* lost)
+{
+    if (symbols)
+    {
+        *symbols = sampling_results;
+    }
+    if (samples)
+    {
+        *samples = sampling_totalSamples;
+    }
+    if (lost)
+    {
+        *lost = sampling_lostSamples;
+    }
+    return sampling_numResults;
+}
+
+void
+perfmon_finalizeSampling(void)
+{
+    if (sampling_running)
+    {
+        perfmon_stopSampling();
+    }
+    sampling_freeResults();
+}
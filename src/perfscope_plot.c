@@ -0,0 +1,365 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  perfscope_plot.c
+ *
+ *      Description:  Plot stream of likwid-perfscope. The samples of all curves
+ *                    are kept in a ring buffer and sent to gnuplot as inline
+ *                    binary data, one frame redraws all samples in the plotted
+ *                    range. Optionally, every sample is appended to a binary
+ *                    record file.
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+/* #####   HEADER FILE INCLUDES   ######################################### */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <types.h>
+#include <error.h>
+#include <perfscope_plot.h>
+
+/* #####   LOCAL TYPE DEFINITIONS   ####################################### */
+
+typedef struct {
+    FILE* out;
+    int isPipe;
+    FILE* record;
+    int numSeries;
+    char** titles;
+    int* y2;
+    int bounded;
+    int capacity;
+    int head;
+    int count;
+    double* time;
+    double* values;
+    double* frame;
+} PlotStream;
+
+/* #####   VARIABLES  -  LOCAL TO THIS SOURCE FILE   ###################### */
+
+static PlotStream* plot_streams[PLOT_MAX_STREAMS];
+
+/* #####   FUNCTION DEFINITIONS  -  LOCAL TO THIS SOURCE FILE   ########### */
+
+static PlotStream*
+plot_get(int handle)
+{
+    if ((handle < 0) || (handle >= PLOT_MAX_STREAMS))
+    {
+        return NULL;
+    }
+    return plot_streams[handle];
+}
+
+static void
+plot_free(PlotStream* p)
+{
+    int i;
+    if (p->titles)
+    {
+        for (i = 0; i < p->numSeries; i++)
+        {
+            free(p->titles[i]);
+        }
+        free(p->titles);
+    }
+    free(p->y2);
+    free(p->time);
+    free(p->values);
+    free(p->frame);
+    free(p);
+}
+
+static int
+plot_resize(PlotStream* p, int capacity)
+{
+    int i;
+    double* time = malloc(capacity * sizeof(double));
+    double* values = malloc(capacity * p->numSeries * sizeof(double));
+    double* frame = malloc(2 * capacity * sizeof(double));
+
+    if (time == NULL || values == NULL || frame == NULL)
+    {
+        free(time);
+        free(values);
+        free(frame);
+        return -ENOMEM;
+    }
+    /* Store the samples from the oldest one on */
+    for (i = 0; i < p->count; i++)
+    {
+        int idx = (p->head + i) % p->capacity;
+        time[i] = p->time[idx];
+        memcpy(&values[i * p->numSeries], &p->values[idx * p->numSeries], p->numSeries * sizeof(double));
+    }
+    free(p->time);
+    free(p->values);
+    free(p->frame);
+    p->time = time;
+    p->values = values;
+    p->frame = frame;
+    p->capacity = capacity;
+    p->head = 0;
+    return 0;
+}
+
+static void
+plot_putTitle(FILE* out, const char* title)
+{
+    fputc('"', out);
+    for (; *title != '\0'; title++)
+    {
+        if (*title == '"' || *title == '\\')
+        {
+            fputc('\\', out);
+        }
+        fputc(*title, out);
+    }
+    fputc('"', out);
+}
+
+/* #####   FUNCTION DEFINITIONS  -  EXPORTED FUNCTIONS   ################## */
+
+int
+plot_open(const char* command, int numSeries, PlotSeries* series, int capacity)
+{
+    int i;
+    int handle = -1;
+    PlotStream* p = NULL;
+
+    if (numSeries <= 0)
+    {
+        return -EINVAL;
+    }
+    for (i = 0; i < PLOT_MAX_STREAMS; i++)
+    {
+        if (plot_streams[i] == NULL)
+        {
+            handle = i;
+            break;
+        }
+    }
+    if (handle < 0)
+    {
+        return -EMFILE;
+    }
+    p = calloc(1, sizeof(PlotStream));
+    if (p == NULL)
+    {
+        return -ENOMEM;
+    }
+    p->numSeries = numSeries;
+    p->titles = calloc(numSeries, sizeof(char*));
+    p->y2 = calloc(numSeries, sizeof(int));
+    if (p->titles == NULL || p->y2 == NULL)
+    {
+        plot_free(p);
+        return -ENOMEM;
+    }
+    for (i = 0; i < numSeries; i++)
+    {
+        p->titles[i] = strdup(series[i].title ? series[i].title : "");
+        p->y2[i] = series[i].y2;
+        if (p->titles[i] == NULL)
+        {
+            plot_free(p);
+            return -ENOMEM;
+        }
+    }
+    p->bounded = (capacity > 0);
+    if (plot_resize(p, (capacity > 0 ? capacity : PLOT_INITIAL_SAMPLES)) < 0)
+    {
+        plot_free(p);
+        return -ENOMEM;
+    }
+    if ((command == NULL) || (strcmp(command, "-") == 0))
+    {
+        p->out = stdout;
+    }
+    else
+    {
+        p->out = popen(command, "w");
+        p->isPipe = 1;
+        if (p->out == NULL)
+        {
+            plot_free(p);
+            return -errno;
+        }
+    }
+    plot_streams[handle] = p;
+    return handle;
+}
+
+int
+plot_record(int handle, const char* filename)
+{
+    PlotStream* p = plot_get(handle);
+    if (p == NULL)
+    {
+        return -EBADF;
+    }
+    if (p->record)
+    {
+        fclose(p->record);
+    }
+    p->record = fopen(filename, "w");
+    if (p->record == NULL)
+    {
+        return -errno;
+    }
+    return 0;
+}
+
+int
+plot_command(int handle, const char* text)
+{
+    PlotStream* p = plot_get(handle);
+    if (p == NULL)
+    {
+        return -EBADF;
+    }
+    if (fputs(text, p->out) < 0 || fflush(p->out) != 0)
+    {
+        return -EIO;
+    }
+    return 0;
+}
+
+int
+plot_add(int handle, double time, int numValues, double* values)
+{
+    int idx;
+    PlotStream* p = plot_get(handle);
+
+    if (p == NULL)
+    {
+        return -EBADF;
+    }
+    if (numValues != p->numSeries)
+    {
+        return -EINVAL;
+    }
+    if (p->count == p->capacity)
+    {
+        if (p->bounded)
+        {
+            /* Drop the oldest sample */
+            p->head = (p->head + 1) % p->capacity;
+            p->count--;
+        }
+        else if (plot_resize(p, 2 * p->capacity) < 0)
+        {
+            return -ENOMEM;
+        }
+    }
+    idx = (p->head + p->count) % p->capacity;
+    p->time[idx] = time;
+    memcpy(&p->values[idx * p->numSeries], values, p->numSeries * sizeof(double));
+    p->count++;
+    if (p->record)
+    {
+        if (fwrite(&time, sizeof(double), 1, p->record) != 1 ||
+            fwrite(values, sizeof(double), numValues, p->record) != (size_t)numValues)
+        {
+            return -EIO;
+        }
+    }
+    return 0;
+}
+
+int
+plot_frame(int handle, double xmin)
+{
+    int i, s;
+    int first = 0;
+    int num = 0;
+    PlotStream* p = plot_get(handle);
+
+    if (p == NULL)
+    {
+        return -EBADF;
+    }
+    while ((first < p->count) && (p->time[(p->head + first) % p->capacity] < xmin))
+    {
+        first++;
+    }
+    num = p->count - first;
+    if (num == 0)
+    {
+        return 0;
+    }
+    fputs("plot ", p->out);
+    for (s = 0; s < p->numSeries; s++)
+    {
+        fprintf(p->out, "%s'-' binary record=%d format='%%float64%%float64' using 1:2 title ",
+                        (s > 0 ? ", " : ""), num);
+        plot_putTitle(p->out, p->titles[s]);
+        fprintf(p->out, " axes x1y%d with linespoints", (p->y2[s] ? 2 : 1));
+    }
+    fputc('\n', p->out);
+    for (s = 0; s < p->numSeries; s++)
+    {
+        for (i = 0; i < num; i++)
+        {
+            int idx = (p->head + first + i) % p->capacity;
+            p->frame[2*i] = p->time[idx];
+            p->frame[2*i+1] = p->values[idx * p->numSeries + s];
+        }
+        fwrite(p->frame, sizeof(double), 2 * num, p->out);
+    }
+    if (fflush(p->out) != 0 || ferror(p->out))
+    {
+        return -EIO;
+    }
+    return num;
+}
+
+void
+plot_close(int handle)
+{
+    PlotStream* p = plot_get(handle);
+    if (p == NULL)
+    {
+        return;
+    }
+    if (p->isPipe)
+    {
+        pclose(p->out);
+    }
+    else
+    {
+        fflush(p->out);
+    }
+    if (p->record)
+    {
+        fclose(p->record);
+    }
+    plot_free(p);
+    plot_streams[handle] = NULL;
+}
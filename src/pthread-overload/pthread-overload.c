@@ -34,7 +34,7 @@
 #include <stdint.h>
 #include <dlfcn.h>
 #include <sched.h>
-#include <bits/pthreadtypes.h>
+#include <pthread.h>
 #include <sys/types.h>
 #include <errno.h>
 #include <dirent.h>
@@ -44,12 +44,33 @@
 #ifdef COLOR
 #include <textcolor.h>
 #endif
+#include <numa_interleave.h>
 
 #define STRINGIFY(x) #x
 #define TOSTRING(x) STRINGIFY(x)
 #define LLU_CAST  (unsigned long long)
 
-extern int pthread_setaffinity_np(pthread_t thread, size_t cpusetsize, const cpu_set_t *cpuset);
+typedef int (*pthread_create_func)(pthread_t *, const pthread_attr_t *, void* (*start_routine)(void *), void *);
+
+/* Placement policies, static uses the order of LIKWID_PIN round-robin. The
+ * dynamic policies place a thread on the least-loaded CPU of LIKWID_PIN and
+ * free the CPU again when the thread exits. likwid-pin orders the list for
+ * compact and spread placement, balance only considers the CPUs in the
+ * affinity domain of the creating thread (LIKWID_PIN_DOMAINS). */
+typedef enum {
+    PIN_POLICY_STATIC = 0,
+    PIN_POLICY_BALANCE,
+    PIN_POLICY_COMPACT,
+    PIN_POLICY_SPREAD
+} PinPolicy;
+
+static char* policy_names[] = {"static", "balance", "compact", "spread", NULL};
+
+typedef struct {
+    void* (*start_routine)(void *);
+    void* arg;
+    int slot;
+} PinnedStart;
 
 static char * sosearchpaths[] = {
 #ifdef LIBPTHREAD
@@ -60,6 +81,26 @@ static char * sosearchpaths[] = {
     NULL
 };
 
+/* Number of threads placed on a CPU, padded to a cache line as the
+ * counters are updated concurrently by all creating threads */
+typedef struct {
+    int load;
+} __attribute__ ((aligned (64))) PinLoad;
+
+/* Set up once by the first pthread_create call, the placement counters are
+ * updated atomically as threads may be created concurrently */
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static pthread_create_func rptc = NULL;
+static int npinned = 0;
+static int ncalled = 0;
+static int silent = 0;
+static int* pin_ids = NULL;
+static int* pin_domains = NULL;
+static PinLoad* pin_load = NULL;
+static PinPolicy policy = PIN_POLICY_STATIC;
+static uint64_t skipMask = 0x0;
+static int ncpus = 0;
+
 
 #ifdef COLOR
 #define color_print(format,...) do { \
@@ -73,181 +114,486 @@ static char * sosearchpaths[] = {
     } while(0)
 #endif
 
-int __attribute__ ((visibility ("default") ))
-pthread_create(pthread_t* thread,
-        const pthread_attr_t* attr,
-        void* (*start_routine)(void *),
-        void * arg)
+static void
+resolve_pthread_create(void)
 {
-    void *handle;
+    int reallpthrindex = 0;
+    void *handle = NULL;
     char *error;
-    int (*rptc) (pthread_t *, const pthread_attr_t *, void* (*start_routine)(void *), void *);
-    int ret;
-    static int reallpthrindex = 0;
-    static int npinned = 0;
-    static int ncalled = 0;
-    static int overflow = 0;
-    static int silent = 0;
-    static int pin_ids[MAX_NUM_THREADS];
-    static uint64_t skipMask = 0x0;
-    static int ncpus = 0;
 
-
-    /* On first entry: Get Evironment Variable and initialize pin_ids */
-    if (ncalled == 0)
+    /* The next definition after this library is the one of the C library */
+    rptc = (pthread_create_func) dlsym(RTLD_NEXT, "pthread_create");
+    if (rptc != NULL)
     {
-        char *str;
-        char *token, *saveptr;
-        char *delimiter = ",";
-        int i = 0;
-        cpu_set_t cpuset;
+        return;
+    }
 
-        str = getenv("LIKWID_SKIP");
-        if (str != NULL)
+    while (sosearchpaths[reallpthrindex] != NULL)
+    {
+        handle = dlopen(sosearchpaths[reallpthrindex], RTLD_LAZY);
+        if (handle)
         {
-            skipMask = strtoul(str, &str, 16);
+            break;
         }
-        else if ( skipMask == 0x0 )
-        {
-            dlerror();    /* Clear any existing error */
-            dlsym(RTLD_DEFAULT,"__kmpc_begin");
+        reallpthrindex++;
+    }
 
-            if (( dlerror()) == NULL)  {
-                skipMask = 0x1;
-            }
-        }
+    if (!handle)
+    {
+        color_print("%s\n", dlerror());
+        return;
+    }
 
+    dlerror();    /* Clear any existing error */
+    rptc = (pthread_create_func) dlsym(handle, "pthread_create");
+
+    if ((error = dlerror()) != NULL)
+    {
+        color_print("%s\n", error);
+        rptc = NULL;
+    }
+    /* The handle stays open, rptc points into the library */
+}
+
+#ifdef HAS_MEMPOLICY
+/* Applies the weighted interleaving of LIKWID_INTERLEAVE (node:weight,...)
+ * to the large anonymous mappings. It runs when the first thread is created,
+ * usually the shared data is allocated by then but not yet initialized by
+ * the threads. */
+static void
+interleave_mappings(void)
+{
+    FILE* fp;
+    char line[1024];
+    char* str = getenv("LIKWID_INTERLEAVE");
+    int nodes[NUMA_INTERLEAVE_MAXNODES];
+    int weights[NUMA_INTERLEAVE_MAXNODES];
+    int count = 0;
+    int mapped = 0;
+    int failed = 0;
+    int error = 0;
+    int ret;
 
-        if (getenv("LIKWID_SILENT") != NULL)
+    while ((str != NULL) && (*str != '\0') && (count < (int)NUMA_INTERLEAVE_MAXNODES))
+    {
+        nodes[count] = strtol(str, &str, 10);
+        weights[count] = 1;
+        if (*str == ':')
         {
-            silent = 1;
+            weights[count] = strtol(str+1, &str, 10);
         }
-
-        if (!silent)
+        count++;
+        if (*str == ',')
+        {
+            str++;
+        }
+        else
+        {
+            break;
+        }
+    }
+    if (count == 0)
+    {
+        return;
+    }
+    fp = fopen("/proc/self/maps", "r");
+    if (fp == NULL)
+    {
+        return;
+    }
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        unsigned long start, end;
+        char perms[8];
+        char path[512] = "";
+        if (sscanf(line, "%lx-%lx %7s %*s %*s %*s %511s", &start, &end, perms, path) < 3)
+        {
+            continue;
+        }
+        if ((perms[1] != 'w') || (perms[3] != 'p') ||
+            ((path[0] != '\0') && (strcmp(path, "[heap]") != 0)) ||
+            (end - start < NUMA_INTERLEAVE_MINSIZE))
         {
-            color_print("[pthread wrapper] \n");
+            continue;
         }
+        ret = numa_mbindWeighted((void*)start, end - start, nodes, weights, count, MPOL_MF_MOVE);
+        if (ret == 0)
+        {
+            mapped++;
+        }
+        else
+        {
+            failed++;
+            error = ret;
+        }
+    }
+    fclose(fp);
+    if (failed > 0)
+    {
+        color_print("[pthread wrapper] WARNING: Cannot interleave %d mappings: %s\n",
+                    failed, strerror(-error));
+    }
+    if (!silent)
+    {
+        color_print("[pthread wrapper] INTERLEAVE: %d mappings\n", mapped);
+    }
+}
+#endif
+
+static void
+init_overload(void)
+{
+    char *str;
+    char *token, *saveptr;
+    char *delimiter = ",";
+    int i = 0;
+    int ret;
+    cpu_set_t cpuset;
+
+    str = getenv("LIKWID_SKIP");
+    if (str != NULL)
+    {
+        skipMask = strtoul(str, &str, 16);
+    }
+    else if ( skipMask == 0x0 )
+    {
+        dlerror();    /* Clear any existing error */
+        dlsym(RTLD_DEFAULT,"__kmpc_begin");
+
+        if (( dlerror()) == NULL)  {
+            skipMask = 0x1;
+        }
+    }
 
-        str = getenv("LIKWID_PIN");
-        if (str != NULL)
+
+    if (getenv("LIKWID_SILENT") != NULL)
+    {
+        silent = 1;
+    }
+
+    if (!silent)
+    {
+        color_print("[pthread wrapper] \n");
+    }
+#ifdef HAS_MEMPOLICY
+    interleave_mappings();
+#endif
+
+    str = getenv("LIKWID_PIN");
+    if (str != NULL)
+    {
+        int n = 1;
+        for (token = str; *token != '\0'; token++)
         {
-            token = str;
-            while (token)
+            if (*token == ',')
             {
-                token = strtok_r(str,delimiter,&saveptr);
-                str = NULL;
-                if (token)
-                {
-                    ncpus++;
-                    pin_ids[i++] = strtoul(token, &token, 10);
-                }
+                n++;
             }
-            CPU_ZERO(&cpuset);
-            CPU_SET(pin_ids[ncpus-1], &cpuset);
-            ret = sched_setaffinity(getpid(), sizeof(cpu_set_t), &cpuset);
-            if (!silent)
+        }
+        pin_ids = calloc(n, sizeof(int));
+        pin_domains = calloc(n, sizeof(int));
+        if ((pin_ids == NULL) || (pin_domains == NULL) ||
+            (posix_memalign((void**)&pin_load, sizeof(PinLoad), n * sizeof(PinLoad)) != 0))
+        {
+            color_print("[pthread wrapper] ERROR: Cannot allocate pin list\n");
+            free(pin_ids);
+            free(pin_domains);
+            pin_ids = NULL;
+            pin_domains = NULL;
+            pin_load = NULL;
+            return;
+        }
+        memset(pin_load, 0, n * sizeof(PinLoad));
+        token = str;
+        while (token && i < n)
+        {
+            token = strtok_r(str,delimiter,&saveptr);
+            str = NULL;
+            if (token)
             {
-                color_print("[pthread wrapper] MAIN -> %d\n",pin_ids[ncpus-1]);
+                ncpus++;
+                pin_ids[i++] = strtoul(token, &token, 10);
             }
-            //ncpus--; /* last ID is the first (the process was pinned to) */
         }
-        else
+        if (ncpus == 0)
         {
-            color_print("[pthread wrapper] ERROR: Environment Variabel LIKWID_PIN not set!\n");
+            return;
         }
-
+        CPU_ZERO(&cpuset);
+        CPU_SET(pin_ids[ncpus-1], &cpuset);
+        ret = sched_setaffinity(getpid(), sizeof(cpu_set_t), &cpuset);
         if (!silent)
         {
-            color_print("[pthread wrapper] PIN_MASK: ");
-
-            for (int i=0;i<ncpus-1;i++)
-            {
-                color_print("%d->%d  ",i,pin_ids[i]);
-            }
-            color_print("\n[pthread wrapper] SKIP MASK: 0x%llX\n",LLU_CAST skipMask);
+            color_print("[pthread wrapper] MAIN -> %d\n",pin_ids[ncpus-1]);
         }
+        //ncpus--; /* last ID is the first (the process was pinned to) */
+    }
+    else
+    {
+        color_print("[pthread wrapper] ERROR: Environment Variabel LIKWID_PIN not set!\n");
+    }
 
-        overflow = ncpus;
+    if (!silent)
+    {
+        color_print("[pthread wrapper] PIN_MASK: ");
+
+        for (int i=0;i<ncpus-1;i++)
+        {
+            color_print("%d->%d  ",i,pin_ids[i]);
+        }
+        color_print("\n[pthread wrapper] SKIP MASK: 0x%llX\n",LLU_CAST skipMask);
     }
 
-    /* Handle dll related stuff */
-    do
+    str = getenv("LIKWID_PIN_POLICY");
+    if (str != NULL)
     {
-        handle = dlopen(sosearchpaths[reallpthrindex], RTLD_LAZY);
-        if (handle)
+        for (i = 0; policy_names[i] != NULL; i++)
         {
-            break;
+            if (strcmp(str, policy_names[i]) == 0)
+            {
+                policy = (PinPolicy) i;
+                break;
+            }
         }
-        if (sosearchpaths[reallpthrindex] != NULL) 
+        if (policy_names[i] == NULL)
         {
-            reallpthrindex++;
+            color_print("[pthread wrapper] ERROR: Unknown placement policy %s, using static\n", str);
         }
     }
-
-    while (sosearchpaths[reallpthrindex] != NULL);
-
-    if (!handle)
+    str = getenv("LIKWID_PIN_DOMAINS");
+    i = 0;
+    while ((str != NULL) && (*str != '\0') && (i < ncpus))
     {
-        color_print("%s\n", dlerror());
-        return -1;
+        pin_domains[i++] = strtol(str, &str, 10);
+        if (*str == ',')
+        {
+            str++;
+        }
     }
-
-    dlerror();    /* Clear any existing error */
-    rptc = dlsym(handle, "pthread_create");
-
-    if ((error = dlerror()) != NULL)
+    if (ncpus > 0)
     {
-        color_print("%s\n", error);
-        return -2;
+        /* The main thread runs on the last CPU of the list */
+        pin_load[ncpus-1].load = 1;
+    }
+    if ((!silent) && (policy != PIN_POLICY_STATIC))
+    {
+        color_print("[pthread wrapper] POLICY: %s\n", policy_names[policy]);
     }
 
-    ret = (*rptc)(thread, attr, start_routine, arg);
+    resolve_pthread_create();
+}
 
-    /* After thread creation pin the thread */
-    if (ret == 0)
-    {
-        cpu_set_t cpuset;
+/* Takes the least-loaded CPU, for the balance policy only out of the domain
+ * of the creating thread. Ties are resolved by the order of the list. */
+static int
+acquire_slot(void)
+{
+    int i;
+    int slot;
+    int load;
+    int domain = -1;
 
-        if ((ncalled<64) && (skipMask&(1ULL<<(ncalled))))
+    if (policy == PIN_POLICY_BALANCE)
+    {
+        int cpu = sched_getcpu();
+        for (i = 0; i < ncpus; i++)
         {
-            if (!silent)
+            if (pin_ids[i] == cpu)
             {
-                color_print("\tthreadid %lu -> SKIP \n", *thread);
+                domain = pin_domains[i];
+                break;
             }
         }
-        else
+    }
+    do
+    {
+        slot = -1;
+        load = 0;
+        for (i = 0; i < ncpus; i++)
         {
-            CPU_ZERO(&cpuset);
-            CPU_SET(pin_ids[npinned], &cpuset);
-            pthread_setaffinity_np(*thread, sizeof(cpu_set_t), &cpuset);
-
-            if (npinned == overflow)
+            int l = __atomic_load_n(&pin_load[i].load, __ATOMIC_RELAXED);
+            if ((domain >= 0) && (pin_domains[i] != domain))
             {
-                if (!silent)
-                {
-                    color_print("Roundrobin placement triggered\n\tthreadid %lu -> core %d - OK", *thread, pin_ids[npinned]);
-                }
-                npinned = 0;
+                continue;
             }
-            else
+            if ((slot < 0) || (l < load))
             {
-                if (!silent)
-                {
-                    color_print("\tthreadid %lu -> core %d - OK", *thread, pin_ids[npinned]);
-                }
-                npinned++;
+                slot = i;
+                load = l;
             }
+        }
+    } while (!__sync_bool_compare_and_swap(&pin_load[slot].load, load, load + 1));
+    return slot;
+}
 
-            if (!silent)
-            {
-                color_print("\n");
-            }
+static void
+release_slot(void* ptr)
+{
+    PinnedStart* start = (PinnedStart*) ptr;
+    __sync_fetch_and_sub(&pin_load[start->slot].load, 1);
+    free(start);
+}
+
+/* Start routine of threads placed by a dynamic policy, the CPU is released
+ * on return and on pthread_exit or cancellation */
+static void*
+pinned_start(void* ptr)
+{
+    void* ret;
+    PinnedStart* start = (PinnedStart*) ptr;
+
+    pthread_cleanup_push(release_slot, start);
+    ret = start->start_routine(start->arg);
+    pthread_cleanup_pop(1);
+    return ret;
+}
+
+/* Copies the settings of attr to the initialized attribute object copy. The
+ * caller's object is not modified, a CPU set in it is replaced by the
+ * pinning. */
+static void
+copy_attr(const pthread_attr_t* attr, pthread_attr_t* copy)
+{
+    int value;
+    size_t size;
+    void* stackaddr;
+    struct sched_param param;
+
+    if (pthread_attr_getdetachstate(attr, &value) == 0)
+    {
+        pthread_attr_setdetachstate(copy, value);
+    }
+    if (pthread_attr_getscope(attr, &value) == 0)
+    {
+        pthread_attr_setscope(copy, value);
+    }
+    if (pthread_attr_getinheritsched(attr, &value) == 0)
+    {
+        pthread_attr_setinheritsched(copy, value);
+    }
+    if (pthread_attr_getschedpolicy(attr, &value) == 0)
+    {
+        pthread_attr_setschedpolicy(copy, value);
+    }
+    if (pthread_attr_getschedparam(attr, &param) == 0)
+    {
+        pthread_attr_setschedparam(copy, &param);
+    }
+    if (pthread_attr_getguardsize(attr, &size) == 0)
+    {
+        pthread_attr_setguardsize(copy, size);
+    }
+    /* A stack given by the application is reported with its real address,
+     * otherwise glibc returns an address that wraps to NULL at its end */
+    if ((pthread_attr_getstack(attr, &stackaddr, &size) == 0) &&
+        (stackaddr != NULL) && ((uintptr_t)stackaddr + size != 0))
+    {
+        pthread_attr_setstack(copy, stackaddr, size);
+    }
+    else if (pthread_attr_getstacksize(attr, &size) == 0)
+    {
+        pthread_attr_setstacksize(copy, size);
+    }
+}
+
+int __attribute__ ((visibility ("default") ))
+pthread_create(pthread_t* thread,
+        const pthread_attr_t* attr,
+        void* (*start_routine)(void *),
+        void * arg)
+{
+    int ret;
+    int call;
+    int slot;
+    int pinned;
+    pthread_attr_t pinattr;
+    cpu_set_t cpuset;
+    PinnedStart* start = NULL;
+
+    /* On first entry: Get Evironment Variable and initialize pin_ids */
+    pthread_once(&init_once, init_overload);
+    if (rptc == NULL)
+    {
+        return EAGAIN;
+    }
+
+    call = __sync_fetch_and_add(&ncalled, 1);
+    if ((ncpus == 0) || ((call<64) && (skipMask&(1ULL<<(call)))))
+    {
+        ret = rptc(thread, attr, start_routine, arg);
+        if ((ret == 0) && (!silent))
+        {
+            color_print("\tthreadid %lu -> SKIP \n", *thread);
+            fflush(stdout);
+        }
+        return ret;
+    }
+
+    /* Create the thread with the CPU set in its attributes, so it runs on its
+     * CPU from the first instruction */
+    pinned = __sync_fetch_and_add(&npinned, 1);
+    if (policy == PIN_POLICY_STATIC)
+    {
+        slot = pinned % ncpus;
+    }
+    else
+    {
+        start = malloc(sizeof(PinnedStart));
+        if (start == NULL)
+        {
+            __sync_fetch_and_sub(&npinned, 1);
+            return EAGAIN;
+        }
+        slot = acquire_slot();
+        start->start_routine = start_routine;
+        start->arg = arg;
+        start->slot = slot;
+    }
+    pthread_attr_init(&pinattr);
+    if (attr != NULL)
+    {
+        copy_attr(attr, &pinattr);
+    }
+    CPU_ZERO(&cpuset);
+    CPU_SET(pin_ids[slot], &cpuset);
+    pthread_attr_setaffinity_np(&pinattr, sizeof(cpu_set_t), &cpuset);
+    if (start != NULL)
+    {
+        ret = rptc(thread, &pinattr, pinned_start, start);
+        if (ret != 0)
+        {
+            release_slot(start);
+        }
+    }
+    else
+    {
+        ret = rptc(thread, &pinattr, start_routine, arg);
+    }
+    pthread_attr_destroy(&pinattr);
+    if (ret != 0)
+    {
+        /* The thread did not take its CPU, the following threads keep
+         * their places */
+        __sync_fetch_and_sub(&npinned, 1);
+        if (ret == EINVAL)
+        {
+            /* The CPU is not in the cpuset of the process (cgroups, batch
+             * allocations). Create the thread unpinned like before. */
+            color_print("[pthread wrapper] WARNING: Cannot pin thread to core %d, running it unpinned\n",
+                        pin_ids[slot]);
+            return rptc(thread, attr, start_routine, arg);
         }
     }
 
-    fflush(stdout);
-    ncalled++;
-    dlclose(handle);
+    if ((ret == 0) && (!silent))
+    {
+        if ((policy == PIN_POLICY_STATIC) && (pinned >= ncpus) && (slot == 0))
+        {
+            color_print("Roundrobin placement triggered\n");
+        }
+        color_print("\tthreadid %lu -> core %d - OK\n", *thread, pin_ids[slot]);
+        fflush(stdout);
+    }
 
     return ret;
 }
@@ -0,0 +1,1086 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  result_record.c
+ *
+ *      Description:  Binary result records of likwid-mpirun. Every rank writes
+ *                    its counter results as one record, the records are merged
+ *                    per node and finally as a reduction tree. Merged records
+ *                    keep the rank entries unparsed and carry mergeable
+ *                    min/max/sum statistics per node.
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+/* #####   HEADER FILE INCLUDES   ######################################### */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <types.h>
+#include <error.h>
+#include <result_record.h>
+
+/* #####   LOCAL TYPE DEFINITIONS   ####################################### */
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t used;
+} RecordBuffer;
+
+typedef struct {
+    const char* data;
+    size_t length;
+    size_t pos;
+} RecordReader;
+
+typedef struct {
+    int rank;
+    const char* data;
+    size_t length;
+} RecordRankRef;
+
+typedef struct {
+    pthread_t thread;
+    int first;
+    int stride;
+    int count;
+    int step;
+    const char** files;
+    ResultRecord** records;
+} RecordWorker;
+
+/* #####   FUNCTION DEFINITIONS  -  LOCAL TO THIS SOURCE FILE   ########### */
+
+static int
+buffer_put(RecordBuffer* buf, const void* src, size_t len)
+{
+    if (buf->used + len > buf->size)
+    {
+        size_t newsize = (buf->size > 0 ? 2 * buf->size : 4096);
+        char* tmp = NULL;
+        while (newsize < buf->used + len)
+        {
+            newsize *= 2;
+        }
+        tmp = realloc(buf->data, newsize);
+        if (tmp == NULL)
+        {
+            return -ENOMEM;
+        }
+        buf->data = tmp;
+        buf->size = newsize;
+    }
+    memcpy(buf->data + buf->used, src, len);
+    buf->used += len;
+    return 0;
+}
+
+static int
+buffer_putInt(RecordBuffer* buf, int value)
+{
+    int32_t tmp = (int32_t) value;
+    return buffer_put(buf, &tmp, sizeof(int32_t));
+}
+
+static int
+buffer_putDouble(RecordBuffer* buf, double value)
+{
+    return buffer_put(buf, &value, sizeof(double));
+}
+
+static int
+buffer_putString(RecordBuffer* buf, const char* str)
+{
+    int len = (str ? strlen(str) : 0);
+    int ret = buffer_putInt(buf, len);
+    if (ret == 0 && len > 0)
+    {
+        ret = buffer_put(buf, str, len);
+    }
+    return ret;
+}
+
+static int
+reader_get(RecordReader* r, void* dst, size_t len)
+{
+    if (len > r->length - r->pos)
+    {
+        return -EINVAL;
+    }
+    memcpy(dst, r->data + r->pos, len);
+    r->pos += len;
+    return 0;
+}
+
+static int
+reader_getInt(RecordReader* r, int* value)
+{
+    int32_t tmp = 0;
+    int ret = reader_get(r, &tmp, sizeof(int32_t));
+    *value = (int) tmp;
+    return ret;
+}
+
+static int
+reader_getCount(RecordReader* r, int* value, size_t elemSize)
+{
+    int ret = reader_getInt(r, value);
+    if (ret == 0 && (*value < 0 || (size_t)(*value) * elemSize > r->length - r->pos))
+    {
+        ret = -EINVAL;
+    }
+    return ret;
+}
+
+static int
+reader_getDoubles(RecordReader* r, double** values, size_t count)
+{
+    *values = malloc((count > 0 ? count : 1) * sizeof(double));
+    if (*values == NULL)
+    {
+        return -ENOMEM;
+    }
+    return reader_get(r, *values, count * sizeof(double));
+}
+
+static int
+reader_getString(RecordReader* r, char** str)
+{
+    int len = 0;
+    int ret = reader_getCount(r, &len, 1);
+    if (ret < 0)
+    {
+        return ret;
+    }
+    *str = malloc(len + 1);
+    if (*str == NULL)
+    {
+        return -ENOMEM;
+    }
+    ret = reader_get(r, *str, len);
+    (*str)[len] = '\0';
+    return ret;
+}
+
+static void
+stat_add(RecordStat* s, double value)
+{
+    if (s->count == 0 || value < s->min)
+    {
+        s->min = value;
+    }
+    if (s->count == 0 || value > s->max)
+    {
+        s->max = value;
+    }
+    s->count += 1;
+    s->sum += value;
+}
+
+static void
+stat_merge(RecordStat* dest, RecordStat* src)
+{
+    if (src->count == 0)
+    {
+        return;
+    }
+    if (dest->count == 0)
+    {
+        *dest = *src;
+        return;
+    }
+    if (src->min < dest->min)
+    {
+        dest->min = src->min;
+    }
+    if (src->max > dest->max)
+    {
+        dest->max = src->max;
+    }
+    dest->count += src->count;
+    dest->sum += src->sum;
+}
+
+static int
+record_encodeRank(RecordBuffer* buf, RecordRank* rank)
+{
+    int i, s;
+    int ret = 0;
+
+    ret |= buffer_putInt(buf, rank->rank);
+    ret |= buffer_putString(buf, rank->hostname);
+    ret |= buffer_putDouble(buf, rank->clock);
+    ret |= buffer_putInt(buf, rank->numCpus);
+    for (i = 0; i < rank->numCpus; i++)
+    {
+        ret |= buffer_putInt(buf, rank->cpus[i]);
+    }
+    ret |= buffer_putInt(buf, rank->numSections);
+    for (s = 0; s < rank->numSections; s++)
+    {
+        RecordSection* sec = &rank->sections[s];
+        ret |= buffer_putString(buf, sec->region);
+        ret |= buffer_putInt(buf, sec->group);
+        ret |= buffer_putInt(buf, sec->numEvents);
+        ret |= buffer_put(buf, sec->time, rank->numCpus * sizeof(double));
+        ret |= buffer_put(buf, sec->calls, rank->numCpus * sizeof(double));
+        ret |= buffer_put(buf, sec->values, sec->numEvents * rank->numCpus * sizeof(double));
+    }
+    return (ret ? -ENOMEM : 0);
+}
+
+static int
+record_encodeScope(RecordBuffer* buf, RecordScope* scope)
+{
+    int s;
+    int ret = 0;
+
+    ret |= buffer_putString(buf, scope->hostname);
+    ret |= buffer_putInt(buf, scope->numRanks);
+    ret |= buffer_putInt(buf, scope->numCpus);
+    ret |= buffer_putInt(buf, scope->numSections);
+    for (s = 0; s < scope->numSections; s++)
+    {
+        RecordStatSection* sec = &scope->sections[s];
+        ret |= buffer_putString(buf, sec->region);
+        ret |= buffer_putInt(buf, sec->group);
+        ret |= buffer_putInt(buf, sec->numEvents);
+        ret |= buffer_put(buf, &sec->time, sizeof(RecordStat));
+        ret |= buffer_put(buf, &sec->calls, sizeof(RecordStat));
+        ret |= buffer_put(buf, sec->events, sec->numEvents * sizeof(RecordStat));
+    }
+    return (ret ? -ENOMEM : 0);
+}
+
+static int
+record_decodeScope(const char* data, size_t length, RecordScope* scope)
+{
+    int s;
+    int ret = 0;
+    RecordReader r = {data, length, 0};
+
+    memset(scope, 0, sizeof(RecordScope));
+    ret = reader_getString(&r, &scope->hostname);
+    if (ret == 0)
+        ret = reader_getInt(&r, &scope->numRanks);
+    if (ret == 0)
+        ret = reader_getInt(&r, &scope->numCpus);
+    if (ret == 0)
+        ret = reader_getCount(&r, &scope->numSections, sizeof(int32_t));
+    if (ret == 0 && scope->numSections > 0)
+    {
+        scope->sections = calloc(scope->numSections, sizeof(RecordStatSection));
+        if (scope->sections == NULL)
+        {
+            scope->numSections = 0;
+            ret = -ENOMEM;
+        }
+    }
+    for (s = 0; ret == 0 && s < scope->numSections; s++)
+    {
+        RecordStatSection* sec = &scope->sections[s];
+        ret = reader_getString(&r, &sec->region);
+        if (ret == 0)
+            ret = reader_getInt(&r, &sec->group);
+        if (ret == 0)
+            ret = reader_getCount(&r, &sec->numEvents, sizeof(RecordStat));
+        if (ret == 0)
+            ret = reader_get(&r, &sec->time, sizeof(RecordStat));
+        if (ret == 0)
+            ret = reader_get(&r, &sec->calls, sizeof(RecordStat));
+        if (ret == 0)
+        {
+            sec->events = malloc((sec->numEvents > 0 ? sec->numEvents : 1) * sizeof(RecordStat));
+            ret = (sec->events ? reader_get(&r, sec->events, sec->numEvents * sizeof(RecordStat)) : -ENOMEM);
+        }
+    }
+    if (ret < 0)
+    {
+        record_freeScope(scope);
+    }
+    return ret;
+}
+
+static int
+scope_findSection(RecordScope* scope, const char* region, int group)
+{
+    int s;
+    for (s = 0; s < scope->numSections; s++)
+    {
+        if (scope->sections[s].group == group && strcmp(scope->sections[s].region, region) == 0)
+        {
+            return s;
+        }
+    }
+    return -1;
+}
+
+static int
+scope_addSection(RecordScope* scope, const char* region, int group)
+{
+    RecordStatSection* tmp = realloc(scope->sections, (scope->numSections + 1) * sizeof(RecordStatSection));
+    if (tmp == NULL)
+    {
+        return -ENOMEM;
+    }
+    scope->sections = tmp;
+    tmp = &scope->sections[scope->numSections];
+    memset(tmp, 0, sizeof(RecordStatSection));
+    tmp->region = strdup(region);
+    tmp->group = group;
+    if (tmp->region == NULL)
+    {
+        return -ENOMEM;
+    }
+    return scope->numSections++;
+}
+
+static int
+section_resizeEvents(RecordStatSection* sec, int numEvents)
+{
+    RecordStat* tmp = NULL;
+    if (numEvents <= sec->numEvents)
+    {
+        return 0;
+    }
+    tmp = realloc(sec->events, numEvents * sizeof(RecordStat));
+    if (tmp == NULL)
+    {
+        return -ENOMEM;
+    }
+    memset(&tmp[sec->numEvents], 0, (numEvents - sec->numEvents) * sizeof(RecordStat));
+    sec->events = tmp;
+    sec->numEvents = numEvents;
+    return 0;
+}
+
+static ResultRecord*
+record_new(void)
+{
+    return calloc(1, sizeof(ResultRecord));
+}
+
+static int
+record_addRank(ResultRecord* rec, const char* data, size_t length)
+{
+    if (rec->numRanks == rec->rankSize)
+    {
+        int newsize = (rec->rankSize > 0 ? 2 * rec->rankSize : 16);
+        const char** tmpData = realloc(rec->rankData, newsize * sizeof(char*));
+        size_t* tmpLength = NULL;
+        if (tmpData == NULL)
+        {
+            return -ENOMEM;
+        }
+        rec->rankData = tmpData;
+        tmpLength = realloc(rec->rankLength, newsize * sizeof(size_t));
+        if (tmpLength == NULL)
+        {
+            return -ENOMEM;
+        }
+        rec->rankLength = tmpLength;
+        rec->rankSize = newsize;
+    }
+    rec->rankData[rec->numRanks] = data;
+    rec->rankLength[rec->numRanks] = length;
+    rec->numRanks++;
+    return 0;
+}
+
+/* Takes over the content of scope */
+static int
+record_addNode(ResultRecord* rec, RecordScope* scope)
+{
+    int i;
+    int ret = 0;
+    RecordScope* tmp = NULL;
+
+    for (i = 0; i < rec->numNodes; i++)
+    {
+        if (strcmp(rec->nodes[i].hostname, scope->hostname) == 0)
+        {
+            ret = record_mergeScope(&rec->nodes[i], scope);
+            record_freeScope(scope);
+            return ret;
+        }
+    }
+    tmp = realloc(rec->nodes, (rec->numNodes + 1) * sizeof(RecordScope));
+    if (tmp == NULL)
+    {
+        record_freeScope(scope);
+        return -ENOMEM;
+    }
+    rec->nodes = tmp;
+    rec->nodes[rec->numNodes++] = *scope;
+    return 0;
+}
+
+static int
+record_addMap(ResultRecord* rec, void* map, size_t length)
+{
+    void** tmpMaps = realloc(rec->maps, (rec->numMaps + 1) * sizeof(void*));
+    size_t* tmpLength = NULL;
+    if (tmpMaps == NULL)
+    {
+        return -ENOMEM;
+    }
+    rec->maps = tmpMaps;
+    tmpLength = realloc(rec->mapLength, (rec->numMaps + 1) * sizeof(size_t));
+    if (tmpLength == NULL)
+    {
+        return -ENOMEM;
+    }
+    rec->mapLength = tmpLength;
+    rec->maps[rec->numMaps] = map;
+    rec->mapLength[rec->numMaps] = length;
+    rec->numMaps++;
+    return 0;
+}
+
+static int
+record_load(const char* filename, ResultRecord** record)
+{
+    int i;
+    int fd;
+    int ret = 0;
+    struct stat st;
+    void* map = NULL;
+    RecordHeader header;
+    RecordReader r;
+    ResultRecord* rec = NULL;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return -errno;
+    }
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(RecordHeader))
+    {
+        close(fd);
+        return -EINVAL;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return -errno;
+    }
+    rec = record_new();
+    if (rec == NULL || record_addMap(rec, map, st.st_size) < 0)
+    {
+        munmap(map, st.st_size);
+        free(rec);
+        return -ENOMEM;
+    }
+    r.data = map;
+    r.length = st.st_size;
+    r.pos = 0;
+    reader_get(&r, &header, sizeof(RecordHeader));
+    if (strncmp(header.magic, RECORD_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != RECORD_VERSION)
+    {
+        record_free(rec);
+        return -EINVAL;
+    }
+    for (i = 0; ret == 0 && i < (int)header.numRanks; i++)
+    {
+        uint64_t len = 0;
+        ret = reader_get(&r, &len, sizeof(uint64_t));
+        if (ret == 0 && len > r.length - r.pos)
+        {
+            ret = -EINVAL;
+        }
+        if (ret == 0)
+        {
+            ret = record_addRank(rec, r.data + r.pos, len);
+            r.pos += len;
+        }
+    }
+    for (i = 0; ret == 0 && i < (int)header.numNodes; i++)
+    {
+        uint64_t len = 0;
+        RecordScope scope;
+        ret = reader_get(&r, &len, sizeof(uint64_t));
+        if (ret == 0 && len > r.length - r.pos)
+        {
+            ret = -EINVAL;
+        }
+        if (ret == 0)
+        {
+            ret = record_decodeScope(r.data + r.pos, len, &scope);
+            r.pos += len;
+        }
+        if (ret == 0)
+        {
+            ret = record_addNode(rec, &scope);
+        }
+    }
+    /* Record of a single rank, build its node scope */
+    if (ret == 0 && header.numNodes == 0)
+    {
+        for (i = 0; ret == 0 && i < rec->numRanks; i++)
+        {
+            RecordRank rank;
+            RecordScope scope;
+            ret = record_decodeRank(rec->rankData[i], rec->rankLength[i], &rank);
+            if (ret == 0)
+            {
+                ret = record_rankScope(&rank, &scope);
+                record_freeRank(&rank);
+            }
+            if (ret == 0)
+            {
+                ret = record_addNode(rec, &scope);
+            }
+        }
+    }
+    if (ret < 0)
+    {
+        record_free(rec);
+        return ret;
+    }
+    *record = rec;
+    return 0;
+}
+
+/* Moves all mappings, ranks and nodes of src to dest and frees src */
+static int
+record_absorb(ResultRecord* dest, ResultRecord* src)
+{
+    int i;
+    int ret = 0;
+
+    for (i = 0; ret == 0 && i < src->numMaps; i++)
+    {
+        ret = record_addMap(dest, src->maps[i], src->mapLength[i]);
+        if (ret == 0)
+        {
+            src->maps[i] = NULL;
+        }
+    }
+    /* The ranks of src point into its mappings */
+    for (i = 0; ret == 0 && i < src->numRanks; i++)
+    {
+        ret = record_addRank(dest, src->rankData[i], src->rankLength[i]);
+    }
+    for (i = 0; i < src->numNodes; i++)
+    {
+        if (ret == 0)
+        {
+            ret = record_addNode(dest, &src->nodes[i]);
+        }
+        else
+        {
+            record_freeScope(&src->nodes[i]);
+        }
+    }
+    src->numNodes = 0;
+    record_free(src);
+    return ret;
+}
+
+static void*
+record_loadWorker(void* arg)
+{
+    int i;
+    int ret;
+    RecordWorker* w = (RecordWorker*) arg;
+
+    for (i = w->first; i < w->count; i += w->stride)
+    {
+        w->records[i] = NULL;
+        ret = record_load(w->files[i], &w->records[i]);
+        if (ret < 0)
+        {
+            errno = -ret;
+            ERROR_PRINT(Cannot read result record %s, w->files[i]);
+        }
+    }
+    return NULL;
+}
+
+static void*
+record_reduceWorker(void* arg)
+{
+    int i, j;
+    RecordWorker* w = (RecordWorker*) arg;
+
+    for (j = w->first; ; j += w->stride)
+    {
+        i = j * 2 * w->step;
+        if (i + w->step >= w->count)
+        {
+            break;
+        }
+        if (w->records[i + w->step] == NULL)
+        {
+            continue;
+        }
+        if (w->records[i] == NULL)
+        {
+            w->records[i] = w->records[i + w->step];
+        }
+        else if (record_absorb(w->records[i], w->records[i + w->step]) < 0)
+        {
+            ERROR_PLAIN_PRINT(Cannot merge result records);
+        }
+        w->records[i + w->step] = NULL;
+    }
+    return NULL;
+}
+
+static void
+record_runWorkers(int numThreads, RecordWorker* workers, void* (*func)(void*))
+{
+    int t;
+    for (t = 0; t < numThreads; t++)
+    {
+        if (pthread_create(&workers[t].thread, NULL, func, &workers[t]) != 0)
+        {
+            func(&workers[t]);
+            workers[t].stride = 0;
+        }
+    }
+    for (t = 0; t < numThreads; t++)
+    {
+        if (workers[t].stride > 0)
+        {
+            pthread_join(workers[t].thread, NULL);
+        }
+    }
+}
+
+static int
+record_compareRank(const void* a, const void* b)
+{
+    const RecordRankRef* ra = (const RecordRankRef*) a;
+    const RecordRankRef* rb = (const RecordRankRef*) b;
+    return (ra->rank > rb->rank) - (ra->rank < rb->rank);
+}
+
+static int
+record_sortRanks(ResultRecord* rec)
+{
+    int i;
+    RecordRankRef* refs = NULL;
+
+    if (rec->numRanks < 2)
+    {
+        return 0;
+    }
+    refs = malloc(rec->numRanks * sizeof(RecordRankRef));
+    if (refs == NULL)
+    {
+        return -ENOMEM;
+    }
+    for (i = 0; i < rec->numRanks; i++)
+    {
+        int32_t rank = 0;
+        if (rec->rankLength[i] >= sizeof(int32_t))
+        {
+            memcpy(&rank, rec->rankData[i], sizeof(int32_t));
+        }
+        refs[i].rank = rank;
+        refs[i].data = rec->rankData[i];
+        refs[i].length = rec->rankLength[i];
+    }
+    qsort(refs, rec->numRanks, sizeof(RecordRankRef), record_compareRank);
+    for (i = 0; i < rec->numRanks; i++)
+    {
+        rec->rankData[i] = refs[i].data;
+        rec->rankLength[i] = refs[i].length;
+    }
+    free(refs);
+    return 0;
+}
+
+static int
+record_putEntry(FILE* fp, const char* data, size_t length)
+{
+    uint64_t len = length;
+    if (fwrite(&len, sizeof(uint64_t), 1, fp) != 1)
+    {
+        return -EIO;
+    }
+    if (length > 0 && fwrite(data, length, 1, fp) != 1)
+    {
+        return -EIO;
+    }
+    return 0;
+}
+
+/* #####   FUNCTION DEFINITIONS  -  EXPORTED FUNCTIONS   ################## */
+
+int
+record_decodeRank(const char* data, size_t length, RecordRank* rank)
+{
+    int i, s;
+    int ret = 0;
+    RecordReader r = {data, length, 0};
+
+    memset(rank, 0, sizeof(RecordRank));
+    ret = reader_getInt(&r, &rank->rank);
+    if (ret == 0)
+        ret = reader_getString(&r, &rank->hostname);
+    if (ret == 0)
+        ret = reader_get(&r, &rank->clock, sizeof(double));
+    if (ret == 0)
+        ret = reader_getCount(&r, &rank->numCpus, sizeof(int32_t));
+    if (ret == 0)
+    {
+        rank->cpus = malloc((rank->numCpus > 0 ? rank->numCpus : 1) * sizeof(int));
+        if (rank->cpus == NULL)
+        {
+            ret = -ENOMEM;
+        }
+    }
+    for (i = 0; ret == 0 && i < rank->numCpus; i++)
+    {
+        ret = reader_getInt(&r, &rank->cpus[i]);
+    }
+    if (ret == 0)
+        ret = reader_getCount(&r, &rank->numSections, sizeof(int32_t));
+    if (ret == 0 && rank->numSections > 0)
+    {
+        rank->sections = calloc(rank->numSections, sizeof(RecordSection));
+        if (rank->sections == NULL)
+        {
+            rank->numSections = 0;
+            ret = -ENOMEM;
+        }
+    }
+    for (s = 0; ret == 0 && s < rank->numSections; s++)
+    {
+        RecordSection* sec = &rank->sections[s];
+        ret = reader_getString(&r, &sec->region);
+        if (ret == 0)
+            ret = reader_getInt(&r, &sec->group);
+        if (ret == 0)
+            ret = reader_getCount(&r, &sec->numEvents, rank->numCpus * sizeof(double));
+        if (ret == 0)
+            ret = reader_getDoubles(&r, &sec->time, rank->numCpus);
+        if (ret == 0)
+            ret = reader_getDoubles(&r, &sec->calls, rank->numCpus);
+        if (ret == 0)
+            ret = reader_getDoubles(&r, &sec->values, sec->numEvents * rank->numCpus);
+    }
+    if (ret < 0)
+    {
+        record_freeRank(rank);
+    }
+    return ret;
+}
+
+void
+record_freeRank(RecordRank* rank)
+{
+    int s;
+    if (rank->sections)
+    {
+        for (s = 0; s < rank->numSections; s++)
+        {
+            free(rank->sections[s].region);
+            free(rank->sections[s].time);
+            free(rank->sections[s].calls);
+            free(rank->sections[s].values);
+        }
+        free(rank->sections);
+    }
+    free(rank->hostname);
+    free(rank->cpus);
+    memset(rank, 0, sizeof(RecordRank));
+}
+
+int
+record_writeRank(const char* filename, RecordRank* rank)
+{
+    int ret;
+    RecordBuffer buf = {NULL, 0, 0};
+    ResultRecord rec;
+    const char* data[1];
+    size_t length[1];
+
+    ret = record_encodeRank(&buf, rank);
+    if (ret < 0)
+    {
+        free(buf.data);
+        return ret;
+    }
+    memset(&rec, 0, sizeof(ResultRecord));
+    data[0] = buf.data;
+    length[0] = buf.used;
+    rec.numRanks = 1;
+    rec.rankSize = 1;
+    rec.rankData = data;
+    rec.rankLength = length;
+    ret = record_write(filename, &rec);
+    free(buf.data);
+    return ret;
+}
+
+int
+record_rankScope(RecordRank* rank, RecordScope* scope)
+{
+    int i, e, s;
+
+    memset(scope, 0, sizeof(RecordScope));
+    scope->hostname = strdup(rank->hostname ? rank->hostname : "");
+    scope->numRanks = 1;
+    scope->numCpus = rank->numCpus;
+    if (scope->hostname == NULL)
+    {
+        return -ENOMEM;
+    }
+    for (s = 0; s < rank->numSections; s++)
+    {
+        RecordSection* sec = &rank->sections[s];
+        RecordStatSection* dest = NULL;
+        int idx = scope_addSection(scope, sec->region, sec->group);
+        if (idx < 0 || section_resizeEvents(&scope->sections[idx], sec->numEvents) < 0)
+        {
+            record_freeScope(scope);
+            return -ENOMEM;
+        }
+        dest = &scope->sections[idx];
+        for (i = 0; i < rank->numCpus; i++)
+        {
+            stat_add(&dest->time, sec->time[i]);
+            stat_add(&dest->calls, sec->calls[i]);
+            for (e = 0; e < sec->numEvents; e++)
+            {
+                stat_add(&dest->events[e], sec->values[e * rank->numCpus + i]);
+            }
+        }
+    }
+    return 0;
+}
+
+int
+record_mergeScope(RecordScope* dest, RecordScope* src)
+{
+    int e, s;
+
+    dest->numRanks += src->numRanks;
+    dest->numCpus += src->numCpus;
+    for (s = 0; s < src->numSections; s++)
+    {
+        RecordStatSection* sec = &src->sections[s];
+        int idx = scope_findSection(dest, sec->region, sec->group);
+        if (idx < 0)
+        {
+            idx = scope_addSection(dest, sec->region, sec->group);
+        }
+        if (idx < 0 || section_resizeEvents(&dest->sections[idx], sec->numEvents) < 0)
+        {
+            return -ENOMEM;
+        }
+        stat_merge(&dest->sections[idx].time, &sec->time);
+        stat_merge(&dest->sections[idx].calls, &sec->calls);
+        for (e = 0; e < sec->numEvents; e++)
+        {
+            stat_merge(&dest->sections[idx].events[e], &sec->events[e]);
+        }
+    }
+    return 0;
+}
+
+void
+record_freeScope(RecordScope* scope)
+{
+    int s;
+    if (scope->sections)
+    {
+        for (s = 0; s < scope->numSections; s++)
+        {
+            free(scope->sections[s].region);
+            free(scope->sections[s].events);
+        }
+        free(scope->sections);
+    }
+    free(scope->hostname);
+    memset(scope, 0, sizeof(RecordScope));
+}
+
+int
+record_merge(int numFiles, const char** files, ResultRecord** record)
+{
+    int t;
+    int step;
+    int numThreads;
+    ResultRecord** records = NULL;
+    RecordWorker workers[RECORD_MAX_THREADS];
+
+    if (numFiles <= 0)
+    {
+        return -EINVAL;
+    }
+    records = calloc(numFiles, sizeof(ResultRecord*));
+    if (records == NULL)
+    {
+        return -ENOMEM;
+    }
+    numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (numThreads > RECORD_MAX_THREADS)
+    {
+        numThreads = RECORD_MAX_THREADS;
+    }
+    if (numThreads > numFiles)
+    {
+        numThreads = numFiles;
+    }
+    if (numThreads < 1)
+    {
+        numThreads = 1;
+    }
+    for (t = 0; t < numThreads; t++)
+    {
+        workers[t].first = t;
+        workers[t].stride = numThreads;
+        workers[t].count = numFiles;
+        workers[t].step = 0;
+        workers[t].files = files;
+        workers[t].records = records;
+    }
+    record_runWorkers(numThreads, workers, record_loadWorker);
+
+    /* Pairwise reduction, in level l record i absorbs record i + 2^l */
+    for (step = 1; step < numFiles; step *= 2)
+    {
+        int pairs = (numFiles + 2 * step - 1) / (2 * step);
+        int levelThreads = (pairs < numThreads ? pairs : numThreads);
+        for (t = 0; t < levelThreads; t++)
+        {
+            workers[t].first = t;
+            workers[t].stride = levelThreads;
+            workers[t].step = step;
+        }
+        record_runWorkers(levelThreads, workers, record_reduceWorker);
+    }
+    *record = records[0];
+    free(records);
+    if (*record == NULL)
+    {
+        return -ENOENT;
+    }
+    DEBUG_PRINT(DEBUGLEV_DEVELOP, Merged %d result records with %d ranks on %d nodes,
+                numFiles, (*record)->numRanks, (*record)->numNodes);
+    return record_sortRanks(*record);
+}
+
+int
+record_write(const char* filename, ResultRecord* record)
+{
+    int i;
+    int ret = 0;
+    FILE* fp = NULL;
+    RecordHeader header;
+    RecordBuffer buf = {NULL, 0, 0};
+    char* tmpname = malloc(strlen(filename) + 5);
+
+    if (tmpname == NULL)
+    {
+        return -ENOMEM;
+    }
+    sprintf(tmpname, "%s.tmp", filename);
+    fp = fopen(tmpname, "w");
+    if (fp == NULL)
+    {
+        ret = -errno;
+        free(tmpname);
+        return ret;
+    }
+    memset(&header, 0, sizeof(RecordHeader));
+    memcpy(header.magic, RECORD_MAGIC, sizeof(header.magic));
+    header.version = RECORD_VERSION;
+    header.numRanks = record->numRanks;
+    header.numNodes = record->numNodes;
+    if (fwrite(&header, sizeof(RecordHeader), 1, fp) != 1)
+    {
+        ret = -EIO;
+    }
+    for (i = 0; ret == 0 && i < record->numRanks; i++)
+    {
+        ret = record_putEntry(fp, record->rankData[i], record->rankLength[i]);
+    }
+    for (i = 0; ret == 0 && i < record->numNodes; i++)
+    {
+        buf.used = 0;
+        ret = record_encodeScope(&buf, &record->nodes[i]);
+        if (ret == 0)
+        {
+            ret = record_putEntry(fp, buf.data, buf.used);
+        }
+    }
+    free(buf.data);
+    if (fclose(fp) != 0 && ret == 0)
+    {
+        ret = -EIO;
+    }
+    if (ret == 0 && rename(tmpname, filename) < 0)
+    {
+        ret = -errno;
+    }
+    if (ret < 0)
+    {
+        unlink(tmpname);
+    }
+    free(tmpname);
+    return ret;
+}
+
+void
+record_free(ResultRecord* record)
+{
+    int i;
+    if (record == NULL)
+    {
+        return;
+    }
+    for (i = 0; i < record->numNodes; i++)
+    {
+        record_freeScope(&record->nodes[i]);
+    }
+    for (i = 0; i < record->numMaps; i++)
+    {
+        if (record->maps[i] != NULL)
+        {
+            munmap(record->maps[i], record->mapLength[i]);
+        }
+    }
+    free(record->nodes);
+    free(record->rankData);
+    free(record->rankLength);
+    free(record->maps);
+    free(record->mapLength);
+    free(record);
+}
@@ -43,6 +43,7 @@ static uint64_t baseline = 0ULL;
 static uint64_t cpuClock = 0ULL;
 static uint64_t sleepbase = 0ULL;
 static int timer_initialized = 0;
+static int timer_invariant = 0;
 
 void (*TSTART)(TscCounter*) = NULL;
 void (*TSTOP)(TscCounter*) = NULL;
@@ -89,6 +90,31 @@ static void fRDTSCP(TscCounter* cpu_c)
     : "=r" ((cpu_c)->int32.lo), "=r" ((cpu_c)->int32.hi) \
     : : "%eax","%ebx","%ecx","%edx");
 }
+
+/* Variants for invariant TSC without CPUID. CPUID is serializing and costs
+ * hundreds of cycles natively and a VM exit on virtualized systems. The LFENCE
+ * keeps the TSC read from being reordered with the surrounding code. */
+static void fRDTSC_LF(TscCounter* cpu_c)
+{
+    __asm__ volatile(     \
+    "lfence\n\t"          \
+    "rdtsc\n\t"           \
+    "movl %%eax, %0\n\t"  \
+    "movl %%edx, %1\n\t"  \
+    : "=r" ((cpu_c)->int32.lo), "=r" ((cpu_c)->int32.hi) \
+    : : "%eax","%edx","memory");
+}
+
+static void fRDTSCP_LF(TscCounter* cpu_c)
+{
+    __asm__ volatile(     \
+    "rdtscp\n\t"          \
+    "lfence\n\t"          \
+    "movl %%eax, %0\n\t"  \
+    "movl %%edx, %1\n\t"  \
+    : "=r" ((cpu_c)->int32.lo), "=r" ((cpu_c)->int32.hi) \
+    : : "%eax","%ecx","%edx","memory");
+}
 #endif
 #endif
 
@@ -161,18 +187,11 @@ static double _timer_print( TimerData* time )
 }
 
 static uint64_t
-getCpuSpeed(void)
+getBaseline(void)
 {
-#ifdef __x86_64
     int i;
     TimerData data;
-    TscCounter start;
-    TscCounter stop;
     uint64_t result = 0xFFFFFFFFFFFFFFFFULL;
-    struct timeval tv1;
-    struct timeval tv2;
-    struct timezone tzp;
-    struct timespec delay = { 0, 500000000 }; /* calibration time: 500 ms */
 
     for (i=0; i< 10; i++)
     {
@@ -180,9 +199,22 @@ getCpuSpeed(void)
         _timer_stop(&data);
         result = MIN(result,_timer_printCycles(&data));
     }
+    return result;
+}
 
-    baseline = result;
-    result = 0xFFFFFFFFFFFFFFFFULL;
+static uint64_t
+getCpuSpeed(void)
+{
+#ifdef __x86_64
+    int i;
+    TimerData data;
+    uint64_t result = 0xFFFFFFFFFFFFFFFFULL;
+    struct timeval tv1;
+    struct timeval tv2;
+    struct timezone tzp;
+    struct timespec delay = { 0, 500000000 }; /* calibration time: 500 ms */
+
+    baseline = getBaseline();
     data.stop.int64 = 0;
     data.start.int64 = 0;
 
@@ -218,6 +250,97 @@ getCpuSpeed(void)
 #endif
 }
 
+#ifdef __x86_64
+static uint64_t
+getTscSpeedKernel(void)
+{
+    FILE* fp = NULL;
+    unsigned long long khz = 0ULL;
+
+    fp = fopen("/sys/devices/system/cpu/cpu0/tsc_freq_khz", "r");
+    if (fp == NULL)
+    {
+        return 0ULL;
+    }
+    if (fscanf(fp, "%llu", &khz) != 1)
+    {
+        khz = 0ULL;
+    }
+    fclose(fp);
+    return (uint64_t)khz * 1000ULL;
+}
+
+static uint64_t
+getTscSpeedCpuid(void)
+{
+    uint32_t eax,ebx,ecx,edx;
+
+    eax = 0x0;
+    ecx = 0x0;
+    CPUID;
+    if (eax < 0x15)
+    {
+        return 0ULL;
+    }
+    eax = 0x15;
+    ecx = 0x0;
+    CPUID;
+    /* EAX: denominator, EBX: numerator of TSC/crystal ratio, ECX: crystal in Hz */
+    if ((eax == 0) || (ebx == 0) || (ecx == 0))
+    {
+        return 0ULL;
+    }
+    return ((uint64_t)ecx * ebx) / eax;
+}
+
+static uint64_t
+getTscSpeedCalibrate(void)
+{
+    int i;
+    TimerData data;
+    struct timespec ts1, ts2;
+    uint64_t ns = 0ULL;
+    uint64_t result = 0xFFFFFFFFFFFFFFFFULL;
+    const uint64_t calibration = 20000000ULL; /* calibration time: 20 ms */
+
+    /* Busy-wait against CLOCK_MONOTONIC_RAW instead of sleeping, the
+     * timestamps are taken back to back so no wakeup latency is included. */
+    for (i=0; i< 3; i++)
+    {
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts1);
+        _timer_start(&data);
+        do
+        {
+            clock_gettime(CLOCK_MONOTONIC_RAW, &ts2);
+            ns = (uint64_t)(ts2.tv_sec - ts1.tv_sec) * 1000000000ULL +
+                 ts2.tv_nsec - ts1.tv_nsec;
+        } while (ns < calibration);
+        _timer_stop(&data);
+        result = MIN(result, (data.stop.int64 - data.start.int64) * 1000000000ULL / ns);
+    }
+    return result;
+}
+
+static uint64_t
+getCpuSpeedInvariant(void)
+{
+    uint64_t result = 0ULL;
+
+    baseline = getBaseline();
+
+    result = getTscSpeedKernel();
+    if (result == 0ULL)
+    {
+        result = getTscSpeedCpuid();
+    }
+    if (result == 0ULL)
+    {
+        result = getTscSpeedCalibrate();
+    }
+    return result;
+}
+#endif
+
 
 
 /* #####   FUNCTION DEFINITIONS  -  EXPORTED FUNCTIONS   ################## */
@@ -248,6 +371,7 @@ void timer_init( void )
     {
         return;
     }
+#ifdef __x86_64
     if ((!TSTART) && (!TSTOP))
     {
         TSTART = fRDTSC;
@@ -257,6 +381,14 @@ void timer_init( void )
         if (edx & (1<<27))
         {
             TSTOP = fRDTSCP;
+            eax = 0x80000007;
+            CPUID;
+            if ((edx & (1<<8)) && (getenv("LIKWID_TIMER_CPUID") == NULL))
+            {
+                TSTART = fRDTSC_LF;
+                TSTOP = fRDTSCP_LF;
+                timer_invariant = 1;
+            }
         }
         else
         {
@@ -266,9 +398,21 @@ void timer_init( void )
         TSTOP = fRDTSC_CR;
 #endif
     }
+#endif
     if (cpuClock == 0ULL)
     {
+#ifdef __x86_64
+        if (timer_invariant)
+        {
+            cpuClock = getCpuSpeedInvariant();
+        }
+        else
+        {
+            cpuClock = getCpuSpeed();
+        }
+#else
         cpuClock = getCpuSpeed();
+#endif
     }
     timer_initialized = 1;
 }
@@ -376,6 +520,7 @@ void timer_finalize(void)
     cpuClock = 0ULL;
     TSTART = NULL;
     TSTOP = NULL;
+    timer_invariant = 0;
     timer_initialized = 0;
 }
 
@@ -33,6 +33,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <sched.h>
+#include <time.h>
 
 #include <likwid.h>
 
@@ -42,13 +43,14 @@
 #include <bitUtil.h>
 //#include <strUtil.h>
 #include <configuration.h>
+#include <topology_cache.h>
 
 
 static int topology_initialized = 0;
 CpuInfo cpuid_info;
 CpuTopology cpuid_topology;
 
-int affinity_thread2tile_lookup[MAX_NUM_THREADS];
+int* affinity_thread2tile_lookup = NULL;
 
 static char* pentium_m_b_str = "Intel Pentium M Banias processor";
 static char* pentium_m_d_str = "Intel Pentium M Dothan processor";
@@ -123,6 +125,23 @@ static char* short_unknown = "unknown";
 
 
 
+/* Sizes the tile lookup by the largest processor ID in the thread pool */
+static int allocTileLookup(HWThread* hwThreadPool)
+{
+    int count = cpuid_topology.numHWThreads;
+    for (uint32_t i=0; i < cpuid_topology.numHWThreads; i++)
+    {
+        count = MAX(count, (int)hwThreadPool[i].apicId + 1);
+    }
+    free(affinity_thread2tile_lookup);
+    affinity_thread2tile_lookup = (int*) calloc(count, sizeof(int));
+    if (affinity_thread2tile_lookup == NULL)
+    {
+        return -ENOMEM;
+    }
+    return 0;
+}
+
 int cpu_count(cpu_set_t* set)
 {
     uint32_t i;
@@ -168,6 +187,11 @@ static void initTopologyFile(FILE* file)
     items = fread((void*) cacheLevels, sizeof(CacheLevel), cpuid_topology.numCacheLevels, file);
     cpuid_topology.cacheLevels = cacheLevels;
     cpuid_topology.topologyTree = NULL;
+    if (allocTileLookup(hwThreadPool) < 0)
+    {
+        ERROR_PLAIN_PRINT(Cannot allocate tile lookup);
+        return;
+    }
 
     tree_init(&cpuid_topology.topologyTree, 0);
 
@@ -316,7 +340,7 @@ static int readTopologyFile(const char* filename)
                 char type[128];
                 sscanf(line, "%s %s %d %s", structure, field, &level, value);
 
-                cpuid_topology.cacheLevels[level-1].level = level-1;
+                cpuid_topology.cacheLevels[level-1].level = level;
                 if (strcmp(value, "type") == 0)
                 {
                     sscanf(line, "%s %s %d %s = %s", structure, field, &level, value, type);
@@ -786,6 +810,17 @@ const struct topology_functions topology_funcs = {
     .init_fileTopology = initTopologyFile,
 };
 
+#ifdef LIKWID_USE_HWLOC
+/* Native backend that is used instead of hwloc unless hwloc is requested */
+static const struct topology_functions topology_funcs_native = {
+    .init_cpuInfo = cpuid_init_cpuInfo,
+    .init_cpuFeatures = cpuid_init_cpuFeatures,
+    .init_nodeTopology = cpuid_init_nodeTopology,
+    .init_cacheTopology = cpuid_init_cacheTopology,
+    .init_fileTopology = initTopologyFile,
+};
+#endif
+
 
 void topology_setupTree(void)
 {
@@ -793,6 +828,11 @@ void topology_setupTree(void)
     TreeNode* currentNode;
     HWThread* hwThreadPool = cpuid_topology.threadPool;
 
+    if (allocTileLookup(hwThreadPool) < 0)
+    {
+        ERROR_PLAIN_PRINT(Cannot allocate tile lookup);
+        return;
+    }
     tree_init(&cpuid_topology.topologyTree, 0);
     for (i=0; i<  cpuid_topology.numHWThreads; i++)
     {
@@ -828,9 +868,24 @@ void topology_setupTree(void)
     return;
 }
 
+static void topology_setCpuSet(cpu_set_t* cpuSet)
+{
+    cpuid_topology.activeHWThreads = 0;
+    for (int i=0;i<cpuid_topology.numHWThreads;i++)
+    {
+        cpuid_topology.threadPool[i].inCpuSet = 0;
+        if (CPU_ISSET(cpuid_topology.threadPool[i].apicId, cpuSet))
+        {
+            cpuid_topology.activeHWThreads++;
+            cpuid_topology.threadPool[i].inCpuSet = 1;
+        }
+    }
+}
+
 int topology_init(void)
 {
     struct topology_functions funcs = topology_funcs;
+    int ret = 0;
 
     if (topology_initialized)
     {
@@ -846,8 +901,23 @@ int topology_init(void)
     if ((config.topologyCfgFileName == NULL) || access(config.topologyCfgFileName, R_OK))
     {
         cpu_set_t cpuSet;
+        struct timespec start, end;
         CPU_ZERO(&cpuSet);
         sched_getaffinity(0,sizeof(cpu_set_t), &cpuSet);
+        if (topology_cacheRead() == 0)
+        {
+            topology_setCpuSet(&cpuSet);
+            topology_setName();
+            topology_setupTree();
+            topology_initialized = 1;
+            return EXIT_SUCCESS;
+        }
+#ifdef LIKWID_USE_HWLOC
+        if (!config_useHwloc())
+        {
+            funcs = topology_funcs_native;
+        }
+#endif
         if (cpu_count(&cpuSet) < sysconf(_SC_NPROCESSORS_CONF))
         {
             funcs.init_cpuInfo = proc_init_cpuInfo;
@@ -862,14 +932,40 @@ int topology_init(void)
         else
         {
             cpuid_topology.activeHWThreads = sysconf(_SC_NPROCESSORS_CONF);
+            topocache_pending = 1;
         }
+        clock_gettime(CLOCK_MONOTONIC, &start);
         funcs.init_cpuInfo(cpuSet);
         topology_setName();
         funcs.init_cpuFeatures();
-        funcs.init_nodeTopology(cpuSet);
+        ret = funcs.init_nodeTopology(cpuSet);
+#ifdef LIKWID_USE_HWLOC
+        if ((ret < 0) && (funcs.init_nodeTopology == cpuid_init_nodeTopology))
+        {
+            /* hwloc is loaded only now, the CPU information stays from CPUID */
+            DEBUG_PLAIN_PRINT(DEBUGLEV_INFO, Falling back to the hwloc node topology);
+            funcs.init_nodeTopology = hwloc_init_nodeTopology;
+            funcs.init_cacheTopology = hwloc_init_cacheTopology;
+            ret = funcs.init_nodeTopology(cpuSet);
+        }
+#endif
+        if (ret < 0)
+        {
+            /* The sysfs topology works on all systems the CPUID decoding
+             * does not cover */
+            DEBUG_PLAIN_PRINT(DEBUGLEV_INFO, Falling back to the procfs node topology);
+            funcs.init_nodeTopology = proc_init_nodeTopology;
+            funcs.init_nodeTopology(cpuSet);
+        }
         topology_setupTree();
         funcs.init_cacheTopology();
         sched_setaffinity(0, sizeof(cpu_set_t), &cpuSet);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        DEBUG_PRINT(DEBUGLEV_INFO, Topology discovery of %d HW threads with %s backend took %.3f ms,
+                    cpuid_topology.numHWThreads,
+                    (funcs.init_nodeTopology == proc_init_nodeTopology ? "procfs" :
+                        (funcs.init_nodeTopology == cpuid_init_nodeTopology ? "cpuid" : "hwloc")),
+                    ((end.tv_sec - start.tv_sec) * 1E3) + ((end.tv_nsec - start.tv_nsec) * 1E-6));
     }
     else
     {
@@ -878,15 +974,7 @@ int topology_init(void)
         sched_getaffinity(0,sizeof(cpu_set_t), &cpuSet);
         DEBUG_PRINT(DEBUGLEV_INFO, Reading topology information from %s, config.topologyCfgFileName);
         readTopologyFile(config.topologyCfgFileName);
-        cpuid_topology.activeHWThreads = 0;
-        for (int i=0;i<cpuid_topology.numHWThreads;i++)
-        {
-            if (CPU_ISSET(cpuid_topology.threadPool[i].apicId, &cpuSet))
-            {
-                cpuid_topology.activeHWThreads++;
-                cpuid_topology.threadPool[i].inCpuSet = 1;
-            }
-        }
+        topology_setCpuSet(&cpuSet);
         topology_setName();
         topology_setupTree();
     }
@@ -950,6 +1038,8 @@ void topology_finalize(void)
     cpuid_topology.numThreadsPerCore = 0;
     cpuid_topology.numCacheLevels = 0;
 
+    topocache_pending = 0;
+    topocache_loaded = 0;
     topology_initialized = 0;
 }
 
@@ -0,0 +1,454 @@
+/*
+ * =======================================================================================
+ *
+ *      Filename:  topology_cache.c
+ *
+ *      Description:  Binary cache for the CPU topology and NUMA information
+ *
+ *      Version:   <VERSION>
+ *      Released:  <DATE>
+ *
+ *      Author:   Thomas Roehl (tr), thomas.roehl@googlemail.com
+ *      Project:  likwid
+ *
+ *      Copyright (C) 2015 RRZE, University Erlangen-Nuremberg
+ *
+ *      This program is free software: you can redistribute it and/or modify it under
+ *      the terms of the GNU General Public License as published by the Free Software
+ *      Foundation, either version 3 of the License, or (at your option) any later
+ *      version.
+ *
+ *      This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ *      WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ *      PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along with
+ *      this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * =======================================================================================
+ */
+
+/* #####   HEADER FILE INCLUDES   ######################################### */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <likwid.h>
+#include <error.h>
+#include <configuration.h>
+#include <topology.h>
+#include <topology_cache.h>
+
+/* #####   EXPORTED VARIABLES   ########################################### */
+
+int topocache_pending = 0;
+int topocache_loaded = 0;
+
+/* #####   MACROS  -  LOCAL TO THIS SOURCE FILE   ######################### */
+
+#define TOPOCACHE_DEFAULT_PATH "/tmp/likwid-topo-%d.cache"
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+/* #####   VARIABLES  -  LOCAL TO THIS SOURCE FILE   ###################### */
+
+/* All sections are stored at 8 byte aligned offsets from the start of the file,
+ * so the file can be used directly through mmap() */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t key;
+    uint64_t fileSize;
+    uint64_t clock;
+    uint32_t family;
+    uint32_t model;
+    uint32_t stepping;
+    uint32_t turbo;
+    uint32_t isIntel;
+    uint32_t featureFlags;
+    uint32_t perf_version;
+    uint32_t perf_num_ctr;
+    uint32_t perf_width_ctr;
+    uint32_t perf_num_fixed_ctr;
+    uint32_t numHWThreads;
+    uint32_t numSockets;
+    uint32_t numCoresPerSocket;
+    uint32_t numThreadsPerCore;
+    uint32_t numCacheLevels;
+    uint32_t numberOfNodes;
+    uint32_t osnameLength;
+    uint32_t featuresLength;
+    uint64_t threadPoolOffset;
+    uint64_t cacheLevelsOffset;
+    uint64_t nodesOffset;
+    uint64_t listOffset;
+    uint64_t stringOffset;
+} TopoCacheHeader;
+
+typedef struct {
+    uint64_t totalMemory;
+    uint64_t freeMemory;
+    uint32_t id;
+    uint32_t numberOfProcessors;
+    uint32_t numberOfDistances;
+    uint32_t reserved;
+} TopoCacheNode;
+
+/* #####   FUNCTION DEFINITIONS  -  LOCAL TO THIS SOURCE FILE   ########### */
+
+static uint64_t
+fnv1a(uint64_t hash, const void* data, size_t len)
+{
+    const unsigned char* ptr = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= ptr[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t
+fnv1a_file(uint64_t hash, const char* filename)
+{
+    int fd;
+    ssize_t len;
+    char buffer[4096];
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return fnv1a(hash, "-", 1);
+    }
+    while ((len = read(fd, buffer, sizeof(buffer))) > 0)
+    {
+        hash = fnv1a(hash, buffer, len);
+    }
+    close(fd);
+    return hash;
+}
+
+/* The key covers everything that may change the topology without changing
+ * the cache file: the library build, the host, the online CPUs and nodes, the
+ * microcode and the boot. Only small sysfs/procfs files are read. */
+static uint64_t
+topocache_key(void)
+{
+    uint64_t hash = FNV_OFFSET;
+    char hostname[256];
+    uint32_t meta[] = {TOPOCACHE_VERSION, VERSION, RELEASE,
+                       sizeof(HWThread), sizeof(CacheLevel), sizeof(TopoCacheHeader),
+#ifdef LIKWID_USE_HWLOC
+                       1
+#else
+                       0
+#endif
+                      };
+
+    hash = fnv1a(hash, meta, sizeof(meta));
+    memset(hostname, 0, sizeof(hostname));
+    gethostname(hostname, sizeof(hostname)-1);
+    hash = fnv1a(hash, hostname, strlen(hostname));
+    hash = fnv1a_file(hash, "/proc/sys/kernel/random/boot_id");
+    hash = fnv1a_file(hash, "/sys/devices/system/cpu/online");
+    hash = fnv1a_file(hash, "/sys/devices/system/node/online");
+    hash = fnv1a_file(hash, "/sys/devices/system/cpu/cpu0/microcode/version");
+    return hash;
+}
+
+static int
+topocache_path(char* path, size_t length)
+{
+    char* env = getenv("LIKWID_TOPOCACHE");
+
+    if (env != NULL)
+    {
+        if ((strlen(env) == 0) || (strcmp(env, "none") == 0) || (strcmp(env, "0") == 0))
+        {
+            return -ENOENT;
+        }
+        snprintf(path, length, "%s", env);
+    }
+    else if (config.topologyCacheFileName != NULL)
+    {
+        if (strcmp(config.topologyCacheFileName, "none") == 0)
+        {
+            return -ENOENT;
+        }
+        snprintf(path, length, "%s", config.topologyCacheFileName);
+    }
+    else
+    {
+        snprintf(path, length, TOPOCACHE_DEFAULT_PATH, (int)geteuid());
+    }
+    return 0;
+}
+
+static inline uint64_t
+align8(uint64_t offset)
+{
+    return (offset + 7ULL) & ~7ULL;
+}
+
+static int
+topocache_layout(TopoCacheHeader* hdr)
+{
+    uint64_t listEntries = 0;
+
+    hdr->threadPoolOffset = align8(sizeof(TopoCacheHeader));
+    hdr->cacheLevelsOffset = align8(hdr->threadPoolOffset +
+                                    (uint64_t)hdr->numHWThreads * sizeof(HWThread));
+    hdr->nodesOffset = align8(hdr->cacheLevelsOffset +
+                              (uint64_t)hdr->numCacheLevels * sizeof(CacheLevel));
+    hdr->listOffset = align8(hdr->nodesOffset +
+                             (uint64_t)hdr->numberOfNodes * sizeof(TopoCacheNode));
+    for (uint32_t i = 0; i < numa_info.numberOfNodes; i++)
+    {
+        listEntries += numa_info.nodes[i].numberOfProcessors;
+        listEntries += numa_info.nodes[i].numberOfDistances;
+    }
+    hdr->stringOffset = align8(hdr->listOffset + listEntries * sizeof(uint32_t));
+    hdr->fileSize = hdr->stringOffset + hdr->osnameLength + hdr->featuresLength;
+    return 0;
+}
+
+/* #####   FUNCTION DEFINITIONS  -  EXPORTED FUNCTIONS   ################## */
+
+int
+topology_cacheRead(void)
+{
+    int fd;
+    int ret = -EINVAL;
+    char path[1024];
+    struct stat st;
+    char* map = NULL;
+    TopoCacheHeader* hdr;
+    TopoCacheNode* cnodes;
+    uint32_t* list;
+    uint64_t listEntries = 0;
+
+    topocache_loaded = 0;
+    if (topocache_path(path, sizeof(path)) < 0)
+    {
+        return -ENOENT;
+    }
+    fd = open(path, O_RDONLY|O_NOFOLLOW);
+    if (fd < 0)
+    {
+        return -errno;
+    }
+    /* Do not trust cache files that other users could have prepared */
+    if ((fstat(fd, &st) < 0) || (st.st_uid != geteuid()) ||
+        (!S_ISREG(st.st_mode)) || (st.st_mode & (S_IWGRP|S_IWOTH)) ||
+        (st.st_size < (off_t)sizeof(TopoCacheHeader)))
+    {
+        close(fd);
+        return -EINVAL;
+    }
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return -errno;
+    }
+    hdr = (TopoCacheHeader*)map;
+    if ((strncmp(hdr->magic, TOPOCACHE_MAGIC, 8) != 0) ||
+        (hdr->version != TOPOCACHE_VERSION) ||
+        (hdr->headerSize != sizeof(TopoCacheHeader)) ||
+        (hdr->fileSize != (uint64_t)st.st_size) ||
+        (hdr->numHWThreads == 0) || (hdr->numCacheLevels == 0) ||
+        (hdr->numberOfNodes == 0))
+    {
+        DEBUG_PRINT(DEBUGLEV_DEVELOP, Topology cache %s has wrong format, path);
+        goto unmap;
+    }
+    if (hdr->key != topocache_key())
+    {
+        DEBUG_PRINT(DEBUGLEV_DEVELOP, Topology cache %s is outdated, path);
+        goto unmap;
+    }
+    cnodes = (TopoCacheNode*)(map + hdr->nodesOffset);
+    if (hdr->nodesOffset + (uint64_t)hdr->numberOfNodes * sizeof(TopoCacheNode) > hdr->fileSize)
+    {
+        goto unmap;
+    }
+    for (uint32_t i = 0; i < hdr->numberOfNodes; i++)
+    {
+        listEntries += cnodes[i].numberOfProcessors + cnodes[i].numberOfDistances;
+    }
+    if ((hdr->threadPoolOffset + (uint64_t)hdr->numHWThreads * sizeof(HWThread) > hdr->cacheLevelsOffset) ||
+        (hdr->cacheLevelsOffset + (uint64_t)hdr->numCacheLevels * sizeof(CacheLevel) > hdr->nodesOffset) ||
+        (hdr->listOffset + listEntries * sizeof(uint32_t) > hdr->stringOffset) ||
+        (hdr->stringOffset + hdr->osnameLength + hdr->featuresLength != hdr->fileSize))
+    {
+        goto unmap;
+    }
+
+    cpuid_info.family = hdr->family;
+    cpuid_info.model = hdr->model;
+    cpuid_info.stepping = hdr->stepping;
+    cpuid_info.clock = hdr->clock;
+    cpuid_info.turbo = hdr->turbo;
+    cpuid_info.isIntel = hdr->isIntel;
+    cpuid_info.featureFlags = hdr->featureFlags;
+    cpuid_info.perf_version = hdr->perf_version;
+    cpuid_info.perf_num_ctr = hdr->perf_num_ctr;
+    cpuid_info.perf_width_ctr = hdr->perf_width_ctr;
+    cpuid_info.perf_num_fixed_ctr = hdr->perf_num_fixed_ctr;
+    cpuid_info.osname = (char*) malloc((hdr->osnameLength+1) * sizeof(char));
+    memcpy(cpuid_info.osname, map + hdr->stringOffset, hdr->osnameLength);
+    cpuid_info.osname[hdr->osnameLength] = '\0';
+    cpuid_info.features = (char*) malloc((hdr->featuresLength+1) * sizeof(char));
+    memcpy(cpuid_info.features, map + hdr->stringOffset + hdr->osnameLength, hdr->featuresLength);
+    cpuid_info.features[hdr->featuresLength] = '\0';
+
+    cpuid_topology.numHWThreads = hdr->numHWThreads;
+    cpuid_topology.numSockets = hdr->numSockets;
+    cpuid_topology.numCoresPerSocket = hdr->numCoresPerSocket;
+    cpuid_topology.numThreadsPerCore = hdr->numThreadsPerCore;
+    cpuid_topology.numCacheLevels = hdr->numCacheLevels;
+    cpuid_topology.threadPool = (HWThread*) malloc(hdr->numHWThreads * sizeof(HWThread));
+    memcpy(cpuid_topology.threadPool, map + hdr->threadPoolOffset, hdr->numHWThreads * sizeof(HWThread));
+    cpuid_topology.cacheLevels = (CacheLevel*) malloc(hdr->numCacheLevels * sizeof(CacheLevel));
+    memcpy(cpuid_topology.cacheLevels, map + hdr->cacheLevelsOffset, hdr->numCacheLevels * sizeof(CacheLevel));
+
+    numa_info.numberOfNodes = hdr->numberOfNodes;
+    numa_info.nodes = (NumaNode*) malloc(hdr->numberOfNodes * sizeof(NumaNode));
+    list = (uint32_t*)(map + hdr->listOffset);
+    for (uint32_t i = 0; i < hdr->numberOfNodes; i++)
+    {
+        NumaNode* node = &numa_info.nodes[i];
+        node->id = cnodes[i].id;
+        node->totalMemory = cnodes[i].totalMemory;
+        node->freeMemory = cnodes[i].freeMemory;
+        node->numberOfProcessors = cnodes[i].numberOfProcessors;
+        node->numberOfDistances = cnodes[i].numberOfDistances;
+        node->processors = (uint32_t*) malloc(node->numberOfProcessors * sizeof(uint32_t));
+        memcpy(node->processors, list, node->numberOfProcessors * sizeof(uint32_t));
+        list += node->numberOfProcessors;
+        node->distances = (uint32_t*) malloc(node->numberOfDistances * sizeof(uint32_t));
+        memcpy(node->distances, list, node->numberOfDistances * sizeof(uint32_t));
+        list += node->numberOfDistances;
+    }
+    DEBUG_PRINT(DEBUGLEV_INFO, Reading topology information from cache %s, path);
+    topocache_loaded = 1;
+    ret = 0;
+unmap:
+    munmap(map, st.st_size);
+    return ret;
+}
+
+int
+topology_cacheWrite(void)
+{
+    int fd;
+    int ret = 0;
+    char path[1024];
+    char tmppath[1100];
+    char* buffer = NULL;
+    TopoCacheHeader hdr;
+    TopoCacheNode* cnodes;
+    uint32_t* list;
+
+    topocache_pending = 0;
+    if ((cpuid_topology.numHWThreads == 0) || (numa_info.numberOfNodes == 0) ||
+        (topocache_path(path, sizeof(path)) < 0))
+    {
+        return -EINVAL;
+    }
+
+    memset(&hdr, 0, sizeof(TopoCacheHeader));
+    memcpy(hdr.magic, TOPOCACHE_MAGIC, 8);
+    hdr.version = TOPOCACHE_VERSION;
+    hdr.headerSize = sizeof(TopoCacheHeader);
+    hdr.key = topocache_key();
+    hdr.family = cpuid_info.family;
+    hdr.model = cpuid_info.model;
+    hdr.stepping = cpuid_info.stepping;
+    hdr.clock = cpuid_info.clock;
+    hdr.turbo = cpuid_info.turbo;
+    hdr.isIntel = cpuid_info.isIntel;
+    hdr.featureFlags = cpuid_info.featureFlags;
+    hdr.perf_version = cpuid_info.perf_version;
+    hdr.perf_num_ctr = cpuid_info.perf_num_ctr;
+    hdr.perf_width_ctr = cpuid_info.perf_width_ctr;
+    hdr.perf_num_fixed_ctr = cpuid_info.perf_num_fixed_ctr;
+    hdr.numHWThreads = cpuid_topology.numHWThreads;
+    hdr.numSockets = cpuid_topology.numSockets;
+    hdr.numCoresPerSocket = cpuid_topology.numCoresPerSocket;
+    hdr.numThreadsPerCore = cpuid_topology.numThreadsPerCore;
+    hdr.numCacheLevels = cpuid_topology.numCacheLevels;
+    hdr.numberOfNodes = numa_info.numberOfNodes;
+    hdr.osnameLength = (cpuid_info.osname ? strlen(cpuid_info.osname) : 0);
+    hdr.featuresLength = (cpuid_info.features ? strlen(cpuid_info.features) : 0);
+    topocache_layout(&hdr);
+
+    buffer = (char*) calloc(hdr.fileSize, sizeof(char));
+    if (buffer == NULL)
+    {
+        return -ENOMEM;
+    }
+    memcpy(buffer, &hdr, sizeof(TopoCacheHeader));
+    memcpy(buffer + hdr.threadPoolOffset, cpuid_topology.threadPool,
+           hdr.numHWThreads * sizeof(HWThread));
+    memcpy(buffer + hdr.cacheLevelsOffset, cpuid_topology.cacheLevels,
+           hdr.numCacheLevels * sizeof(CacheLevel));
+    cnodes = (TopoCacheNode*)(buffer + hdr.nodesOffset);
+    list = (uint32_t*)(buffer + hdr.listOffset);
+    for (uint32_t i = 0; i < numa_info.numberOfNodes; i++)
+    {
+        NumaNode* node = &numa_info.nodes[i];
+        cnodes[i].id = node->id;
+        cnodes[i].totalMemory = node->totalMemory;
+        cnodes[i].freeMemory = node->freeMemory;
+        cnodes[i].numberOfProcessors = node->numberOfProcessors;
+        cnodes[i].numberOfDistances = node->numberOfDistances;
+        memcpy(list, node->processors, node->numberOfProcessors * sizeof(uint32_t));
+        list += node->numberOfProcessors;
+        memcpy(list, node->distances, node->numberOfDistances * sizeof(uint32_t));
+        list += node->numberOfDistances;
+    }
+    if (hdr.osnameLength > 0)
+    {
+        memcpy(buffer + hdr.stringOffset, cpuid_info.osname, hdr.osnameLength);
+    }
+    if (hdr.featuresLength > 0)
+    {
+        memcpy(buffer + hdr.stringOffset + hdr.osnameLength, cpuid_info.features, hdr.featuresLength);
+    }
+
+    /* Write to a private file and rename it, so concurrently starting
+     * processes see either the old or the complete new cache */
+    snprintf(tmppath, sizeof(tmppath), "%s.%d", path, (int)getpid());
+    fd = open(tmppath, O_WRONLY|O_CREAT|O_EXCL|O_NOFOLLOW, S_IRUSR|S_IWUSR|S_IRGRP|S_IROTH);
+    if (fd < 0)
+    {
+        ret = -errno;
+        free(buffer);
+        return ret;
+    }
+    if (write(fd, buffer, hdr.fileSize) != (ssize_t)hdr.fileSize)
+    {
+        ret = -EIO;
+    }
+    close(fd);
+    free(buffer);
+    if ((ret == 0) && (rename(tmppath, path) < 0))
+    {
+        ret = -errno;
+    }
+    if (ret < 0)
+    {
+        unlink(tmppath);
+        return ret;
+    }
+    DEBUG_PRINT(DEBUGLEV_INFO, Wrote topology information to cache %s, path);
+    return 0;
+}
@@ -31,8 +31,12 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sched.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
 
 #include <error.h>
 
@@ -51,8 +55,39 @@
             "=c" (ecx),     \
             "=d" (edx)      \
             : "0" (eax), "2" (ecx))
-            
-            
+
+/* CPUs per topology worker if the package of a CPU is unknown */
+#define CPUID_TOPO_CHUNK 32
+
+/* #####   LOCAL TYPE DEFINITIONS   ####################################### */
+
+typedef enum {
+    CPUID_TOPO_NONE = 0,
+    CPUID_TOPO_LEAF_B,
+    CPUID_TOPO_LEGACY_INTEL,
+    CPUID_TOPO_LEGACY_AMD,
+    CPUID_TOPO_EXTENDED_AMD
+} CpuidTopoMethod;
+
+/* Decoding parameters shared by all topology workers */
+typedef struct {
+    CpuidTopoMethod method;
+    int maxNumLogicalProcs;
+    int maxNumLogicalProcsPerCore;
+    int maxNumCores;
+    int width;
+    cpu_set_t* cpuSet;
+    HWThread* pool;
+} CpuidTopoScan;
+
+typedef struct {
+    CpuidTopoScan* scan;
+    int numCpus;
+    int* cpus;
+    int started;
+    int error;
+} CpuidTopoWorker;
+
 /* #####   VARIABLES  -  LOCAL TO THIS SOURCE FILE   ###################### */
 static int largest_function = 0;        
 static uint32_t eax, ebx, ecx, edx;
@@ -61,6 +96,225 @@ static uint32_t eax, ebx, ecx, edx;
 char* (*ownstrcpy)(char *__restrict __dest, const char *__restrict __src);
 
 /* #####   FUNCTION DEFINITIONS  -  LOCAL TO THIS SOURCE FILE   ########### */
+static int cpuid_packageOfCpu(int cpu)
+{
+    FILE* fp;
+    char path[128];
+    int package = -1;
+
+    snprintf(path, 127, "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    fp = fopen(path, "r");
+    if (fp != NULL)
+    {
+        if (fscanf(fp, "%d", &package) != 1)
+        {
+            package = -1;
+        }
+        fclose(fp);
+    }
+    return package;
+}
+
+/* Executes CPUID on the given CPU. If the cpuid device of the CPU can be
+ * read, the calling thread stays where it is, otherwise it is moved to the
+ * CPU. fd is the open device, -2 if the thread still has to be moved to the
+ * CPU or -1 if it already runs there. */
+static void cpuid_onCpu(int cpu, int* fd, uint32_t leaf, uint32_t subleaf, uint32_t* regs)
+{
+    uint32_t eax = leaf, ebx = 0, ecx = subleaf, edx = 0;
+    cpu_set_t set;
+
+    if (*fd >= 0)
+    {
+        if (pread(*fd, regs, 4*sizeof(uint32_t), ((off_t)subleaf << 32)|leaf) == 4*sizeof(uint32_t))
+        {
+            return;
+        }
+        close(*fd);
+        *fd = -2;
+    }
+    if (*fd == -2)
+    {
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        sched_setaffinity(0, sizeof(cpu_set_t), &set);
+        *fd = -1;
+    }
+    CPUID;
+    regs[0] = eax;
+    regs[1] = ebx;
+    regs[2] = ecx;
+    regs[3] = edx;
+}
+
+static int cpuid_readHWThread(CpuidTopoScan* scan, int cpu)
+{
+    int fd;
+    int ret = 0;
+    int id = cpu;
+    uint32_t regs[4];
+    uint32_t apicId;
+    uint32_t bitField;
+    int prevOffset = 0;
+    int currOffset = 0;
+    char path[64];
+    HWThread* hwThreadPool = scan->pool;
+
+    snprintf(path, 63, "/dev/cpu/%d/cpuid", cpu);
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        fd = -2;
+    }
+
+    switch (scan->method)
+    {
+        case CPUID_TOPO_LEAF_B:
+            cpuid_onCpu(cpu, &fd, 0x0B, 0, regs);
+            apicId = regs[3];
+            hwThreadPool[id].apicId = cpu;
+            hwThreadPool[id].inCpuSet = 0;
+            if (CPU_ISSET(id, scan->cpuSet))
+            {
+                hwThreadPool[id].inCpuSet = 1;
+            }
+
+            for (int level=0; level < 3; level++)
+            {
+                cpuid_onCpu(cpu, &fd, 0x0B, level, regs);
+                currOffset = regs[0]&0xFU;
+
+                switch ( level ) {
+                    case 0:  /* SMT thread */
+                        bitField = extractBitField(apicId,
+                                currOffset,
+                                0);
+                        hwThreadPool[id].threadId = bitField;
+                        break;
+
+                    case 1:  /* Core */
+                        bitField = extractBitField(apicId,
+                                currOffset-prevOffset,
+                                prevOffset);
+                        hwThreadPool[id].coreId = bitField;
+                        break;
+
+                    case 2:  /* Package */
+                        bitField = extractBitField(apicId,
+                                32-prevOffset,
+                                prevOffset);
+                        hwThreadPool[id].packageId = bitField;
+                        break;
+
+                }
+                prevOffset = currOffset;
+            }
+            break;
+
+        case CPUID_TOPO_LEGACY_INTEL:
+            hwThreadPool[id].apicId = cpu;
+
+            /* ThreadId is extracted from th apicId using the bit width
+             * of the number of logical processors
+             * */
+            hwThreadPool[id].threadId =
+                extractBitField(hwThreadPool[id].apicId,
+                        getBitFieldWidth(scan->maxNumLogicalProcsPerCore),0);
+
+            /* CoreId is extracted from th apicId using the bitWidth
+             * of the number of logical processors as offset and the
+             * bit width of the number of cores as width
+             * */
+            hwThreadPool[id].coreId =
+                extractBitField(hwThreadPool[id].apicId,
+                        getBitFieldWidth(scan->maxNumCores),
+                        getBitFieldWidth(scan->maxNumLogicalProcsPerCore));
+
+            hwThreadPool[id].packageId =
+                extractBitField(hwThreadPool[id].apicId,
+                        8-getBitFieldWidth(scan->maxNumLogicalProcs),
+                        getBitFieldWidth(scan->maxNumLogicalProcs));
+            break;
+
+        case CPUID_TOPO_LEGACY_AMD:
+            cpuid_onCpu(cpu, &fd, 0x01, 0, regs);
+            apicId = extractBitField(regs[1],8,24);
+            id = apicId;
+            if (id >= (int)cpuid_topology.numHWThreads)
+            {
+                /* Sparse APIC IDs cannot be used as index */
+                ret = -ERANGE;
+                break;
+            }
+            hwThreadPool[id].apicId = apicId;
+
+            hwThreadPool[id].threadId =
+                extractBitField(apicId,
+                        getBitFieldWidth(scan->maxNumLogicalProcsPerCore),0);
+            hwThreadPool[id].coreId =
+                extractBitField(apicId,
+                        getBitFieldWidth(scan->maxNumCores),
+                        0);
+            hwThreadPool[id].packageId =
+                extractBitField(apicId,
+                        8-getBitFieldWidth(scan->maxNumCores),
+                        getBitFieldWidth(scan->maxNumCores));
+            break;
+
+        case CPUID_TOPO_EXTENDED_AMD:
+            cpuid_onCpu(cpu, &fd, 0x01, 0, regs);
+            apicId = extractBitField(regs[1],8,24);
+            id = apicId;
+            if (id >= (int)cpuid_topology.numHWThreads)
+            {
+                /* Sparse APIC IDs cannot be used as index */
+                ret = -ERANGE;
+                break;
+            }
+            hwThreadPool[id].apicId = apicId;
+            /* AMD only knows cores */
+            hwThreadPool[id].threadId = 0;
+
+            hwThreadPool[id].coreId =
+                extractBitField(apicId,
+                        scan->width, 0);
+            hwThreadPool[id].packageId =
+                extractBitField(apicId,
+                        (8-scan->width), scan->width);
+            break;
+
+        default:
+            ret = -ENODEV;
+            break;
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    if (id < (int)cpuid_topology.numHWThreads)
+    {
+        DEBUG_PRINT(DEBUGLEV_DEVELOP, I[%d] ID[%d] APIC[%d] T[%d] C[%d] P [%d], cpu, id,
+                                hwThreadPool[id].apicId, hwThreadPool[id].threadId,
+                                hwThreadPool[id].coreId, hwThreadPool[id].packageId);
+    }
+    return ret;
+}
+
+static void* cpuid_topoWorker(void* arg)
+{
+    CpuidTopoWorker* worker = (CpuidTopoWorker*) arg;
+
+    for (int i = 0; i < worker->numCpus; i++)
+    {
+        worker->error = cpuid_readHWThread(worker->scan, worker->cpus[i]);
+        if (worker->error < 0)
+        {
+            break;
+        }
+    }
+    return NULL;
+}
+
 static int intelCpuidFunc_4(CacheLevel** cachePool)
 {
     int i;
@@ -519,25 +773,30 @@ void cpuid_init_cpuFeatures(void)
     return;
 }
 
-void cpuid_init_nodeTopology(cpu_set_t cpuSet)
+int cpuid_init_nodeTopology(cpu_set_t cpuSet)
 {
-    uint32_t apicId;
-    uint32_t bitField;
-    int level;
-    int prevOffset = 0;
-    int currOffset = 0;
-    cpu_set_t set;
-    HWThread* hwThreadPool;
-    int hasBLeaf = 0;
-    int maxNumLogicalProcs;
-    int maxNumLogicalProcsPerCore;
-    int maxNumCores;
-    int width;
-    
-    hwThreadPool = (HWThread*) malloc(cpuid_topology.numHWThreads * sizeof(HWThread));
-    
-    
-    /* check if 0x0B cpuid leaf is supported */
+    int ret = 0;
+    int numWorkers = 0;
+    int numThreads = cpuid_topology.numHWThreads;
+    int* groupIds = NULL;
+    pthread_t* threads = NULL;
+    CpuidTopoWorker* workers = NULL;
+    CpuidTopoScan scan;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    memset(&scan, 0, sizeof(CpuidTopoScan));
+    scan.cpuSet = &cpuSet;
+    scan.pool = (HWThread*) calloc(numThreads, sizeof(HWThread));
+    if (scan.pool == NULL)
+    {
+        ERROR_PLAIN_PRINT(Cannot allocate HW thread pool);
+        return -ENOMEM;
+    }
+
+    /* The parameters of the ID decoding are the same on all CPUs and are
+     * read once on the calling CPU */
+    scan.method = CPUID_TOPO_NONE;
     if (largest_function >= 0x0B)
     {
         eax = 0x0B;
@@ -546,68 +805,11 @@ void cpuid_init_nodeTopology(cpu_set_t cpuSet)
 
         if (ebx)
         {
-            hasBLeaf = 1;
+            scan.method = CPUID_TOPO_LEAF_B;
         }
     }
 
-    if (hasBLeaf)
-    {
-        for (uint32_t i=0; i < cpuid_topology.numHWThreads; i++)
-        {
-            int id;
-            CPU_ZERO(&set);
-            CPU_SET(i,&set);
-            sched_setaffinity(0, sizeof(cpu_set_t), &set);
-            eax = 0x0B;
-            ecx = 0;
-            CPUID;
-            apicId = edx;
-            id = i;
-            hwThreadPool[id].apicId = i;
-            hwThreadPool[id].inCpuSet = 0;
-            if (CPU_ISSET(id, &cpuSet))
-            {
-                hwThreadPool[id].inCpuSet = 1;
-            }
-
-            for (level=0; level < 3; level++)
-            {
-                eax = 0x0B;
-                ecx = level;
-                CPUID;
-                currOffset = eax&0xFU;
-
-                switch ( level ) {
-                    case 0:  /* SMT thread */
-                        bitField = extractBitField(apicId,
-                                currOffset,
-                                0);
-                        hwThreadPool[id].threadId = bitField;
-                        break;
-
-                    case 1:  /* Core */
-                        bitField = extractBitField(apicId,
-                                currOffset-prevOffset,
-                                prevOffset);
-                        hwThreadPool[id].coreId = bitField;
-                        break;
-
-                    case 2:  /* Package */
-                        bitField = extractBitField(apicId,
-                                32-prevOffset,
-                                prevOffset);
-                        hwThreadPool[id].packageId = bitField;
-                        break;
-
-                }
-                prevOffset = currOffset;
-            }
-            DEBUG_PRINT(DEBUGLEV_DEVELOP, I[%d] ID[%d] APIC[%d] T[%d] C[%d] P [%d], i, id,
-                                    hwThreadPool[id].apicId, hwThreadPool[id].threadId,
-                                    hwThreadPool[id].coreId, hwThreadPool[id].packageId);
-        }
-    }
-    else
+    if (scan.method == CPUID_TOPO_NONE)
     {
         switch ( cpuid_info.family )
         {
@@ -617,52 +819,16 @@ void cpuid_init_nodeTopology(cpu_set_t cpuSet)
             case P6_FAMILY:
                 eax = 0x01;
                 CPUID;
-                maxNumLogicalProcs = extractBitField(ebx,8,16);
+                scan.maxNumLogicalProcs = extractBitField(ebx,8,16);
 
                 /* Check number of cores per package */
                 eax = 0x04;
                 ecx = 0;
                 CPUID;
-                maxNumCores = extractBitField(eax,6,26)+1;
-
-                maxNumLogicalProcsPerCore = maxNumLogicalProcs/maxNumCores;
+                scan.maxNumCores = extractBitField(eax,6,26)+1;
 
-                for (uint32_t i=0; i<  cpuid_topology.numHWThreads; i++)
-                {
-                    int id;
-                    CPU_ZERO(&set);
-                    CPU_SET(i,&set);
-                    sched_setaffinity(0, sizeof(cpu_set_t), &set);
-
-                    eax = 0x01;
-                    CPUID;
-                    id = i;
-                    hwThreadPool[id].apicId = i;//extractBitField(ebx,8,24);
-
-                    /* ThreadId is extracted from th apicId using the bit width
-                     * of the number of logical processors
-                     * */
-                    hwThreadPool[id].threadId =
-                        extractBitField(hwThreadPool[id].apicId,
-                                getBitFieldWidth(maxNumLogicalProcsPerCore),0); 
-
-                    /* CoreId is extracted from th apicId using the bitWidth 
-                     * of the number of logical processors as offset and the
-                     * bit width of the number of cores as width
-                     * */
-                    hwThreadPool[id].coreId =
-                        extractBitField(hwThreadPool[id].apicId,
-                                getBitFieldWidth(maxNumCores),
-                                getBitFieldWidth(maxNumLogicalProcsPerCore)); 
-
-                    hwThreadPool[id].packageId =
-                        extractBitField(hwThreadPool[id].apicId,
-                                8-getBitFieldWidth(maxNumLogicalProcs),
-                                getBitFieldWidth(maxNumLogicalProcs));
-                    DEBUG_PRINT(DEBUGLEV_DEVELOP, I[%d] ID[%d] APIC[%d] T[%d] C[%d] P [%d], i, id,
-                                    hwThreadPool[id].apicId, hwThreadPool[id].threadId,
-                                    hwThreadPool[id].coreId, hwThreadPool[id].packageId);
-                }
+                scan.maxNumLogicalProcsPerCore = scan.maxNumLogicalProcs/scan.maxNumCores;
+                scan.method = CPUID_TOPO_LEGACY_INTEL;
                 break;
 
             case K8_FAMILY:
@@ -670,50 +836,14 @@ void cpuid_init_nodeTopology(cpu_set_t cpuSet)
                  * Legacy method */
                 /*FIXME: This is a bit of a hack */
 
-                maxNumLogicalProcsPerCore = 1;
-                maxNumLogicalProcs = 1;
+                scan.maxNumLogicalProcsPerCore = 1;
+                scan.maxNumLogicalProcs = 1;
 
                 eax = 0x80000008;
                 CPUID;
 
-                maxNumCores =  extractBitField(ecx,8,0)+1;
-
-                for (uint32_t i=0; i<  cpuid_topology.numHWThreads; i++)
-                {
-                    int id;
-                    CPU_ZERO(&set);
-                    CPU_SET(i,&set);
-                    sched_setaffinity(0, sizeof(cpu_set_t), &set);
-
-                    eax = 0x01;
-                    CPUID;
-                    id = extractBitField(ebx,8,24);
-                    hwThreadPool[id].apicId = extractBitField(ebx,8,24);
-
-                    /* ThreadId is extracted from th apicId using the bit width
-                     * of the number of logical processors
-                     * */
-                    hwThreadPool[id].threadId =
-                        extractBitField(hwThreadPool[i].apicId,
-                                getBitFieldWidth(maxNumLogicalProcsPerCore),0); 
-
-                    /* CoreId is extracted from th apicId using the bitWidth 
-                     * of the number of logical processors as offset and the
-                     * bit width of the number of cores as width
-                     * */
-                    hwThreadPool[id].coreId =
-                        extractBitField(hwThreadPool[i].apicId,
-                                getBitFieldWidth(maxNumCores),
-                                0); 
-
-                    hwThreadPool[id].packageId =
-                        extractBitField(hwThreadPool[i].apicId,
-                                8-getBitFieldWidth(maxNumCores),
-                                getBitFieldWidth(maxNumCores));
-                    DEBUG_PRINT(DEBUGLEV_DEVELOP, I[%d] ID[%d] APIC[%d] T[%d] C[%d] P [%d], i, id,
-                                    hwThreadPool[id].apicId, hwThreadPool[id].threadId,
-                                    hwThreadPool[id].coreId, hwThreadPool[id].packageId);
-                }
+                scan.maxNumCores =  extractBitField(ecx,8,0)+1;
+                scan.method = CPUID_TOPO_LEGACY_AMD;
                 break;
 
             case K16_FAMILY:
@@ -726,50 +856,111 @@ void cpuid_init_nodeTopology(cpu_set_t cpuSet)
                 eax = 0x80000008;
                 CPUID;
 
-                width =  extractBitField(ecx,4,12);
+                scan.width =  extractBitField(ecx,4,12);
 
-                if (width == 0)
+                if (scan.width == 0)
                 {
-                    width =  extractBitField(ecx,8,0)+1;
+                    scan.width =  extractBitField(ecx,8,0)+1;
                 }
 
                 eax = 0x01;
                 CPUID;
-                maxNumLogicalProcs =  extractBitField(ebx,8,16);
-                maxNumCores = extractBitField(ecx,8,0)+1;
-
-
-                for (uint32_t i=0; i<  cpuid_topology.numHWThreads; i++)
-                {
-                    int id;
-                    CPU_ZERO(&set);
-                    CPU_SET(i,&set);
-                    sched_setaffinity(0, sizeof(cpu_set_t), &set);
-
-                    eax = 0x01;
-                    CPUID;
-                    id = extractBitField(ebx,8,24);
-                    hwThreadPool[id].apicId = extractBitField(ebx,8,24);
-                    /* AMD only knows cores */
-                    hwThreadPool[id].threadId = 0;
-
-                    hwThreadPool[id].coreId =
-                        extractBitField(hwThreadPool[i].apicId,
-                                width, 0); 
-                    hwThreadPool[id].packageId =
-                        extractBitField(hwThreadPool[i].apicId,
-                                (8-width), width);
-                    DEBUG_PRINT(DEBUGLEV_DEVELOP, I[%d] ID[%d] APIC[%d] T[%d] C[%d] P [%d], i, id,
-                                    hwThreadPool[id].apicId, hwThreadPool[id].threadId,
-                                    hwThreadPool[id].coreId, hwThreadPool[id].packageId);
-                }
+                scan.maxNumLogicalProcs =  extractBitField(ebx,8,16);
+                scan.maxNumCores = extractBitField(ecx,8,0)+1;
+                scan.method = CPUID_TOPO_EXTENDED_AMD;
+                break;
+        }
+    }
 
+    /* One worker per package, the package of a CPU is taken from sysfs. If
+     * it is unknown, the CPUs are split in chunks of CPUID_TOPO_CHUNK */
+    groupIds = (int*) malloc(numThreads * sizeof(int));
+    workers = (CpuidTopoWorker*) calloc(numThreads, sizeof(CpuidTopoWorker));
+    threads = (pthread_t*) malloc(numThreads * sizeof(pthread_t));
+    if ((groupIds == NULL) || (workers == NULL) || (threads == NULL))
+    {
+        ERROR_PLAIN_PRINT(Cannot allocate topology workers);
+        free(groupIds);
+        free(workers);
+        free(threads);
+        free(scan.pool);
+        return -ENOMEM;
+    }
+    for (int i = 0; i < numThreads; i++)
+    {
+        int package = cpuid_packageOfCpu(i);
+        int group;
+        if (package < 0)
+        {
+            package = (i / CPUID_TOPO_CHUNK) + numThreads;
+        }
+        for (group = 0; group < numWorkers; group++)
+        {
+            if (groupIds[group] == package)
+            {
                 break;
+            }
         }
+        if (group == numWorkers)
+        {
+            groupIds[group] = package;
+            workers[group].scan = &scan;
+            workers[group].cpus = (int*) malloc(numThreads * sizeof(int));
+            if (workers[group].cpus == NULL)
+            {
+                ret = -ENOMEM;
+                break;
+            }
+            numWorkers++;
+        }
+        workers[group].cpus[workers[group].numCpus++] = i;
     }
-    cpuid_topology.threadPool = hwThreadPool;
-    
-    return;
+
+    for (int i = 0; (ret == 0) && (i < numWorkers); i++)
+    {
+        workers[i].started = 0;
+        if (pthread_create(&threads[i], NULL, cpuid_topoWorker, &workers[i]) == 0)
+        {
+            workers[i].started = 1;
+        }
+        else
+        {
+            /* Scan the CPUs from the calling thread, topology_init restores
+             * its affinity afterwards */
+            cpuid_topoWorker(&workers[i]);
+        }
+    }
+    for (int i = 0; i < numWorkers; i++)
+    {
+        if (workers[i].started)
+        {
+            pthread_join(threads[i], NULL);
+        }
+        if (workers[i].error < 0)
+        {
+            ret = workers[i].error;
+        }
+        free(workers[i].cpus);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    DEBUG_PRINT(DEBUGLEV_DETAIL, Scanned %d HW threads with %d workers in %.3f ms,
+                numThreads, numWorkers,
+                ((end.tv_sec - start.tv_sec) * 1E3) + ((end.tv_nsec - start.tv_nsec) * 1E-6));
+
+    free(groupIds);
+    free(workers);
+    free(threads);
+    if (ret < 0)
+    {
+        /* A partially filled pool is not used, the caller has to take
+         * another backend */
+        DEBUG_PRINT(DEBUGLEV_INFO, Cannot decode the IDs of all HW threads: %s, strerror(-ret));
+        free(scan.pool);
+        return ret;
+    }
+    cpuid_topology.threadPool = scan.pool;
+
+    return 0;
 }
 
 
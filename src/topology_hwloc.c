@@ -120,7 +120,7 @@ void hwloc_init_cpuInfo(cpu_set_t cpuSet)
     return;
 }
 
-void hwloc_init_nodeTopology(cpu_set_t cpuSet)
+int hwloc_init_nodeTopology(cpu_set_t cpuSet)
 {
     HWThread* hwThreadPool;
     int maxNumLogicalProcs;
@@ -130,6 +130,13 @@ void hwloc_init_nodeTopology(cpu_set_t cpuSet)
     int poolsize = 0;
     int id = 0;
     hwloc_obj_type_t socket_type = HWLOC_OBJ_SOCKET;
+    if (!hwloc_topology)
+    {
+        /* The CPU information was read by another backend */
+        likwid_hwloc_topology_init(&hwloc_topology);
+        likwid_hwloc_topology_set_flags(hwloc_topology, HWLOC_TOPOLOGY_FLAG_WHOLE_IO );
+        likwid_hwloc_topology_load(hwloc_topology);
+    }
     for (uint32_t i=0;i<cpuid_topology.numHWThreads;i++)
     {
         if (CPU_ISSET(i, &cpuSet))
@@ -207,7 +214,7 @@ void hwloc_init_nodeTopology(cpu_set_t cpuSet)
 
     cpuid_topology.threadPool = hwThreadPool;
 
-    return;
+    return 0;
 }
 
 
@@ -307,9 +314,9 @@ void hwloc_init_cpuFeatures(void)
     return;
 }
 
-void hwloc_init_nodeTopology(void)
+int hwloc_init_nodeTopology(cpu_set_t cpuSet)
 {
-    return;
+    return 0;
 }
 
 void hwloc_init_cacheTopology(void)
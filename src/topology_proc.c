@@ -396,7 +396,7 @@ void proc_init_cpuFeatures(void)
 
 
 
-void proc_init_nodeTopology(cpu_set_t cpuSet)
+int proc_init_nodeTopology(cpu_set_t cpuSet)
 {
     HWThread* hwThreadPool;
     FILE *fp;
@@ -449,7 +449,7 @@ void proc_init_nodeTopology(cpu_set_t cpuSet)
                             hwThreadPool[i].packageId)
     }
     cpuid_topology.threadPool = hwThreadPool;
-    return;
+    return 0;
 }
 
 void proc_init_cacheTopology(void)
@@ -1,17 +1,37 @@
 #include <stdio.h>
 #include <omp.h>
 
-#ifdef PERFMON
 #include <likwid.h>
-#endif
 
 #define SIZE 1000000
-#define N1   1000
-#define N2   300
-#define N3   500
+#define N1   10
+#define N2   3
 
 double sum = 0, a[SIZE], b[SIZE], c[SIZE];
 
+void triad(double alpha)
+{
+    LIKWID_MARKER_START("triad");
+    for (int i=0; i<SIZE; i++)
+    {
+        a[i] = b[i] + alpha * c[i];
+        sum += a[i];
+    }
+    LIKWID_MARKER_STOP("triad");
+}
+
+/* Recursive calls are accounted once to the running region "recursion" */
+void recursion(int depth, double alpha)
+{
+    LIKWID_MARKER_START("recursion");
+    triad(alpha);
+    if (depth > 0)
+    {
+        recursion(depth-1, alpha);
+    }
+    LIKWID_MARKER_STOP("recursion");
+}
+
 main()
 {
     double alpha = 3.14;
@@ -26,29 +46,25 @@ main()
 
     LIKWID_MARKER_INIT;
 
-#pragma omp parallel for num_threads(num_tasks) 
-        for (int task = 0; task<num_dels+1; task++) { 
-            if (task==0) { 
-#pragma omp parallel for num_threads(num_threads) 
-                for (thread_num=0; thread_num < num_threads; thread_num++) { 
-                    cpu_set_t set; 
-                    CPU_ZERO(&set); 
-                    CPU_SET(...) 
-                    sched_setaffinity(0, sizeof(cpu_set_t), &set); 
-
-                    /**... work ...**/ 
-                } //barrier 
-
-                /**...unmeasured work **/ 
-            } else { //task==1,2 
-                cpu_set_t set; 
-                CPU_ZERO(&set); 
-                CPU_SET(...) 
-                sched_setaffinity(0, sizeof(cpu_set_t), &set); 
-
-                /**... work... **/ 
-            } 
-        } 
+#pragma omp parallel
+    {
+        LIKWID_MARKER_THREADINIT;
+        /* Results in the regions outer, outer/triad, outer/inner, outer/inner/triad,
+         * outer/recursion and outer/recursion/triad */
+        LIKWID_MARKER_START("outer");
+        for (int j=0; j<N1; j++)
+        {
+            triad(alpha);
+            LIKWID_MARKER_START("inner");
+            for (int k=0; k<N2; k++)
+            {
+                triad(alpha);
+            }
+            LIKWID_MARKER_STOP("inner");
+        }
+        recursion(N2, alpha);
+        LIKWID_MARKER_STOP("outer");
+    }
 
     LIKWID_MARKER_CLOSE;
     printf( "OK, dofp result = %e\n", sum);